@@ -1,12 +1,12 @@
 # Install pathology application
 if(APPLE)
 	install(
-		TARGETS fastpathology
+		TARGETS fastpathology fastpathology-cli
 		DESTINATION ../MacOS/bin
 	)
 else()
 	install(
-		TARGETS fastpathology
+		TARGETS fastpathology fastpathology-cli
 		DESTINATION bin
 	)
 endif()
@@ -1,1373 +1,415 @@
-#include <FAST/Testing.hpp>
-#include <FAST/Algorithms/NeuralNetwork/SegmentationNetwork.hpp>
-#include <FAST/Importers/ImageFileImporter.hpp>
-#include <FAST/Visualization/SimpleWindow.hpp>
-#include <FAST/Streamers/ImageFileStreamer.hpp>
-#include <FAST/Algorithms/NeuralNetwork/InferenceEngineManager.hpp>
-#include <fstream>
-#include <FAST/Algorithms/ImagePatch/PatchGenerator.hpp>
-#include <FAST/Algorithms/ImagePatch/PatchStitcher.hpp>
-#include <FAST/Importers/WholeSlideImageImporter.hpp>
-#include <FAST/Algorithms/TissueSegmentation/TissueSegmentation.hpp>
 #include <FAST/Tools/CommandLineParser.hpp>
-#include <FAST/Algorithms/ImagePatch/ImageToBatchGenerator.hpp>
-#include <FAST/Algorithms/ImageResizer/ImageResizer.hpp>
-#include <FAST/Data/ImagePyramid.hpp>
-#include <FAST/Algorithms/NeuralNetwork/TensorToSegmentation.hpp>
-#include <FAST/Algorithms/NeuralNetwork/BoundingBoxNetwork.hpp>
-#include <FAST/Data/BoundingBox.hpp>
+#include <FAST/Pipeline.hpp>
+#include <FAST/Utility.hpp>
+#include <FAST/Config.hpp>
+#include <FAST/DeviceManager.hpp>
+#include <FAST/Importers/WholeSlideImageImporter.hpp>
+#include <FAST/Algorithms/NeuralNetwork/NeuralNetwork.hpp>
+#include <FAST/Algorithms/NeuralNetwork/InferenceEngineManager.hpp>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSysInfo>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <thread>
+#include "source/logic/PipelineRuntime.h"
 
 using namespace fast;
 
-int main(int argc, char** argv) {
-    Reporter::setGlobalReportMethod(Reporter::INFO, Reporter::NONE);
-
-    CommandLineParser parser("Measure neural network performance script");
-    parser.addOption("disable-case-1");
-    parser.addOption("disable-case-2");
-    parser.addOption("disable-case-3");
-    parser.addOption("disable-case-4");
-    parser.addOption("disable-case-3a");
-    parser.addOption("disable-case-4a");
-    parser.addOption("disable-case-1-batch");
-    parser.addOption("disable-case-1_inceptionv3");
-    //parser.addOption("disable-case-3-batch");
-    parser.addOption("disable-warmup");
-    parser.parse(argc, argv);
-    const int iterations = 10;  //10;
-    const bool warmupIteration = !parser.getOption("disable-warmup");
-    const bool case1 = !parser.getOption("disable-case-1");
-    const bool case2 = !parser.getOption("disable-case-2");
-    const bool case3 = !parser.getOption("disable-case-3");
-    const bool case4 = !parser.getOption("disable-case-4");
-    const bool case3a = !parser.getOption("disable-case-3a");
-    const bool case4a = !parser.getOption("disable-case-4a");
-    const bool case1_batch = !parser.getOption("disable-case-1-batch");
-    const bool case1_inceptionv3 = !parser.getOption("disable-case-1_inceptionv3");
-    //const bool case3_batch = !parser.getOption("disable-case-3-batch");
-    const std::string machine = "windows2";  // {windows, windows2, ubuntu}, just for storing results on both machines used in the experiments
-
-
-    if(case1) {
-        std::cout << "\nPatch-wise classification...\n" << std::endl;
-        // CASE 1 - Patch-wise classification using BACH-model on 20x WSI
-        std::string resultFilename = "../results_" + machine + "/neural-network-runtimes-case-1.csv";
-        if (machine.substr(0, 7) == "windows") {
-            resultFilename = "../" + resultFilename;
-        }
-        std::ofstream file(resultFilename.c_str());
-
-        std::vector<int> img_size {512, 512};
-        int patch_level = 0;
-        int nb_gpus = 1;
-
-        // Write header
-        file << "Engine;Device Type;Iteration;Patch generator AVG;Patch generator STD;NN input AVG;NN input STD;NN inference AVG;NN inference STD;NN output AVG;NN output STD;Patch stitcher AVG;Patch stitcher STD;Total\n";
-
-        auto engines = {"TensorRT", "TensorFlowCUDA", "OpenVINO", "TensorFlowCPU"};
-        if (machine == "windows") {
-            engines = {"OpenVINO", "TensorFlowCPU"};
-		} else if (machine == "windows2") {
-			engines = {"TensorRT", "OpenVINO", "TensorFlowCPU"};
-		}
-        //for(auto &engine : InferenceEngineManager::getEngineList()) {TensorFlowCUDA
-        for(std::string engine : engines) {
-            std::map<std::string, InferenceDeviceType> deviceTypes = {{"ANY", InferenceDeviceType::ANY}};
-            if(engine == "OpenVINO") {
-                // On OpenVINO, try all device types
-                deviceTypes = std::map<std::string, InferenceDeviceType>{
-                        {"CPU", InferenceDeviceType::CPU},
-                        //{"GPU", InferenceDeviceType::GPU},
-                        //{"VPU", InferenceDeviceType::VPU},
-                };
-                if (machine.substr(0, 7) == "windows") {
-                    deviceTypes = std::map<std::string, InferenceDeviceType>{
-                        {"CPU", InferenceDeviceType::CPU},
-                        {"GPU", InferenceDeviceType::GPU},
-                        //{"VPU", InferenceDeviceType::VPU},
-                };
-                }
-            }
-            for(auto &&deviceType : deviceTypes) {
-                std::cout << engine << " for device type " << deviceType.first << std::endl;
-                std::cout << "====================================" << std::endl;
-
-                for(int currDevice = 0; currDevice <= nb_gpus; ++currDevice) {  // for each GPU
-                    //if (!((engine == "TensorRT") || (engine == "TensorFlowCUDA")) && (currDevice > 0))
-                    if (!((engine == "TensorRT")) && (currDevice > 0))
-                        break;
-
-                    std::cout << "Current device (GPU): " << currDevice << std::endl;
-                    std::cout << "//////////////////////////////" << std::endl;
-
-                    for (int iteration = 0; iteration <= iterations; ++iteration) {
-                        auto importer = WholeSlideImageImporter::create();
-						if (machine == "windows") {
-							importer->setFilename("C:/Users/andrep/workspace/FAST-Pathology_old/A05.svs");
-						} else if (machine == "windows2") {
-							importer->setFilename("C:/Users/andrp/workspace/FAST-Pathology/A05.svs");
-                        } else {
-                            importer->setFilename(Config::getTestDataPath() + "/WSI/A05.svs");
-                        }
-
-                        auto tissueSegmentation = TissueSegmentation::create();
-                        tissueSegmentation->setInputConnection(importer->getOutputPort());
-
-                        auto generator = PatchGenerator::create();
-                        generator->setPatchSize(img_size[0], img_size[1]);
-                        generator->setPatchLevel(patch_level);
-                        generator->setInputConnection(importer->getOutputPort());
-                        generator->setInputConnection(1, tissueSegmentation->getOutputPort());
-                        generator->enableRuntimeMeasurements();
-
-                        auto network = NeuralNetwork::create();
-                        network->setInferenceEngine(engine);
-                        if (engine != "TensorRT") {
-                        //if (!((engine == "TensorRT") || (engine == "TensorFlowCUDA"))) {
-                            network->getInferenceEngine()->setDevice(1);
-                        } else {
-                            network->getInferenceEngine()->setDevice(currDevice);
-                        }
-                        std::string postfix;
-                        if (engine.substr(0, 10) == "TensorFlow") {
-                            network->setInputNode(0, "input_1", NodeType::IMAGE,
-                                                  TensorShape({1, img_size[0], img_size[1], 3}));
-                            network->setOutputNode(0, "dense_1/Softmax", NodeType::TENSOR);
-                        } else if (engine == "TensorRT") {
-                            network->setInputNode(0, "input_1", NodeType::IMAGE,
-                                                  TensorShape{-1, 3, img_size[0], img_size[1]});
-                            network->setOutputNode(0, "dense_1/Softmax", NodeType::TENSOR, TensorShape{-1, 3});
-                        } else if (engine == "OpenVINO") {
-                            network->getInferenceEngine()->setDeviceType(deviceType.second);
-                            if (deviceType.first == "VPU") {
-                                postfix = "_fp16";
-                            }
-                        }
-                        //network->load(Config::getTestDataPath() + "NeuralNetworkModels/wsi_classification" + postfix + "." + network->getInferenceEngine()->getDefaultFileExtension());
-                        if (machine == "ubuntu") {
-                            network->load("/home/andrep/FastPathology/data/Models/mobilenet_v2_bach_model" + postfix + "." +
-                                      network->getInferenceEngine()->getDefaultFileExtension());
-                        }
-                        else if (machine == "windows") {
-                            network->load("C:/Users/andrep/FastPathology/data/Models/mobilenet_v2_bach_model" + postfix + "." +
-                                      network->getInferenceEngine()->getDefaultFileExtension());
-						}
-						else {
-							network->load("C:/Users/andrp/FastPathology/data/Models/mobilenet_v2_bach_model" + postfix + "." +
-								network->getInferenceEngine()->getDefaultFileExtension());
-						}
-                        network->setInputConnection(generator->getOutputPort());
-                        network->setScaleFactor(1.0f / 255.0f);
-                        network->enableRuntimeMeasurements();
-
-                        auto stitcher = PatchStitcher::create();
-                        stitcher->setInputConnection(network->getOutputPort());
-                        stitcher->enableRuntimeMeasurements();
-
-                        auto start = std::chrono::high_resolution_clock::now();
-                        DataObject::pointer data;
-                        do {
-                            data = stitcher->updateAndGetOutputData<DataObject>();
-                        } while (!data->isLastFrame());
-
-                        std::chrono::duration<float, std::milli> timeUsed =
-                                std::chrono::high_resolution_clock::now() - start;
-                        std::cout << "Total runtime: " << timeUsed.count() << std::endl;
-                        std::cout << "Patch generator runtime: " << std::endl;
-                        generator->getRuntime("create patch")->print();
-                        std::cout << "NN runtime: " << std::endl;
-                        network->getRuntime()->print();
-                        std::cout << "Patch stitcher runtime: " << std::endl;
-                        stitcher->getRuntime()->print();
-
-                        if (iteration == 0 && warmupIteration)
-                            continue;
-
-                        auto deviceUsed = deviceType.first;
-                        if ((engine == "TensorRT") || (engine == "TensorFlowCUDA")) {
-                            deviceUsed = deviceType.first + std::to_string(currDevice);
-                        } else {
-                            deviceUsed = deviceType.first;
-                        }
-
-                        //network->stopPipeline();  // free memory when finished
-
-                        file <<
-                             engine + ";" +
-                             deviceUsed + ";" +  //deviceType.first + ";" +
-                             std::to_string(iteration) + ";" +
-                             std::to_string(generator->getRuntime("create patch")->getAverage()) + ";" +
-                             std::to_string(generator->getRuntime("create patch")->getStdDeviation()) + ";" +
-                             std::to_string(network->getRuntime("input_processing")->getAverage()) + ";" +
-                             std::to_string(network->getRuntime("input_processing")->getStdDeviation()) + ";" +
-                             std::to_string(network->getRuntime("inference")->getAverage()) + ";" +
-                             std::to_string(network->getRuntime("inference")->getStdDeviation()) + ";" +
-                             std::to_string(network->getRuntime("output_processing")->getAverage()) + ";" +
-                             std::to_string(network->getRuntime("output_processing")->getStdDeviation()) + ";" +
-                             std::to_string(stitcher->getRuntime("stitch patch")->getAverage()) + ";" +
-                             std::to_string(stitcher->getRuntime("stitch patch")->getStdDeviation()) + ";" +
-                             std::to_string(timeUsed.count())
-                             << std::endl;
-                    }
-                }
-            }
-        }
+/**
+ * Benchmark of FastPathology pipelines (.fpl), driven by a JSON config file, see benchmark.json.
+ *
+ * Every combination of slide, engine, device type, device, patch size, level and batch size of a case is run
+ * warmup + iterations times. The values are given to the pipeline as variables, e.g. $engine$ and $patch_size$, see
+ * pipelines/patch_classification.fpl. Axes which are not given in the config are not passed to the pipeline.
+ *
+ * The results are written as JSON with the environment, the runtime of each stage of each run (as in runtime.json of
+ * results) and a summary per combination. If a baseline (an earlier result file) is given, the throughput of each
+ * combination is compared to it, and the exit code is nonzero if any combination is slower than the tolerance allows.
+ */
+
+// Exit codes, so that CI can tell regressions apart from broken configs
+enum ExitCode {
+    EXIT_CODE_OK = 0,
+    EXIT_CODE_INVALID_ARGUMENTS = 1,
+    EXIT_CODE_REGRESSION = 2,
+    EXIT_CODE_RUN_FAILED = 3,
+};
+
+// Pipeline variables set by the config, in the order they are iterated
+static const std::vector<std::string> axes = {"engine", "device_type", "device", "patch_size", "level", "batch_size"};
+
+/**
+ * Values of an axis of a case; a single value or a list. A single empty value if not given, so that the axis is
+ * skipped when iterating.
+ */
+static std::vector<std::string> getAxisValues(const QJsonObject& object, const std::string& axis) {
+    std::vector<std::string> values;
+    auto toString = [](const QJsonValue& value) {
+        if(value.isDouble())
+            return std::to_string(value.toInt());
+        return value.toString().toStdString();
+    };
+    // Config keys are plural, e.g. engines, device_types, patch_sizes
+    const QJsonValue value = object[QString::fromStdString(axis + "s")];
+    if(value.isArray()) {
+        for(auto item : value.toArray())
+            values.push_back(toString(item));
+    } else if(!value.isUndefined()) {
+        values.push_back(toString(value));
     }
+    if(values.empty())
+        values.push_back("");
+    return values;
+}
 
-
-    if(case2) {
-        std::cout << "\nLow-res semantic segmentation...\n" << std::endl;
-        // CASE 2 - Low-res semantic segmentation of nuclei on 20x WSI
-        const std::string resultFilename = "../results_" + machine + "neural-network-runtimes-case-2.csv";
-        std::ofstream file(resultFilename.c_str());
-
-        std::vector<int> img_size {1024, 1024};
-        int patch_level = 1;
-        int nb_gpus = 1;
-
-        // Write header
-        file << "Engine;Device Type;Iteration;Image Read AVG;Image Read STD;Resize AVG;Resize STD;NN input AVG;NN input STD;NN inference AVG;NN inference STD;NN output AVG;NN output STD;Convert AVG;Convert STD;Resize Back AVG;Resize Back STD;Total\n";
-
-        //for(auto &engine : InferenceEngineManager::getEngineList()) {
-        for(std::string engine : {"TensorFlowCUDA", "OpenVINO", "TensorFlowCPU"}) {  // {"TensorFlowCUDA", "OpenVINO", "TensorFlowCPU"}) {
-            std::map<std::string, InferenceDeviceType> deviceTypes = {{"ANY", InferenceDeviceType::ANY}};
-            if(engine == "OpenVINO") {
-                // On OpenVINO, try all device types
-                deviceTypes = std::map<std::string, InferenceDeviceType>{
-                        {"CPU", InferenceDeviceType::CPU},
-                        //{"GPU", InferenceDeviceType::GPU},
-                        //{"VPU", InferenceDeviceType::VPU},
-                };
-            }
-            for(auto &&deviceType : deviceTypes) {
-                std::cout << engine << " for device type " << deviceType.first << std::endl;
-                std::cout << "====================================" << std::endl;
-
-                for(int currDevice = 0; currDevice < nb_gpus; ++currDevice) {  // for each GPU
-                    //if (!((engine == "TensorRT") || (engine == "TensorFlowCUDA")) && (currDevice > 0))
-                    //    break;
-
-                    std::cout << "Current device (GPU): " << currDevice << std::endl;
-                    std::cout << "//////////////////////////////" << std::endl;
-                    for (int iteration = 0; iteration <= iterations; ++iteration) {  // run N number of times
-                        auto importer = WholeSlideImageImporter::create();
-                        importer->setFilename(Config::getTestDataPath() + "/WSI/A05.svs");
-                        importer->enableRuntimeMeasurements();
-
-                        auto m_image = importer->updateAndGetOutputData<ImagePyramid>();
-                        auto access = m_image->getAccess(ACCESS_READ);
-                        //auto input = access->getLevelAsImage(m_image->getNrOfLevels()-1);
-                        auto input = access->getLevelAsImage(patch_level); //m_image->getNrOfLevels()-1); // FIXME: Should automatically find best suitable magn.lvl.
-                        importer->update();
-
-                        // resize
-                        ImageResizer::pointer resizer = ImageResizer::create();
-                        resizer->setInputData(input);
-                        resizer->setWidth(img_size[0]);
-                        resizer->setHeight(img_size[1]);
-                        resizer->enableRuntimeMeasurements();
-                        auto port = resizer->getOutputPort();
-                        resizer->update();
-                        //Image::pointer resized = port->getNextFrame<Image>();
-
-                        auto network = SegmentationNetwork::create();
-                        network->setInferenceEngine(engine);
-                        network->getInferenceEngine()->setDevice(1);
-                        std::string postfix;
-                        if (engine.substr(0, 10) == "TensorFlow") {
-                            network->setInputNode(0, "input_1", NodeType::IMAGE,
-                                                  TensorShape({1, img_size[0], img_size[1], 3}));
-                            network->setOutputNode(0, "conv2d_34/truediv", NodeType::TENSOR,
-                                                   {1, img_size[0], img_size[1], 2});
-                        } else if (engine == "TensorRT") {
-                            network->setInputNode(0, "input_1", NodeType::IMAGE,
-                                                  TensorShape{-1, 3, img_size[0], img_size[1]});
-                            network->setOutputNode(0, "dense_1/Softmax", NodeType::TENSOR, TensorShape{-1, 3});
-                        } else if (engine == "OpenVINO") {
-                            //network->setInputNode(0, "input_1", NodeType::IMAGE, TensorShape({1, img_size[0], img_size[1], 3}));
-                            //network->setOutputNode(0, "conv2d_34/truediv", NodeType::TENSOR, TensorShape({1, img_size[0], img_size[1], 2}));
-                            network->getInferenceEngine()->setDeviceType(deviceType.second);
-                            if (deviceType.first == "VPU") {
-                                postfix = "_fp16";
-                            }
-                        }
-                        //network->setInputNode(0, "input_1", NodeType::IMAGE, {1, img_size[0], img_size[1], 3});
-                        //network->setOutputNode(0, "conv2d_34/truediv", NodeType::TENSOR, {1, img_size[0], img_size[1], 2});
-                        network->load("/home/andrep/FastPathology/data/Models/low_res_tumor_unet." +
-                                      network->getInferenceEngine()->getDefaultFileExtension());
-                        //network->setInputData(resizer->updateAndGetOutputData<Image>());  // FIXME: This hangs, use solution below instead
-                        network->setInputData(port->getNextFrame<Image>());
-                        network->setScaleFactor(1.0f / 255.0f);   // 1.0f/255.0f
-                        network->enableRuntimeMeasurements();
-
-                        auto converter = TensorToSegmentation::create();  // FIXME: This is where it hangs for whatever reason... And only with openvino IE (not TF)
-                        converter->setInputConnection(network->getOutputPort());
-                        converter->enableRuntimeMeasurements();
-                        //converter->update();
-
-                        /*
-                        if ((engine == "TensorRT") || (engine == "OpenVINO")) {
-                            converter->setNCHW(true);
-                        }
-                         */
-
-                        // resize back
-                        ImageResizer::pointer resizer2 = ImageResizer::create();
-                        resizer2->setInputData(converter->updateAndGetOutputData<Image>());
-                        resizer2->setWidth(input->getWidth());
-                        resizer2->setHeight(input->getHeight());
-                        resizer2->enableRuntimeMeasurements();
-
-                        auto port2 = resizer2->getOutputPort();
-                        resizer2->update();
-
-                        auto m_tumorMap = port2->getNextFrame<Image>();
-                        m_tumorMap->setSpacing((float) m_image->getFullHeight() / (float) input->getHeight(), (float) m_image->getFullWidth() / (float) input->getWidth(), 1.0f);
-
-
-                        /*
-                        auto start = std::chrono::high_resolution_clock::now();
-                        //network->update();
-                        //auto m_tumorMap = port2->getNextFrame<Image>();
-                        //network->update();
-                        //resizer2->update();
-                        std::chrono::duration<float, std::milli> timeUsed = std::chrono::high_resolution_clock::now() - start;
-                         */
-
-                        //std::chrono::duration<float, std::milli>
-
-                        auto timeUsed = importer->getRuntime()->getAverage() +
-                                        resizer->getRuntime()->getAverage() +
-                                        network->getRuntime()->getAverage() +
-                                        converter->getRuntime()->getAverage() +
-                                        resizer2->getRuntime()->getAverage();
-
-                        /*
-                        std::cout << "Total runtime: " << timeUsed.count() << std::endl;
-                        std::cout << "Patch generator runtime: " << patch_time << std::endl;
-                        //resizer->getAllRuntimes()->printAll();
-                        //resizer->getRuntime()->print();
-                        std::cout << "NN runtime: " << nn_time << std::endl;
-                        //network->getRuntime()->print();
-                        std::cout << "Patch stitcher runtime: " << std::endl;
-                        resizer2->getRuntime()->print();
-                         */
-
-                        std::cout << "\nTotal runtime: " << timeUsed << std::endl;
-                        std::cout << "Read image runtime: " << importer->getRuntime()->getAverage() << std::endl;
-                        std::cout << "Resize runtime: " << resizer->getRuntime()->getAverage() << std::endl;
-                        std::cout << "NN runtime: " << network->getRuntime()->getAverage() << std::endl;
-                        std::cout << "Convert to segmentation runtime: " << converter->getRuntime()->getAverage() << std::endl;
-                        std::cout << "Resize back runtime: " << resizer2->getRuntime()->getAverage() << std::endl;
-                        //resizer2->getRuntime()->print();
-
-                        if (iteration == 0 && warmupIteration)
-                            continue;
-
-                        auto deviceUsed = deviceType.first;
-                        if ((engine == "TensorRT") || (engine == "TensorFlowCUDA")) {
-                            deviceUsed = deviceType.first + std::to_string(currDevice);
-                        } else {
-                            deviceUsed = deviceType.first;
-                        }
-
-                        file <<
-                             engine + ";" +
-                             deviceUsed + ";" +  // deviceType.first + ";" +
-                             std::to_string(iteration) + ";" +
-                             std::to_string(importer->getRuntime()->getAverage()) + ";" +
-                             std::to_string(importer->getRuntime()->getStdDeviation()) + ";" +
-                             std::to_string(resizer->getRuntime()->getAverage()) + ";" +
-                             std::to_string(resizer->getRuntime()->getStdDeviation()) + ";" +
-                             std::to_string(network->getRuntime("input_processing")->getAverage()) + ";" +
-                             std::to_string(network->getRuntime("input_processing")->getStdDeviation()) +
-                             ";" +
-                             std::to_string(network->getRuntime("inference")->getAverage()) + ";" +
-                             std::to_string(network->getRuntime("inference")->getStdDeviation()) + ";" +
-                             std::to_string(network->getRuntime("output_processing")->getAverage()) + ";" +
-                             std::to_string(network->getRuntime("output_processing")->getStdDeviation()) +
-                             ";" +
-                             std::to_string(converter->getRuntime()->getAverage()) + ";" +
-                             std::to_string(converter->getRuntime()->getStdDeviation()) + ";" +
-                             std::to_string(resizer2->getRuntime()->getAverage()) + ";" +
-                             std::to_string(resizer2->getRuntime()->getStdDeviation()) + ";" +
-                             std::to_string(timeUsed)  // std::to_string(timeUsed.count())
-                             << std::endl;
-                    }
-                }
+/**
+ * All combinations of the axes of a case, as pipeline variables.
+ */
+static std::vector<std::map<std::string, std::string>> getCombinations(const QJsonObject& caseObject) {
+    std::vector<std::map<std::string, std::string>> combinations = {{}};
+    for(const auto& axis : axes) {
+        std::vector<std::map<std::string, std::string>> next;
+        for(const auto& combination : combinations) {
+            for(const auto& value : getAxisValues(caseObject, axis)) {
+                auto variables = combination;
+                if(!value.empty())
+                    variables[axis] = value;
+                next.push_back(variables);
             }
         }
+        combinations = next;
     }
+    return combinations;
+}
 
-
-    if(case3) {
-        std::cout << "\nPatch-wise high-res semantic segmentation...\n" << std::endl;
-        // CASE 3 - Patch-wise high-res semantic segmentation on 20x WSI (of nuceli)
-        const std::string resultFilename = "../results_" + machine + "neural-network-runtimes-case-3.csv";
-        std::ofstream file(resultFilename.c_str());
-
-        std::vector<int> img_size{512, 512};
-        int patch_level = 0;
-
-        // Write header
-        file << "Engine;Device Type;Iteration;Patch generator AVG;Patch generator STD;NN input AVG;NN input STD;NN inference AVG;NN inference STD;NN output AVG;NN output STD;Patch stitcher AVG;Patch stitcher STD;Total\n";
-
-        //for(auto &engine : InferenceEngineManager::getEngineList()) {
-        for (std::string engine : {"TensorFlowCUDA", "OpenVINO", "TensorFlowCPU"}) {
-            std::map<std::string, InferenceDeviceType> deviceTypes = {{"ANY", InferenceDeviceType::ANY}};
-            if (engine == "OpenVINO") {
-                // On OpenVINO, try all device types
-                deviceTypes = std::map<std::string, InferenceDeviceType>{
-                        {"CPU", InferenceDeviceType::CPU},
-                        //{"GPU", InferenceDeviceType::GPU},
-                        //{"VPU", InferenceDeviceType::VPU},
-                };
-            }
-            for (auto &&deviceType : deviceTypes) {
-                std::cout << engine << " for device type " << deviceType.first << std::endl;
-                std::cout << "====================================" << std::endl;
-
-                for (int iteration = 0; iteration <= iterations; ++iteration) {
-                    auto importer = WholeSlideImageImporter::create();
-                    importer->setFilename(Config::getTestDataPath() + "/WSI/A05.svs");
-
-                    auto tissueSegmentation = TissueSegmentation::create();
-                    tissueSegmentation->setInputConnection(importer->getOutputPort());
-
-                    auto generator = PatchGenerator::create();
-                    generator->setPatchSize(img_size[0], img_size[1]);
-                    generator->setPatchLevel(patch_level);
-                    generator->setInputConnection(importer->getOutputPort());
-                    generator->setInputConnection(1, tissueSegmentation->getOutputPort());
-                    generator->enableRuntimeMeasurements();
-
-                    auto network = SegmentationNetwork::create();
-                    network->setInferenceEngine(engine);
-                    network->getInferenceEngine()->setDevice(1);
-                    std::string postfix;
-                    if (engine.substr(0, 10) == "TensorFlow") {
-                        network->setOutputNode(0, "conv2d_26/truediv", NodeType::TENSOR);
-                    } else if (engine == "TensorRT") {
-                        network->setInputNode(0, "input_1", NodeType::IMAGE,
-                                              TensorShape{-1, 3, img_size[0], img_size[1]});
-                        network->setOutputNode(0, "conv2d_26/truediv", NodeType::TENSOR, TensorShape{-1, 3});
-                    } else if (engine == "OpenVINO") {
-                        network->getInferenceEngine()->setDeviceType(deviceType.second);
-                        if (deviceType.first == "VPU") {
-                            postfix = "_fp16";
-                        }
-                    }
-                    //network->load(Config::getTestDataPath() + "NeuralNetworkModels/wsi_classification" + postfix + "." + network->getInferenceEngine()->getDefaultFileExtension());
-                    network->load("/home/andrep/FastPathology/data/Models/high_res_nuclei_unet" + postfix + "." + network->getInferenceEngine()->getDefaultFileExtension());
-                    network->setInputConnection(generator->getOutputPort());
-                    network->setScaleFactor(1.0f / 255.0f);
-                    network->enableRuntimeMeasurements();
-
-                    auto stitcher = PatchStitcher::create();
-                    stitcher->setInputConnection(network->getOutputPort());
-                    stitcher->enableRuntimeMeasurements();
-
-                    auto start = std::chrono::high_resolution_clock::now();
-                    DataObject::pointer data;
-                    do {
-                        data = stitcher->updateAndGetOutputData<DataObject>();
-                    } while (!data->isLastFrame());
-                    std::chrono::duration<float, std::milli> timeUsed =
-                            std::chrono::high_resolution_clock::now() - start;
-                    std::cout << "Total runtime: " << timeUsed.count() << std::endl;
-                    std::cout << "Patch generator runtime: " << std::endl;
-                    generator->getRuntime("create patch")->print();
-                    std::cout << "NN runtime: " << std::endl;
-                    network->getRuntime()->print();
-                    std::cout << "Patch stitcher runtime: " << std::endl;
-                    stitcher->getRuntime()->print();
-
-                    if (iteration == 0 && warmupIteration)
-                        continue;
-
-                    file <<
-                         engine + ";" +
-                         deviceType.first + ";" +
-                         std::to_string(iteration) + ";" +
-                         std::to_string(generator->getRuntime("create patch")->getAverage()) + ";" +
-                         std::to_string(generator->getRuntime("create patch")->getStdDeviation()) + ";" +
-                         std::to_string(network->getRuntime("input_processing")->getAverage()) + ";" +
-                         std::to_string(network->getRuntime("input_processing")->getStdDeviation()) + ";" +
-                         std::to_string(network->getRuntime("inference")->getAverage()) + ";" +
-                         std::to_string(network->getRuntime("inference")->getStdDeviation()) + ";" +
-                         std::to_string(network->getRuntime("output_processing")->getAverage()) + ";" +
-                         std::to_string(network->getRuntime("output_processing")->getStdDeviation()) + ";" +
-                         std::to_string(stitcher->getRuntime("stitch patch")->getAverage()) + ";" +
-                         std::to_string(stitcher->getRuntime("stitch patch")->getStdDeviation()) + ";" +
-                         std::to_string(timeUsed.count())
-                         << std::endl;
-                }
-            }
-        }
+/**
+ * Identifies a combination of a case and slide, used to match runs with the baseline.
+ */
+static std::string getKey(const std::string& caseName, const std::string& slide, const std::map<std::string, std::string>& variables) {
+    std::string key = caseName + "|" + QFileInfo(QString::fromStdString(slide)).fileName().toStdString();
+    for(const auto& axis : axes) {
+        key += "|";
+        if(variables.count(axis) > 0)
+            key += variables.at(axis);
     }
+    return key;
+}
 
-    if(case4) {
-        std::cout << "\nPatch-wise object detection and classification...\n" << std::endl;
-        // CASE 4 - Patch-wise object detection and classification 20x WSI of nuclei (ODAC)
-        const std::string resultFilename = "../results_" + machine + "neural-network-runtimes-case-4.csv";
-        std::ofstream file(resultFilename.c_str());
-
-        std::vector<int> img_size {256, 256};
-        int patch_level = 0;
-        int nb_classes = 1;
-        int nb_anchors = 3;
-
-        // Write header
-        file << "Engine;Device Type;Iteration;Patch generator AVG;Patch generator STD;NN input AVG;NN input STD;NN inference AVG;NN inference STD;NN output AVG;NN output STD;Patch stitcher AVG;Patch stitcher STD;Total\n";
-
-        //for(auto &engine : InferenceEngineManager::getEngineList()) {
-        //for(std::string engine : {"TensorFlowCUDA", "TensorRT", "OpenVINO", "TensorFlowCPU"}) {
-        for(std::string engine : {"TensorFlowCUDA", "OpenVINO", "TensorFlowCPU"}) {
-            std::map<std::string, InferenceDeviceType> deviceTypes = {{"ANY", InferenceDeviceType::ANY}};
-            if(engine == "OpenVINO") {
-                // On OpenVINO, try all device types
-                deviceTypes = std::map<std::string, InferenceDeviceType>{
-                        {"CPU", InferenceDeviceType::CPU},
-                        //{"GPU", InferenceDeviceType::GPU},
-                        //{"VPU", InferenceDeviceType::VPU},
-                };
-            }
-            for(auto &&deviceType : deviceTypes) {
-                std::cout << engine << " for device type " << deviceType.first << std::endl;
-                std::cout << "====================================" << std::endl;
-
-                for(int iteration = 0; iteration <= iterations; ++iteration) {
-                    auto importer = WholeSlideImageImporter::create();
-                    importer->setFilename(Config::getTestDataPath() + "/WSI/A05.svs");
-
-                    auto tissueSegmentation = TissueSegmentation::create();
-                    tissueSegmentation->setInputConnection(importer->getOutputPort());
-
-                    auto generator = PatchGenerator::create();
-                    generator->setPatchSize(img_size[0], img_size[1]);
-                    generator->setPatchLevel(patch_level);
-                    generator->setInputConnection(importer->getOutputPort());
-                    generator->setInputConnection(1, tissueSegmentation->getOutputPort());
-                    generator->enableRuntimeMeasurements();
-
-                    auto network = BoundingBoxNetwork::create();
-                    network->setThreshold(0.1); //0.01); // default: 0.5
-                    network->setInferenceEngine(engine);
-                    network->getInferenceEngine()->setDevice(1);
-                    std::string postfix;
-                    if(engine.substr(0, 10) == "TensorFlow") {
-                        network->setInputNode(0, "input_1", NodeType::IMAGE, TensorShape{-1, img_size[0], img_size[1], 3});
-                        network->setOutputNode(0, "conv2d_10/BiasAdd", NodeType::TENSOR, TensorShape{-1, 8, 8, (int)(nb_anchors * (nb_classes + 5))});
-                    } else if(engine == "TensorRT") {
-                        network->setInputNode(0, "input_1", NodeType::IMAGE, TensorShape{-1, 3, img_size[0], img_size[1]});
-                        network->setOutputNode(0, "conv2d_10/BiasAdd", NodeType::TENSOR, TensorShape{-1, 8, 8, 18});
-                    } else if(engine == "OpenVINO") {
-                        network->getInferenceEngine()->setDeviceType(deviceType.second);
-                        if(deviceType.first == "VPU") {
-                            postfix = "_fp16";
-                        }
-                    }
-
-                    // read anchors from corresponding anchor file
-                    std::vector<std::vector<Vector2f> > anchors;
-                    std::ifstream infile("/home/andrep/FastPathology/data/Models/yolo_test_model_fixed_output_nodes.anchors");
-                    std::string anchorStr;
-                    while (std::getline(infile, anchorStr)) {
-                        std::vector<std::string> anchorVector = split_custom(anchorStr, " ");
-                        anchorVector.resize(6); // for TinyYOLOv3 should only be 6 pairs, 3 for each level (2 levels)
-                        int cntr = 0;
-                        for (int i = 1; i < 3; i++) { // assumes TinyYOLOv3 (only two output layers)
-                            std::vector<Vector2f> levelAnchors;
-                            for (int j = 0; j < 3; j++) {
-                                auto currentPair = split_custom(anchorVector[cntr], ",");
-                                levelAnchors.push_back(Vector2f(std::stoi(currentPair[0]), std::stoi(currentPair[1])));
-                                cntr++;
-                            }
-                            anchors.push_back(levelAnchors);
-                        }
-                    }
-                    network->setAnchors(anchors); // finally set anchors
-
-                    //network->load(Config::getTestDataPath() + "NeuralNetworkModels/wsi_classification" + postfix + "." + network->getInferenceEngine()->getDefaultFileExtension());
-                    network->load("/home/andrep/FastPathology/data/Models/yolo_test_model_fixed_output_nodes" + postfix + "." + network->getInferenceEngine()->getDefaultFileExtension());
-                    network->setInputConnection(generator->getOutputPort());
-                    network->setScaleFactor(1.0f / 255.0f);
-                    network->enableRuntimeMeasurements();
-
-                    auto boxAccum = BoundingBoxSetAccumulator::create();
-                    //boxAccum->setInputConnection(nms->getOutputPort());
-                    boxAccum->setInputConnection(network->getOutputPort());
-                    boxAccum->enableRuntimeMeasurements();
-
-                    // FIXME: add update of this
-                    // MERGE <- for waiting for threads/syncs
-
-                    auto start = std::chrono::high_resolution_clock::now();
-                    DataObject::pointer data;
-                    do {
-                        data = boxAccum->updateAndGetOutputData<DataObject>();
-                    } while(!data->isLastFrame());
-                    std::chrono::duration<float, std::milli> timeUsed = std::chrono::high_resolution_clock::now() - start;
-                    std::cout << "Total runtime: " << timeUsed.count() << std::endl;
-                    std::cout << "Patch generator runtime: " << std::endl;
-                    generator->getRuntime("create patch")->print();
-                    std::cout << "NN runtime: " << std::endl;
-                    network->getRuntime()->print();
-                    std::cout << "Patch stitcher runtime: " << std::endl;
-                    boxAccum->getRuntime()->print();
-
-                    if(iteration == 0 && warmupIteration)
-                        continue;
-
-                    file <<
-                         engine + ";" +
-                         deviceType.first + ";" +
-                         std::to_string(iteration) + ";" +
-                         std::to_string(generator->getRuntime("create patch")->getAverage()) + ";" +
-                         std::to_string(generator->getRuntime("create patch")->getStdDeviation()) + ";" +
-                         std::to_string(network->getRuntime("input_processing")->getAverage()) + ";" +
-                         std::to_string(network->getRuntime("input_processing")->getStdDeviation()) + ";" +
-                         std::to_string(network->getRuntime("inference")->getAverage()) + ";" +
-                         std::to_string(network->getRuntime("inference")->getStdDeviation()) + ";" +
-                         std::to_string(network->getRuntime("output_processing")->getAverage()) + ";" +
-                         std::to_string(network->getRuntime("output_processing")->getStdDeviation()) + ";" +
-                         std::to_string(boxAccum->getRuntime("stitch patch")->getAverage()) + ";" +
-                         std::to_string(boxAccum->getRuntime("stitch patch")->getStdDeviation()) + ";" +
-                         std::to_string(timeUsed.count())
-                         << std::endl;
-                }
-            }
+static QJsonObject getEnvironment() {
+    QJsonObject environment;
+    environment["date"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+    environment["host"] = QSysInfo::machineHostName();
+    environment["os"] = QSysInfo::prettyProductName();
+    environment["kernel"] = QSysInfo::kernelVersion();
+    environment["cpu_architecture"] = QSysInfo::currentCpuArchitecture();
+    environment["cpu_threads"] = (int)std::thread::hardware_concurrency();
+    QJsonArray engines;
+    for(const auto& engine : InferenceEngineManager::getEngineList())
+        engines.append(QString::fromStdString(engine));
+    environment["engines"] = engines;
+    try {
+        auto device = std::dynamic_pointer_cast<OpenCLDevice>(DeviceManager::getInstance()->getDefaultDevice());
+        if(device) {
+            QJsonObject gpu;
+            gpu["name"] = QString::fromStdString(device->getName());
+            gpu["memory_mb"] = (double)(device->getDevice().getInfo<CL_DEVICE_GLOBAL_MEM_SIZE>() / (1024*1024));
+            gpu["opencl_version"] = QString::fromStdString(device->getDevice().getInfo<CL_DEVICE_VERSION>());
+            environment["gpu"] = gpu;
         }
+    } catch(std::exception &e) {
+        std::cout << "Unable to get GPU information: " << e.what() << std::endl;
     }
+    return environment;
+}
 
-    if(case1_batch) {
-        std::cout << "\nBatch-inference with use-case patch-wise classification...\n" << std::endl;
-        const std::string resultFilename = "../results_" + machine + "neural-network-runtimes-case-1_batch.csv";
-        std::ofstream file(resultFilename.c_str());
-
-        std::vector<int> img_size {512, 512};
-        int patch_level = 0;
-        int nb_gpus = 1;
-        int max_batch_size = 16;
-
-        // Write header
-        file << "Engine;Device Type;Iteration;Patch generator AVG;Patch generator STD;NN input AVG;NN input STD;NN inference AVG;NN inference STD;NN output AVG;NN output STD;Patch stitcher AVG;Patch stitcher STD;Total\n";
-
-        //for(auto &engine : InferenceEngineManager::getEngineList()) {TensorFlowCUDA
-        for(std::string engine : {"TensorFlowCUDA", "OpenVINO", "TensorFlowCPU"}) {
-            std::map<std::string, InferenceDeviceType> deviceTypes = {{"ANY", InferenceDeviceType::ANY}};
-            if(engine == "OpenVINO") {
-                // On OpenVINO, try all device types
-                deviceTypes = std::map<std::string, InferenceDeviceType>{
-                        {"CPU", InferenceDeviceType::CPU},
-                        //{"GPU", InferenceDeviceType::GPU},
-                        //{"VPU", InferenceDeviceType::VPU},
-                };
-            }
-            for(auto &&deviceType : deviceTypes) {
-                std::cout << engine << " for device type " << deviceType.first << std::endl;
-                std::cout << "====================================" << std::endl;
-
-                for(int currDevice = 0; currDevice <= nb_gpus; ++currDevice) {  // for each GPU
-                    //if (!((engine == "TensorRT") || (engine == "TensorFlowCUDA")) && (currDevice > 0))
-                    if (!((engine == "TensorRT")) && (currDevice > 0))
-                        break;
-
-                    std::cout << "Current device (GPU): " << currDevice << std::endl;
-                    std::cout << "//////////////////////////////" << std::endl;
-
-                    for (int iteration = 0; iteration <= iterations; ++iteration) {
-                        auto importer = WholeSlideImageImporter::create();
-                        importer->setFilename(Config::getTestDataPath() + "/WSI/A05.svs");
-
-                        auto tissueSegmentation = TissueSegmentation::create();
-                        tissueSegmentation->setInputConnection(importer->getOutputPort());
-
-                        auto generator = PatchGenerator::create();
-                        generator->setPatchSize(img_size[0], img_size[1]);
-                        generator->setPatchLevel(patch_level);
-                        generator->setInputConnection(importer->getOutputPort());
-                        generator->setInputConnection(1, tissueSegmentation->getOutputPort());
-                        generator->enableRuntimeMeasurements();
-
-                        auto batchGenerator = ImageToBatchGenerator::create();
-                        batchGenerator->setMaxBatchSize(max_batch_size);
-                        batchGenerator->setInputConnection(generator->getOutputPort());
-
-                        auto network = NeuralNetwork::create();
-                        network->setInferenceEngine(engine);
-                        if (engine != "TensorRT") {
-                            //if (!((engine == "TensorRT") || (engine == "TensorFlowCUDA"))) {
-                            network->getInferenceEngine()->setDevice(1);
-                        } else {
-                            network->getInferenceEngine()->setDevice(currDevice);
-                        }
-                        std::string postfix;
-                        if (engine.substr(0, 10) == "TensorFlow") {
-                            network->setInputNode(0, "input_1", NodeType::IMAGE,
-                                                  TensorShape({1, img_size[0], img_size[1], 3}));
-                            network->setOutputNode(0, "dense_1/Softmax", NodeType::TENSOR);
-                        } else if (engine == "TensorRT") {
-                            network->setInputNode(0, "input_1", NodeType::IMAGE,
-                                                  TensorShape{-1, 3, img_size[0], img_size[1]});
-                            network->setOutputNode(0, "dense_1/Softmax", NodeType::TENSOR, TensorShape{-1, 3});
-                        } else if (engine == "OpenVINO") {
-                            network->getInferenceEngine()->setDeviceType(deviceType.second);
-                            if (deviceType.first == "VPU") {
-                                postfix = "_fp16";
-                            }
-                        }
-                        //network->load(Config::getTestDataPath() + "NeuralNetworkModels/wsi_classification" + postfix + "." + network->getInferenceEngine()->getDefaultFileExtension());
-                        network->load("/home/andrep/FastPathology/data/Models/mobilenet_v2_bach_model" + postfix + "." +
-                                      network->getInferenceEngine()->getDefaultFileExtension());
-                        network->setInputConnection(batchGenerator->getOutputPort());
-                        network->setScaleFactor(1.0f / 255.0f);
-                        network->enableRuntimeMeasurements();
-
-                        auto stitcher = PatchStitcher::create();
-                        stitcher->setInputConnection(network->getOutputPort());
-                        stitcher->enableRuntimeMeasurements();
-
-                        auto start = std::chrono::high_resolution_clock::now();
-                        DataObject::pointer data;
-                        do {
-                            data = stitcher->updateAndGetOutputData<DataObject>();
-                        } while (!data->isLastFrame());
-
-                        std::chrono::duration<float, std::milli> timeUsed =
-                                std::chrono::high_resolution_clock::now() - start;
-                        std::cout << "Total runtime: " << timeUsed.count() << std::endl;
-                        std::cout << "Patch generator runtime: " << std::endl;
-                        generator->getRuntime("create patch")->print();
-                        std::cout << "NN runtime: " << std::endl;
-                        network->getRuntime()->print();
-                        std::cout << "Patch stitcher runtime: " << std::endl;
-                        stitcher->getRuntime()->print();
-
-                        if (iteration == 0 && warmupIteration)
-                            continue;
-
-                        auto deviceUsed = deviceType.first;
-                        if ((engine == "TensorRT") || (engine == "TensorFlowCUDA")) {
-                            deviceUsed = deviceType.first + std::to_string(currDevice);
-                        } else {
-                            deviceUsed = deviceType.first;
-                        }
-
-                        //network->stopPipeline();  // free memory when finished
-
-                        file <<
-                             engine + ";" +
-                             deviceUsed + ";" +  //deviceType.first + ";" +
-                             std::to_string(iteration) + ";" +
-                             std::to_string(generator->getRuntime("create patch")->getAverage()) + ";" +
-                             std::to_string(generator->getRuntime("create patch")->getStdDeviation()) + ";" +
-                             std::to_string(network->getRuntime("input_processing")->getAverage()) + ";" +
-                             std::to_string(network->getRuntime("input_processing")->getStdDeviation()) + ";" +
-                             std::to_string(network->getRuntime("inference")->getAverage()) + ";" +
-                             std::to_string(network->getRuntime("inference")->getStdDeviation()) + ";" +
-                             std::to_string(network->getRuntime("output_processing")->getAverage()) + ";" +
-                             std::to_string(network->getRuntime("output_processing")->getStdDeviation()) + ";" +
-                             std::to_string(stitcher->getRuntime("stitch patch")->getAverage()) + ";" +
-                             std::to_string(stitcher->getRuntime("stitch patch")->getStdDeviation()) + ";" +
-                             std::to_string(timeUsed.count())
-                             << std::endl;
-                    }
-                }
-            }
+/**
+ * A parsed pipeline with its models loaded, run for all iterations of a combination.
+ */
+struct ParsedPipeline {
+    std::shared_ptr<WholeSlideImageImporter> importer;
+    std::shared_ptr<Pipeline> pipeline;
+};
+
+/**
+ * Parse a pipeline for a slide, loading its models on the device given by the device variable, if any.
+ */
+static ParsedPipeline parsePipeline(const std::string& pipelineFilename, const std::string& slide, std::map<std::string, std::string> variables) {
+    int device = -1;
+    if(variables.count("device") > 0) {
+        try {
+            device = std::stoi(variables["device"]);
+        } catch(std::exception &e) {
+            throw Exception("The device variable must be an integer, got " + variables["device"]);
         }
     }
-
-    if(case1_inceptionv3) {
-        std::cout << "\nPatch-wise classification with InceptionV3...\n" << std::endl;
-        // /*
-        std::string resultFilename = "../results_" + machine + "/neural-network-runtimes-case-1_inceptionv3.csv";
-        if (machine.substr(0, 7) == "windows") {
-            resultFilename = "../" + resultFilename;
-        }
-
-        // */
-        //const std::string resultFilename = "C:/Users/andrep/workspace/FAST-Pathology/inference_study/results_windows/neural-network-runtimes-case-1_inceptionv3.csv";
-        std::ofstream file(resultFilename.c_str());
-
-        std::cout << "\nFile: " << resultFilename << std::endl;
-
-        std::vector<int> img_size {512, 512};
-        int patch_level = 0;
-        int nb_gpus = 1;
-        int max_batch_size = 16;
-
-        // Write header
-        file << "Engine;Device Type;Iteration;Patch generator AVG;Patch generator STD;NN input AVG;NN input STD;NN inference AVG;NN inference STD;NN output AVG;NN output STD;Patch stitcher AVG;Patch stitcher STD;Total\n";
-
-        //for(auto &engine : InferenceEngineManager::getEngineList()) {TensorFlowCUDA
-        auto engines = {"TensorFlowCUDA", "OpenVINO", "TensorFlowCPU"};  // ubuntu default
-        if (machine == "windows") {
-            engines = {"OpenVINO", "TensorFlowCPU"};
-		} else if (machine == "windows2") {
-			engines = {"TensorRT", "OpenVINO", "TensorFlowCPU"};
-		}
-
-        for(std::string engine : engines) {
-            std::map<std::string, InferenceDeviceType> deviceTypes = {{"ANY", InferenceDeviceType::ANY}};
-            if(engine == "OpenVINO") {
-                // On OpenVINO, try all device types
-                deviceTypes = std::map<std::string, InferenceDeviceType>{
-                        {"CPU", InferenceDeviceType::CPU},
-                        //{"GPU", InferenceDeviceType::GPU},
-                        //{"VPU", InferenceDeviceType::VPU},
-                };
-                if (machine.substr(0, 7) == "windows") {
-                    deviceTypes = std::map<std::string, InferenceDeviceType>{
-                        {"CPU", InferenceDeviceType::CPU},
-                        {"GPU", InferenceDeviceType::GPU},
-                        //{"VPU", InferenceDeviceType::VPU},
-                };
-                }
-            }
-            for(auto &&deviceType : deviceTypes) {
-                std::cout << engine << " for device type " << deviceType.first << std::endl;
-                std::cout << "====================================" << std::endl;
-
-                for(int currDevice = 0; currDevice <= nb_gpus; ++currDevice) {  // for each GPU
-                    //if (!((engine == "TensorRT") || (engine == "TensorFlowCUDA")) && (currDevice > 0))
-                    if (!((engine == "TensorRT")) && (currDevice > 0))
-                        break;
-
-                    std::cout << "Current device (GPU): " << currDevice << std::endl;
-                    std::cout << "//////////////////////////////" << std::endl;
-
-                    for (int iteration = 0; iteration <= iterations; ++iteration) {
-                        auto importer = WholeSlideImageImporter::create();
-                        //importer->setFilename(Config::getTestDataPath() + "/WSI/A05.svs");
-                        if (machine == "windows") {
-                            importer->setFilename("C:/Users/andrep/workspace/FAST-Pathology_old/A05.svs");
-						} else if (machine == "windows2") {
-							importer->setFilename("C:/Users/andrp/workspace/FAST-Pathology/A05.svs");
-						} else {
-                            importer->setFilename(Config::getTestDataPath() + "/WSI/A05.svs");
-                        }
-
-                        auto tissueSegmentation = TissueSegmentation::create();
-                        tissueSegmentation->setInputConnection(importer->getOutputPort());
-
-                        auto generator = PatchGenerator::create();
-                        generator->setPatchSize(img_size[0], img_size[1]);
-                        generator->setPatchLevel(patch_level);
-                        generator->setInputConnection(importer->getOutputPort());
-                        generator->setInputConnection(1, tissueSegmentation->getOutputPort());
-                        generator->enableRuntimeMeasurements();
-
-                        /*
-                        auto batchGenerator = ImageToBatchGenerator::create();
-                        batchGenerator->setMaxBatchSize(max_batch_size);
-                        batchGenerator->setInputConnection(generator->getOutputPort());
-                         */
-
-                        auto network = NeuralNetwork::create();
-                        network->setInferenceEngine(engine);
-                        if (engine != "TensorRT") {
-                            //if (!((engine == "TensorRT") || (engine == "TensorFlowCUDA"))) {
-							if (machine == "ubuntu") {
-								network->getInferenceEngine()->setDevice(1);
-							}
-                        } else {
-                            network->getInferenceEngine()->setDevice(currDevice);
-                        }
-                        std::string postfix;
-                        if (engine.substr(0, 10) == "TensorFlow") {
-                            network->setInputNode(0, "input_1", NodeType::IMAGE,
-                                                  TensorShape({1, img_size[0], img_size[1], 3}));
-                            network->setOutputNode(0, "sequential/dense_1/Softmax", NodeType::TENSOR);
-                        } else if (engine == "TensorRT") {
-                            network->setInputNode(0, "input_1", NodeType::IMAGE,
-                                                  TensorShape{-1, 3, img_size[0], img_size[1]});
-                            network->setOutputNode(0, "sequential/dense_1/Softmax", NodeType::TENSOR, TensorShape{-1, 3});
-                        } else if (engine == "OpenVINO") {
-                            network->getInferenceEngine()->setDeviceType(deviceType.second);
-                            if (deviceType.first == "VPU") {
-                                postfix = "_fp16";
-                            }
-                        }
-                        /*
-                        if (machine == "ubuntu") {
-                            network->load(Config::getTestDataPath() + "NeuralNetworkModels/wsi_classification" + postfix + "." + network->getInferenceEngine()->getDefaultFileExtension());
-                        } else if (machine == "windows") {
-                            network->load("C:/Users/andrep/FastPathology/data/Models/mobilenet_v2_bach_model" + postfix + "." +
-                                      network->getInferenceEngine()->getDefaultFileExtension());
-                        }
-                         */
-						if (machine == "windows") {
-							network->load("C:/Users/andrep/Downloads/FAST_Test_Data/data/NeuralNetworkModels/wsi_classification" + postfix + "." + network->getInferenceEngine()->getDefaultFileExtension());
-						} else if (machine == "windows2") {
-							network->load("C:/Users/andrp/Downloads/FAST_Test_Data/data/NeuralNetworkModels/wsi_classification" + postfix + "." + network->getInferenceEngine()->getDefaultFileExtension());
-						}
-						else {
-							network->load(Config::getTestDataPath() + "NeuralNetworkModels/wsi_classification" + postfix + "." + network->getInferenceEngine()->getDefaultFileExtension());
-						}
-                        //network->load(Config::getTestDataPath() + "NeuralNetworkModels/wsi_classification" + postfix + "." + network->getInferenceEngine()->getDefaultFileExtension());
-                        //network->load("/home/andrep/FastPathology/data/Models/mobilenet_v2_bach_model" + postfix + "." + network->getInferenceEngine()->getDefaultFileExtension());
-                        network->setInputConnection(generator->getOutputPort());
-                        network->setScaleFactor(1.0f / 255.0f);
-                        network->enableRuntimeMeasurements();
-
-                        auto stitcher = PatchStitcher::create();
-                        stitcher->setInputConnection(network->getOutputPort());
-                        stitcher->enableRuntimeMeasurements();
-
-                        auto start = std::chrono::high_resolution_clock::now();
-                        DataObject::pointer data;
-                        do {
-                            data = stitcher->updateAndGetOutputData<DataObject>();
-                        } while (!data->isLastFrame());
-
-                        std::chrono::duration<float, std::milli> timeUsed =
-                                std::chrono::high_resolution_clock::now() - start;
-                        std::cout << "Total runtime: " << timeUsed.count() << std::endl;
-                        std::cout << "Patch generator runtime: " << std::endl;
-                        generator->getRuntime("create patch")->print();
-                        std::cout << "NN runtime: " << std::endl;
-                        network->getRuntime()->print();
-                        std::cout << "Patch stitcher runtime: " << std::endl;
-                        stitcher->getRuntime()->print();
-
-                        if (iteration == 0 && warmupIteration)
-                            continue;
-
-                        auto deviceUsed = deviceType.first;
-                        if ((engine == "TensorRT") || (engine == "TensorFlowCUDA")) {
-                            deviceUsed = deviceType.first + std::to_string(currDevice);
-                        } else {
-                            deviceUsed = deviceType.first;
-                        }
-
-                        //network->stopPipeline();  // free memory when finished
-
-                        file <<
-                             engine + ";" +
-                             deviceUsed + ";" +  //deviceType.first + ";" +
-                             std::to_string(iteration) + ";" +
-                             std::to_string(generator->getRuntime("create patch")->getAverage()) + ";" +
-                             std::to_string(generator->getRuntime("create patch")->getStdDeviation()) + ";" +
-                             std::to_string(network->getRuntime("input_processing")->getAverage()) + ";" +
-                             std::to_string(network->getRuntime("input_processing")->getStdDeviation()) + ";" +
-                             std::to_string(network->getRuntime("inference")->getAverage()) + ";" +
-                             std::to_string(network->getRuntime("inference")->getStdDeviation()) + ";" +
-                             std::to_string(network->getRuntime("output_processing")->getAverage()) + ";" +
-                             std::to_string(network->getRuntime("output_processing")->getStdDeviation()) + ";" +
-                             std::to_string(stitcher->getRuntime("stitch patch")->getAverage()) + ";" +
-                             std::to_string(stitcher->getRuntime("stitch patch")->getStdDeviation()) + ";" +
-                             std::to_string(timeUsed.count())
-                             << std::endl;
-                    }
-                }
+    ParsedPipeline parsed;
+    parsed.importer = WholeSlideImageImporter::create();
+    parsed.importer->setFilename(slide);
+    parsed.pipeline = std::make_shared<Pipeline>(pipelineFilename, variables);
+    parsed.pipeline->parse({}, {{"WSI", parsed.importer}}, false);
+    if(device >= 0) {
+        for(auto PO : parsed.pipeline->getProcessObjects()) {
+            if(auto network = std::dynamic_pointer_cast<NeuralNetwork>(PO.second)) {
+                // As in the batch scheduler, parsing loads the model on the default device. It is loaded on the
+                // device once here, as the pipeline is kept for all iterations.
+                network->getInferenceEngine()->setDevice(device);
+                network->getInferenceEngine()->load();
             }
         }
     }
+    return parsed;
+}
 
-    if(case3a) {
-        std::cout << "\nCASE 3a - Inference on different magnification levels with rendering with high-res U-Net model...\n" << std::endl;
-        //std::cout << "\nCASE 3a - Inference on different magnification levels with rendering with tiny-YOLOv3 model...\n" << std::endl;
-        // CASE 3a - Inference on different magnification levels (40x, 20x, 10x, 5x, 2.5x) with tiny-YOLOv3 model
-        const std::string resultFilename = "../results_" + machine + "neural-network-runtimes-case-3a.csv";
-        std::ofstream file(resultFilename.c_str());
-
-        //std::vector<int> img_size {256, 256};
-        std::vector<int> img_sizes {1024, 512, 256};
-        //int patch_level = 0;
-        std::vector<float> patch_levels {40, 20, 10, 5, 2.5};  //, 20, 10, 5, 2.5};
-        std::reverse(patch_levels.begin(), patch_levels.end());
-        float wsi_res = 40;
-        int nb_classes = 1;
-        int nb_anchors = 3;
-
-        // Write header
-        file << "Engine;Device Type;Patch level;Iteration;Patch generator AVG;Patch generator STD;NN input AVG;NN input STD;NN inference AVG;NN inference STD;NN output AVG;NN output STD;Patch stitcher AVG;Patch stitcher STD;Total\n";
-
-        //for(auto &engine : InferenceEngineManager::getEngineList()) {
-        //for(std::string engine : {"TensorFlowCUDA", "TensorRT", "OpenVINO", "TensorFlowCPU"}) {
-        for(std::string engine : {"TensorFlowCUDA", "OpenVINO"}) {
-            std::map<std::string, InferenceDeviceType> deviceTypes = {{"ANY", InferenceDeviceType::ANY}};
-            if(engine == "OpenVINO") {
-                // On OpenVINO, try all device types
-                deviceTypes = std::map<std::string, InferenceDeviceType>{
-                        {"CPU", InferenceDeviceType::CPU},
-                        //{"GPU", InferenceDeviceType::GPU},
-                        //{"VPU", InferenceDeviceType::VPU},
-                };
-            }
-            for(auto &&deviceType : deviceTypes) {
-                std::cout << engine << " for device type " << deviceType.first << std::endl;
-                std::cout << "====================================" << std::endl;
-
-                for(auto const& patch_level : patch_levels) {
-                    std::cout << "current patch level: " << std::to_string(patch_level) << std::endl;
-                    std::cout << "------------------------------------" << std::endl;
-
-                    int curr_patch_level = (int) (log2(wsi_res / patch_level) / log2(2));
-
-                    for(auto const& img_size : img_sizes) {
-                        std::cout << "current img size: " << std::to_string(img_size) << " x " << std::to_string(img_size) << std::endl;
-                        std::cout << "------------------------------------" << std::endl;
-
-                        for(int iteration = 0; iteration <= iterations; ++iteration) {
-                            auto importer = WholeSlideImageImporter::create();
-                            importer->setFilename("/home/andrep/workspace/FAST-Pathology/fastPathology_stuff/images/camelyon16_tumor_047-043.tif");
-
-                            /*
-                            auto image = importer->updateAndGetOutputData<ImagePyramid>();
-                            for(auto const& [key, val] : image->getMetadata()) {
-                                std::cout << "\nInfo: " << key << ": " << val << std::endl;
-                            }
-                            std::cout << "\nFinished!" << std::endl;
-                             */
-
-                            auto tissueSegmentation = TissueSegmentation::create();
-                            tissueSegmentation->setInputConnection(importer->getOutputPort());
-
-                            auto generator = PatchGenerator::create();
-                            generator->setPatchSize(img_size, img_size);
-                            std::cout << "\nCurrent p-level: " << curr_patch_level << std::endl;
-                            generator->setPatchLevel(curr_patch_level);
-                            generator->setInputConnection(importer->getOutputPort());
-                            generator->setInputConnection(1, tissueSegmentation->getOutputPort());
-                            generator->enableRuntimeMeasurements();
-
-                            auto network = SegmentationNetwork::create();
-                            network->setInferenceEngine(engine);
-                            network->getInferenceEngine()->setDevice(1);
-                            std::string postfix;
-                            if (engine.substr(0, 10) == "TensorFlow") {
-                                network->setOutputNode(0, "conv2d_26/truediv", NodeType::TENSOR);
-                            } else if (engine == "TensorRT") {
-                                network->setInputNode(0, "input_1", NodeType::IMAGE,
-                                                      TensorShape{-1, 3, img_size, img_size});
-                                network->setOutputNode(0, "conv2d_26/truediv", NodeType::TENSOR, TensorShape{-1, 3});
-                            } else if (engine == "OpenVINO") {
-                                network->getInferenceEngine()->setDeviceType(deviceType.second);
-                                if (deviceType.first == "VPU") {
-                                    postfix = "_fp16";
-                                }
-                            }
-                            //network->load(Config::getTestDataPath() + "NeuralNetworkModels/wsi_classification" + postfix + "." + network->getInferenceEngine()->getDefaultFileExtension());
-                            network->load("/home/andrep/FastPathology/data/Models/high_res_nuclei_unet" + postfix + "." + network->getInferenceEngine()->getDefaultFileExtension());
-                            network->setInputConnection(generator->getOutputPort());
-                            network->setScaleFactor(1.0f / 255.0f);
-                            network->enableRuntimeMeasurements();
-
-                            auto stitcher = PatchStitcher::create();
-                            stitcher->setInputConnection(network->getOutputPort());
-                            stitcher->enableRuntimeMeasurements();
-
-                            auto start = std::chrono::high_resolution_clock::now();
-                            DataObject::pointer data;
-                            do {
-                                data = stitcher->updateAndGetOutputData<DataObject>();
-                            } while (!data->isLastFrame());
-                            std::chrono::duration<float, std::milli> timeUsed =
-                                    std::chrono::high_resolution_clock::now() - start;
-                            std::cout << "Total runtime: " << timeUsed.count() << std::endl;
-                            std::cout << "Patch generator runtime: " << std::endl;
-                            generator->getRuntime("create patch")->print();
-                            std::cout << "NN runtime: " << std::endl;
-                            network->getRuntime()->print();
-                            std::cout << "Patch stitcher runtime: " << std::endl;
-                            stitcher->getRuntime()->print();
-
-                            if (iteration == 0 && warmupIteration)
-                                continue;
-
-                            file <<
-                                 engine + ";" +
-                                 deviceType.first + ";" +
-                                 std::to_string(curr_patch_level) + ";" +
-                                 std::to_string(img_size) + ";" +
-                                 std::to_string(iteration) + ";" +
-                                 std::to_string(generator->getRuntime("create patch")->getAverage()) + ";" +
-                                 std::to_string(generator->getRuntime("create patch")->getStdDeviation()) + ";" +
-                                 std::to_string(network->getRuntime("input_processing")->getAverage()) + ";" +
-                                 std::to_string(network->getRuntime("input_processing")->getStdDeviation()) + ";" +
-                                 std::to_string(network->getRuntime("inference")->getAverage()) + ";" +
-                                 std::to_string(network->getRuntime("inference")->getStdDeviation()) + ";" +
-                                 std::to_string(network->getRuntime("output_processing")->getAverage()) + ";" +
-                                 std::to_string(network->getRuntime("output_processing")->getStdDeviation()) + ";" +
-                                 std::to_string(stitcher->getRuntime("stitch patch")->getAverage()) + ";" +
-                                 std::to_string(stitcher->getRuntime("stitch patch")->getStdDeviation()) + ";" +
-                                 std::to_string(timeUsed.count())
-                                 << std::endl;
-                    }
-                    }
-                }
-            }
-        }
+/**
+ * Run a parsed pipeline once. Returns the run with total runtime, patch throughput and stages.
+ */
+static QJsonObject runOnce(ParsedPipeline& parsed, const std::string& slide) {
+    // Setting the filename marks the importer as modified, thus the whole pipeline is executed again
+    parsed.importer->setFilename(slide);
+    PipelineRuntime::enable(parsed.pipeline->getProcessObjects());
+
+    const auto start = std::chrono::steady_clock::now();
+    parsed.pipeline->getAllPipelineOutputData();
+    const double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    auto stages = PipelineRuntime::getStages(parsed.pipeline->getProcessObjects());
+    int patches = 0;
+    for(const auto& stage : stages) {
+        if(stage.stage == "create patch")
+            patches += stage.samples;
     }
+    QJsonObject run = QJsonDocument::fromJson(QByteArray::fromStdString(PipelineRuntime::toJSON(stages))).object();
+    run["total_ms"] = totalMs;
+    run["patches"] = patches;
+    run["patches_per_second"] = patches / (totalMs / 1000.0);
+    return run;
+}
 
+/**
+ * Parse the tolerance argument, a non-negative number. Throws an Exception with a message for the user if invalid.
+ */
+static double parseTolerance(std::string value) {
+    trim(value);
+    std::size_t end = 0;
+    double result;
+    try {
+        result = std::stod(value, &end);
+    } catch(std::exception &e) {
+        throw Exception("--tolerance must be a number, got " + value);
+    }
+    if(end != value.size() || !std::isfinite(result))
+        throw Exception("--tolerance must be a number, got " + value);
+    if(result < 0)
+        throw Exception("--tolerance must be at least 0, got " + value);
+    return result;
+}
 
-    if(case4a) {
-        std::cout << "\nCASE 4a - Inference on different magnification levels with rendering with high-res U-Net model...\n" << std::endl;
-        // CASE 4a - Inference on different magnification levels (40x, 20x, 10x, 5x, 2.5x) with high-res U-Net for nuclei seg.
-        const std::string resultFilename = "../results_" + machine + "neural-network-runtimes-case-4a.csv";
-        std::ofstream file(resultFilename.c_str());
-
-        std::vector<int> img_size {256, 256};
-        //int patch_level = 0;
-        std::vector<float> patch_levels {40, 20, 10, 5, 2.5};
-        float wsi_res = 40;
-        int nb_classes = 1;
-        int nb_anchors = 3;
-
-        // Write header
-        file << "Engine;Device Type;Patch level;Iteration;Patch generator AVG;Patch generator STD;NN input AVG;NN input STD;NN inference AVG;NN inference STD;NN output AVG;NN output STD;Patch stitcher AVG;Patch stitcher STD;Total\n";
-
-        //for(auto &engine : InferenceEngineManager::getEngineList()) {
-        //for(std::string engine : {"TensorFlowCUDA", "TensorRT", "OpenVINO", "TensorFlowCPU"}) {
-        for(std::string engine : {"TensorFlowCUDA", "OpenVINO"}) {
-            std::map<std::string, InferenceDeviceType> deviceTypes = {{"ANY", InferenceDeviceType::ANY}};
-            if(engine == "OpenVINO") {
-                // On OpenVINO, try all device types
-                deviceTypes = std::map<std::string, InferenceDeviceType>{
-                        {"CPU", InferenceDeviceType::CPU},
-                        {"GPU", InferenceDeviceType::GPU},
-                        //{"VPU", InferenceDeviceType::VPU},
-                };
-            }
-            for(auto &&deviceType : deviceTypes) {
-                std::cout << engine << " for device type " << deviceType.first << std::endl;
-                std::cout << "====================================" << std::endl;
-
-                for(auto const& patch_level : patch_levels) {
-                    std::cout << "current patch level: " << std::to_string(patch_level) << std::endl;
-                    std::cout << "------------------------------------" << std::endl;
-                    int curr_patch_level = (int) (log2(wsi_res / patch_level) / log2(2));
-
-                    for(int iteration = 0; iteration <= iterations; ++iteration) {
-                        auto importer = WholeSlideImageImporter::create();
-                        importer->setFilename("/home/andrep/workspace/FAST-Pathology/fastPathology_stuff/images/camelyon16_tumor_047-043.tif");
-
-                        auto image = importer->updateAndGetOutputData<ImagePyramid>();
-                        for(auto const& [key, val] : image->getMetadata()) {
-                            std::cout << "\nInfo: " << key << ": " << val << std::endl;
-                        }
-                        std::cout << "\nFinished!" << std::endl;
-
-                        auto tissueSegmentation = TissueSegmentation::create();
-                        tissueSegmentation->setInputConnection(importer->getOutputPort());
-
-                        auto generator = PatchGenerator::create();
-                        generator->setPatchSize(img_size[0], img_size[1]);
-                        generator->setPatchLevel(curr_patch_level);
-                        generator->setInputConnection(importer->getOutputPort());
-                        generator->setInputConnection(1, tissueSegmentation->getOutputPort());
-                        generator->enableRuntimeMeasurements();
-
-                        auto network = BoundingBoxNetwork::create();
-                        network->setThreshold(0.1); //0.01); // default: 0.5
-                        network->setInferenceEngine(engine);
-                        network->getInferenceEngine()->setDevice(1);
-                        std::string postfix;
-                        if (engine.substr(0, 10) == "TensorFlow") {
-                            network->setInputNode(0, "input_1", NodeType::IMAGE,
-                                                  TensorShape{-1, img_size[0], img_size[1], 3});
-                            network->setOutputNode(0, "conv2d_10/BiasAdd", NodeType::TENSOR,
-                                                   TensorShape{-1, 8, 8, (int) (nb_anchors * (nb_classes + 5))});
-                        } else if (engine == "TensorRT") {
-                            network->setInputNode(0, "input_1", NodeType::IMAGE,
-                                                  TensorShape{-1, 3, img_size[0], img_size[1]});
-                            network->setOutputNode(0, "conv2d_10/BiasAdd", NodeType::TENSOR, TensorShape{-1, 8, 8, 18});
-                        } else if (engine == "OpenVINO") {
-                            network->getInferenceEngine()->setDeviceType(deviceType.second);
-                            if (deviceType.first == "VPU") {
-                                postfix = "_fp16";
-                            }
-                        }
-
-                        // read anchors from corresponding anchor file
-                        std::vector<std::vector<Vector2f> > anchors;
-                        std::ifstream infile(
-                                "/home/andrep/FastPathology/data/Models/yolo_test_model_fixed_output_nodes.anchors");
-                        std::string anchorStr;
-                        while (std::getline(infile, anchorStr)) {
-                            std::vector<std::string> anchorVector = split_custom(anchorStr, " ");
-                            anchorVector.resize(
-                                    6); // for TinyYOLOv3 should only be 6 pairs, 3 for each level (2 levels)
-                            int cntr = 0;
-                            for (int i = 1; i < 3; i++) { // assumes TinyYOLOv3 (only two output layers)
-                                std::vector<Vector2f> levelAnchors;
-                                for (int j = 0; j < 3; j++) {
-                                    auto currentPair = split_custom(anchorVector[cntr], ",");
-                                    levelAnchors.push_back(
-                                            Vector2f(std::stoi(currentPair[0]), std::stoi(currentPair[1])));
-                                    cntr++;
-                                }
-                                anchors.push_back(levelAnchors);
-                            }
-                        }
-                        network->setAnchors(anchors); // finally set anchors
-
-                        //network->load(Config::getTestDataPath() + "NeuralNetworkModels/wsi_classification" + postfix + "." + network->getInferenceEngine()->getDefaultFileExtension());
-                        network->load(
-                                "/home/andrep/FastPathology/data/Models/yolo_test_model_fixed_output_nodes" + postfix +
-                                "." + network->getInferenceEngine()->getDefaultFileExtension());
-                        network->setInputConnection(generator->getOutputPort());
-                        network->setScaleFactor(1.0f / 255.0f);
-                        network->enableRuntimeMeasurements();
-
-                        auto boxAccum = BoundingBoxSetAccumulator::create();
-                        //boxAccum->setInputConnection(nms->getOutputPort());
-                        boxAccum->setInputConnection(network->getOutputPort());
-                        boxAccum->enableRuntimeMeasurements();
-
-                        // FIXME: add update of this
-                        // MERGE <- for waiting for threads/syncs
+static double mean(const std::vector<double>& values) {
+    double sum = 0;
+    for(auto value : values)
+        sum += value;
+    return values.empty() ? 0 : sum / values.size();
+}
 
-                        auto start = std::chrono::high_resolution_clock::now();
-                        DataObject::pointer data;
-                        do {
-                            data = boxAccum->updateAndGetOutputData<DataObject>();
-                        } while (!data->isLastFrame());
-                        std::chrono::duration<float, std::milli> timeUsed =
-                                std::chrono::high_resolution_clock::now() - start;
-                        std::cout << "Total runtime: " << timeUsed.count() << std::endl;
-                        std::cout << "Patch generator runtime: " << std::endl;
-                        generator->getRuntime("create patch")->print();
-                        std::cout << "NN runtime: " << std::endl;
-                        network->getRuntime()->print();
-                        std::cout << "Patch stitcher runtime: " << std::endl;
-                        boxAccum->getRuntime()->print();
+static double stdDeviation(const std::vector<double>& values) {
+    const double average = mean(values);
+    double sum = 0;
+    for(auto value : values)
+        sum += (value - average)*(value - average);
+    return values.size() < 2 ? 0 : std::sqrt(sum / (values.size() - 1));
+}
 
-                        if (iteration == 0 && warmupIteration)
-                            continue;
+static QJsonObject readJSON(const std::string& filename) {
+    QFile file(QString::fromStdString(filename));
+    if(!file.open(QIODevice::ReadOnly))
+        throw Exception("Unable to open " + filename);
+    QJsonParseError error;
+    auto document = QJsonDocument::fromJson(file.readAll(), &error);
+    if(document.isNull())
+        throw Exception("Unable to parse " + filename + ": " + error.errorString().toStdString());
+    return document.object();
+}
 
-                        file <<
-                             engine + ";" +
-                             deviceType.first + ";" +
-                             std::to_string(curr_patch_level) + ";" +
-                             std::to_string(iteration) + ";" +
-                             std::to_string(generator->getRuntime("create patch")->getAverage()) + ";" +
-                             std::to_string(generator->getRuntime("create patch")->getStdDeviation()) + ";" +
-                             std::to_string(network->getRuntime("input_processing")->getAverage()) + ";" +
-                             std::to_string(network->getRuntime("input_processing")->getStdDeviation()) + ";" +
-                             std::to_string(network->getRuntime("inference")->getAverage()) + ";" +
-                             std::to_string(network->getRuntime("inference")->getStdDeviation()) + ";" +
-                             std::to_string(network->getRuntime("output_processing")->getAverage()) + ";" +
-                             std::to_string(network->getRuntime("output_processing")->getStdDeviation()) + ";" +
-                             std::to_string(boxAccum->getRuntime("stitch patch")->getAverage()) + ";" +
-                             std::to_string(boxAccum->getRuntime("stitch patch")->getStdDeviation()) + ";" +
-                             std::to_string(timeUsed.count())
-                             << std::endl;
-                    }
-                }
-            }
+/**
+ * Compare the summary with a baseline. Throughput is compared for pipelines which generate patches, else total
+ * runtime. Returns the number of regressions.
+ */
+static int compareWithBaseline(QJsonArray& summary, const QJsonObject& baseline, double tolerance) {
+    std::map<std::string, QJsonObject> baselineSummary;
+    for(auto item : baseline["summary"].toArray())
+        baselineSummary[item.toObject()["key"].toString().toStdString()] = item.toObject();
+
+    int regressions = 0;
+    for(int i = 0; i < summary.size(); ++i) {
+        QJsonObject item = summary[i].toObject();
+        const std::string key = item["key"].toString().toStdString();
+        if(baselineSummary.count(key) == 0) {
+            std::cout << key << ": not in baseline" << std::endl;
+            continue;
+        }
+        const auto& previous = baselineSummary[key];
+        double change;
+        if(item["patches"].toInt() > 0 && previous["patches_per_second_mean"].toDouble() > 0) {
+            change = item["patches_per_second_mean"].toDouble() / previous["patches_per_second_mean"].toDouble() - 1.0;
+        } else {
+            change = previous["total_ms_mean"].toDouble() / item["total_ms_mean"].toDouble() - 1.0;
         }
+        const bool regression = change < -tolerance;
+        if(regression)
+            ++regressions;
+        std::stringstream message;
+        message << key << ": " << (change >= 0 ? "+" : "") << std::fixed << std::setprecision(1) << change*100.0
+                << "% throughput" << (regression ? " REGRESSION" : "");
+        std::cout << message.str() << std::endl;
+        item["baseline_change"] = change;
+        item["regression"] = regression;
+        summary[i] = item;
     }
+    return regressions;
+}
 
+int main(int argc, char** argv) {
+    Reporter::setGlobalReportMethod(Reporter::INFO, Reporter::NONE);
 
+    CommandLineParser parser("Measure pipeline performance", "Benchmark FastPathology pipelines on slides, as given by a JSON config file");
+    parser.addVariable("config", true, "Benchmark config file (.json), see benchmark.json");
+    parser.addVariable("output", "benchmark-results.json", "Where to write the results");
+    parser.addVariable("baseline", "", "Results of an earlier run to compare throughput with");
+    parser.addVariable("tolerance", "0.1", "Relative loss of throughput compared to the baseline allowed before failing");
+    parser.addOption("disable-warmup", "Do not run the warmup iterations given in the config");
+    double tolerance;
+    try {
+        parser.parse(argc, argv);
+        tolerance = parseTolerance(parser.get("tolerance"));
+    } catch(Exception &e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_CODE_INVALID_ARGUMENTS;
+    }
 
-    if(false) {  // (case3_batch) {
-        // CASE 3 - WSI CLASSIFICATION with batches
-        const int batchSize = 16;
-        const std::string resultFilename = "neural-network-runtimes-case-3-batch.csv";
-        std::ofstream file(resultFilename.c_str());
-
-        // Write header
-        file << "Engine;Device Type;Iteration;Patch generator AVG;Patch generator STD;NN input AVG;NN input STD;NN inference AVG;NN inference STD;NN output AVG;NN output STD;Patch stitcher AVG;Patch stitcher STD;Total\n";
-
-        //for(std::string engine : {"TensorRT", "TensorFlowCUDA", "TensorFlowROCm", "OpenVINO"}) {
-        for(std::string engine : {"TensorFlowCUDA", "OpenVINO", "TensorFlowCPU"}) {
-            if(!InferenceEngineManager::isEngineAvailable(engine))
-                continue;
-            std::map<std::string, InferenceDeviceType> deviceTypes = {{"ANY", InferenceDeviceType::ANY}};
-            if(engine == "OpenVINO") {
-                // On OpenVINO, try all device types
-                deviceTypes = std::map<std::string, InferenceDeviceType>{
-                        //{"CPU", InferenceDeviceType::CPU},
-                        {"GPU", InferenceDeviceType::GPU},
-                        {"VPU", InferenceDeviceType::VPU},
-                };
-            }
-            for(auto &&deviceType : deviceTypes) {
-                std::cout << engine << " for device type " << deviceType.first << std::endl;
-                std::cout << "====================================" << std::endl;
-
-                for(int iteration = 0; iteration <= iterations; ++iteration) {
-                    auto importer = WholeSlideImageImporter::create();
-                    importer->setFilename(Config::getTestDataPath() + "/WSI/A05.svs");
-
-                    auto tissueSegmentation = TissueSegmentation::create();
-                    tissueSegmentation->setInputConnection(importer->getOutputPort());
-
-                    auto generator = PatchGenerator::create();
-                    generator->setPatchSize(512, 512);
-                    generator->setPatchLevel(0);
-                    generator->setInputConnection(importer->getOutputPort());
-                    generator->setInputConnection(1, tissueSegmentation->getOutputPort());
-                    generator->enableRuntimeMeasurements();
-
-                    auto batchGenerator = ImageToBatchGenerator::create();
-                    batchGenerator->setMaxBatchSize(16);
+    // Benchmarks measure processing only, without rendering
+    Config::setVisualization(false);
+
+    QJsonObject config;
+    QJsonObject baseline;
+    try {
+        config = readJSON(parser.get("config"));
+        if(!parser.get("baseline").empty())
+            baseline = readJSON(parser.get("baseline"));
+    } catch(Exception &e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_CODE_INVALID_ARGUMENTS;
+    }
+    // Relative paths in the config are relative to the config file
+    const QDir configDir = QFileInfo(QString::fromStdString(parser.get("config"))).absoluteDir();
+    auto getPath = [&configDir](const QJsonValue& value) {
+        return QDir::cleanPath(configDir.absoluteFilePath(value.toString())).toStdString();
+    };
+    const int iterations = config["iterations"].toInt(10);
+    const int warmup = parser.getOption("disable-warmup") ? 0 : config["warmup"].toInt(1);
+    std::vector<std::string> slides;
+    for(auto slide : config["slides"].toArray())
+        slides.push_back(getPath(slide));
+    if(slides.empty() || config["cases"].toArray().isEmpty()) {
+        std::cerr << "The config must have at least one slide and one case" << std::endl;
+        return EXIT_CODE_INVALID_ARGUMENTS;
+    }
 
-                    auto network = NeuralNetwork::create();
-                    network->setInferenceEngine(engine);
-                    network->getInferenceEngine()->setMaxBatchSize(batchSize);
-                    std::string postfix;
-                    if(engine.substr(0, 10) == "TensorFlow") {
-                        network->setOutputNode(0, "sequential/dense_1/Softmax", NodeType::TENSOR);
-                    } else if(engine == "TensorRT") {
-                        network->setInputNode(0, "input_1", NodeType::IMAGE, TensorShape{-1, 3, 512, 512});
-                        network->setOutputNode(0, "sequential/dense_1/Softmax", NodeType::TENSOR, TensorShape{-1, 3});
-                    } else if(engine == "OpenVINO") {
-                        network->getInferenceEngine()->setDeviceType(deviceType.second);
-                        postfix = "batch_" + std::to_string(batchSize);
-                        if(deviceType.first == "VPU") {
-                            postfix = "_fp16";
-                        }
+    QJsonArray runs;
+    QJsonArray summary;
+    int failed = 0;
+    for(auto caseValue : config["cases"].toArray()) {
+        const QJsonObject caseObject = caseValue.toObject();
+        const std::string caseName = caseObject["name"].toString().toStdString();
+        const std::string pipelineFilename = getPath(caseObject["pipeline"]);
+        std::map<std::string, std::string> caseVariables;
+        for(auto variable : caseObject["variables"].toObject().keys())
+            caseVariables[variable.toStdString()] = caseObject["variables"].toObject()[variable].toString().toStdString();
+        for(const auto& slide : slides) {
+            for(auto variables : getCombinations(caseObject)) {
+                variables.insert(caseVariables.begin(), caseVariables.end());
+                const std::string key = getKey(caseName, slide, variables);
+                std::cout << key << std::endl;
+                std::vector<double> totals, throughputs;
+                int patches = 0;
+                ParsedPipeline parsed;
+                for(int iteration = 0; iteration < warmup + iterations; ++iteration) {
+                    QJsonObject run;
+                    try {
+                        if(!parsed.pipeline)
+                            parsed = parsePipeline(pipelineFilename, slide, variables);
+                        run = runOnce(parsed, slide);
+                    } catch(std::exception &e) {
+                        // An engine or device which is unavailable on this machine does not stop the benchmark
+                        std::cerr << key << " failed: " << e.what() << std::endl;
+                        ++failed;
+                        break;
                     }
-                    network->load(Config::getTestDataPath() + "NeuralNetworkModels/wsi_classification" + postfix + "." +
-                                  network->getInferenceEngine()->getDefaultFileExtension());
-                    network->setInputConnection(generator->getOutputPort());
-                    network->setScaleFactor(1.0f / 255.0f);
-                    network->enableRuntimeMeasurements();
-
-                    auto stitcher = PatchStitcher::create();
-                    stitcher->setInputConnection(network->getOutputPort());
-                    stitcher->enableRuntimeMeasurements();
-
-                    auto start = std::chrono::high_resolution_clock::now();
-                    DataObject::pointer data;
-                    do {
-                        data = stitcher->updateAndGetOutputData<DataObject>();
-                    } while(!data->isLastFrame());
-                    std::chrono::duration<float, std::milli> timeUsed = std::chrono::high_resolution_clock::now() - start;
-                    std::cout << "Total runtime: " << timeUsed.count() << std::endl;
-                    std::cout << "Patch generator runtime: " << std::endl;
-                    generator->getRuntime("create patch")->print();
-                    std::cout << "NN runtime: " << std::endl;
-                    network->getRuntime()->print();
-                    std::cout << "Patch stitcher runtime: " << std::endl;
-                    stitcher->getRuntime()->print();
-
-                    if(iteration == 0 && warmupIteration)
+                    std::cout << "Iteration " << iteration << (iteration < warmup ? " (warmup)" : "") << ": "
+                              << run["total_ms"].toDouble() << " ms" << std::endl;
+                    if(iteration < warmup)
                         continue;
-
-                    file <<
-                         engine + ";" +
-                         deviceType.first + ";" +
-                         std::to_string(iteration) + ";" +
-                         std::to_string(generator->getRuntime("create patch")->getAverage()) + ";" +
-                         std::to_string(generator->getRuntime("create patch")->getStdDeviation()) + ";" +
-                         std::to_string(network->getRuntime("input_processing")->getAverage()) + ";" +
-                         std::to_string(network->getRuntime("input_processing")->getStdDeviation()) + ";" +
-                         std::to_string(network->getRuntime("inference")->getAverage()) + ";" +
-                         std::to_string(network->getRuntime("inference")->getStdDeviation()) + ";" +
-                         std::to_string(network->getRuntime("output_processing")->getAverage()) + ";" +
-                         std::to_string(network->getRuntime("output_processing")->getStdDeviation()) + ";" +
-                         std::to_string(stitcher->getRuntime("stitch patch")->getAverage()) + ";" +
-                         std::to_string(stitcher->getRuntime("stitch patch")->getStdDeviation()) + ";" +
-                         std::to_string(timeUsed.count())
-                         << std::endl;
+                    run["key"] = QString::fromStdString(key);
+                    run["case"] = QString::fromStdString(caseName);
+                    run["slide"] = QString::fromStdString(slide);
+                    run["iteration"] = iteration - warmup;
+                    for(const auto& variable : variables)
+                        run[QString::fromStdString(variable.first)] = QString::fromStdString(variable.second);
+                    totals.push_back(run["total_ms"].toDouble());
+                    throughputs.push_back(run["patches_per_second"].toDouble());
+                    patches = run["patches"].toInt();
+                    runs.append(run);
                 }
+                if(totals.empty())
+                    continue;
+                QJsonObject item;
+                item["key"] = QString::fromStdString(key);
+                item["iterations"] = (int)totals.size();
+                item["patches"] = patches;
+                item["total_ms_mean"] = mean(totals);
+                item["total_ms_std"] = stdDeviation(totals);
+                item["patches_per_second_mean"] = mean(throughputs);
+                item["patches_per_second_std"] = stdDeviation(throughputs);
+                summary.append(item);
             }
         }
     }
 
+    int regressions = 0;
+    if(!baseline.isEmpty())
+        regressions = compareWithBaseline(summary, baseline, tolerance);
+
+    QJsonObject results;
+    results["config"] = QString::fromStdString(parser.get("config"));
+    results["environment"] = getEnvironment();
+    results["iterations"] = iterations;
+    results["warmup"] = warmup;
+    results["runs"] = runs;
+    results["summary"] = summary;
+    if(!baseline.isEmpty())
+        results["baseline"] = QString::fromStdString(parser.get("baseline"));
+    QFile file(QString::fromStdString(parser.get("output")));
+    if(!file.open(QIODevice::WriteOnly)) {
+        std::cerr << "Unable to write results to " << parser.get("output") << std::endl;
+        return EXIT_CODE_INVALID_ARGUMENTS;
+    }
+    file.write(QJsonDocument(results).toJson());
+    file.close();
+    std::cout << "Results written to " << parser.get("output") << std::endl;
+
+    if(regressions > 0) {
+        std::cerr << regressions << " of " << summary.size() << " benchmarks are slower than the baseline" << std::endl;
+        return EXIT_CODE_REGRESSION;
+    }
+    if(failed > 0)
+        return EXIT_CODE_RUN_FAILED;
+    return EXIT_CODE_OK;
 }
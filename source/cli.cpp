@@ -0,0 +1,226 @@
+#include <FAST/Tools/CommandLineParser.hpp>
+#include <FAST/Config.hpp>
+#include <FAST/Pipeline.hpp>
+#include <FAST/Data/ImagePyramid.hpp>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <chrono>
+#include <fstream>
+#include <set>
+#include "source/logic/Project.h"
+#include "source/logic/WholeSlideImage.h"
+#include "source/logic/BatchScheduler.h"
+#include "source/logic/EngineCache.h"
+#include "source/logic/RemoteSlideCache.h"
+#include "source/logic/Tracing.h"
+
+using namespace fast;
+
+// Exit codes, so that batch schedulers (e.g. Slurm) can tell failures apart
+enum ExitCode {
+    EXIT_CODE_OK = 0,
+    EXIT_CODE_INVALID_ARGUMENTS = 1,
+    EXIT_CODE_SLIDES_FAILED = 2,
+};
+
+/**
+ * Expands a list of glob patterns separated by ; (e.g. "/data/cohort/*.svs;/data/extra/*.tiff") to file paths.
+ * Wildcards are only supported in the file name part. s3:// and http(s):// URIs are used as they are.
+ */
+static std::vector<std::string> expandSlidePatterns(const std::string& patterns) {
+    std::vector<std::string> paths;
+    for(auto pattern : split(patterns, ";")) {
+        trim(pattern);
+        if(pattern.empty())
+            continue;
+        if(RemoteSlideCache::isRemote(pattern)) {
+            paths.push_back(pattern);
+            continue;
+        }
+        QFileInfo info(QString::fromStdString(pattern));
+        QDir dir = info.dir();
+        for(auto& filename : dir.entryList({info.fileName()}, QDir::Files, QDir::Name)) {
+            paths.push_back(dir.absoluteFilePath(filename).toStdString());
+        }
+    }
+    return paths;
+}
+
+/**
+ * Integer value of a command line variable, which must be at least minimum.
+ */
+static int parseInteger(const std::string& name, std::string value, int minimum) {
+    trim(value);
+    std::size_t end = 0;
+    int result;
+    try {
+        result = std::stoi(value, &end);
+    } catch(std::exception &e) {
+        throw Exception("--" + name + " must be an integer, got " + value);
+    }
+    if(end != value.size())
+        throw Exception("--" + name + " must be an integer, got " + value);
+    if(result < minimum)
+        throw Exception("--" + name + " must be at least " + std::to_string(minimum) + ", got " + value);
+    return result;
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    // Remote slides are fetched with QNetworkAccessManager, which needs an application instance for its event loops
+    QCoreApplication app(argc, argv);
+    CommandLineParser parser("FastPathology CLI", "Run a FastPathology pipeline (.fpl) on all images of a project without a GUI");
+    parser.addVariable("pipeline", true, "Path to the pipeline (.fpl) to run");
+    parser.addVariable("project", true, "Name of the project in ~/fastpathology/projects/. Created if it does not exist.");
+    parser.addVariable("slides", "", "Images to add to the project before processing, as glob patterns or s3:// and http(s):// URIs separated by ;");
+    parser.addVariable("report", "", "Where to write the JSON timing report. Default: <project>/batch-report.json");
+    parser.addVariable("slides-in-flight", "", "Number of images processed concurrently. Default: batch/slides-in-flight setting, else 2");
+    parser.addVariable("inference-slots-per-device", "", "Number of images running inference concurrently per device. Default: 1");
+    parser.addVariable("devices", "", "Inference devices to distribute the images over, separated by comma, e.g. 0,1");
+    parser.addVariable("batch-size", "", "Number of patches per inference, 0 for the largest batch which fits in GPU memory, 1 for no batching. Default: batch size setting of the pipeline, else 0");
+    parser.addVariable("trace", "", "Where to write a trace of the import, parse, inference and export of each image, as Chrome trace JSON. Default: no trace, unless the tracing/enabled setting is set");
+    parser.addVariable("max-attempts", "", "Number of times to attempt processing an image, including earlier runs. Default: batch/max-attempts setting, else 3");
+    parser.addOption("split-slides", "Process one image at a time, with its patches split over all --devices, to lower the time per image");
+    parser.addOption("recompute", "Process all images, also those with results from the same pipeline, models and image");
+    try {
+        parser.parse(argc, argv);
+    } catch(Exception &e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_CODE_INVALID_ARGUMENTS;
+    }
+
+    // No renderers and no OpenGL context are created, this allows running on headless GPU nodes
+    Config::setVisualization(false);
+    EngineCache::setup();
+    std::string traceFilename = parser.get("trace");
+    if(traceFilename.empty() && getSetting("tracing/enabled", false).toBool())
+        traceFilename = join(QDir::homePath().toStdString(), "fastpathology", "trace.json");
+    Tracing::setEnabled(!traceFilename.empty());
+    Tracing::setThreadName("main");
+
+    const std::string pipelineFilename = parser.get("pipeline");
+    if(!fileExists(pipelineFilename)) {
+        std::cerr << "Pipeline file " << pipelineFilename << " does not exist" << std::endl;
+        return EXIT_CODE_INVALID_ARGUMENTS;
+    }
+    const std::string projectName = parser.get("project");
+    const bool projectExists = isDir(QDir::homePath().toStdString() + "/fastpathology/projects/" + projectName);
+    std::shared_ptr<Project> project;
+    try {
+        project = std::make_shared<Project>(projectName, projectExists);
+        if(!parser.get("slides").empty()) {
+            auto slides = expandSlidePatterns(parser.get("slides"));
+            if(slides.empty()) {
+                std::cerr << "No images matched " << parser.get("slides") << std::endl;
+                return EXIT_CODE_INVALID_ARGUMENTS;
+            }
+            std::set<std::string> included;
+            for(auto uid : project->getAllWsiUids())
+                included.insert(project->getImage(uid)->get_filename());
+            for(auto& slide : slides) {
+                if(included.count(slide) == 0)
+                    project->includeImage(slide);
+            }
+        }
+    } catch(Exception &e) {
+        std::cerr << "Unable to set up project " << projectName << ": " << e.what() << std::endl;
+        return EXIT_CODE_INVALID_ARGUMENTS;
+    }
+    if(project->isProjectEmpty()) {
+        std::cerr << "Project " << projectName << " has no images to process" << std::endl;
+        return EXIT_CODE_INVALID_ARGUMENTS;
+    }
+
+    BatchScheduler scheduler(project, pipelineFilename);
+    try {
+        if(!parser.get("slides-in-flight").empty())
+            scheduler.setSlidesInFlight(parseInteger("slides-in-flight", parser.get("slides-in-flight"), 1));
+        if(!parser.get("inference-slots-per-device").empty())
+            scheduler.setInferenceSlotsPerDevice(parseInteger("inference-slots-per-device", parser.get("inference-slots-per-device"), 1));
+        if(!parser.get("devices").empty()) {
+            std::vector<int> devices;
+            for(auto device : split(parser.get("devices"), ","))
+                devices.push_back(parseInteger("devices", device, 0));
+            scheduler.setDevices(devices);
+        }
+        if(!parser.get("batch-size").empty())
+            scheduler.setBatchSize(parseInteger("batch-size", parser.get("batch-size"), 0));
+        if(!parser.get("max-attempts").empty())
+            scheduler.setMaxAttempts(parseInteger("max-attempts", parser.get("max-attempts"), 1));
+    } catch(Exception &e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_CODE_INVALID_ARGUMENTS;
+    }
+    if(parser.getOption("split-slides"))
+        scheduler.setSplitSlides(true);
+    scheduler.setSkipUpToDate(!parser.getOption("recompute"));
+    scheduler.setItemFinishedCallback([](const BatchItemReport& item) {
+        std::cout << "Finished " << item.uid << ": " << item.status << std::endl;
+    });
+
+    const std::string batchStartTime = currentDateTime();
+    const auto batchStart = std::chrono::steady_clock::now();
+    auto items = scheduler.run(project->getAllWsiUids());
+
+    // A failing slide does not abort the batch, it is recorded in the report and the exit code
+    QJsonArray slideReports;
+    int failed = 0;
+    int skipped = 0;
+    for(auto& item : items) {
+        QJsonObject slideReport;
+        slideReport["uid"] = QString::fromStdString(item.uid);
+        slideReport["filename"] = QString::fromStdString(item.filename);
+        slideReport["status"] = QString::fromStdString(item.status);
+        if(!item.error.empty())
+            slideReport["error"] = QString::fromStdString(item.error);
+        slideReport["device"] = item.device;
+        if(!item.devices.empty()) {
+            QJsonArray devices;
+            for(auto device : item.devices)
+                devices.append(device);
+            slideReport["devices"] = devices;
+        }
+        slideReport["attempts"] = item.attempts;
+        for(auto& timing : item.timings)
+            slideReport[QString::fromStdString(timing.first)] = timing.second;
+        if(item.status == "skipped")
+            ++skipped;
+        else if(item.status != "done")
+            ++failed;
+        slideReports.append(slideReport);
+    }
+
+    QJsonObject report;
+    report["pipeline"] = QString::fromStdString(pipelineFilename);
+    report["project"] = QString::fromStdString(projectName);
+    report["started"] = QString::fromStdString(batchStartTime);
+    report["total"] = secondsSince(batchStart);
+    report["processed"] = (int)slideReports.size() - failed - skipped;
+    report["skipped"] = skipped;
+    report["failed"] = failed;
+    report["slides"] = slideReports;
+
+    std::string reportFilename = parser.get("report");
+    if(reportFilename.empty())
+        reportFilename = join(project->getRootFolder(), "batch-report.json");
+    std::ofstream file(reportFilename);
+    file << QJsonDocument(report).toJson().toStdString();
+    file.close();
+    std::cout << "Report written to " << reportFilename << std::endl;
+    if(!traceFilename.empty()) {
+        if(Tracing::dump(traceFilename)) {
+            std::cout << "Trace written to " << traceFilename << std::endl;
+        } else {
+            std::cerr << "Unable to write trace to " << traceFilename << std::endl;
+        }
+    }
+
+    return failed > 0 ? EXIT_CODE_SLIDES_FAILED : EXIT_CODE_OK;
+}
@@ -18,7 +18,7 @@ namespace fast{
         _project_widget = new ProjectWidget(m_mainWindow, this);
         _process_widget = new ProcessWidget(m_mainWindow, this);
         _view_widget = new ViewWidget(m_mainWindow, this);
-        //_stats_widget = new StatsWidget(this);
+        _stats_widget = new StatsWidget(m_mainWindow, this);
         //_export_widget = new ExportWidget(this);
 
         //stackedWidget->setStyleSheet("border:1px solid rgb(0, 255, 0); ");
@@ -27,7 +27,7 @@ namespace fast{
         _container_stacked_widget->insertWidget(0, _project_widget);
         _container_stacked_widget->insertWidget(1, _process_widget);
         _container_stacked_widget->insertWidget(2, _view_widget);
-        //_container_stacked_widget->insertWidget(3, _stats_widget);
+        _container_stacked_widget->insertWidget(3, _stats_widget);
         //_container_stacked_widget->insertWidget(4, _export_widget);
         //stackedLayout->setSizeConstraint(QLayout::SetFixedSize);
         //stackedWidget->setLayout(mainLayout);
@@ -61,7 +61,7 @@ namespace fast{
         QPixmap openPix(QString::fromStdString(":/data/Icons/import_icon_new_cropped_resized.png"));
         QPixmap processPix(QString::fromStdString(":/data/Icons/process_icon_new_cropped_resized.png"));
         QPixmap viewPix(QString::fromStdString(":/data/Icons/visualize_icon_new_cropped_resized.png"));
-        //QPixmap resultPix(QString::fromStdString(":/data/Icons/statistics_icon_new_cropped_resized.png"));
+        QPixmap resultPix(QString::fromStdString(":/data/Icons/statistics_icon_new_cropped_resized.png"));
         //QPixmap savePix(QString::fromStdString(":/data/Icons/export_icon_new_cropped_resized.png"));
 
         QPainter painter(&menuIcon);
@@ -103,7 +103,6 @@ namespace fast{
         mapper->setMapping(view_action, 2);
         mapper->connect(view_action, SIGNAL(triggered(bool)), SLOT(map()));
 
-        /*
         auto stats_action = new QAction("Stats", actionGroup);
         stats_action->setIcon(QIcon(resultPix));
         stats_action->setCheckable(true);
@@ -111,6 +110,7 @@ namespace fast{
         mapper->setMapping(stats_action, 3);
         mapper->connect(stats_action, SIGNAL(triggered(bool)), SLOT(map()));
 
+        /*
         auto save_action = new QAction("Export", actionGroup);
         save_action->setIcon(QIcon(savePix));
         save_action->setCheckable(true);
@@ -144,7 +144,7 @@ namespace fast{
         _project_widget->resetInterface();
         _process_widget->resetInterface();
         _view_widget->resetInterface();
-        //_stats_widget->resetInterface();
+        _stats_widget->resetInterface();
         //_export_widget->resetInterface();
     }
 
@@ -164,4 +164,8 @@ namespace fast{
     ViewWidget *MainSidePanelWidget::getViewWidget() {
         return _view_widget;
     }
+
+    StatsWidget *MainSidePanelWidget::getStatsWidget() {
+        return _stats_widget;
+    }
 }
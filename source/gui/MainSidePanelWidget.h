@@ -23,6 +23,7 @@ namespace fast{
          */
         void resetInterface();
         ViewWidget* getViewWidget();
+        StatsWidget* getStatsWidget();
     protected:
         void setUpInterface();
         /**
@@ -45,7 +46,7 @@ namespace fast{
         ProjectWidget *_project_widget;
         ProcessWidget *_process_widget;
         ViewWidget *_view_widget;
-        //StatsWidget *_stats_widget;
+        StatsWidget *_stats_widget;
         //ExportWidget *_export_widget;
 
     private:
@@ -68,6 +68,7 @@ MainWindow::MainWindow() {
         }
     }
 
+    m_tilePrefetcher = std::make_unique<TilePrefetcher>();
     setupInterface();
     setupConnections();
 
@@ -103,7 +104,7 @@ void MainWindow::showSplashMenu(bool allowClose, bool showDataHub) {
             reset();
         std::cout << "Opening project with name " << name.toStdString() << std::endl;;
         // TODO have some sort of progress bar here.
-        m_project = std::make_shared<Project>(name.toStdString(), true); // <-- This takes time
+        m_project = std::make_shared<Project>(name.toStdString(), true); // WSIs are imported lazily, thumbnails read from cache
         emit _side_panel_widget->loadProject();
         emit updateProjectTitle();
     });
@@ -183,6 +184,10 @@ void MainWindow::setupConnections()
     QObject::connect(mWidget, &WindowWidget::filesDropped, _side_panel_widget, &MainSidePanelWidget::filesDropped);
     QObject::connect(_side_panel_widget, &MainSidePanelWidget::changeWSIDisplayTriggered, this, &MainWindow::changeWSIDisplayReceived);
     QObject::connect(_side_panel_widget, &MainSidePanelWidget::resetDisplay, this, &MainWindow::resetDisplay);
+    // Follow the camera for the tile prefetcher
+    m_prefetchTimer = new QTimer(this);
+    QObject::connect(m_prefetchTimer, &QTimer::timeout, this, &MainWindow::updatePrefetchViewport);
+    m_prefetchTimer->start(100);
     QObject::connect(_side_panel_widget, &MainSidePanelWidget::showMenu, this, &MainWindow::showSplashMenuWithClose);
 }
 
@@ -230,14 +235,14 @@ void MainWindow::changeWSIDisplayReceived(std::string uid_name)
     auto renderer = ImagePyramidRenderer::create()
         ->connect(img->get_image_pyramid());
     view->addRenderer(renderer);
+    m_prefetchImage = img->get_image_pyramid();
+    m_tilePrefetcher->setImage(m_prefetchImage);
 
+    // Only lists the results, they are imported in the background by the view widget
+    _side_panel_widget->getViewWidget()->flushRendererAttributes();
     auto results = getCurrentProject()->loadResults(uid_name);
-    if(!results.empty()) {
-        for(auto result : results) {
-            view->addRenderer(result.renderer);
-        }
-        _side_panel_widget->getViewWidget()->setResults(results);
-    }
+    _side_panel_widget->getViewWidget()->setResults(results);
+    _side_panel_widget->getStatsWidget()->setResults(results);
 
     // update application name to contain current WSI
     setTitle(_application_name + " - " + splitCustom(uid_name, "/").back());
@@ -248,6 +253,44 @@ void MainWindow::changeWSIDisplayReceived(std::string uid_name)
 
 void MainWindow::resetDisplay(){
     getView(0)->removeAllRenderers();
+    m_prefetchImage.reset();
+    m_tilePrefetcher->clear();
+}
+
+void MainWindow::updatePrefetchViewport() {
+    if(!m_prefetchImage || !view->isVisible())
+        return;
+    m_tilePrefetcher->updateViewport(getViewport(view->rect()));
+}
+
+Viewport MainWindow::getViewport(const QRect& region) const {
+    Viewport viewport;
+    if(m_currentVisibleWSI.empty() || view->width() == 0 || view->height() == 0)
+        return viewport;
+    auto image = getCurrentWSI()->get_image_pyramid();
+    // Corners of the region, from normalized device coordinates to world (mm) and then level 0 pixel coordinates
+    const Matrix4f inverse = (view->getPerspectiveMatrix()*view->getViewMatrix()).inverse();
+    const float left = 2.0f*region.left()/view->width() - 1;
+    const float right = 2.0f*(region.right() + 1)/view->width() - 1;
+    const float top = 1 - 2.0f*region.top()/view->height();
+    const float bottom = 1 - 2.0f*(region.bottom() + 1)/view->height();
+    Vector4f corner0 = inverse*Vector4f(left, bottom, 0, 1);
+    Vector4f corner1 = inverse*Vector4f(right, top, 0, 1);
+    corner0 /= corner0.w();
+    corner1 /= corner1.w();
+    const Vector3f spacing = image->getSpacing();
+    const float fullWidth = image->getFullWidth()*spacing.x();
+    const float fullHeight = image->getFullHeight()*spacing.y();
+    viewport.x = std::min(corner0.x(), corner1.x()) / fullWidth;
+    viewport.y = std::min(corner0.y(), corner1.y()) / fullHeight;
+    viewport.width = std::abs(corner1.x() - corner0.x()) / fullWidth;
+    viewport.height = std::abs(corner1.y() - corner0.y()) / fullHeight;
+    viewport.screenWidth = region.width();
+    return viewport;
+}
+
+TilePrefetcher* MainWindow::getTilePrefetcher() const {
+    return m_tilePrefetcher.get();
 }
 
 std::shared_ptr<ComputationThread> MainWindow::getComputationThread() {
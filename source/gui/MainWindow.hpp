@@ -11,6 +11,7 @@
 #include <QProgressDialog>
 #include "source/utils/utilities.h"
 #include "source/gui/MainSidePanelWidget.h"
+#include "source/logic/TilePrefetcher.h"
 
 QT_BEGIN_NAMESPACE
 class QAction;
@@ -29,6 +30,7 @@ class QPlainTextEdit;
 class QString;
 class QScrollArea;
 class QListWidget;
+class QTimer;
 QT_END_NAMESPACE
 
 namespace fast {
@@ -66,6 +68,14 @@ class MainWindow : public Window {
         std::shared_ptr<WholeSlideImage> getCurrentWSI() const;
 
         std::string getRootFolder() const;
+        /**
+         * Prefetches tiles of the WSI and results shown in the view, ahead of the camera.
+         */
+        TilePrefetcher* getTilePrefetcher() const;
+        /**
+         * Region of the visible WSI shown in a rectangle of the view, in pixels of the view. Empty if no WSI is shown.
+         */
+        Viewport getViewport(const QRect& region) const;
     protected:
         /**
          * Define the interface for the current global widget.
@@ -75,6 +85,10 @@ class MainWindow : public Window {
          * Define the connections for all elements inside the current global widget.
          */
         void setupConnections();
+        /**
+         * Send the region of the WSI currently visible in the view to the tile prefetcher.
+         */
+        void updatePrefetchViewport();
 
     private:
         MainWindow();
@@ -85,6 +99,9 @@ class MainWindow : public Window {
 
         std::string _application_name; /* */
         MainSidePanelWidget *_side_panel_widget; /* Main widget for the left-hand panel */
+        std::unique_ptr<TilePrefetcher> m_tilePrefetcher;
+        std::shared_ptr<ImagePyramid> m_prefetchImage; /* Image pyramid of the visible WSI, empty if none */
+        QTimer* m_prefetchTimer;
 
     public slots:
         void closeEvent (QCloseEvent *event);
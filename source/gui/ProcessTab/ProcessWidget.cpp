@@ -10,9 +10,25 @@
 #include <FAST/Visualization/ComputationThread.hpp>
 #include <FAST/Algorithms/ImagePatch/PatchGenerator.hpp>
 #include "source/logic/WholeSlideImage.h"
+#include "source/logic/BatchScheduler.h"
+#include "source/logic/EngineCache.h"
+#include "source/logic/PipelineRuntime.h"
+#include "source/logic/PipelineBatching.h"
+#include "source/logic/TissueMaskCache.h"
+#include "source/logic/IncrementalPipeline.h"
+#include "source/logic/Tracing.h"
 #include "source/gui/MainWindow.hpp"
 #include <QApplication>
 #include <QDesktopWidget>
+#include <QPointer>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QFormLayout>
+#include <QSpinBox>
+#include <QFileInfo>
+#include <QRubberBand>
+#include <QMouseEvent>
+#include <QKeyEvent>
 
 namespace fast {
     ProcessWidget::ProcessWidget(MainWindow* mainWindow, QWidget* parent): QWidget(parent){
@@ -20,6 +36,11 @@ namespace fast {
         m_computationThread = mainWindow->getComputationThread();
         this->_cwd = join(QDir::homePath().toStdString(), "fastpathology");
         m_view = mainWindow->getView(0);
+        m_precompilePool = new QThreadPool(this);
+        m_precompilePool->setMaxThreadCount(1);
+        m_incrementalPipeline = std::make_shared<IncrementalPipeline>();
+        m_regionBand = new QRubberBand(QRubberBand::Rectangle, m_view);
+        m_view->installEventFilter(this);
         this->setupInterface();
         this->setupConnections();
 
@@ -31,6 +52,11 @@ namespace fast {
 
         // Connection to show message in GUI in main thread
         QObject::connect(this, &ProcessWidget::messageSignal, this, &ProcessWidget::showMessage, Qt::QueuedConnection);
+
+        // pipelineFinished is emitted from the export and batch threads, which requires a queued connection
+        qRegisterMetaType<std::string>("std::string");
+
+        QObject::connect(mainWindow, &MainWindow::updateProjectTitle, this, &ProcessWidget::updatePatchSkipping);
     }
 
     ProcessWidget::~ProcessWidget(){
@@ -70,6 +96,71 @@ namespace fast {
         _main_layout->addWidget(addModelsButton);
         connect(addModelsButton, &QPushButton::clicked, this, &ProcessWidget::addModelsFromDisk);
 
+        auto engineCacheLayout = new QHBoxLayout();
+        m_engineCacheLabel = new QLabel();
+        engineCacheLayout->addWidget(m_engineCacheLabel);
+        auto clearEngineCacheButton = new QPushButton();
+        clearEngineCacheButton->setText("Clear");
+        clearEngineCacheButton->setToolTip("Remove compiled inference engines. They are compiled again the next time a model is used.");
+        engineCacheLayout->addWidget(clearEngineCacheButton);
+        _main_layout->addLayout(engineCacheLayout);
+        connect(clearEngineCacheButton, &QPushButton::clicked, this, &ProcessWidget::clearEngineCache);
+        updateEngineCacheSize();
+
+        auto tracingLayout = new QHBoxLayout();
+        auto tracingCheckBox = new QCheckBox("Record trace");
+        tracingCheckBox->setChecked(Tracing::isEnabled());
+        tracingCheckBox->setToolTip("Record when images are imported, pipelines parsed and run, and results written, to find out where time is spent.");
+        tracingLayout->addWidget(tracingCheckBox);
+        auto saveTraceButton = new QPushButton();
+        saveTraceButton->setText("Save trace");
+        saveTraceButton->setToolTip("Save the recorded trace as JSON, which can be opened in ui.perfetto.dev or chrome://tracing.");
+        tracingLayout->addWidget(saveTraceButton);
+        _main_layout->addLayout(tracingLayout);
+        connect(tracingCheckBox, &QCheckBox::toggled, [](bool checked) {
+            Tracing::setEnabled(checked);
+        });
+        connect(saveTraceButton, &QPushButton::clicked, [this]() {
+            const QString filename = QFileDialog::getSaveFileName(this, "Save trace", QString::fromStdString(join(_cwd, "trace.json")), "Trace (*.json)");
+            if(filename.isEmpty())
+                return;
+            if(!Tracing::dump(filename.toStdString()))
+                showMessage("Unable to write " + filename);
+        });
+
+        m_patchSkippingBox = new QGroupBox("Patch skipping in this project");
+        auto patchSkippingLayout = new QFormLayout();
+        m_patchSkippingBox->setLayout(patchSkippingLayout);
+        m_tissueMaskCheckBox = new QCheckBox("Cache tissue masks");
+        m_tissueMaskCheckBox->setToolTip("Segment the tissue of each image once, and only process patches with tissue in all pipelines.");
+        patchSkippingLayout->addRow(m_tissueMaskCheckBox);
+        m_coarsePipelineComboBox = new QComboBox();
+        m_coarsePipelineComboBox->setToolTip("Cheap low magnification pipeline run first. Other pipelines only process patches where its score passes the threshold.");
+        patchSkippingLayout->addRow("Coarse pipeline", m_coarsePipelineComboBox);
+        m_coarseThresholdSpinBox = new QDoubleSpinBox();
+        m_coarseThresholdSpinBox->setRange(0, 1);
+        m_coarseThresholdSpinBox->setSingleStep(0.05);
+        patchSkippingLayout->addRow("Coarse threshold", m_coarseThresholdSpinBox);
+        _main_layout->addWidget(m_patchSkippingBox);
+        connect(m_tissueMaskCheckBox, &QCheckBox::toggled, [this](bool checked) {
+            if(auto project = m_mainWindow->getCurrentProject())
+                project->setProjectSetting("tissue/cache-masks", checked);
+        });
+        connect(m_coarsePipelineComboBox, QOverload<int>::of(&QComboBox::activated), [this](int index) {
+            if(auto project = m_mainWindow->getCurrentProject())
+                project->setProjectSetting("tissue/coarse-pipeline", m_coarsePipelineComboBox->itemData(index));
+        });
+        connect(m_coarseThresholdSpinBox, QOverload<double>::of(&QDoubleSpinBox::valueChanged), [this](double value) {
+            if(auto project = m_mainWindow->getCurrentProject())
+                project->setProjectSetting("tissue/coarse-threshold", value);
+        });
+
+        m_runtimeLabel = new QLabel();
+        m_runtimeLabel->setWordWrap(true);
+        m_runtimeLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+        m_runtimeLabel->hide();
+        _main_layout->addWidget(m_runtimeLabel);
+
         this->refreshPipelines();
     }
 
@@ -86,7 +177,9 @@ namespace fast {
 
     void ProcessWidget::refreshPipelines(QString currentFilename) {
         _page_combobox->clear();
-        clearLayout(_stacked_layout);
+        // Pages are kept, and only created again when their pipeline file has been modified
+        while(_stacked_layout->count() > 0)
+            _stacked_layout->removeWidget(_stacked_layout->widget(0));
         resetInterface();
         int index = 0;
         int counter = 0;
@@ -102,66 +195,156 @@ namespace fast {
                 pipelinePaths.push_back(join(pipelineFolder, dir, "pipeline.fpl"));
             }
         }
-        // Load pipelines and create buttons for each.
+        m_coarsePipelineComboBox->clear();
+        m_coarsePipelineComboBox->addItem("None", QString());
+        std::map<std::string, PipelinePage> pages;
         for(auto& filename : pipelinePaths) {
-            try {
-                auto pipeline = Pipeline(filename);
-
-                if(getFileName(filename) == currentFilename.toStdString()) {
-                    index = counter;
+            const qint64 modified = QFileInfo(QString::fromStdString(filename)).lastModified().toMSecsSinceEpoch();
+            auto cached = m_pipelinePages.find(filename);
+            if(cached != m_pipelinePages.end() && cached->second.modified == modified) {
+                pages[filename] = cached->second;
+                m_pipelinePages.erase(cached);
+            } else {
+                try {
+                    auto pipeline = Pipeline(filename);
+                    PipelinePage page;
+                    page.modified = modified;
+                    page.name = pipeline.getName();
+                    page.widget = createPipelinePage(pipeline);
+                    pages[filename] = page;
+                } catch(std::exception &e) {
+                    Reporter::warning() << "Unable to read pipeline file " << filename << ", ignoring.." << Reporter::end();
+                    continue;
                 }
-
-                auto page = new QWidget();
-                page->setMaximumWidth(QApplication::desktop()->screen()->width()/4);
-                auto layout = new QVBoxLayout();
-                layout->setAlignment(Qt::AlignTop);
-                page->setLayout(layout);
-                _stacked_layout->addWidget(page);
-                _page_combobox->addItem(QString::fromStdString(pipeline.getName()));
-
-                auto description = new QLabel();
-                description->setMaximumWidth(QApplication::desktop()->screen()->width()/4);
-                description->setText(QString::fromStdString(pipeline.getDescription()));
-                description->setWordWrap(true);
-                description->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
-                layout->addWidget(description);
-
-                auto button = new QPushButton;
-                button->setText("Run pipeline for this image");
-                button->setStyleSheet("background-color: #ADD8E6;");
-                layout->addWidget(button);
-                QObject::connect(button, &QPushButton::clicked, [=]() {
-                    runInThread(pipeline.getFilename(), pipeline.getName(), false);
-                });
-
-                auto batchButton = new QPushButton;
-                batchButton->setText("Run pipeline for all images");
-                layout->addWidget(batchButton);
-                QObject::connect(batchButton, &QPushButton::clicked, [=]() {
-                    runInThread(pipeline.getFilename(), pipeline.getName(), true);
-                });
-
-                layout->addSpacing(20);
-
-                auto editButton = new QPushButton;
-                editButton->setText("Edit pipeline");
-                layout->addWidget(editButton);
-                connect(editButton, &QPushButton::clicked, [=]() {
-                    auto editor = new PipelineScriptEditorWidget(QString::fromStdString(pipeline.getFilename()), this);
-                    connect(editor, &PipelineScriptEditorWidget::pipelineSaved, this, &ProcessWidget::refreshPipelines);
-                });
-                ++counter;
-            } catch(std::exception &e) {
-                Reporter::warning() << "Unable to read pipeline file " << filename << ", ignoring.." << Reporter::end();
-                continue;
             }
+            if(getFileName(filename) == currentFilename.toStdString()) {
+                index = counter;
+            }
+            _stacked_layout->addWidget(pages[filename].widget);
+            _page_combobox->addItem(QString::fromStdString(pages[filename].name));
+            m_coarsePipelineComboBox->addItem(QString::fromStdString(pages[filename].name), QString::fromStdString(filename));
+            ++counter;
         }
+        // Pages of removed and modified pipelines
+        for(auto& page : m_pipelinePages)
+            page.second.widget->deleteLater();
+        m_pipelinePages = pages;
         _page_combobox->setCurrentIndex(index);
         _stacked_layout->setCurrentIndex(index);
+        updatePatchSkipping();
+    }
+
+    QWidget* ProcessWidget::createPipelinePage(Pipeline pipeline) {
+        auto page = new QWidget();
+        page->setMaximumWidth(QApplication::desktop()->screen()->width()/4);
+        auto layout = new QVBoxLayout();
+        layout->setAlignment(Qt::AlignTop);
+        page->setLayout(layout);
+
+        auto description = new QLabel();
+        description->setMaximumWidth(QApplication::desktop()->screen()->width()/4);
+        description->setText(QString::fromStdString(pipeline.getDescription()));
+        description->setWordWrap(true);
+        description->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+        layout->addWidget(description);
+
+        auto button = new QPushButton;
+        button->setText("Run pipeline for this image");
+        button->setStyleSheet("background-color: #ADD8E6;");
+        layout->addWidget(button);
+        QObject::connect(button, &QPushButton::clicked, [=]() {
+            runInThread(pipeline.getFilename(), pipeline.getName(), false);
+        });
+
+        auto batchButton = new QPushButton;
+        batchButton->setText("Run pipeline for all images");
+        layout->addWidget(batchButton);
+        QObject::connect(batchButton, &QPushButton::clicked, [=]() {
+            runInThread(pipeline.getFilename(), pipeline.getName(), true);
+        });
+
+        // Only the patches of a region are processed, which gives results for it in seconds
+        auto regionLayout = new QHBoxLayout();
+        auto visibleButton = new QPushButton;
+        visibleButton->setText("Run for visible region");
+        visibleButton->setToolTip("Run the pipeline only on the region of the image shown in the view. The results are shown, not stored.");
+        regionLayout->addWidget(visibleButton);
+        QObject::connect(visibleButton, &QPushButton::clicked, [=]() {
+            const auto region = RegionOfInterest::fromViewport(m_mainWindow->getViewport(m_view->rect()));
+            if(region.isEmpty()) {
+                showMessage("No image is shown in the view.");
+                return;
+            }
+            runInThread(pipeline.getFilename(), pipeline.getName(), false, region);
+        });
+        auto drawButton = new QPushButton;
+        drawButton->setText("Run for drawn region");
+        drawButton->setToolTip("Draw a rectangle in the view with the mouse to run the pipeline only on it. Escape cancels.");
+        regionLayout->addWidget(drawButton);
+        QObject::connect(drawButton, &QPushButton::clicked, [=]() {
+            if(m_mainWindow->getCurrentWSIUID().empty()) {
+                showMessage("No image is shown in the view.");
+                return;
+            }
+            m_regionPipelineFilename = pipeline.getFilename();
+            m_regionPipelineName = pipeline.getName();
+            m_drawingRegion = true;
+            m_view->setCursor(Qt::CrossCursor);
+            m_view->setFocus();
+        });
+        layout->addLayout(regionLayout);
+
+        // Batching is applied when the pipeline is parsed, see PipelineBatching
+        const std::string pipelineName = pipeline.getName();
+        auto batchingLayout = new QFormLayout();
+        auto batchSize = new QSpinBox();
+        batchSize->setRange(0, 256);
+        batchSize->setSpecialValueText("Auto");
+        batchSize->setValue(PipelineBatching::getBatchSize(pipelineName));
+        batchSize->setToolTip("Number of patches per inference. Auto selects the largest batch which fits in GPU memory, 1 disables batching.");
+        batchingLayout->addRow("Batch size", batchSize);
+        QObject::connect(batchSize, QOverload<int>::of(&QSpinBox::valueChanged), [pipelineName](int value) {
+            PipelineBatching::setBatchSize(pipelineName, value);
+        });
+        auto maxInFlight = new QSpinBox();
+        maxInFlight->setRange(0, 64);
+        maxInFlight->setSpecialValueText("Default");
+        maxInFlight->setValue(PipelineBatching::getMaxInFlight(pipelineName));
+        maxInFlight->setToolTip("Number of images processed at the same time when running the pipeline for all images.");
+        batchingLayout->addRow("Images in flight", maxInFlight);
+        QObject::connect(maxInFlight, QOverload<int>::of(&QSpinBox::valueChanged), [pipelineName](int value) {
+            PipelineBatching::setMaxInFlight(pipelineName, value);
+        });
+        layout->addLayout(batchingLayout);
+
+        layout->addSpacing(20);
+
+        auto editButton = new QPushButton;
+        editButton->setText("Edit pipeline");
+        layout->addWidget(editButton);
+        connect(editButton, &QPushButton::clicked, [=]() {
+            auto editor = new PipelineScriptEditorWidget(QString::fromStdString(pipeline.getFilename()), this);
+            connect(editor, &PipelineScriptEditorWidget::pipelineSaved, this, &ProcessWidget::refreshPipelines);
+        });
+        return page;
     }
 
-    void ProcessWidget::runInThread(std::string pipelineFilename, std::string pipelineName, bool runForAll) {
+    void ProcessWidget::updatePatchSkipping() {
+        auto project = m_mainWindow->getCurrentProject();
+        m_patchSkippingBox->setEnabled((bool)project);
+        if(!project)
+            return;
+        const QSignalBlocker checkBoxBlocker(m_tissueMaskCheckBox);
+        const QSignalBlocker spinBoxBlocker(m_coarseThresholdSpinBox);
+        m_tissueMaskCheckBox->setChecked(project->getProjectSetting("tissue/cache-masks", false).toBool());
+        m_coarseThresholdSpinBox->setValue(project->getProjectSetting("tissue/coarse-threshold", 0.5).toDouble());
+        const int index = m_coarsePipelineComboBox->findData(project->getProjectSetting("tissue/coarse-pipeline", "").toString());
+        m_coarsePipelineComboBox->setCurrentIndex(std::max(0, index));
+    }
+
+    void ProcessWidget::runInThread(std::string pipelineFilename, std::string pipelineName, bool runForAll, RegionOfInterest region) {
         stopProcessing(); // Have to stop any renderers etc first.
+        m_regionOfInterest = runForAll ? RegionOfInterest() : region;
 
         // Create a GL context for the thread which is sharing with the context of the view
         // We have to this because we need an OpenGL context when parsing the pipeline and thereby creating renderers
@@ -203,6 +386,8 @@ namespace fast {
         QObject::connect(m_progressDialog, &QProgressDialog::canceled, timer, &QTimer::stop);
         QObject::connect(m_progressDialog, &QProgressDialog::canceled, [this, thread]() {
             std::cout << "canceled.." << std::endl;
+            if(m_batchScheduler)
+                m_batchScheduler->stop();
             thread->wait();
             std::cout << "done waiting" << std::endl;
             stop();
@@ -214,18 +399,17 @@ namespace fast {
 
     void ProcessWidget::stopProcessing() {
         m_procesessing = false;
-        std::cout << "stopping pipeline" << std::endl;
+        TraceScope trace("gui", "stop pipeline");
         m_view->stopPipeline();
-        std::cout << "done" << std::endl;
-        std::cout << "removing renderers.." << std::endl;
         m_view->removeAllRenderers();
-        std::cout << "done" << std::endl;
     }
 
     void ProcessWidget::stop() {
         if(m_progressDialog)
             m_progressDialog->setValue(m_progressDialog->maximum()); // Close progress dialog
         m_batchProcesessing = false;
+        if(m_batchScheduler)
+            m_batchScheduler->stop();
         stopProcessing();
         selectWSI(m_mainWindow->getCurrentWSI()->get_image_pyramid());
     }
@@ -238,9 +422,21 @@ namespace fast {
     }
 
     void ProcessWidget::updateProgress() {
+        if(m_batchProcesessing && m_batchScheduler) {
+            if(m_progressDialog != nullptr)
+                m_progressDialog->setValue(std::floor(m_batchScheduler->getProgress()*m_progressDialog->maximum()));
+            return;
+        }
         if(m_procesessing && m_runningPipeline && m_runningPipeline->isParsed()) {
+            if(m_runtime) {
+                m_runtime->update();
+                m_runtimeLabel->setText(QString::fromStdString(m_runtime->getSummary()));
+                m_runtimeLabel->show();
+            }
             std::vector<std::shared_ptr<PatchGenerator>> currentPatchGenerators;
             for(auto PO : m_runningPipeline->getProcessObjects()) {
+                if(m_skippedStages.count(PO.first) > 0)
+                    continue; // Disconnected by reused stages, never run
                 if(auto generator = std::dynamic_pointer_cast<PatchGenerator>(PO.second)) {
                     currentPatchGenerators.push_back(generator);
                 }
@@ -252,40 +448,24 @@ namespace fast {
             for(auto generator : currentPatchGenerators) {
                 totalProgress += std::floor(generator->getProgress()*100);
             }
-            if(m_progressDialog != nullptr) {
-                if(m_batchProcesessing) {
-                    m_progressDialog->setValue(std::floor(m_currentWSI*100 + totalProgress/currentPatchGenerators.size()));
-                } else {
-                    m_progressDialog->setValue(std::floor(totalProgress/currentPatchGenerators.size()));
-                }
-            }
+            if(m_progressDialog != nullptr)
+                m_progressDialog->setValue(std::floor(totalProgress/currentPatchGenerators.size()));
         }
     }
 
     void ProcessWidget::done() {
-        if(m_procesessing)
-            saveResults();
-        if(m_batchProcesessing) {
-            if(m_currentWSI == m_mainWindow->getCurrentProject()->getWSICountInProject()-1) {
-                // All processed. Stop.
-                m_progressDialog->setValue(m_progressDialog->maximum());
-                m_progressDialog->close();
-                m_batchProcesessing = false;
-                m_procesessing = false;
-                emit messageSignal("Batch processing is done!");
-                emit pipelineFinished(m_mainWindow->getCurrentProject()->getAllWsiUids()[0]);
-            } else {
-                // Run next
-                m_currentWSI += 1;
-                m_progressDialog->setValue(m_currentWSI*100);
-                std::cout << "Processing WSI " << m_currentWSI << std::endl;
-                processPipeline(m_runningPipeline->getFilename(), m_mainWindow->getCurrentProject()->getImage(m_currentWSI)->get_image_pyramid());
+        if(m_procesessing) {
+            Tracing::record("gui", "run pipeline", m_runningPipeline ? m_runningPipeline->getName() : std::string(), m_runStart);
+            if(m_runtime) {
+                m_runtime->update();
+                m_runtimeLabel->setText(QString::fromStdString(m_runtime->getSummary()));
             }
-        } else if(m_procesessing) {
+            // The results are written in the background, and shown in the project when complete.
+            // Results of a region are incomplete, they are only shown by the renderers of the pipeline.
+            if(m_regionOfInterest.isEmpty())
+                saveResults();
             m_progressDialog->setValue(m_progressDialog->maximum());
             m_progressDialog->close();
-            emit messageSignal("Processing is done!");
-            emit pipelineFinished(m_mainWindow->getCurrentProject()->getAllWsiUids()[m_currentWSI]);
             m_procesessing = false;
         }
     }
@@ -294,14 +474,13 @@ namespace fast {
         std::cout << "Processing pipeline: " << pipelinePath << std::endl;
         stopProcessing();
         m_procesessing = true;
+        m_runStart = std::chrono::steady_clock::now();
         auto view = m_view;
 
         // Load pipeline and give it a WSI
-        std::cout << "Loading pipeline in thread: " << std::this_thread::get_id() << std::endl;
         m_runningPipeline = std::make_shared<Pipeline>(pipelinePath);
-        std::cout << "OK" << std::endl;
         try {
-            std::cout << "parsing" << std::endl;
+            TraceScope trace("gui", "parse", pipelinePath);
             if(!WSI) {
                 auto uids = m_mainWindow->getCurrentProject()->getAllWsiUids();
                 auto currentUID = m_mainWindow->getCurrentWSIUID();
@@ -315,18 +494,46 @@ namespace fast {
                 WSI = m_mainWindow->getCurrentProject()->getImage(currentUID)->get_image_pyramid();
             }
             m_runningPipeline->parse({{"WSI", WSI}});
-            std::cout << "OK" << std::endl;
+            const int batchSize = PipelineBatching::getBatchSize(m_runningPipeline->getName());
+            PipelineBatching::apply(m_runningPipeline, batchSize);
+            auto project = m_mainWindow->getCurrentProject();
+            // Changes done here are not in the pipeline file, outputs are only reused from a run with the same changes
+            std::string parameters = "batch-size " + std::to_string(batchSize) + "\n";
+            std::shared_ptr<Image> tissueMask;
+            if(TissueMaskCache::isEnabled(*project)) {
+                try {
+                    tissueMask = TissueMaskCache::getMask(*project, m_mainWindow->getCurrentWSIUID(), WSI);
+                    const int masked = TissueMaskCache::apply(m_runningPipeline, tissueMask);
+                    parameters += "mask " + TissueMaskCache::getKey(*project, m_mainWindow->getCurrentWSIUID()) + " " + std::to_string(masked) + "\n";
+                } catch(Exception &e) {
+                    // Without the mask all patches are processed, which gives the same results, only slower
+                    Reporter::warning() << "Unable to create the patch mask, processing all patches: " << e.what() << Reporter::end();
+                }
+            }
+            if(!m_regionOfInterest.isEmpty()) {
+                // The outputs are of the region only, they are not stored, see saveResults
+                m_regionOfInterest.apply(m_runningPipeline, WSI, tissueMask);
+                parameters += "region " + m_regionOfInterest.toString() + "\n";
+            }
+            // Stages which are unchanged since the previous run on this image are not executed again
+            const int reused = m_incrementalPipeline->reuse(project->getAllWsiUids()[m_currentWSI], m_runningPipeline, parameters);
+            // Run in a QThread, the progress is shown by the main thread
+            QMetaObject::invokeMethod(this, [this, reused, skipped = m_incrementalPipeline->getSkippedStages()]() {
+                m_skippedStages = skipped;
+                if(reused > 0 && m_progressDialog != nullptr)
+                    m_progressDialog->setLabelText(m_progressDialog->labelText() + "<br>Reusing the outputs of " + QString::number(reused) + " unchanged stages.");
+            }, Qt::QueuedConnection);
+            m_runtime = std::make_shared<PipelineRuntime>(m_runningPipeline->getProcessObjects());
         } catch(Exception &e) {
             m_procesessing = false;
             m_batchProcesessing = false;
             m_runningPipeline.reset();
+            m_runtime.reset();
             // Syntax error in pipeline file. Raise error and return to avoid crash.
             std::string msg = "Error parsing pipeline! " + std::string(e.what());
             emit messageSignal(msg.c_str());
             return;
         }
-        std::cout << "Done" << std::endl;
-
         for(auto renderer : m_runningPipeline->getRenderers()) {
             view->addRenderer(renderer);
         }
@@ -334,10 +541,31 @@ namespace fast {
     }
 
     void ProcessWidget::batchProcessPipeline(std::string pipelineFilename) {
-        m_currentWSI = 0;
+        // Batch mode runs without visualization, using the scheduler to keep several WSIs in flight.
+        // This runs in the thread created by runInThread, and blocks until the batch is done.
+        auto project = m_mainWindow->getCurrentProject();
+        m_batchScheduler = std::make_shared<BatchScheduler>(project, pipelineFilename);
         m_batchProcesessing = true;
-        auto uid = m_mainWindow->getCurrentProject()->getAllWsiUids()[m_currentWSI];
-        processPipeline(pipelineFilename, m_mainWindow->getCurrentProject()->getImage(uid)->get_image_pyramid());
+        auto reports = m_batchScheduler->run(project->getAllWsiUids());
+        if(!m_batchProcesessing) // Stopped by user
+            return;
+        m_batchProcesessing = false;
+
+        int failed = 0;
+        for(auto& report : reports) {
+            if(report.status != "done" && report.status != "skipped") // Skipped images already have up to date results
+                ++failed;
+        }
+        QMetaObject::invokeMethod(m_progressDialog, [this]() {
+            m_progressDialog->setValue(m_progressDialog->maximum());
+            m_progressDialog->close();
+        }, Qt::QueuedConnection);
+        if(failed > 0) {
+            emit messageSignal(QString("Batch processing is done, but %1 of %2 images failed.").arg(failed).arg(reports.size()));
+        } else {
+            emit messageSignal("Batch processing is done!");
+        }
+        emit pipelineFinished(project->getAllWsiUids()[0]);
     }
 
     void ProcessWidget::selectWSI(std::shared_ptr<ImagePyramid> WSI) {
@@ -349,9 +577,74 @@ namespace fast {
         view->addRenderer(renderer);
     }
 
+    bool ProcessWidget::eventFilter(QObject* object, QEvent* event) {
+        if(object != m_view || !m_drawingRegion)
+            return QWidget::eventFilter(object, event);
+        switch(event->type()) {
+            case QEvent::MouseButtonPress: {
+                auto mouseEvent = static_cast<QMouseEvent*>(event);
+                if(mouseEvent->button() != Qt::LeftButton) {
+                    stopDrawingRegion();
+                    return true;
+                }
+                m_regionOrigin = mouseEvent->pos();
+                m_regionBand->setGeometry(QRect(m_regionOrigin, QSize()));
+                m_regionBand->show();
+                return true;
+            }
+            case QEvent::MouseMove: {
+                if(m_regionBand->isVisible())
+                    m_regionBand->setGeometry(QRect(m_regionOrigin, static_cast<QMouseEvent*>(event)->pos()).normalized());
+                return true;
+            }
+            case QEvent::MouseButtonRelease: {
+                if(!m_regionBand->isVisible())
+                    return true;
+                const QRect rectangle = m_regionBand->geometry();
+                stopDrawingRegion();
+                const auto region = RegionOfInterest::fromViewport(m_mainWindow->getViewport(rectangle));
+                if(rectangle.width() < 4 || rectangle.height() < 4 || region.isEmpty())
+                    return true; // A click, or outside of the WSI
+                runInThread(m_regionPipelineFilename, m_regionPipelineName, false, region);
+                return true;
+            }
+            case QEvent::Wheel:
+                return m_regionBand->isVisible(); // Zooming while drawing would move the rectangle on the WSI
+            case QEvent::KeyPress: {
+                if(static_cast<QKeyEvent*>(event)->key() == Qt::Key_Escape) {
+                    stopDrawingRegion();
+                    return true;
+                }
+                break;
+            }
+            default:
+                break;
+        }
+        return QWidget::eventFilter(object, event);
+    }
+
+    void ProcessWidget::stopDrawingRegion() {
+        m_drawingRegion = false;
+        m_regionBand->hide();
+        m_view->unsetCursor();
+    }
+
     void ProcessWidget::saveResults() {
-        auto pipelineData = m_runningPipeline->getAllPipelineOutputData();
-        m_mainWindow->getCurrentProject()->saveResults(m_mainWindow->getCurrentProject()->getAllWsiUids()[m_currentWSI], m_runningPipeline, pipelineData);
+        auto pipelineData = m_incrementalPipeline->getAllPipelineOutputData(m_runningPipeline);
+        const std::string uid = m_mainWindow->getCurrentProject()->getAllWsiUids()[m_currentWSI];
+        m_incrementalPipeline->store(uid, m_runningPipeline);
+        // Called from the export thread of the project, the signals are queued to the main thread.
+        // The GUI thread does not wait for room in the export queue.
+        const bool queued = m_mainWindow->getCurrentProject()->saveResults(uid, m_runningPipeline, pipelineData, [this, uid](bool success) {
+            if(success) {
+                emit messageSignal("Processing is done!");
+            } else {
+                emit messageSignal("Processing is done, but the results could not be saved.");
+            }
+            emit pipelineFinished(uid);
+        }, -1, false);
+        if(!queued)
+            emit messageSignal("Processing is done, the results are saved after the results still being written.");
     }
 
     void ProcessWidget::editorPipelinesReceived()
@@ -375,6 +668,7 @@ namespace fast {
         progDialog->setLabelText("Adding models...");
 
         int counter = 0;
+        std::vector<std::string> newModels;
         // now iterate over all selected files and add selected files and corresponding ones to Models/
         for (QString& filename : ls) {
             std::string filepath = filename.toStdString();
@@ -387,8 +681,55 @@ namespace fast {
             }
             counter++;
             progDialog->setValue(counter);
+            if(EngineCache::isPrecompiledModel(newPath.toStdString()))
+                newModels.push_back(newPath.toStdString());
         }
         progDialog->close();
+        // Queued after all files are copied, as OpenVINO models also need their .bin file
+        for(auto& model : newModels)
+            precompileModel(model);
+    }
+
+    /**
+     * Runs EngineCache::precompile in a thread pool
+     */
+    class PrecompileTask : public QRunnable {
+        public:
+            PrecompileTask(std::string modelFilename, std::function<void()> callback) :
+                m_modelFilename(modelFilename), m_callback(callback) {}
+            void run() override {
+                try {
+                    if(EngineCache::precompile(m_modelFilename))
+                        std::cout << "Compiled inference engine for " << m_modelFilename << std::endl;
+                } catch(std::exception &e) {
+                    Reporter::warning() << "Unable to precompile " << m_modelFilename << ": " << e.what() << Reporter::end();
+                }
+                m_callback();
+            }
+        private:
+            std::string m_modelFilename;
+            std::function<void()> m_callback;
+    };
+
+    void ProcessWidget::precompileModel(const std::string& modelFilename) {
+        QPointer<ProcessWidget> widget(this);
+        m_precompilePool->start(new PrecompileTask(modelFilename, [widget]() {
+            if(widget)
+                QMetaObject::invokeMethod(widget, [widget]() { widget->updateEngineCacheSize(); }, Qt::QueuedConnection);
+        }));
+    }
+
+    void ProcessWidget::updateEngineCacheSize() {
+        m_engineCacheLabel->setText(QString("Engine cache: %1 MB").arg(EngineCache::getSize() / (1024.0*1024.0), 0, 'f', 1));
+    }
+
+    void ProcessWidget::clearEngineCache() {
+        if(m_procesessing || m_batchProcesessing || m_precompilePool->activeThreadCount() > 0) {
+            QMessageBox::warning(nullptr, "Engine cache", "The engine cache can not be cleared while processing.");
+            return;
+        }
+        EngineCache::clear();
+        updateEngineCacheSize();
     }
 
     void ProcessWidget::addPipelinesFromDisk() {
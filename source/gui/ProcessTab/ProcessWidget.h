@@ -1,6 +1,9 @@
 #pragma once
 
 #include <string>
+#include <map>
+#include <set>
+#include <chrono>
 #include <iostream>
 #include <fstream>
 #include <QWidget>
@@ -19,13 +22,18 @@
 #include <QComboBox>
 #include <QGroupBox>
 #include <QPlainTextEdit>
+#include <QCheckBox>
+#include <QDoubleSpinBox>
 #include <FAST/Visualization/Renderer.hpp>
 #include "source/utils/utilities.h"
 #include "source/utils/qutilities.h"
 #include "source/gui/ProcessTab/PipelineScriptEditorWidget.h"
+#include "source/logic/RegionOfInterest.h"
 #include <FAST/Pipeline.hpp>
 
 class QStackedLayout;
+class QThreadPool;
+class QRubberBand;
 
 namespace fast {
 
@@ -33,6 +41,9 @@ class View;
 class ComputationThread;
 class MainWindow;
 class ImagePyramid;
+class BatchScheduler;
+class PipelineRuntime;
+class IncrementalPipeline;
 
 class ProcessWidget: public QWidget {
 Q_OBJECT
@@ -52,7 +63,12 @@ public:
     void batchProcessPipeline(std::string pipelinePath);
     void saveResults();
     void showMessage(QString msg);
-    void runInThread(std::string pipelineFilename, std::string pipelineName, bool runForAll);
+    /**
+     * @brief runInThread Run a pipeline on the current WSI, or all WSIs of the project, in a new thread.
+     * @param region If not empty, only this region of the current WSI is processed, and the results are only
+     * shown in the view, not stored in the project.
+     */
+    void runInThread(std::string pipelineFilename, std::string pipelineName, bool runForAll, RegionOfInterest region = RegionOfInterest());
 protected:
     /**
      * Define the interface for the current global widget.
@@ -83,10 +99,47 @@ public slots:
      */
     void addPipelinesFromDisk();
     /**
-     * @brief Update progress dialog
+     * @brief Update progress dialog, and the runtime measurements of the running pipeline
      */
     void updateProgress();
+    /**
+     * @brief Show the current size of the compiled engine cache
+     */
+    void updateEngineCacheSize();
+    /**
+     * @brief Remove all compiled engines from the cache
+     */
+    void clearEngineCache();
+    /**
+     * @brief Show the patch skipping settings of the current project, see TissueMaskCache
+     */
+    void updatePatchSkipping();
+protected:
+    /**
+     * Draws the region to run a pipeline on with the mouse in the view, after "Run pipeline for drawn region".
+     */
+    bool eventFilter(QObject* object, QEvent* event) override;
 private:
+    void stopDrawingRegion();
+    /**
+     * Compile the inference engine of a model in the background, so that the first run of it starts immediately.
+     */
+    void precompileModel(const std::string& modelFilename);
+    /**
+     * Create the page of a pipeline, with its description, run buttons and batching settings.
+     */
+    QWidget* createPipelinePage(Pipeline pipeline);
+
+    /**
+     * Page of a pipeline file, created again only when the file has been modified.
+     */
+    class PipelinePage {
+        public:
+            qint64 modified = 0; /* Last modified time of the pipeline file, in ms since epoch */
+            QWidget* widget = nullptr;
+            std::string name;
+    };
+
     QVBoxLayout* _main_layout; /* Principal layout holder for the current custom QWidget */
     QStackedLayout* _stacked_layout;
     QWidget* _stacked_widget;
@@ -96,11 +149,30 @@ private:
     bool m_batchProcesessing = false;
     int m_currentWSI = 0;
     std::shared_ptr<Pipeline> m_runningPipeline;
+    std::shared_ptr<BatchScheduler> m_batchScheduler;
+    std::shared_ptr<PipelineRuntime> m_runtime; /* Runtime measurements of m_runningPipeline */
+    std::chrono::steady_clock::time_point m_runStart; /* When m_runningPipeline was started, for tracing */
+    std::shared_ptr<IncrementalPipeline> m_incrementalPipeline; /* Results of the previous run, reused by unchanged stages */
+    std::set<std::string> m_skippedStages; /* Stages of the running pipeline not executed due to reuse */
+    std::map<std::string, PipelinePage> m_pipelinePages; /* Pipeline filename -> page */
+    RegionOfInterest m_regionOfInterest; /* Of the running pipeline, empty for the whole WSI */
+    bool m_drawingRegion = false;
+    QRubberBand* m_regionBand; /* Rectangle being drawn in the view */
+    QPoint m_regionOrigin;
+    std::string m_regionPipelineFilename; /* Pipeline to run when the drawn region is complete */
+    std::string m_regionPipelineName;
+    QLabel* m_runtimeLabel; /* Patches/sec, queue depth and time per stage of the running pipeline */
     QProgressDialog* m_progressDialog;
     std::string _cwd; /* Holder for the main folder containing models? */
     MainWindow* m_mainWindow;
     View* m_view;
     std::shared_ptr<ComputationThread> m_computationThread;
+    QLabel* m_engineCacheLabel;
+    QGroupBox* m_patchSkippingBox;
+    QCheckBox* m_tissueMaskCheckBox;
+    QComboBox* m_coarsePipelineComboBox; /* Pipeline filename as item data, empty for none */
+    QDoubleSpinBox* m_coarseThresholdSpinBox;
+    QThreadPool* m_precompilePool; /* Compiles engines of added models, one at a time */
 };
 
 }
\ No newline at end of file
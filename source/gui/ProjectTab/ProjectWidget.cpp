@@ -4,6 +4,8 @@
 #include <FAST/Data/ImagePyramid.hpp>
 #include <FAST/Reporter.hpp>
 #include "source/gui/MainWindow.hpp"
+#include "source/logic/RemoteSlideCache.h"
+#include <QInputDialog>
 
 namespace fast {
     ProjectWidget::ProjectWidget(MainWindow* mainWindow, QWidget *parent): QWidget(parent){
@@ -35,16 +37,21 @@ namespace fast {
         _selectFileButton->setFixedHeight(50);
         //selectFileButton->setStyleSheet("color: white; background-color: blue");
 
+        m_selectRemoteButton = new QPushButton(this);
+        m_selectRemoteButton->setText("Import remote images");
+        m_selectRemoteButton->setToolTip("Include images on object storage or web servers by their s3:// or https:// URI. They are fetched to a local cache when opened.");
+
         _main_layout = new QVBoxLayout(this);
         _main_layout->addWidget(m_projectLabel);
         _main_layout->addWidget(_selectFileButton);
+        _main_layout->addWidget(m_selectRemoteButton);
         createWSIScrollAreaWidget();
     }
 
     void ProjectWidget::resetInterface()
     {
-        _wsi_scroll_listwidget->clear();
-        _thumbnail_qpushbutton_map.clear();
+        m_filterLineEdit->clear();
+        m_wsiModel->reset(nullptr);
         emit resetDisplay();
         QCoreApplication::processEvents(QEventLoop::AllEvents, 0);
         // TODO m_mainWindow->doEmpty();
@@ -52,164 +59,109 @@ namespace fast {
 
     void ProjectWidget::setupConnections() {
         QObject::connect(_selectFileButton, &QPushButton::clicked, this, &ProjectWidget::selectFile);
+        QObject::connect(m_selectRemoteButton, &QPushButton::clicked, this, &ProjectWidget::selectRemoteFiles);
+        QObject::connect(m_filterLineEdit, &QLineEdit::textChanged, m_wsiFilterModel, &QSortFilterProxyModel::setFilterFixedString);
+        QObject::connect(m_wsiListView, &QListView::clicked, this, &ProjectWidget::itemClicked);
+        QObject::connect(m_wsiListView, &QListView::customContextMenuRequested, this, &ProjectWidget::itemRightClicked);
     }
 
     void ProjectWidget::createWSIScrollAreaWidget() {
-        //auto scrollAreaDialog = new QDialog();
-        //scrollAreaDialog->setGeometry(100, 100, 260, 260);
-
-        // TODO: Need to substitute this with QListWidget or similar as it's quite slow and memory expensive for
-        //        larger number of elements
-        _wsi_scroll_area = new QScrollArea(this);  //scrollAreaDialog);
-        _wsi_scroll_area->setAlignment(Qt::AlignTop);
-        //scrollArea->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOn);
-        _wsi_scroll_area->setWidgetResizable(true);
-        _wsi_scroll_area->setGeometry(10, 10, 200, 200);
-
-        _wsi_scroll_listwidget = new QListWidget(this);
-        //scrollList->setStyleSheet("border: none, padding: 0, background: white, color: none");
-        _wsi_scroll_listwidget->setSelectionMode(QAbstractItemView::ExtendedSelection);
-        _wsi_scroll_listwidget->setItemAlignment(Qt::AlignTop);
-        _wsi_scroll_listwidget->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOn);
-        _wsi_scroll_listwidget->setResizeMode(QListView::Adjust);  // resizable adaptively
-        _wsi_scroll_listwidget->setGeometry(10, 10, 200, 200);
-        //scrollList->setStyleSheet("*:hover {background:blue;}");  // setting color of widget when hovering
-        //scrollList->setStyleSheet("QListWidget:item:selected:active {background: blue;}; QListWidget:item:selected:!active {background: gray};");
-        //scrollList->setFocus();
-        //scrollList->setViewMode(QListWidget::IconMode);
-        //scrollList->setIconSize(QSize(100, 100));
-        //scrollList->setFlow(QListView::TopToBottom);
-        //scrollList->setResizeMode(QListWidget::Adjust);
-        //QObject::connect(scrollList, &QPushButton::clicked, std::bind(&MainWindow::selectFileInProject, this, 1));
-        //QObject::connect(scrollList, &QListWidget::itemPressed, std::bind(&MainWindow::selectFileInProject, this, 1));  // this, SLOT(onListMailItemClicked(QListWidgetItem*)));
-        //QObject::connect(scrollList,itemClicked(QListWidgetItem*), std::bind(&MainWindow::selectFileInProject, this, 1));
-        //connect(ui->listMail, SIGNAL(itemClicked(QListWidgetItem*)), this, SLOT(onListMailItemClicked(QListWidgetItem*)));
-        // QListWidget::itemPressed(QListWidgetItem *item)
-        //QObject::connect(scrollList, SIGNAL(itemClicked(QListWidgetItem*)), this, SLOT(&MainWindow::selectFileInProject));
-
-        //scrollList->setSelectionMode(QListWidgetItem::NoSelection);
-        //QObject::connect(scrollList, SIGNAL(itemDoubleClicked(QListWidgetItem*)), this, SLOT(itemDoubleClicked(QListWidgetItem*)));
-
-        _wsi_scroll_area->setWidget(_wsi_scroll_listwidget);
-
-        _wsi_scroll_widget = new QWidget(this);
-        //scrollArea->setWidget(scrollWidget);
-
-        _wsi_scroll_layout = new QVBoxLayout;
-        _wsi_scroll_widget->setLayout(_wsi_scroll_layout);
-
-        //connect(scrollList, SIGNAL(activated(int)), scrollLayout, SLOT(setCurrentIndex(int)));
-
-        //fileLayout->insertWidget(2, scrollArea);  //widget);
-        _main_layout->addWidget(_wsi_scroll_area);
-
-        //scrollAreaDialog->show();
+        m_filterLineEdit = new QLineEdit(this);
+        m_filterLineEdit->setPlaceholderText("Search images..");
+        m_filterLineEdit->setClearButtonEnabled(true);
+
+        m_wsiModel = new ThumbnailListModel(this);
+        m_wsiFilterModel = new QSortFilterProxyModel(this);
+        m_wsiFilterModel->setSourceModel(m_wsiModel);
+        m_wsiFilterModel->setFilterRole(Qt::UserRole);
+        m_wsiFilterModel->setFilterCaseSensitivity(Qt::CaseInsensitive);
+
+        m_wsiListView = new QListView(this);
+        m_wsiListView->setModel(m_wsiFilterModel);
+        m_wsiListView->setSelectionMode(QAbstractItemView::SingleSelection);
+        m_wsiListView->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOn);
+        m_wsiListView->setResizeMode(QListView::Adjust);  // resizable adaptively
+        m_wsiListView->setIconSize(ThumbnailListModel::getThumbnailSize());
+        m_wsiListView->setUniformItemSizes(true); // Item sizes are not computed for every WSI
+        m_wsiListView->setLayoutMode(QListView::Batched);
+        m_wsiListView->setContextMenuPolicy(Qt::CustomContextMenu);
+
+        _main_layout->addWidget(m_filterLineEdit);
+        _main_layout->addWidget(m_wsiListView);
     }
 
     void ProjectWidget::selectFile() {
         auto fileNames = QFileDialog::getOpenFileNames(this, tr("Select File(s)"), nullptr,nullptr,nullptr, QFileDialog::DontUseNativeDialog);
+        loadSelectedWSIs(fileNames);
+    }
 
-        auto progDialog = QProgressDialog(this);
-        progDialog.setRange(0, fileNames.count()-1);
-        //progDialog.setContentsMargins(0, 0, 0, 0);
-        progDialog.setVisible(true);
-        progDialog.setModal(false);
-        progDialog.setLabelText("Loading WSIs...");
-        //QRect screenrect = mWidget->screen()[0].geometry();
-        progDialog.move(width() - progDialog.width() * 1.1, progDialog.height() * 0.1);
-        progDialog.show();
-
-        QCoreApplication::processEvents(QEventLoop::AllEvents, 0);
+    void ProjectWidget::selectRemoteFiles() {
+        bool ok = false;
+        const QString text = QInputDialog::getMultiLineText(this, tr("Import remote images"),
+                tr("s3:// or https:// URIs of the images, one per line:"), "", &ok);
+        if(!ok)
+            return;
+        QList<QString> fileNames;
+        for(auto line : text.split('\n')) {
+            line = line.trimmed();
+            if(line.isEmpty())
+                continue;
+            if(!RemoteSlideCache::isRemote(line.toStdString())) {
+                QMessageBox::warning(this, tr("Import remote images"), tr("Not an s3:// or http(s):// URI: ") + line);
+                return;
+            }
+            fileNames.append(line);
+        }
         loadSelectedWSIs(fileNames);
     }
 
     void ProjectWidget::loadSelectedWSIs(const QList<QString> &fileNames)
     {
-        auto currentPosition = 0; // curr_pos <=?
-
-        // need to handle scenario where a WSI is added, but there already exists N WSIs from before
-        auto nb_wsis_in_list = 0; //wsiList.size();
-        if (nb_wsis_in_list != 0)
-            currentPosition = nb_wsis_in_list;
-
-        int counter = 0;
+        auto project = m_mainWindow->getCurrentProject();
+        if(m_wsiModel->getProject() != project) // New project
+            m_wsiModel->reset(project);
+        std::vector<std::string> uids;
         for (QString fileName : fileNames)
         {
             if (fileName == "")
-                return;
-            //filename = fileName.toStdString();
-            //qDebug() << "QString filename: " << fileName;
+                break;
 #ifdef WIN32
             std::string currFileName = fileName.toLatin1(); // Convert path to ascii so that files with æøå characters work.
 #else
             std::string currFileName = fileName.toStdString();
 #endif
             Reporter::info() << "Selected file: " << currFileName << Reporter::end();
-            const std::string id_name = m_mainWindow->getCurrentProject()->includeImage(currFileName);
-
-            // @TODO. Shouldn't we keep a class attribute list with those buttons, so that it's easier to retrieve them
-            // and delete them on the fly?
-            auto button = new ProjectThumbnailPushButton(m_mainWindow, id_name, this);
-            _thumbnail_qpushbutton_map[id_name] = button;
-            int width_val = 100;
-            int height_val = 150;
-            auto listItem = new QListWidgetItem;
-            listItem->setSizeHint(QSize(width_val, height_val));
-            QObject::connect(button, &ProjectThumbnailPushButton::clicked, this, &ProjectWidget::changeWSIDisplayReceived);
-            QObject::connect(button, &ProjectThumbnailPushButton::rightClicked, this, &ProjectWidget::removeImage);
-            _wsi_scroll_listwidget->addItem(listItem);
-            _wsi_scroll_listwidget->setItemWidget(listItem, button);
-            _wsi_thumbnails_listitem[id_name] = listItem;
-
-//            emit newImageFilename(id_name);
-            // to render straight away (avoid waiting on all WSIs to be handled before rendering)
-            QCoreApplication::processEvents(QEventLoop::AllEvents, 0);
+            // Returns at once, the WSI is opened and its thumbnail created by the worker pool when shown
+            uids.push_back(project->includeImage(currFileName));
         }
+        m_wsiModel->addImages(uids);
     }
 
     void ProjectWidget::loadProject()
     {
-        auto currentPosition = 0; // curr_pos <=?
-
-        // need to handle scenario where a WSI is added, but there already exists N WSIs from before
-        auto nb_wsis_in_list = 0; //wsiList.size();
-        if (nb_wsis_in_list != 0)
-            currentPosition = nb_wsis_in_list;
-
-        int counter = 0;
-        for (auto uid : m_mainWindow->getCurrentProject()->getAllWsiUids())
-        {
-            auto fileName = m_mainWindow->getCurrentProject()->getImage(uid)->get_filename();
-            auto currFileName = fileName;
-            Reporter::info() << "Selected file: " << currFileName << Reporter::end();
-            //const std::string id_name = m_mainWindow->getCurrentProject()->includeImage(currFileName);
+        auto project = m_mainWindow->getCurrentProject();
+        m_wsiModel->reset(project);
+        m_wsiModel->addImages(project->getAllWsiUids());
+    }
 
-            // @TODO. Shouldn't we keep a class attribute list with those buttons, so that it's easier to retrieve them
-            // and delete them on the fly?
-            auto button = new ProjectThumbnailPushButton(m_mainWindow, uid, this);
-            _thumbnail_qpushbutton_map[uid] = button;
-            int width_val = 100;
-            int height_val = 150;
-            auto listItem = new QListWidgetItem;
-            listItem->setSizeHint(QSize(width_val, height_val));
-            QObject::connect(button, &ProjectThumbnailPushButton::clicked, this, &ProjectWidget::changeWSIDisplayReceived);
-            QObject::connect(button, &ProjectThumbnailPushButton::rightClicked, this, &ProjectWidget::removeImage);
-            _wsi_scroll_listwidget->addItem(listItem);
-            _wsi_scroll_listwidget->setItemWidget(listItem, button);
-            _wsi_thumbnails_listitem[uid] = listItem;
+    void ProjectWidget::itemClicked(const QModelIndex& index)
+    {
+        const std::string uid = m_wsiModel->getUid(m_wsiFilterModel->mapToSource(index));
+        if(!uid.empty())
+            emit changeWSIDisplayTriggered(uid, true);
+    }
 
-            //            emit newImageFilename(id_name);
-            // to render straight away (avoid waiting on all WSIs to be handled before rendering)
-            QCoreApplication::processEvents(QEventLoop::AllEvents, 0);
-        }
+    void ProjectWidget::itemRightClicked(const QPoint& pos)
+    {
+        QModelIndex index = m_wsiListView->indexAt(pos);
+        if(!index.isValid() || index != m_wsiListView->currentIndex())
+            return;
+        removeImage(m_wsiModel->getUid(m_wsiFilterModel->mapToSource(index)));
     }
 
     void ProjectWidget::removeImage(std::string uid)
     {
-        _wsi_scroll_listwidget->removeItemWidget(_wsi_thumbnails_listitem[uid]);
-        _wsi_thumbnails_listitem.erase(uid);
-        _thumbnail_qpushbutton_map.erase(uid);
-        _wsi_scroll_listwidget->update();
+        m_wsiModel->removeImage(uid);
         emit changeWSIDisplayTriggered(uid, false);
         m_mainWindow->getCurrentProject()->removeImage(uid);
         QCoreApplication::processEvents(QEventLoop::AllEvents, 0);
@@ -218,13 +170,7 @@ namespace fast {
     void ProjectWidget::changeWSIDisplayReceived(std::string id_name, bool state)
     {
         if(state)
-        {
-            for(auto it = _thumbnail_qpushbutton_map.begin(); it != _thumbnail_qpushbutton_map.end(); it++)
-            {
-                if(it->first != id_name)
-                    it->second->setCheckedState(false);
-            }
-        }
+            m_wsiListView->setCurrentIndex(m_wsiFilterModel->mapFromSource(m_wsiModel->getIndex(id_name)));
         emit changeWSIDisplayTriggered(id_name, state);
     }
 
@@ -269,16 +215,6 @@ namespace fast {
 
 //        resetInterface();
 
-        auto progDialog = QProgressDialog(this);
-        progDialog.setRange(0, fileNames.count()-1);
-        progDialog.setVisible(true);
-        progDialog.setModal(false);
-        progDialog.setLabelText("Loading WSIs...");
-        QRect screenrect = screen()[0].geometry();
-        progDialog.move(width() - progDialog.width() / 2, - width() / 2 - progDialog.width() / 2);
-        progDialog.show();
-
-        QCoreApplication::processEvents(QEventLoop::AllEvents, 0);
         loadSelectedWSIs(fileNames);
     }
 
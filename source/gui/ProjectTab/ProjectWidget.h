@@ -10,17 +10,19 @@
 #include <QTextStream>
 #include <QMessageBox>
 #include <QProgressDialog>
-#include <QListWidgetItem>
-#include <QScrollArea>
+#include <QListView>
+#include <QLineEdit>
+#include <QSortFilterProxyModel>
 #include <QScreen>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QNetworkRequest>
 #include <QDirIterator>
+#include <QThreadPool>
 #include <iostream>
 #include <FAST/Visualization/Renderer.hpp>
 #include "source/utils/utilities.h"
-#include "source/gui/ProjectTab/ProjectThumbnailPushButton.h"
+#include "source/gui/ProjectTab/ThumbnailListModel.h"
 
 
 namespace fast {
@@ -29,6 +31,7 @@ namespace fast {
     class ImagePyramidRenderer;
     class Renderer;
     class MainWindow;
+    class WholeSlideImage;
 
 class ProjectWidget: public QWidget {
 Q_OBJECT
@@ -49,6 +52,10 @@ public:
 
 public slots:
     void selectFile();
+    /**
+     * Asks for s3:// or http(s):// URIs of WSIs to include, one per line.
+     */
+    void selectRemoteFiles();
     /**
      * @brief changeWSIDisplayReceived To toggle/untoggle the main view with the WSI represented by id_name
      * @param id_name Unique name for the WSI to consider
@@ -74,7 +81,8 @@ protected:
     void setupInterface();
 
     /**
-     * Creates the WSI scroll area for selecting which WSI to work with.
+     * Creates the WSI list for selecting which WSI to work with. Only the visible items are drawn, and their
+     * thumbnails loaded, thus it is cheap also for projects with thousands of WSIs.
      */
     void createWSIScrollAreaWidget();
 
@@ -85,15 +93,26 @@ protected:
 
     void loadSelectedWSIs(const QList<QString> &fileNames);
 
+    /**
+     * Display the clicked WSI.
+     * @param index Index of the clicked item, in the filtered model.
+     */
+    void itemClicked(const QModelIndex& index);
+
+    /**
+     * Remove the WSI under the cursor from the project, if it is the displayed one.
+     * @param pos Position of the right click, in the view.
+     */
+    void itemRightClicked(const QPoint& pos);
+
 private:
     QPushButton* _selectFileButton;
+    QPushButton* m_selectRemoteButton;
     QVBoxLayout* _main_layout;
-    QScrollArea* _wsi_scroll_area;
-    QListWidget* _wsi_scroll_listwidget;
-    QWidget* _wsi_scroll_widget;
-    QVBoxLayout* _wsi_scroll_layout;
-    std::map<std::string, QListWidgetItem*> _wsi_thumbnails_listitem;
-    std::map<std::string, ProjectThumbnailPushButton*> _thumbnail_qpushbutton_map;
+    QLineEdit* m_filterLineEdit;
+    QListView* m_wsiListView;
+    ThumbnailListModel* m_wsiModel;
+    QSortFilterProxyModel* m_wsiFilterModel; /* Filters the WSI list by uid */
     MainWindow* m_mainWindow;
     QLabel* m_projectLabel;
 };
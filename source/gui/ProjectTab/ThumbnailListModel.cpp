@@ -0,0 +1,198 @@
+#include "ThumbnailListModel.h"
+#include <FAST/Reporter.hpp>
+#include "source/logic/Project.h"
+#include "source/utils/utilities.h"
+#include "source/logic/Tracing.h"
+#include "source/logic/RemoteSlideCache.h"
+#include <QFileInfo>
+#include <QPointer>
+#include <QThread>
+#include <functional>
+#include <algorithm>
+
+namespace fast {
+    /**
+     * Ingest job run on the thumbnail worker pool: reads the thumbnail from the project thumbnail cache, or opens the
+     * WSI, creates its thumbnail and stores it in the cache. The result is scaled down to the size shown in the list.
+     */
+    class ThumbnailTask : public QRunnable {
+        public:
+            ThumbnailTask(std::shared_ptr<WholeSlideImage> image, std::string cachePath, std::function<void(QImage, bool)> callback) :
+                m_image(image), m_cachePath(cachePath), m_callback(callback) {}
+            void run() override {
+                TraceScope trace("import", "thumbnail", m_image->get_filename());
+                QImage thumbnail;
+                bool created = false;
+                try {
+                    const QString cachePath = QString::fromStdString(m_cachePath);
+                    if(QFileInfo::exists(cachePath))
+                        thumbnail = QImage(cachePath);
+                    if(thumbnail.isNull()) {
+                        // Empty for remote slides which have not been fetched, the placeholder is shown
+                        thumbnail = m_image->get_thumbnail();
+                        if(!thumbnail.isNull()) {
+                            thumbnail.save(cachePath);
+                            m_image->clear_thumbnail(); // Stored in the cache, no need to keep the full size copy
+                            created = true;
+                        }
+                    }
+                    if(!thumbnail.isNull())
+                        thumbnail = thumbnail.scaled(ThumbnailListModel::getThumbnailSize(), Qt::KeepAspectRatio, Qt::SmoothTransformation);
+                } catch(std::exception &e) {
+                    Reporter::warning() << "Unable to create thumbnail for " << m_image->get_filename() << ": " << e.what() << Reporter::end();
+                    thumbnail = QImage();
+                }
+                m_callback(thumbnail, created);
+            }
+        private:
+            std::shared_ptr<WholeSlideImage> m_image;
+            std::string m_cachePath;
+            std::function<void(QImage, bool)> m_callback;
+    };
+
+    ThumbnailListModel::ThumbnailListModel(QObject* parent) : QAbstractListModel(parent) {
+        m_thumbnails.setMaxCost(std::max(1, getSetting("thumbnails/cache-mb", 64).toInt())*1024);
+        m_placeholder = QPixmap(getThumbnailSize());
+        m_placeholder.fill(Qt::transparent);
+        m_pool = new QThreadPool(this);
+        m_pool->setMaxThreadCount(getSetting("ingest/workers", QThread::idealThreadCount()).toInt());
+    }
+
+    ThumbnailListModel::~ThumbnailListModel() {
+        // Wait for running jobs while this object is still valid, their results are then dropped
+        m_pool->clear();
+        m_pool->waitForDone();
+    }
+
+    QSize ThumbnailListModel::getThumbnailSize() {
+        return QSize(90, 135);
+    }
+
+    void ThumbnailListModel::reset(std::shared_ptr<Project> project) {
+        beginResetModel();
+        m_pool->clear(); // Drop queued (not yet started) thumbnail jobs
+        ++m_generation;
+        m_project = project;
+        m_uids.clear();
+        m_thumbnails.clear();
+        m_loading.clear();
+        m_failed.clear();
+        m_notFetched.clear();
+        endResetModel();
+    }
+
+    void ThumbnailListModel::addImages(const std::vector<std::string>& uids) {
+        if(uids.empty())
+            return;
+        beginInsertRows(QModelIndex(), m_uids.size(), m_uids.size() + uids.size() - 1);
+        m_uids.insert(m_uids.end(), uids.begin(), uids.end());
+        endInsertRows();
+    }
+
+    void ThumbnailListModel::removeImage(const std::string& uid) {
+        auto it = std::find(m_uids.begin(), m_uids.end(), uid);
+        if(it == m_uids.end())
+            return;
+        const int row = it - m_uids.begin();
+        beginRemoveRows(QModelIndex(), row, row);
+        m_uids.erase(it);
+        m_thumbnails.remove(QString::fromStdString(uid));
+        m_failed.erase(uid);
+        m_notFetched.erase(uid);
+        endRemoveRows();
+    }
+
+    std::string ThumbnailListModel::getUid(const QModelIndex& index) const {
+        if(!index.isValid() || index.row() >= m_uids.size())
+            return "";
+        return m_uids[index.row()];
+    }
+
+    QModelIndex ThumbnailListModel::getIndex(const std::string& uid) const {
+        auto it = std::find(m_uids.begin(), m_uids.end(), uid);
+        if(it == m_uids.end())
+            return QModelIndex();
+        return index(it - m_uids.begin());
+    }
+
+    int ThumbnailListModel::rowCount(const QModelIndex& parent) const {
+        if(parent.isValid())
+            return 0;
+        return m_uids.size();
+    }
+
+    QVariant ThumbnailListModel::data(const QModelIndex& index, int role) const {
+        if(!index.isValid() || index.row() >= m_uids.size())
+            return QVariant();
+        const std::string& uid = m_uids[index.row()];
+        switch(role) {
+            case Qt::UserRole: // Used for filtering
+                return QString::fromStdString(uid);
+            case Qt::DisplayRole:
+                if(m_failed.count(uid) > 0)
+                    return QString::fromStdString(uid + "\nUnable to open");
+                if(m_notFetched.count(uid) > 0)
+                    return QString::fromStdString(uid + "\nRemote, not fetched");
+                if(m_loading.count(uid) > 0)
+                    return QString::fromStdString(uid + "\nLoading..");
+                return QString::fromStdString(uid);
+            case Qt::ToolTipRole:
+                if(!m_project->hasImage(uid))
+                    return QString::fromStdString(uid);
+                return QString::fromStdString(uid + "\n" + m_project->getImage(uid)->get_filename());
+            case Qt::DecorationRole: {
+                // Only asked for by the view for visible items
+                QPixmap* thumbnail = m_thumbnails.object(QString::fromStdString(uid));
+                if(thumbnail != nullptr)
+                    return *thumbnail;
+                if(m_failed.count(uid) == 0 && m_notFetched.count(uid) == 0)
+                    requestThumbnail(uid);
+                return m_placeholder;
+            }
+            default:
+                return QVariant();
+        }
+    }
+
+    void ThumbnailListModel::requestThumbnail(const std::string& uid) const {
+        if(m_loading.count(uid) > 0)
+            return;
+        m_loading.insert(uid);
+        auto project = m_project;
+        const int generation = m_generation;
+        QPointer<ThumbnailListModel> model(const_cast<ThumbnailListModel*>(this));
+        auto task = new ThumbnailTask(project->getImage(uid), project->getThumbnailPath(uid), [model, project, uid, generation](QImage thumbnail, bool created) {
+            // Called from worker thread, update the model in the GUI thread
+            QMetaObject::invokeMethod(model, [model, project, uid, generation, thumbnail, created]() {
+                if(created)
+                    project->updateSlideMetadata(uid); // The WSI was imported to create the thumbnail
+                if(model)
+                    model->thumbnailLoaded(uid, thumbnail, generation);
+            }, Qt::QueuedConnection);
+        });
+        m_pool->start(task);
+    }
+
+    void ThumbnailListModel::thumbnailLoaded(const std::string& uid, const QImage& thumbnail, int generation) {
+        if(generation != m_generation)
+            return;
+        m_loading.erase(uid);
+        if(!m_project->hasImage(uid)) // Removed while loading
+            return;
+        if(thumbnail.isNull()) {
+            auto image = m_project->getImage(uid);
+            if(RemoteSlideCache::isRemote(image->get_filename()) && !image->is_loaded()) {
+                m_notFetched.insert(uid);
+            } else {
+                m_failed.insert(uid);
+            }
+        } else {
+            auto pixmap = new QPixmap(QPixmap::fromImage(thumbnail));
+            m_thumbnails.insert(QString::fromStdString(uid), pixmap, std::max(1, pixmap->width()*pixmap->height()*pixmap->depth()/8/1024));
+        }
+        QModelIndex index = getIndex(uid);
+        if(index.isValid())
+            emit dataChanged(index, index);
+    }
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+#include <memory>
+#include <QAbstractListModel>
+#include <QCache>
+#include <QPixmap>
+#include <QThreadPool>
+
+namespace fast {
+    class Project;
+
+/**
+ * List model of the WSIs of a project, shown by the ProjectWidget thumbnail view. Thumbnails are only loaded when a
+ * view asks for them, i.e. when the item is visible. They are read from the project thumbnail cache (or created
+ * from the WSI if missing) by a worker pool, and kept in memory in an LRU cache limited by the
+ * thumbnails/cache-mb setting (default: 64 MB).
+ */
+class ThumbnailListModel : public QAbstractListModel {
+Q_OBJECT
+public:
+    ThumbnailListModel(QObject* parent = nullptr);
+    ~ThumbnailListModel();
+
+    /**
+     * Remove all WSIs, and use the given project for the ones added later.
+     * @param project
+     */
+    void reset(std::shared_ptr<Project> project);
+    std::shared_ptr<Project> getProject() const { return m_project; }
+    /**
+     * Append WSIs of the project to the list. Thumbnails are not loaded until shown.
+     * @param uids Unique names for the WSIs.
+     */
+    void addImages(const std::vector<std::string>& uids);
+    void removeImage(const std::string& uid);
+    std::string getUid(const QModelIndex& index) const;
+    QModelIndex getIndex(const std::string& uid) const;
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+    /**
+     * Size of the thumbnails, in pixels.
+     */
+    static QSize getThumbnailSize();
+
+protected:
+    /**
+     * Queue loading of a thumbnail on the worker pool. The item is updated when done.
+     * @param uid Unique name for the WSI.
+     */
+    void requestThumbnail(const std::string& uid) const;
+    void thumbnailLoaded(const std::string& uid, const QImage& thumbnail, int generation);
+
+private:
+    std::shared_ptr<Project> m_project;
+    std::vector<std::string> m_uids;
+    mutable QCache<QString, QPixmap> m_thumbnails; /* Cost is in kB */
+    mutable std::set<std::string> m_loading;
+    std::set<std::string> m_failed;
+    std::set<std::string> m_notFetched; /* Remote slides, which are not fetched for their thumbnail */
+    QPixmap m_placeholder; /* Shown while loading */
+    QThreadPool* m_pool; /* Ingest workers, size given by the ingest/workers setting (default: nr of cores) */
+    int m_generation = 0; /* Incremented on reset, to drop thumbnails of the previous project */
+};
+
+}
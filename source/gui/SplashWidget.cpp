@@ -14,6 +14,9 @@
 #include <QTextEdit>
 #include <QScreen>
 #include "source/utils/utilities.h"
+#include "source/logic/ProjectIndex.h"
+#include <QDateTime>
+#include <QIcon>
 #include <FAST/DataHub.hpp>
 
 namespace fast{
@@ -62,31 +65,27 @@ ProjectSplashWidget::ProjectSplashWidget(std::string rootFolder, bool allowClose
     leftLayout->addWidget(recentLabel);
 
     auto recentList = new QListWidget();
-    std::map<std::string, std::string> sortedFolders;
-    for(auto folder : getDirectoryList(rootFolder, false, true)) {
-        std::ifstream file(join(rootFolder, folder, "/timestamp.txt"));
-        if(file.is_open()) {
-            std::string timestamp;
-            std::getline(file, timestamp);
-            file.close();
-            sortedFolders[timestamp] = folder;
-        } else {
-            std::cout << "Project " << folder << " was missing timestmap.txt" << std::endl;
-        }
-    }
-    // Create a map reverse iterator
-    decltype(sortedFolders)::reverse_iterator it;
-
-    for (it = sortedFolders.rbegin(); it != sortedFolders.rend(); it++) {
-        auto item = new QListWidgetItem(
-                QString::fromStdString(it->second),
-                recentList);
-        //"Last modified: " + QString::fromStdString(it->first),
+    recentList->setIconSize(QSize(32, 48));
+    // The project index is a single file read, project folders are only scanned if they are not in the index
+    const int maxThumbnails = getSetting("splash/thumbnails", 20).toInt();
+    int counter = 0;
+    for(auto& project : ProjectIndex(rootFolder).getProjects()) {
+        const QString name = QString::fromStdString(project.name);
+        const QString details = QString("%1 images, %2 MB, last modified %3")
+                .arg(project.slides)
+                .arg(project.bytes / (1024.0*1024.0), 0, 'f', 1)
+                .arg(QDateTime::fromMSecsSinceEpoch(project.modified).toString("yyyy-MM-dd hh:mm"));
+        auto item = new QListWidgetItem(name + "\n" + details, recentList);
+        item->setData(Qt::UserRole, name);
+        item->setToolTip(details);
+        if(!project.thumbnail.empty() && counter < maxThumbnails)
+            item->setIcon(QIcon(QString::fromStdString(join(rootFolder, project.name, project.thumbnail))));
+        ++counter;
     }
     leftLayout->addWidget(recentList);
     QObject::connect(recentList, &QListWidget::itemDoubleClicked, [=](QListWidgetItem* item) {
         close();
-        emit openProjectSignal(item->text());
+        emit openProjectSignal(item->data(Qt::UserRole).toString());
     });
 
     auto deleteProjectButton = new QPushButton();
@@ -100,9 +99,15 @@ ProjectSplashWidget::ProjectSplashWidget(std::string rootFolder, bool allowClose
                       QMessageBox::Yes|QMessageBox::No);
         if (reply == QMessageBox::Yes) {
             for(auto item : recentList->selectedItems()) {
-                std::cout << "Deleting " << (QString::fromStdString(rootFolder) + item->text() + "/").toStdString() << std::endl;
-                auto dir = QDir(QString::fromStdString(rootFolder) + item->text() + "/");
+                const QString name = item->data(Qt::UserRole).toString();
+                std::cout << "Deleting " << (QString::fromStdString(rootFolder) + name + "/").toStdString() << std::endl;
+                auto dir = QDir(QString::fromStdString(rootFolder) + name + "/");
                 dir.removeRecursively();
+                try {
+                    ProjectIndex(rootFolder).removeProject(name.toStdString());
+                } catch(Exception &e) {
+                    // Removed from the index the next time the projects are listed
+                }
                 recentList->removeItemWidget(item);
                 delete item;
             }
@@ -229,7 +234,12 @@ void ProjectSplashWidget::aboutProgram() {
 }
 
 void ProjectSplashWidget::downloadTestData() {
-    downloadZipFile("http://fast.eriksmistad.no/download/fastpathology-test-images-v1.0.0.zip", join(m_rootFolder, "..", "images"), "test dataset");
+    // The checksum of the published archive, verified after downloading when set
+    const std::string sha256 = getSetting("downloads/test-images-sha256", "").toString().toStdString();
+    if(!downloadZipFile("http://fast.eriksmistad.no/download/fastpathology-test-images-v1.0.0.zip", join(m_rootFolder, "..", "images"), "test dataset", sha256)) {
+        QMessageBox::warning(this, "Download failed", "The test images could not be downloaded. Press the download button again to resume the download.");
+        return;
+    }
     // Create new project
     emit newProjectSignal("Test project");
     emit loadTestDataIntoProject();
@@ -2,10 +2,52 @@
 #include <FAST/Importers/WholeSlideImageImporter.hpp>
 #include <FAST/Visualization/ImagePyramidRenderer/ImagePyramidRenderer.hpp>
 #include <FAST/Data/ImagePyramid.hpp>
+#include <FAST/Reporter.hpp>
+#include "source/gui/MainWindow.hpp"
+#include <QHeaderView>
 #include <QPainterPath>
+#include <QPointer>
+#include <QRunnable>
+#include <QThreadPool>
+#include <functional>
 
 namespace fast {
-    StatsWidget::StatsWidget(QWidget *parent): QWidget(parent){
+    /**
+     * A result to calculate statistics for, with the WSI it belongs to.
+     */
+    typedef std::pair<Result, std::shared_ptr<WholeSlideImage>> StatsJob;
+
+    /**
+     * Calculates the statistics of one or more results in a thread pool, and sums them.
+     */
+    class StatsTask : public QRunnable {
+        public:
+            StatsTask(std::vector<StatsJob> jobs, std::function<void(ResultStatistics, int, int)> callback) :
+                m_jobs(jobs), m_callback(callback) {}
+            void run() override {
+                std::vector<ResultStatistics> statistics;
+                int failed = 0;
+                for(const auto& job : m_jobs) {
+                    try {
+                        statistics.push_back(ResultStatistics::compute(job.first, job.second));
+                    } catch(std::exception &e) {
+                        Reporter::warning() << "Unable to calculate statistics of " << job.first.filename << ": " << e.what() << Reporter::end();
+                        ++failed;
+                    }
+                }
+                m_callback(ResultStatistics::sum(statistics), statistics.size(), failed);
+            }
+        private:
+            std::vector<StatsJob> m_jobs;
+            std::function<void(ResultStatistics, int, int)> m_callback;
+    };
+
+    StatsWidget::StatsWidget(MainWindow* mainWindow, QWidget *parent): QWidget(parent){
+        m_mainWindow = mainWindow;
+        m_pool = new QThreadPool(this);
+        m_pool->setMaxThreadCount(1); // Each calculation reads tiles with all cores
+        setupInterface();
+        setupConnections();
     }
 
     StatsWidget::~StatsWidget(){
@@ -17,99 +59,224 @@ namespace fast {
         this->_main_layout = new QVBoxLayout(this);
         this->_main_layout->setAlignment(Qt::AlignTop);
 
+        auto label = new QLabel();
+        label->setText("Select result:");
+        this->_main_layout->addWidget(label);
+        m_resultComboBox = new QComboBox(this);
+        this->_main_layout->addWidget(m_resultComboBox);
+
+        m_cohortCheckBox = new QCheckBox("All images in project", this);
+        m_cohortCheckBox->setToolTip("Sum the statistics of all images with a result from the same pipeline");
+        this->_main_layout->addWidget(m_cohortCheckBox);
+
         // make button that prints distribution of pixels of each class -> for histogram
         this->_calc_hist_pushbutton = new QPushButton(this);
-        this->_calc_hist_pushbutton->setText("Calculate tissue histogram");
+        this->_calc_hist_pushbutton->setText("Calculate statistics");
         this->_calc_hist_pushbutton->setFixedHeight(50);
-        this->_main_layout->insertWidget(0, this->_calc_hist_pushbutton);
+        this->_main_layout->addWidget(this->_calc_hist_pushbutton);
+
+        m_statusLabel = new QLabel(this);
+        m_statusLabel->setWordWrap(true);
+        this->_main_layout->addWidget(m_statusLabel);
+
+        m_table = new QTableWidget(this);
+        m_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+        m_table->setSelectionBehavior(QAbstractItemView::SelectRows);
+        m_table->setSelectionMode(QAbstractItemView::SingleSelection);
+        m_table->verticalHeader()->setVisible(false);
+        m_table->horizontalHeader()->setStretchLastSection(true);
+        this->_main_layout->addWidget(m_table);
+
+        m_histogramLabel = new QLabel(this);
+        m_histogramLabel->setAlignment(Qt::AlignHCenter);
+        this->_main_layout->addWidget(m_histogramLabel);
+        resetInterface();
     }
 
     void StatsWidget::resetInterface()
     {
-        return;
+        ++m_generation; // Calculations still running are ignored when done
+        m_results.clear();
+        m_resultComboBox->clear();
+        m_statusLabel->setText("");
+        m_table->clear();
+        m_table->setRowCount(0);
+        m_table->setColumnCount(0);
+        m_histogramLabel->clear();
+        m_statistics = ResultStatistics();
+        _calc_hist_pushbutton->setDisabled(true);
     }
 
     void StatsWidget::setupConnections()
     {
         QObject::connect(this->_calc_hist_pushbutton, &QPushButton::clicked, this, &StatsWidget::calcTissueHist);
+        QObject::connect(m_table, &QTableWidget::itemSelectionChanged, this, &StatsWidget::showHistogram);
+    }
+
+    void StatsWidget::setResults(std::vector<Result> results) {
+        resetInterface();
+        m_results = results;
+        for(const auto& result : m_results)
+            m_resultComboBox->addItem(QString::fromStdString(result.pipelineName) + ": " + QString::fromStdString(result.name));
+        _calc_hist_pushbutton->setDisabled(m_results.empty());
     }
 
     const bool StatsWidget::calcTissueHist() {
-        std::cout << "Calculating histogram..."<<std::endl;
+        const int index = m_resultComboBox->currentIndex();
+        if(index < 0 || index >= m_results.size())
+            return false;
+        auto project = m_mainWindow->getCurrentProject();
+        const Result& selected = m_results[index];
+        std::vector<StatsJob> jobs;
+        if(m_cohortCheckBox->isChecked()) {
+            for(const auto& uid : project->getAllWsiUids()) {
+                for(const auto& result : project->loadResults(uid)) {
+                    if(result.pipelineName == selected.pipelineName && result.name == selected.name)
+                        jobs.push_back({result, project->getImage(uid)});
+                }
+            }
+        } else {
+            if(!project->hasImage(selected.WSI_uid)) {
+                m_statusLabel->setText("The image of this result is no longer in the project");
+                return false;
+            }
+            jobs.push_back({selected, project->getImage(selected.WSI_uid)});
+        }
+        std::cout << "Calculating statistics of " << jobs.size() << " results..." << std::endl;
+        m_statusLabel->setText("Calculating statistics of " + QString::number(jobs.size()) + " image(s)..");
+        _calc_hist_pushbutton->setDisabled(true);
+
+        const int generation = m_generation;
+        QPointer<StatsWidget> widget(this);
+        m_pool->start(new StatsTask(jobs, [widget, generation](ResultStatistics statistics, int images, int failed) {
+            if(!widget)
+                return;
+            QMetaObject::invokeMethod(widget, [widget, generation, statistics, images, failed]() {
+                // Another WSI may have been selected while calculating
+                if(!widget || widget->m_generation != generation)
+                    return;
+                widget->_calc_hist_pushbutton->setDisabled(false);
+                widget->showStatistics(statistics, images, failed);
+            }, Qt::QueuedConnection);
+        }));
+        return true;
+    }
 
-        int barWidth = 9;
+    void StatsWidget::showStatistics(const ResultStatistics& statistics, int images, int failed) {
+        m_statistics = statistics;
+        QString status = QString::fromStdString(statistics.pipelineName + ": " + statistics.resultName) + ", " +
+                QString::number(images) + " image(s).";
+        if(images == 0)
+            status = "";
+        if(failed > 0)
+            status += " Unable to calculate statistics for " + QString::number(failed) + " image(s), see the log.";
+        m_statusLabel->setText(status);
+
+        int64_t totalPixels = 0;
+        for(const auto& classStatistics : statistics.classes)
+            totalPixels += classStatistics.pixels;
+        m_table->clear();
+        m_table->setColumnCount(4);
+        m_table->setHorizontalHeaderLabels({"Class", "Area (mm²)", "Area (%)", statistics.heatmap ? "Cells" : "Regions"});
+        m_table->setRowCount(statistics.classes.size());
+        for(int row = 0; row < statistics.classes.size(); ++row) {
+            const auto& classStatistics = statistics.classes[row];
+            m_table->setItem(row, 0, new QTableWidgetItem(QString::fromStdString(classStatistics.name)));
+            m_table->setItem(row, 1, new QTableWidgetItem(classStatistics.area >= 0 ? QString::number(classStatistics.area, 'f', 3) : "Unknown"));
+            m_table->setItem(row, 2, new QTableWidgetItem(QString::number(totalPixels > 0 ? 100.0*classStatistics.pixels/totalPixels : 0.0, 'f', 2)));
+            m_table->setItem(row, 3, new QTableWidgetItem(QString::number(statistics.heatmap ? classStatistics.pixels : classStatistics.regions)));
+        }
+        m_table->resizeColumnsToContents();
+        if(!statistics.classes.empty())
+            m_table->selectRow(std::min<int>(1, statistics.classes.size() - 1)); // First class after background
+        showHistogram();
+    }
+
+    void StatsWidget::showHistogram() {
+        std::vector<QString> labels;
+        std::vector<double> values;
+        if(m_statistics.heatmap) {
+            const int row = m_table->currentRow();
+            if(row < 0 || row >= m_statistics.classes.size())
+                return;
+            const auto& confidence = m_statistics.classes[row].confidence;
+            for(int bin = 0; bin < confidence.size(); ++bin) {
+                labels.push_back(QString::number((bin + 1)*10));
+                values.push_back(confidence[bin]);
+            }
+        } else {
+            for(const auto& classStatistics : m_statistics.classes) {
+                labels.push_back(QString::number(classStatistics.label));
+                values.push_back(classStatistics.pixels);
+            }
+        }
+        if(values.empty()) {
+            m_histogramLabel->clear();
+            return;
+        }
+        m_histogramLabel->setPixmap(drawHistogram(labels, values));
+    }
+
+    QPixmap StatsWidget::drawHistogram(const std::vector<QString>& labels, const std::vector<double>& values) {
+        const int len = values.size();
+        int barWidth = std::max(3, 150 / (len + 1));
         int boxWidth = 250;
         int boxHeight = 250;
         QPixmap pm(boxWidth, boxHeight);
         pm.fill();
 
-        int len = 5;
-
-        //int x_vec[] = {1, 2, 3, 4, 5};
-        std::string x_vec[] = {"a", "b", "c", "d", "e"};
-        int y_vec[] = {12, 20, 43, 30, 5};
-
         double drawMinHeight = 0.1 * (double)(boxHeight);
         double drawMinWidth = 0.1 * (double)(boxWidth);
 
         double newWidth = (double)(boxWidth - drawMinWidth);
         double newHeight = (double)(boxHeight - drawMinHeight);
 
-        double maxHeight = *std::max_element(y_vec,y_vec+len);
+        double maxHeight = std::max(1.0, *std::max_element(values.begin(), values.end()));
         double drawMaxHeight = (double)(maxHeight + maxHeight*0.1);
 
-        auto painters = new QPainter(&pm);
+        QPainter painter(&pm);
+        auto painters = &painter;
         painters->setPen(QColor(140, 140, 210));
 
         for (int i = 0; i < len; i++) {
-            std::cout << std::to_string(i) << std::endl;
-            qreal h = y_vec[i] * maxHeight;
             // draw level
             painters->fillRect(drawMinWidth / 2 + (double)(i + 1) * (double)(newWidth) / (double)(len + 1) - (double)((double)(barWidth)/(double)(2)),
                                newHeight,
                                barWidth,
-                               - (double)(y_vec[i]) / (double)(drawMaxHeight) * (double)(newHeight),
+                               - values[i] / (double)(drawMaxHeight) * (double)(newHeight),
                                Qt::blue);
-            // clear the rest of the control
-            //painters->fillRect(barWidth * i, 0, barWidth * (i + 1), maxHeight - h, Qt::black);
         }
 
         int lineWidth = 3;
         int space = drawMinHeight;
 
-        //auto linePainter = new QPainter(&pm);
         painters->setPen(QPen(QColor(0, 0, 0), lineWidth));
         painters->drawLine(space, boxHeight - space, boxWidth - space, boxHeight - space);
         painters->drawLine(space - 1, boxHeight - space, space - 1, space);
 
         // add ticks on lines
         painters->setPen(QPen(QColor(0, 0, 0), 2));
-        painters->setFont(QFont("times", 10));
-        std::string stringIter;
+        painters->setFont(QFont("times", 8));
         int xTextSpace = 18;
-        int numTicks = 5;
         double tickSize = 10;
-        for (int j = 0; j < numTicks; j++) {
+        for (int j = 0; j < len; j++) {
             painters->drawLine(drawMinWidth / 2 + (double)(j + 1) * (double)(newWidth) / (double)(len + 1),
                                newHeight,
                                drawMinWidth / 2 + (double)(j + 1) * (double)(newWidth) / (double)(len + 1),
                                newHeight + tickSize / 2);
-            painters->drawText(drawMinWidth / 2 + (double)(j + 1) * (double)(newWidth) / (double)(len + 1) - 4, newHeight + xTextSpace, QString::number(j + 1));
-
+            painters->drawText(drawMinWidth / 2 + (double)(j + 1) * (double)(newWidth) / (double)(len + 1) - 4, newHeight + xTextSpace, labels[j]);
         }
 
-        int yTextSpace = 22;
+        // Fraction of the largest bar, in percent of the total
+        double total = 0;
+        for(auto value : values)
+            total += value;
+        total = std::max(1.0, total);
+        int numTicks = 5;
         for (int j = 0; j < numTicks; j++) {
-            painters->drawLine(space - tickSize / 2,
-                               drawMinHeight - drawMinHeight*0.5 + (double)(j + 1) * (double)(newHeight) / (double)(len + 1),
-                               space,
-                               drawMinHeight - drawMinHeight*0.5 + (double)(j + 1) * (double)(newHeight) / (double)(len + 1));
-
-            painters->drawText(drawMinWidth - yTextSpace, drawMinHeight - drawMinHeight*0.5 + (double)(j + 1) * (double)(newHeight) / (double)(len + 1) + 4,
-                               QString::number((int)(std::round((double)(numTicks - j) * (double)(maxHeight) / (double)(len + 1) + 4))));
-            //painters->drawText(drawMinWidth - yTextSpace, drawMinHeight - drawMinHeight*0.5 + (double)(j + 1) * (double)(newHeight) / (double)(len + 1) + 4,
-            //        QString::number((int)(y_vec[numTicks - j - 1])));
-
+            const double y = newHeight - (double)(j + 1) / (double)(numTicks) * maxHeight / drawMaxHeight * newHeight;
+            painters->drawLine(space - tickSize / 2, y, space, y);
+            painters->drawText(2, y + 4, QString::number((int)std::round(100.0 * (double)(j + 1) / (double)(numTicks) * maxHeight / total)) + "%");
         }
 
         // draw arrow heads on end of axes
@@ -129,30 +296,9 @@ namespace fast {
         t.translate(boxWidth, boxHeight - space - yArrowSize - xArrowSize);
         t.rotate(90);
         QPainterPath path2 = t.map(path);
-
-        // draw title of histogram
-        painters->setPen(QPen(QColor(0, 0, 0), 2));
-        painters->setFont(QFont("times", 10));
-
         painters->fillPath(path2, QBrush(QColor ("black")));
 
-        auto histBox = new QLabel;
-        histBox->setPixmap(pm);
-        histBox->setAlignment(Qt::AlignHCenter);
-
-        this->_main_layout->insertWidget(2, histBox); // finally, add histogram to Widget
-
-        // add some text box that explains in words the result from the analysis or something similar...
-        auto smallTextWindowStats = new QTextEdit;
-        smallTextWindowStats->setPlainText(tr("This is some window with text that displays some relevant "
-                                              "information regarding the inference or analysis you just did."));
-        smallTextWindowStats->setReadOnly(true);
-        smallTextWindowStats->show();
-        smallTextWindowStats->setFixedHeight(smallTextWindowStats->document()->size().toSize().height() + 3);
-
-        this->_main_layout->insertWidget(1, smallTextWindowStats);
-
-        return true;
+        return pm;
     }
 
 
@@ -24,10 +24,15 @@
 #include <QPainter>
 #include <QPen>
 #include <QTextEdit>
+#include <QCheckBox>
+#include <QTableWidget>
 #include <iostream>
 #include <FAST/Visualization/Renderer.hpp>
 #include "source/utils/utilities.h"
 #include "source/utils/qutilities.h"
+#include "source/logic/ResultStatistics.h"
+
+class QThreadPool;
 
 
 namespace fast {
@@ -35,17 +40,23 @@ namespace fast {
     class ImagePyramid;
     class ImagePyramidRenderer;
     class Renderer;
+    class MainWindow;
 
 class StatsWidget: public QWidget {
 Q_OBJECT
 public:
-    StatsWidget(QWidget* parent=0);
+    StatsWidget(MainWindow* mainWindow, QWidget* parent=0);
     ~StatsWidget();
     /**
      * Set the interface in its default state.
      */
     void resetInterface();
 
+    /**
+     * List the results of the current WSI which statistics can be calculated for.
+     */
+    void setResults(std::vector<Result> results);
+
 protected:
     /**
      * Define the interface for the current global widget.
@@ -57,11 +68,33 @@ protected:
      */
     void setupConnections();
 
-     const bool calcTissueHist();
+    /**
+     * Calculate the statistics of the selected result in the background, for the current WSI or for all WSIs in
+     * the project with a result from the same pipeline.
+     */
+    const bool calcTissueHist();
+
+    void showStatistics(const ResultStatistics& statistics, int images, int failed);
+    /**
+     * Draw the histogram of the selected class: confidence distribution for heatmaps, and area of all classes
+     * for segmentations.
+     */
+    void showHistogram();
+    QPixmap drawHistogram(const std::vector<QString>& labels, const std::vector<double>& values);
 
 private:
+    MainWindow* m_mainWindow;
     QVBoxLayout* _main_layout; /* Principal layout holder for the current custom QWidget */
     QPushButton* _calc_hist_pushbutton; /* */
+    QComboBox* m_resultComboBox;
+    QCheckBox* m_cohortCheckBox;
+    QLabel* m_statusLabel;
+    QTableWidget* m_table;
+    QLabel* m_histogramLabel;
+    std::vector<Result> m_results;
+    ResultStatistics m_statistics; /* Currently shown */
+    int m_generation = 0; /* Incremented when the results are reset, to drop statistics still being calculated */
+    QThreadPool* m_pool;
 };
 
 }
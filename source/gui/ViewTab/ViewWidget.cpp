@@ -8,16 +8,25 @@
 #include "source/gui/MainWindow.hpp"
 #include <QApplication>
 #include <QDesktopWidget>
+#include <QPointer>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QTimer>
 
 namespace fast {
     ViewWidget::ViewWidget(MainWindow* mainWindow, QWidget *parent): QWidget(parent){
         m_mainWindow = mainWindow;
+        m_importPool = new QThreadPool(this);
+        m_attributeTimer = new QTimer(this);
+        m_attributeTimer->setSingleShot(true);
+        m_attributeTimer->setInterval(getSetting("view/attribute-save-delay-ms", 1000).toInt());
+        QObject::connect(m_attributeTimer, &QTimer::timeout, this, &ViewWidget::flushRendererAttributes);
         setupInterface();
         setupConnections();
     }
 
     ViewWidget::~ViewWidget(){
-
+        flushRendererAttributes();
     }
 
     void ViewWidget::setupInterface()
@@ -45,6 +54,7 @@ namespace fast {
 
     void ViewWidget::resetInterface()
     {
+        flushRendererAttributes();
         _page_combobox->clear();
         // Clear stacked layout
         auto layout = _stacked_layout;
@@ -55,6 +65,10 @@ namespace fast {
             delete item;
         }
         // end clear
+        m_results.clear();
+        m_resultLayouts.clear();
+        m_importing.clear();
+        ++m_generation; // Imports still running are ignored when done
         setVisible(false);
         hide();
     }
@@ -68,206 +82,288 @@ namespace fast {
         if(result.renderer->getNameOfClass() == "ImagePyramidRenderer")
             return;
         auto project = m_mainWindow->getCurrentProject();
-        const std::string saveFolder = join(project->getRootFolder(), "results", result.WSI_uid, result.pipelineName, result.name);
-        std::ofstream file(join(saveFolder, "renderer.attributes.txt"), std::iostream::out);
-        file << result.renderer->attributesToString();
-        file.close();
-        project->writeTimestmap();
+        if(project != m_attributeProject || result.WSI_uid != m_attributeUid)
+            flushRendererAttributes();
+        m_attributeProject = project;
+        m_attributeUid = result.WSI_uid;
+        m_pendingAttributes[result.pipelineName + "/" + result.name] = result.renderer->attributesToString();
+        m_attributeTimer->start(); // Restarted by every change
     }
 
+    void ViewWidget::flushRendererAttributes() {
+        m_attributeTimer->stop();
+        if(m_pendingAttributes.empty())
+            return;
+        try {
+            m_attributeProject->setRendererAttributes(m_attributeUid, m_pendingAttributes);
+        } catch(Exception &e) {
+            Reporter::warning() << "Unable to save renderer attributes: " << e.what() << Reporter::end();
+        }
+        m_pendingAttributes.clear();
+        m_attributeProject.reset();
+    }
+
+    /**
+     * Imports the data of a result in a thread pool
+     */
+    class ResultImportTask : public QRunnable {
+        public:
+            ResultImportTask(Result result, std::function<void(std::shared_ptr<DataObject>)> callback) :
+                m_result(result), m_callback(callback) {}
+            void run() override {
+                std::shared_ptr<DataObject> data;
+                try {
+                    data = Project::importResult(m_result);
+                } catch(std::exception &e) {
+                    Reporter::warning() << "Unable to import result " << m_result.filename << ": " << e.what() << Reporter::end();
+                }
+                m_callback(data);
+            }
+        private:
+            Result m_result;
+            std::function<void(std::shared_ptr<DataObject>)> m_callback;
+    };
+
     void ViewWidget::setResults(std::vector<Result> results) {
         resetInterface();
-        // Create layout for all results
-        for(auto result : results) {
-            auto renderer = result.renderer;
+        m_results = results;
+        // Create layout for all results. The renderer controls are added when a result is first shown.
+        for(int index = 0; index < m_results.size(); ++index) {
+            const Result& result = m_results[index];
             auto page = new QWidget();
             auto layout = new QVBoxLayout();
             layout->setAlignment(Qt::AlignTop);
             page->setLayout(layout);
             _stacked_layout->addWidget(page);
             _page_combobox->addItem(QString::fromStdString(result.pipelineName) + ": " + QString::fromStdString(result.name));
+            m_resultLayouts.push_back(layout);
 
             // Toggle renderer on and off
             auto toggleButton = new QPushButton();
             toggleButton->setText("Toggle");
             layout->addWidget(toggleButton);
-            QObject::connect(toggleButton, &QPushButton::clicked, [renderer, result, this]() {
-                renderer->setDisabled(!renderer->isDisabled());
-                writeRendererAttributes(result);
+            QObject::connect(toggleButton, &QPushButton::clicked, [index, this]() {
+                toggleResult(index);
             });
 
-            auto rendererType = result.renderer->getNameOfClass();
-            if(rendererType == "SegmentationRenderer") { // TODO Move to separate methods
-                auto segRenderer = std::dynamic_pointer_cast<SegmentationRenderer>(renderer);
-
-                // Opacity
-                {
-                    auto label = new QLabel();
-                    label->setText("Opacity:");
-                    layout->addWidget(label);
-                    auto slider = new QSlider(Qt::Horizontal);
-                    slider->setRange(0, 100);
-                    slider->setValue(segRenderer->getOpacity()*100.0f);
-                    QObject::connect(slider, &QSlider::valueChanged, [segRenderer, result, this](int i) {
-                        segRenderer->setOpacity((float)i/100.0f, segRenderer->getBorderOpacity());
-                    });
-                    QObject::connect(slider, &QSlider::sliderReleased, [=]() {
-                        writeRendererAttributes(result);
-                    });
-                    layout->addWidget(slider);
-                }
+            // Results which were shown last time are imported straight away
+            if(Project::isResultEnabled(result))
+                showResult(index, false);
+        }
+        _page_combobox->adjustSize();
+    }
 
-                // Border opacity
-                {
-                    auto label = new QLabel();
-                    label->setText("Border opacity:");
-                    layout->addWidget(label);
-                    auto slider = new QSlider(Qt::Horizontal);
-                    slider->setRange(0, 100);
-                    slider->setValue(segRenderer->getBorderOpacity()*100.0f);
-                    QObject::connect(slider, &QSlider::valueChanged, [segRenderer, result, this](int i) {
-                        segRenderer->setBorderOpacity((float)i/100.0f);
-                    });
-                    QObject::connect(slider, &QSlider::sliderReleased, [=]() {
-                        writeRendererAttributes(result);
-                    });
-                    layout->addWidget(slider);
-                }
-                // Border radius
-                {
-                    auto label = new QLabel();
-                    label->setText("Border radius:");
-                    layout->addWidget(label);
-                    auto slider = new QSlider(Qt::Horizontal);
-                    slider->setRange(1, 32);
-                    slider->setValue(segRenderer->getBorderRadius());
-                    QObject::connect(slider, &QSlider::valueChanged, [segRenderer, result, this](int i) {
-                        segRenderer->setBorderRadius(i);
-                    });
-                    QObject::connect(slider, &QSlider::sliderReleased, [=]() {
-                        writeRendererAttributes(result);
-                    });
-                    layout->addWidget(slider);
-                }
+    void ViewWidget::toggleResult(int index) {
+        auto renderer = m_results[index].renderer;
+        if(!renderer) {
+            showResult(index, true);
+            return;
+        }
+        renderer->setDisabled(!renderer->isDisabled());
+        writeRendererAttributes(m_results[index]);
+    }
+
+    void ViewWidget::showResult(int index, bool toggled) {
+        if(m_importing.count(index) > 0)
+            return;
+        m_importing.insert(index);
+        const int generation = m_generation;
+        QPointer<ViewWidget> widget(this);
+        m_importPool->start(new ResultImportTask(m_results[index], [widget, index, generation, toggled](std::shared_ptr<DataObject> data) {
+            if(!widget)
+                return;
+            QMetaObject::invokeMethod(widget, [widget, index, generation, toggled, data]() {
+                // Another WSI may have been selected while importing
+                if(!widget || widget->m_generation != generation)
+                    return;
+                widget->m_importing.erase(index);
+                if(!data)
+                    return;
+                Result& result = widget->m_results[index];
+                result.renderer = Project::createResultRenderer(result, data);
+                result.renderer->setDisabled(false);
+                widget->m_mainWindow->getView(0)->addRenderer(result.renderer);
+                if(auto pyramid = std::dynamic_pointer_cast<ImagePyramid>(data))
+                    widget->m_mainWindow->getTilePrefetcher()->addImage(pyramid); // Segmentations
+                widget->addRendererControls(widget->m_resultLayouts[index], result);
+                if(toggled)
+                    widget->writeRendererAttributes(result);
+            }, Qt::QueuedConnection);
+        }));
+    }
 
+    void ViewWidget::addRendererControls(QVBoxLayout* layout, Result result) {
+        auto renderer = result.renderer;
+        auto rendererType = result.renderer->getNameOfClass();
+        if(rendererType == "SegmentationRenderer") { // TODO Move to separate methods
+            auto segRenderer = std::dynamic_pointer_cast<SegmentationRenderer>(renderer);
+
+            // Opacity
+            {
                 auto label = new QLabel();
-                label->setText("Classes:");
+                label->setText("Opacity:");
                 layout->addWidget(label);
+                auto slider = new QSlider(Qt::Horizontal);
+                slider->setRange(0, 100);
+                slider->setValue(segRenderer->getOpacity()*100.0f);
+                QObject::connect(slider, &QSlider::valueChanged, [segRenderer, result, this](int i) {
+                    segRenderer->setOpacity((float)i/100.0f, segRenderer->getBorderOpacity());
+                });
+                QObject::connect(slider, &QSlider::sliderReleased, [=]() {
+                    writeRendererAttributes(result);
+                });
+                layout->addWidget(slider);
+            }
 
-                for(int i = 1; i < result.classNames.size(); ++i) { // Assuming first class is background here
-                    auto className = result.classNames[i];
-                    auto button = new QPushButton();
-                    button->setStyleSheet("text-align: left; padding: 10%;");
-                    button->setText(QString::fromStdString(className));
+            // Border opacity
+            {
+                auto label = new QLabel();
+                label->setText("Border opacity:");
+                layout->addWidget(label);
+                auto slider = new QSlider(Qt::Horizontal);
+                slider->setRange(0, 100);
+                slider->setValue(segRenderer->getBorderOpacity()*100.0f);
+                QObject::connect(slider, &QSlider::valueChanged, [segRenderer, result, this](int i) {
+                    segRenderer->setBorderOpacity((float)i/100.0f);
+                });
+                QObject::connect(slider, &QSlider::sliderReleased, [=]() {
+                    writeRendererAttributes(result);
+                });
+                layout->addWidget(slider);
+            }
+            // Border radius
+            {
+                auto label = new QLabel();
+                label->setText("Border radius:");
+                layout->addWidget(label);
+                auto slider = new QSlider(Qt::Horizontal);
+                slider->setRange(1, 32);
+                slider->setValue(segRenderer->getBorderRadius());
+                QObject::connect(slider, &QSlider::valueChanged, [segRenderer, result, this](int i) {
+                    segRenderer->setBorderRadius(i);
+                });
+                QObject::connect(slider, &QSlider::sliderReleased, [=]() {
+                    writeRendererAttributes(result);
+                });
+                layout->addWidget(slider);
+            }
+
+            auto label = new QLabel();
+            label->setText("Classes:");
+            layout->addWidget(label);
+
+            for(int i = 1; i < result.classNames.size(); ++i) { // Assuming first class is background here
+                auto className = result.classNames[i];
+                auto button = new QPushButton();
+                button->setStyleSheet("text-align: left; padding: 10%;");
+                button->setText(QString::fromStdString(className));
+                QPixmap pixmap(64,64);
+                Color color = segRenderer->getColor(i);
+                pixmap.fill(QColor(color.getRedValue()*255, color.getGreenValue()*255, color.getBlueValue()*255));
+                button->setIcon(QIcon(pixmap));
+                layout->addWidget(button);
+
+                auto colorDialog = new QColorDialog();
+                colorDialog->setOption(QColorDialog::DontUseNativeDialog, true);
+
+                QObject::connect(button, &QPushButton::clicked, colorDialog, &QColorDialog::show);
+                QObject::connect(colorDialog, &QColorDialog::colorSelected, [i, button, segRenderer, result, this](QColor color) {
                     QPixmap pixmap(64,64);
-                    Color color = segRenderer->getColor(i);
-                    pixmap.fill(QColor(color.getRedValue()*255, color.getGreenValue()*255, color.getBlueValue()*255));
+                    pixmap.fill(color);
                     button->setIcon(QIcon(pixmap));
-                    layout->addWidget(button);
-
-                    auto colorDialog = new QColorDialog();
-                    colorDialog->setOption(QColorDialog::DontUseNativeDialog, true);
-
-                    QObject::connect(button, &QPushButton::clicked, colorDialog, &QColorDialog::show);
-                    QObject::connect(colorDialog, &QColorDialog::colorSelected, [i, button, segRenderer, result, this](QColor color) {
-                        QPixmap pixmap(64,64);
-                        pixmap.fill(color);
-                        button->setIcon(QIcon(pixmap));
-                        segRenderer->setColor(i, Color(color.red()/255.0f, color.green()/255.0f, color.blue()/255.0f));
-                        writeRendererAttributes(result);
-                    });
-                }
-            } else if(rendererType == "HeatmapRenderer") {
-                auto heatmapRenderer = std::dynamic_pointer_cast<HeatmapRenderer>(renderer);
-
-                // Max opacity
-                {
-                    auto label = new QLabel();
-                    label->setText("Maximum Opacity:");
-                    layout->addWidget(label);
-                    auto slider = new QSlider(Qt::Horizontal);
-                    slider->setRange(0, 100);
-                    slider->setValue(heatmapRenderer->getMaxOpacity()*100.f);
-                    QObject::connect(slider, &QSlider::valueChanged, [heatmapRenderer, result, this](int i) {
-                        heatmapRenderer->setMaxOpacity((float)i/100.0f);
-                    });
-                    QObject::connect(slider, &QSlider::sliderReleased, [=]() {
-                        writeRendererAttributes(result);
-                    });
-                    layout->addWidget(slider);
-                }
+                    segRenderer->setColor(i, Color(color.red()/255.0f, color.green()/255.0f, color.blue()/255.0f));
+                    writeRendererAttributes(result);
+                });
+            }
+        } else if(rendererType == "HeatmapRenderer") {
+            auto heatmapRenderer = std::dynamic_pointer_cast<HeatmapRenderer>(renderer);
 
-                // Min confidence
-                {
-                    auto label = new QLabel();
-                    label->setText("Minimum Confidence:");
-                    layout->addWidget(label);
-                    auto slider = new QSlider(Qt::Horizontal);
-                    slider->setRange(0, 100);
-                    slider->setValue(heatmapRenderer->getMinConfidence()*100.0f);
-                    QObject::connect(slider, &QSlider::valueChanged, [heatmapRenderer, result, this](int i) {
-                        heatmapRenderer->setMinConfidence((float)i/100.0f);
-                    });
-                    QObject::connect(slider, &QSlider::sliderReleased, [=]() {
-                        writeRendererAttributes(result);
-                    });
-                    layout->addWidget(slider);
-                }
+            // Max opacity
+            {
+                auto label = new QLabel();
+                label->setText("Maximum Opacity:");
+                layout->addWidget(label);
+                auto slider = new QSlider(Qt::Horizontal);
+                slider->setRange(0, 100);
+                slider->setValue(heatmapRenderer->getMaxOpacity()*100.f);
+                QObject::connect(slider, &QSlider::valueChanged, [heatmapRenderer, result, this](int i) {
+                    heatmapRenderer->setMaxOpacity((float)i/100.0f);
+                });
+                QObject::connect(slider, &QSlider::sliderReleased, [=]() {
+                    writeRendererAttributes(result);
+                });
+                layout->addWidget(slider);
+            }
 
-                // Interpolation
-                {
-                    auto label = new QLabel();
-                    label->setText("Interpolation:");
-                    layout->addWidget(label);
-                    auto checkbox = new QCheckBox();
-                    checkbox->setChecked(heatmapRenderer->getInterpolation());
-                    QObject::connect(checkbox, &QCheckBox::stateChanged, [heatmapRenderer, result, this](int i) {
-                        heatmapRenderer->setInterpolation(!heatmapRenderer->getInterpolation());
-                        writeRendererAttributes(result);
-                    });
-                    layout->addWidget(checkbox);
-                }
+            // Min confidence
+            {
+                auto label = new QLabel();
+                label->setText("Minimum Confidence:");
+                layout->addWidget(label);
+                auto slider = new QSlider(Qt::Horizontal);
+                slider->setRange(0, 100);
+                slider->setValue(heatmapRenderer->getMinConfidence()*100.0f);
+                QObject::connect(slider, &QSlider::valueChanged, [heatmapRenderer, result, this](int i) {
+                    heatmapRenderer->setMinConfidence((float)i/100.0f);
+                });
+                QObject::connect(slider, &QSlider::sliderReleased, [=]() {
+                    writeRendererAttributes(result);
+                });
+                layout->addWidget(slider);
+            }
 
+            // Interpolation
+            {
                 auto label = new QLabel();
-                label->setText("Classes:");
+                label->setText("Interpolation:");
                 layout->addWidget(label);
+                auto checkbox = new QCheckBox();
+                checkbox->setChecked(heatmapRenderer->getInterpolation());
+                QObject::connect(checkbox, &QCheckBox::stateChanged, [heatmapRenderer, result, this](int i) {
+                    heatmapRenderer->setInterpolation(!heatmapRenderer->getInterpolation());
+                    writeRendererAttributes(result);
+                });
+                layout->addWidget(checkbox);
+            }
+
+            auto label = new QLabel();
+            label->setText("Classes:");
+            layout->addWidget(label);
 
-                for(int i = 0; i < result.classNames.size(); ++i) {
-                    auto classLayout = new QHBoxLayout();
-                    layout->addLayout(classLayout);
-
-                    auto checkbox = new QCheckBox();
-                    checkbox->setChecked(!heatmapRenderer->getChannelHidden(i));
-                    classLayout->addWidget(checkbox);
-                    QObject::connect(checkbox, &QCheckBox::stateChanged, [=]() {
-                        heatmapRenderer->setChannelHidden(i, !checkbox->isChecked());
-                        writeRendererAttributes(result);
-                    });
-
-                    auto className = result.classNames[i];
-                    auto button = new QPushButton();
-                    button->setStyleSheet("text-align: left; padding: 10%;");
-                    button->setText(QString::fromStdString(className));
+            for(int i = 0; i < result.classNames.size(); ++i) {
+                auto classLayout = new QHBoxLayout();
+                layout->addLayout(classLayout);
+
+                auto checkbox = new QCheckBox();
+                checkbox->setChecked(!heatmapRenderer->getChannelHidden(i));
+                classLayout->addWidget(checkbox);
+                QObject::connect(checkbox, &QCheckBox::stateChanged, [=]() {
+                    heatmapRenderer->setChannelHidden(i, !checkbox->isChecked());
+                    writeRendererAttributes(result);
+                });
+
+                auto className = result.classNames[i];
+                auto button = new QPushButton();
+                button->setStyleSheet("text-align: left; padding: 10%;");
+                button->setText(QString::fromStdString(className));
+                QPixmap pixmap(64,64);
+                Color color = heatmapRenderer->getChannelColor(i);
+                pixmap.fill(QColor(color.getRedValue()*255, color.getGreenValue()*255, color.getBlueValue()*255));
+                button->setIcon(QIcon(pixmap));
+                classLayout->addWidget(button);
+
+                auto colorDialog = new QColorDialog();
+                colorDialog->setOption(QColorDialog::DontUseNativeDialog, true);
+
+                QObject::connect(button, &QPushButton::clicked, colorDialog, &QColorDialog::show);
+                QObject::connect(colorDialog, &QColorDialog::colorSelected, [i, button, heatmapRenderer, result, this](QColor color) {
                     QPixmap pixmap(64,64);
-                    Color color = heatmapRenderer->getChannelColor(i);
-                    pixmap.fill(QColor(color.getRedValue()*255, color.getGreenValue()*255, color.getBlueValue()*255));
+                    pixmap.fill(color);
                     button->setIcon(QIcon(pixmap));
-                    classLayout->addWidget(button);
-
-                    auto colorDialog = new QColorDialog();
-                    colorDialog->setOption(QColorDialog::DontUseNativeDialog, true);
-
-                    QObject::connect(button, &QPushButton::clicked, colorDialog, &QColorDialog::show);
-                    QObject::connect(colorDialog, &QColorDialog::colorSelected, [i, button, heatmapRenderer, result, this](QColor color) {
-                        QPixmap pixmap(64,64);
-                        pixmap.fill(color);
-                        button->setIcon(QIcon(pixmap));
-                        heatmapRenderer->setChannelColor(i, Color(color.red()/255.0f, color.green()/255.0f, color.blue()/255.0f));
-                        writeRendererAttributes(result);
-                    });
-                }
+                    heatmapRenderer->setChannelColor(i, Color(color.red()/255.0f, color.green()/255.0f, color.blue()/255.0f));
+                    writeRendererAttributes(result);
+                });
             }
         }
-        _page_combobox->adjustSize();
     }
 } // End of namespace fast
@@ -20,12 +20,15 @@
 #include <QFileDialog>
 #include <QColorDialog>
 #include <QGroupBox>
-#include <iostream>
+#include <set>
 #include <FAST/Visualization/Renderer.hpp>
 #include "source/utils/utilities.h"
 #include "source/utils/qutilities.h"
 #include "source/logic/Project.h"
 
+class QThreadPool;
+class QTimer;
+
 namespace fast {
 
 class MainWindow;
@@ -41,7 +44,15 @@ public:
      */
     void resetInterface();
 
+    /**
+     * List the results of the current WSI. Results are imported on a worker thread when toggled on, or
+     * straight away if they were shown last time, and then added to the view.
+     */
     void setResults(std::vector<Result> results);
+    /**
+     * Store the renderer attributes collected by writeRendererAttributes now, e.g. before the results are listed again.
+     */
+    void flushRendererAttributes();
 
 protected:
     /**
@@ -54,14 +65,36 @@ protected:
      */
     void setupConnections();
 
+    /**
+     * Save the current renderer attributes of a result. Changes are collected, and stored in the project
+     * manifest together when there have been no changes for view/attribute-save-delay-ms (default 1000).
+     */
     void writeRendererAttributes(Result result);
 
+    void toggleResult(int index);
+    /**
+     * Import a result in the background, and add its renderer to the view and its controls to the interface.
+     * @param index
+     * @param toggled Whether the user toggled the result on, the new state is then saved.
+     */
+    void showResult(int index, bool toggled);
+    void addRendererControls(QVBoxLayout* layout, Result result);
+
 private:
     MainWindow* m_mainWindow;
     QVBoxLayout* _main_layout; /* Principal layout holder for the current custom QWidget */
     QStackedLayout* _stacked_layout;
     QWidget* _stacked_widget;
     QComboBox* _page_combobox;
+    std::vector<Result> m_results;
+    std::vector<QVBoxLayout*> m_resultLayouts;
+    std::set<int> m_importing; /* Results being imported */
+    int m_generation = 0; /* Incremented when the results are reset */
+    QThreadPool* m_importPool;
+    QTimer* m_attributeTimer;
+    std::shared_ptr<Project> m_attributeProject; /* Project of the collected attributes */
+    std::string m_attributeUid; /* WSI of the collected attributes */
+    std::map<std::string, std::string> m_pendingAttributes; /* "<pipeline>/<data name>" -> attributes */
 };
 
 }
@@ -0,0 +1,150 @@
+#include "BatchJournal.h"
+#include <FAST/Reporter.hpp>
+#include <FAST/Utility.hpp>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QSaveFile>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#ifdef WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace fast{
+    /**
+     * Tabs and newlines are used as separators in the journal.
+     */
+    static std::string sanitize(std::string text) {
+        std::replace(text.begin(), text.end(), '\t', ' ');
+        std::replace(text.begin(), text.end(), '\n', ' ');
+        std::replace(text.begin(), text.end(), '\r', ' ');
+        return text;
+    }
+
+    static void sync(QFileDevice& file) {
+        file.flush();
+#ifdef WIN32
+        _commit(file.handle());
+#else
+        fsync(file.handle());
+#endif
+    }
+
+    BatchJournal::BatchJournal(const std::string& filename) : m_filename(filename)
+    {
+        // Line format: state \t uid \t pipeline \t time \t error \t attempts \t key \t end, with the entry after
+        // the change. Journals of older versions have lines without attempts and key, which are replayed.
+        std::ifstream file(filename);
+        std::string line;
+        while(std::getline(file, line)) {
+            std::vector<std::string> tokens;
+            std::stringstream stream(line);
+            std::string token;
+            while(std::getline(stream, token, '\t'))
+                tokens.push_back(token);
+            if(tokens.size() >= 8 && tokens[7] == "end") {
+                auto& entry = m_entries[std::make_pair(tokens[1], tokens[2])];
+                entry.state = tokens[0];
+                entry.error = tokens[4];
+                try {
+                    entry.attempts = std::stoi(tokens[5]);
+                } catch(std::exception &e) {
+                    entry.attempts = 0;
+                }
+                entry.key = tokens[6];
+            } else if(tokens.size() >= 6 && tokens[5] == "end") {
+                apply(tokens[1], tokens[2], tokens[0], tokens[4]);
+            }
+            // Else a partially written line
+        }
+    }
+
+    std::string BatchJournal::hashKey(const std::string& key) {
+        return QCryptographicHash::hash(QByteArray::fromStdString(key), QCryptographicHash::Sha1).toHex().toStdString();
+    }
+
+    std::string BatchJournal::createLine(const std::string& uid, const std::string& pipelineName, const BatchJournalEntry& entry) {
+        return entry.state + "\t" + uid + "\t" + pipelineName + "\t" + currentDateTime() + "\t" + entry.error + "\t" +
+            std::to_string(entry.attempts) + "\t" + entry.key + "\tend\n";
+    }
+
+    void BatchJournal::apply(const std::string& uid, const std::string& pipelineName, const std::string& state, const std::string& error) {
+        auto& entry = m_entries[std::make_pair(uid, pipelineName)];
+        entry.state = state;
+        entry.error = error;
+        if(state == "running") {
+            entry.attempts += 1;
+        } else if(state == "stopped") {
+            entry.attempts = std::max(0, entry.attempts - 1); // Stopped by the user, not a failed attempt
+        } else if(state == "done") {
+            entry.attempts = 0;
+        }
+    }
+
+    void BatchJournal::writeLines(const std::string& lines) {
+        QFile file(QString::fromStdString(m_filename));
+        if(!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+            // Not being able to journal should not stop the batch itself
+            Reporter::warning() << "Unable to write to batch journal " << m_filename << Reporter::end();
+            return;
+        }
+        file.write(lines.c_str(), lines.size());
+        sync(file);
+        file.close();
+    }
+
+    void BatchJournal::append(const std::string& uid, const std::string& pipelineName, const std::string& state, const std::string& error, const std::string& key) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        apply(uid, pipelineName, state, sanitize(error));
+        auto& entry = m_entries[std::make_pair(uid, pipelineName)];
+        if(!key.empty())
+            entry.key = hashKey(key);
+        writeLines(createLine(uid, pipelineName, entry));
+    }
+
+    void BatchJournal::appendQueued(const std::vector<std::string>& uids, const std::string& pipelineName) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::string lines;
+        for(auto& uid : uids) {
+            apply(uid, pipelineName, "queued", "");
+            lines += createLine(uid, pipelineName, m_entries[std::make_pair(uid, pipelineName)]);
+        }
+        writeLines(lines);
+    }
+
+    void BatchJournal::resetAttempts(const std::string& uid, const std::string& pipelineName) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto entry = m_entries.find(std::make_pair(uid, pipelineName));
+        if(entry == m_entries.end() || entry->second.attempts == 0)
+            return;
+        entry->second.attempts = 0;
+        writeLines(createLine(uid, pipelineName, entry->second));
+    }
+
+    void BatchJournal::compact() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::string lines;
+        for(auto& entry : m_entries)
+            lines += createLine(entry.first.first, entry.first.second, entry.second);
+        QSaveFile file(QString::fromStdString(m_filename));
+        if(!file.open(QIODevice::WriteOnly)) {
+            Reporter::warning() << "Unable to compact batch journal " << m_filename << Reporter::end();
+            return;
+        }
+        file.write(lines.c_str(), lines.size());
+        sync(file);
+        if(!file.commit())
+            Reporter::warning() << "Unable to compact batch journal " << m_filename << Reporter::end();
+    }
+
+    BatchJournalEntry BatchJournal::getEntry(const std::string& uid, const std::string& pipelineName) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto entry = m_entries.find(std::make_pair(uid, pipelineName));
+        if(entry == m_entries.end())
+            return BatchJournalEntry();
+        return entry->second;
+    }
+} // End of namespace fast
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+
+namespace fast{
+    /**
+     * State of one (WSI, pipeline) pair in the journal.
+     */
+    class BatchJournalEntry {
+        public:
+            std::string state; /* queued, running, stopped, done or failed */
+            int attempts = 0; /* Nr of times processing was started since the last time it was done */
+            std::string error;
+            std::string key; /* Hash of the result key (see Project::getResultKey) of the last attempt */
+    };
+
+    /**
+     * Append-only journal of batch processing in a project, used to resume a batch after a crash.
+     *
+     * Each state change of a (WSI, pipeline) pair is appended as one line and flushed to disk before returning,
+     * thus a WSI which was running when the application crashed is still marked as running in the journal.
+     * A line which was only partially written when crashing is ignored when reading. The journal is compacted to
+     * one line per pair when a batch starts, thus it does not grow with the number of batches run.
+     */
+    class BatchJournal {
+        public:
+            /**
+             * @brief BatchJournal Open a journal, reading all existing entries.
+             * @param filename Location of the journal, created if it does not exist.
+             */
+            BatchJournal(const std::string& filename);
+            /**
+             * @brief append Record a state change. Can be called from any thread. Failing to write is reported as a
+             * warning, and does not throw.
+             * @param uid Unique identifier for the WSI.
+             * @param pipelineName Name of the pipeline.
+             * @param state queued, running, stopped, done or failed.
+             * @param error Reason for failing.
+             * @param key Result key of the attempt, stored hashed. If empty, the key of the last attempt is kept.
+             */
+            void append(const std::string& uid, const std::string& pipelineName, const std::string& state, const std::string& error = "", const std::string& key = "");
+            /**
+             * @brief appendQueued Record that several WSIs are queued, with a single flush to disk.
+             */
+            void appendQueued(const std::vector<std::string>& uids, const std::string& pipelineName);
+            /**
+             * @brief getEntry Current state of a (WSI, pipeline) pair. The state is empty if it is not in the journal.
+             */
+            BatchJournalEntry getEntry(const std::string& uid, const std::string& pipelineName);
+            /**
+             * @brief resetAttempts Forget the attempts of a (WSI, pipeline) pair, e.g. when it is recomputed.
+             */
+            void resetAttempts(const std::string& uid, const std::string& pipelineName);
+            /**
+             * @brief compact Rewrite the journal with only the current entry of each pair, with an atomic rename.
+             */
+            void compact();
+            /**
+             * @brief hashKey Hash of a result key, as stored in the entries.
+             */
+            static std::string hashKey(const std::string& key);
+        protected:
+            void writeLines(const std::string& lines);
+            void apply(const std::string& uid, const std::string& pipelineName, const std::string& state, const std::string& error);
+            static std::string createLine(const std::string& uid, const std::string& pipelineName, const BatchJournalEntry& entry);
+        private:
+            std::string m_filename;
+            std::mutex m_mutex;
+            std::map<std::pair<std::string, std::string>, BatchJournalEntry> m_entries;
+    };
+} // End of namespace fast
@@ -0,0 +1,573 @@
+#include "BatchScheduler.h"
+#include "Project.h"
+#include "BatchJournal.h"
+#include "PipelineRuntime.h"
+#include "PipelineBatching.h"
+#include "TissueMaskCache.h"
+#include "MemoryBudget.h"
+#include "SlideSharding.h"
+#include "Tracing.h"
+#include "RemoteSlideCache.h"
+#include <FAST/Pipeline.hpp>
+#include <FAST/Data/ImagePyramid.hpp>
+#include <FAST/Algorithms/ImagePatch/PatchGenerator.hpp>
+#include <FAST/Algorithms/NeuralNetwork/NeuralNetwork.hpp>
+#include <FAST/Importers/WholeSlideImageImporter.hpp>
+#include <algorithm>
+#include <thread>
+
+namespace fast{
+    static double secondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    BatchScheduler::BatchScheduler(std::shared_ptr<Project> project, std::string pipelineFilename) :
+        m_project(project), m_pipelineFilename(pipelineFilename), m_stop(false), m_finished(0)
+    {
+        m_slidesInFlight = getSetting("batch/slides-in-flight", 2).toInt();
+        m_slotsPerDevice = getSetting("batch/inference-slots-per-device", 1).toInt();
+        m_maxAttempts = std::max(1, getSetting("batch/max-attempts", 3).toInt());
+        m_reusePipeline = getSetting("batch/reuse-pipeline", true).toBool();
+        m_shareEngines = getSetting("batch/share-engines", true).toBool();
+        m_splitSlides = getSetting("batch/split-slides", false).toBool();
+        const std::string pipelineName = Pipeline(m_pipelineFilename).getName();
+        m_batchSize = PipelineBatching::getBatchSize(pipelineName);
+        if(PipelineBatching::getMaxInFlight(pipelineName) > 0)
+            m_slidesInFlight = PipelineBatching::getMaxInFlight(pipelineName);
+        m_journal = std::make_shared<BatchJournal>(join(project->getRootFolder(), "batch.journal"));
+        for(auto device : split(getSetting("batch/devices", "").toString().toStdString(), ",")) {
+            trim(device);
+            if(!device.empty())
+                m_devices.push_back(std::stoi(device));
+        }
+    }
+
+    BatchScheduler::~BatchScheduler()
+    {
+    }
+
+    void BatchScheduler::setSlidesInFlight(int slides) {
+        m_slidesInFlight = std::max(1, slides);
+    }
+
+    void BatchScheduler::setInferenceSlotsPerDevice(int slots) {
+        m_slotsPerDevice = std::max(1, slots);
+    }
+
+    void BatchScheduler::setDevices(std::vector<int> devices) {
+        m_devices = devices;
+    }
+
+    void BatchScheduler::setMaxAttempts(int attempts) {
+        m_maxAttempts = std::max(1, attempts);
+    }
+
+    void BatchScheduler::setReusePipeline(bool reuse) {
+        m_reusePipeline = reuse;
+    }
+
+    void BatchScheduler::setBatchSize(int batchSize) {
+        m_batchSize = std::max(0, batchSize);
+    }
+
+    void BatchScheduler::setShareInferenceEngines(bool share) {
+        m_shareEngines = share;
+    }
+
+    void BatchScheduler::setSplitSlides(bool split) {
+        m_splitSlides = split;
+    }
+
+    void BatchScheduler::setSkipUpToDate(bool skip) {
+        m_skipUpToDate = skip;
+    }
+
+    void BatchScheduler::setItemFinishedCallback(std::function<void(const BatchItemReport&)> callback) {
+        m_itemFinishedCallback = callback;
+    }
+
+    std::vector<BatchItemReport> BatchScheduler::run(const std::vector<std::string>& uids) {
+        m_stop = false;
+        m_finished = 0;
+        m_total = uids.size();
+        m_usedSlots.clear();
+        m_sharedEngines.clear();
+        m_sharedBatchSizes.clear();
+        m_splitWorkers.clear();
+        if(m_shareEngines && m_slotsPerDevice > 1)
+            std::cout << "Inference engines are not shared, as there are " << m_slotsPerDevice << " inference slots per device" << std::endl;
+        if(m_devices.empty()) {
+            m_usedSlots[-1] = 0; // Default device
+        } else {
+            for(auto device : m_devices)
+                m_usedSlots[device] = 0;
+        }
+
+        m_pipelineName = Pipeline(m_pipelineFilename).getName();
+        m_journal->compact();
+        m_journal->appendQueued(uids, m_pipelineName);
+
+        std::vector<BatchItemReport> reports(uids.size());
+        for(int i = 0; i < uids.size(); ++i) {
+            reports[i].uid = uids[i];
+            reports[i].filename = m_project->getImage(uids[i])->get_filename();
+            reports[i].status = "stopped";
+        }
+
+        std::atomic_int next(0);
+        std::vector<std::thread> workers;
+        // A split WSI uses all devices, thus WSIs are processed one at a time
+        const bool split = m_splitSlides && m_devices.size() > 1;
+        if(m_shareEngines && m_slotsPerDevice == 1 && !split && !uids.empty()) {
+            try {
+                createSharedInferenceEngines(uids[0]);
+            } catch(std::exception &e) {
+                m_sharedEngines.clear();
+                m_sharedBatchSizes.clear();
+                std::cout << "Inference engines are not shared, as they could not be created: " << e.what() << std::endl;
+            }
+        }
+        const int nrOfWorkers = std::min(split ? 1 : m_slidesInFlight, (int)uids.size());
+        for(int i = 0; i < nrOfWorkers; ++i) {
+            workers.emplace_back([this, &next, &reports, i]() {
+                Tracing::setThreadName("batch worker " + std::to_string(i + 1));
+                BatchWorkerState worker;
+                while(!m_stop) {
+                    const int index = next++;
+                    if(index >= reports.size())
+                        break;
+                    processItem(reports[index], worker);
+                }
+            });
+        }
+        for(auto& worker : workers)
+            worker.join();
+        m_sharedEngines.clear(); // Free the GPU memory of the models
+        // Results of the last WSIs may still be in the export queue
+        m_project->flushResults();
+        m_splitWorkers.clear();
+        return reports;
+    }
+
+    void BatchScheduler::processItem(BatchItemReport& report, BatchWorkerState& worker) {
+        const auto itemStart = std::chrono::steady_clock::now();
+        std::string resultKey;
+        try {
+            resultKey = m_project->getResultKey(report.uid, m_pipelineFilename, m_batchSize);
+            if(m_skipUpToDate && m_project->hasUpToDateResults(report.uid, m_pipelineFilename, m_batchSize)) {
+                report.status = "skipped";
+                finishItem(report, itemStart);
+                return;
+            }
+        } catch(std::exception &e) {
+            std::cout << "Unable to check for existing results of " << report.uid << ": " << e.what() << std::endl;
+        }
+
+        // Attempts of previous runs are counted as well. A WSI still marked as running in the journal crashed the
+        // application, and should not do so again on every resume. They are forgotten when the WSI is recomputed on
+        // request, or when the pipeline, models, image or settings changed since.
+        const BatchJournalEntry entry = m_journal->getEntry(report.uid, m_pipelineName);
+        if(!m_skipUpToDate || (!resultKey.empty() && entry.key != BatchJournal::hashKey(resultKey)))
+            m_journal->resetAttempts(report.uid, m_pipelineName);
+        const int previousAttempts = m_journal->getEntry(report.uid, m_pipelineName).attempts;
+        report.attempts = previousAttempts;
+        if(previousAttempts >= m_maxAttempts) {
+            report.status = "failed";
+            report.error = "Gave up after " + std::to_string(previousAttempts) + " attempts, see batch.journal in the project";
+            finishItem(report, itemStart);
+            return;
+        }
+        while(report.attempts < m_maxAttempts && !m_stop) {
+            report.attempts += 1;
+            report.error = "";
+            m_journal->append(report.uid, m_pipelineName, "running", "", resultKey);
+            if(runItem(report, worker, itemStart))
+                return; // Finished by the export thread
+            m_journal->append(report.uid, m_pipelineName, report.status, report.error);
+            if(report.status == "stopped")
+                break;
+        }
+        finishItem(report, itemStart);
+    }
+
+    bool BatchScheduler::runItem(BatchItemReport& report, BatchWorkerState& worker, std::chrono::steady_clock::time_point itemStart) {
+        if(m_splitSlides && m_devices.size() > 1)
+            return runSplitItem(report, itemStart);
+        int device = -1;
+        std::int64_t reservedMemory = 0;
+        bool hasSlot = false;
+        bool queued = false;
+        try {
+            // The WSI is imported through an importer which is part of the pipeline. Changing its filename marks
+            // the pipeline as modified, while the parsed process objects and loaded models are kept.
+            auto start = std::chrono::steady_clock::now();
+            if(!m_reusePipeline || !worker.pipeline) {
+                worker = BatchWorkerState();
+                worker.lease = m_project->getImage(report.uid)->get_local_file();
+                worker.importer = WholeSlideImageImporter::New();
+                worker.importer->setFilename(worker.lease->getFilename());
+                worker.pipeline = std::make_shared<Pipeline>(m_pipelineFilename);
+                // Parsing loads the models. With shared engines, workers parse one at a time and release their
+                // copy right away, thus only one copy besides the shared engines exists at any time.
+                std::unique_lock<std::mutex> parseLock(m_parseMutex, std::defer_lock);
+                if(!m_sharedEngines.empty())
+                    parseLock.lock();
+                worker.pipeline->parse({}, {{"WSI", worker.importer}}, false);
+                if(!m_sharedEngines.empty()) {
+                    // Batches of the sizes the shared engines are loaded with, see createSharedInferenceEngines
+                    PipelineBatching::insertBatchGenerators(worker.pipeline, m_sharedBatchSizes);
+                    useSharedInferenceEngines(worker.pipeline, m_sharedEngines.begin()->first);
+                } else {
+                    PipelineBatching::apply(worker.pipeline, m_batchSize);
+                }
+            } else {
+                // The queued results of the previous WSI are the output data of the process objects, which would
+                // be overwritten by running the pipeline again
+                if(worker.exported.valid())
+                    worker.exported.wait();
+                worker.lease = m_project->getImage(report.uid)->get_local_file();
+                worker.importer->setFilename(worker.lease->getFilename());
+            }
+            auto pipeline = worker.pipeline;
+            PipelineRuntime::enable(pipeline->getProcessObjects()); // Reset, runtime.json covers this WSI only
+            report.timings["parse"] = secondsSince(start);
+            Tracing::record("batch", "parse", report.uid, start);
+            {
+                std::lock_guard<std::mutex> lock(m_runningMutex);
+                m_runningPipelines[report.uid] = {pipeline};
+            }
+
+            start = std::chrono::steady_clock::now();
+            worker.importer->run();
+            report.timings["import"] = secondsSince(start);
+            Tracing::record("batch", "import", report.uid, start);
+
+            // Run tissue segmentation before waiting for an inference slot. The results are kept by the process
+            // objects, and are not recomputed when the rest of the pipeline is executed. With a cached mask for the
+            // project, the patch generators use it instead.
+            start = std::chrono::steady_clock::now();
+            int masked = 0;
+            if(TissueMaskCache::isEnabled(*m_project)) {
+                auto WSI = worker.importer->getOutputData<ImagePyramid>();
+                masked = TissueMaskCache::apply(pipeline, TissueMaskCache::getMask(*m_project, report.uid, WSI));
+            }
+            for(auto PO : pipeline->getProcessObjects()) {
+                if(masked == 0 && PO.second->getNameOfClass() == "TissueSegmentation")
+                    PO.second->run();
+            }
+            report.timings["preprocess"] = secondsSince(start);
+            Tracing::record("batch", "preprocess", report.uid, start);
+
+            // Outputs stay in memory until exported, wait until they fit in the memory budget
+            start = std::chrono::steady_clock::now();
+            const std::int64_t outputSize = MemoryBudget::estimateOutputSize(pipeline, worker.importer->getOutputData<ImagePyramid>());
+            if(!MemoryBudget::getInstance().reserve(outputSize, [this]() { return (bool)m_stop; }))
+                throw Exception("Batch processing was stopped");
+            reservedMemory = outputSize;
+            report.timings["memory"] = secondsSince(start);
+            Tracing::record("batch", "memory", report.uid, start);
+
+            start = std::chrono::steady_clock::now();
+            hasSlot = acquireInferenceSlot(device);
+            if(!hasSlot)
+                throw Exception("Batch processing was stopped");
+            report.device = device;
+            if(!m_sharedEngines.empty()) {
+                useSharedInferenceEngines(pipeline, device);
+            } else if(device >= 0 && device != worker.device) {
+                for(auto PO : pipeline->getProcessObjects()) {
+                    if(auto network = std::dynamic_pointer_cast<NeuralNetwork>(PO.second)) {
+                        // The model was loaded on the default device while parsing, load it on the assigned device
+                        network->getInferenceEngine()->setDevice(device);
+                        network->getInferenceEngine()->load();
+                    }
+                }
+                worker.device = device;
+            }
+            auto data = pipeline->getAllPipelineOutputData();
+            releaseInferenceSlot(device);
+            hasSlot = false;
+            report.timings["inference"] = secondsSince(start);
+            Tracing::record("batch", "inference", report.uid, start);
+            // A pipeline stopped during execution returns incomplete outputs, which must not be stored as results
+            if(m_stop)
+                throw Exception("Batch processing was stopped");
+
+            worker.exported = queueResults(report, pipeline, data, itemStart, reservedMemory, worker.lease);
+            queued = true;
+        } catch(std::exception &e) {
+            if(hasSlot)
+                releaseInferenceSlot(device);
+            if(!queued)
+                MemoryBudget::getInstance().release(reservedMemory);
+            worker = BatchWorkerState(); // The pipeline may be in a bad state, parse it again for the next WSI
+            report.status = m_stop ? "stopped" : "failed";
+            report.error = e.what();
+            std::cout << "Processing " << report.uid << " failed (attempt " << report.attempts << " of " << m_maxAttempts << "): " << e.what() << std::endl;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_runningMutex);
+            m_runningPipelines.erase(report.uid);
+        }
+        return queued;
+    }
+
+    std::shared_future<void> BatchScheduler::queueResults(BatchItemReport& report, std::shared_ptr<Pipeline> pipeline, std::map<std::string, std::shared_ptr<DataObject>> data,
+                                      std::chrono::steady_clock::time_point itemStart, std::int64_t reservedMemory, std::shared_ptr<SlideLease> lease) {
+        // The report is only touched by the export thread from here on
+        const auto start = std::chrono::steady_clock::now();
+        auto exported = std::make_shared<std::promise<void>>();
+        std::shared_future<void> future = exported->get_future().share();
+        m_project->saveResults(report.uid, pipeline, data, [this, &report, start, itemStart, reservedMemory, lease, exported](bool success) mutable {
+            MemoryBudget::getInstance().release(reservedMemory);
+            lease.reset(); // The WSI may be evicted from the remote slide cache, unless a worker still uses it
+            report.timings["export"] = secondsSince(start);
+            Tracing::record("batch", "export", report.uid, start);
+            report.status = success ? "done" : "failed";
+            if(!success)
+                report.error = "Unable to save results";
+            m_journal->append(report.uid, m_pipelineName, report.status, report.error);
+            finishItem(report, itemStart);
+            exported->set_value();
+        }, m_batchSize);
+        return future;
+    }
+
+    bool BatchScheduler::runSplitItem(BatchItemReport& report, std::chrono::steady_clock::time_point itemStart) {
+        std::int64_t reservedMemory = 0;
+        std::shared_ptr<SlideLease> lease;
+        bool queued = false;
+        report.device = m_devices[0];
+        report.devices = m_devices;
+        try {
+            // One copy of the pipeline per device, each with its own importer of the WSI, kept as worker pipelines
+            auto start = std::chrono::steady_clock::now();
+            lease = m_project->getImage(report.uid)->get_local_file();
+            if(!m_reusePipeline || m_splitWorkers.size() != m_devices.size()) {
+                m_splitWorkers.clear();
+                for(int i = 0; i < m_devices.size(); ++i) {
+                    BatchWorkerState worker;
+                    worker.importer = WholeSlideImageImporter::New();
+                    worker.importer->setFilename(lease->getFilename());
+                    worker.pipeline = std::make_shared<Pipeline>(m_pipelineFilename);
+                    worker.pipeline->parse({}, {{"WSI", worker.importer}}, false);
+                    // Batched and loaded on the device, the models are not loaded again for it
+                    PipelineBatching::apply(worker.pipeline, m_batchSize, m_devices[i]);
+                    worker.device = m_devices[i];
+                    m_splitWorkers.push_back(worker);
+                }
+            } else {
+                // The merged results of the previous WSI are output data of the first copy, see queueResults
+                if(m_splitWorkers[0].exported.valid())
+                    m_splitWorkers[0].exported.wait();
+                for(auto& worker : m_splitWorkers)
+                    worker.importer->setFilename(lease->getFilename());
+            }
+            std::vector<std::shared_ptr<Pipeline>> pipelines;
+            std::vector<std::shared_ptr<WholeSlideImageImporter>> importers;
+            for(auto& worker : m_splitWorkers) {
+                pipelines.push_back(worker.pipeline);
+                importers.push_back(worker.importer);
+            }
+            report.timings["parse"] = secondsSince(start);
+            Tracing::record("batch", "parse", report.uid, start);
+            {
+                std::lock_guard<std::mutex> lock(m_runningMutex);
+                m_runningPipelines[report.uid] = pipelines;
+            }
+
+            start = std::chrono::steady_clock::now();
+            for(auto& importer : importers)
+                importer->run();
+            auto WSI = importers[0]->getOutputData<ImagePyramid>();
+            report.timings["import"] = secondsSince(start);
+            Tracing::record("batch", "import", report.uid, start);
+
+            // Each copy only creates the patches of its part of the tissue
+            start = std::chrono::steady_clock::now();
+            auto masks = SlideSharding::splitMask(TissueMaskCache::getMask(*m_project, report.uid, WSI), pipelines.size());
+            for(int i = 0; i < pipelines.size(); ++i) {
+                int generators = 0;
+                for(auto PO : pipelines[i]->getProcessObjects()) {
+                    if(std::dynamic_pointer_cast<PatchGenerator>(PO.second))
+                        ++generators;
+                }
+                if(TissueMaskCache::apply(pipelines[i], masks[i]) < generators)
+                    throw Exception("The patch generators of " + m_pipelineName + " use masks of the pipeline, thus a WSI can not be split over devices");
+            }
+            report.timings["preprocess"] = secondsSince(start);
+            Tracing::record("batch", "preprocess", report.uid, start);
+
+            // Each copy stitches outputs of the size of the WSI
+            start = std::chrono::steady_clock::now();
+            const std::int64_t outputSize = MemoryBudget::estimateOutputSize(pipelines[0], WSI)*pipelines.size();
+            if(!MemoryBudget::getInstance().reserve(outputSize, [this]() { return (bool)m_stop; }))
+                throw Exception("Batch processing was stopped");
+            reservedMemory = outputSize;
+            report.timings["memory"] = secondsSince(start);
+            Tracing::record("batch", "memory", report.uid, start);
+
+            start = std::chrono::steady_clock::now();
+            std::vector<std::map<std::string, std::shared_ptr<DataObject>>> outputs(pipelines.size());
+            std::vector<std::string> errors(pipelines.size());
+            std::vector<std::thread> threads;
+            for(int i = 0; i < pipelines.size(); ++i) {
+                threads.emplace_back([this, &pipelines, &outputs, &errors, i]() {
+                    Tracing::setThreadName("device " + std::to_string(m_devices[i]));
+                    try {
+                        outputs[i] = pipelines[i]->getAllPipelineOutputData();
+                    } catch(std::exception &e) {
+                        errors[i] = e.what();
+                    }
+                });
+            }
+            for(auto& thread : threads)
+                thread.join();
+            for(int i = 0; i < errors.size(); ++i) {
+                if(!errors[i].empty())
+                    throw Exception("Processing on device " + std::to_string(m_devices[i]) + " failed: " + errors[i]);
+            }
+            report.timings["inference"] = secondsSince(start);
+            Tracing::record("batch", "inference", report.uid, start);
+            if(m_stop) // Incomplete outputs, as above
+                throw Exception("Batch processing was stopped");
+
+            start = std::chrono::steady_clock::now();
+            auto data = SlideSharding::merge(outputs);
+            report.timings["merge"] = secondsSince(start);
+            Tracing::record("batch", "merge", report.uid, start);
+
+            m_splitWorkers[0].exported = queueResults(report, pipelines[0], data, itemStart, reservedMemory, lease);
+            queued = true;
+        } catch(std::exception &e) {
+            if(!queued)
+                MemoryBudget::getInstance().release(reservedMemory);
+            m_splitWorkers.clear(); // The pipelines may be in a bad state, parse them again for the next WSI
+            report.status = m_stop ? "stopped" : "failed";
+            report.error = e.what();
+            std::cout << "Processing " << report.uid << " failed (attempt " << report.attempts << " of " << m_maxAttempts << "): " << e.what() << std::endl;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_runningMutex);
+            m_runningPipelines.erase(report.uid);
+        }
+        return queued;
+    }
+
+    void BatchScheduler::finishItem(BatchItemReport& report, std::chrono::steady_clock::time_point itemStart) {
+        report.timings["total"] = secondsSince(itemStart);
+        Tracing::record("batch", "WSI", report.uid + " " + report.status, itemStart);
+        ++m_finished;
+        if(m_itemFinishedCallback)
+            m_itemFinishedCallback(report);
+    }
+
+    bool BatchScheduler::acquireInferenceSlot(int& device) {
+        std::unique_lock<std::mutex> lock(m_slotMutex);
+        m_slotCondition.wait(lock, [this, &device]() {
+            if(m_stop)
+                return true;
+            // Pick the least used device with a free slot
+            int leastUsed = m_slotsPerDevice;
+            for(auto& slots : m_usedSlots) {
+                if(slots.second < leastUsed) {
+                    leastUsed = slots.second;
+                    device = slots.first;
+                }
+            }
+            return leastUsed < m_slotsPerDevice;
+        });
+        if(m_stop)
+            return false;
+        m_usedSlots[device] += 1;
+        return true;
+    }
+
+    void BatchScheduler::releaseInferenceSlot(int device) {
+        {
+            std::lock_guard<std::mutex> lock(m_slotMutex);
+            if(m_usedSlots[device] > 0)
+                m_usedSlots[device] -= 1;
+        }
+        m_slotCondition.notify_all();
+    }
+
+    void BatchScheduler::createSharedInferenceEngines(const std::string& uid) {
+        std::lock_guard<std::mutex> lock(m_engineMutex);
+        std::vector<int> devices = m_devices;
+        if(devices.empty())
+            devices.push_back(-1);
+        for(int i = 0; i < devices.size(); ++i) {
+            // The engines of a pipeline parsed and batched as those of the workers keep all of their settings. Only
+            // the engines are kept, the rest of the pipeline is released at the end.
+            // The importer is not run, the remote slide cache is not needed
+            auto importer = WholeSlideImageImporter::New();
+            importer->setFilename(m_project->getImage(uid)->get_filename());
+            auto pipeline = std::make_shared<Pipeline>(m_pipelineFilename);
+            pipeline->parse({}, {{"WSI", importer}}, false);
+            std::map<std::string, int> batchSizes;
+            PipelineBatching::apply(pipeline, m_batchSize, devices[i], &batchSizes);
+            // The workers are batched before the device is known, thus all devices must use the same batch sizes
+            if(i == 0) {
+                m_sharedBatchSizes = batchSizes;
+            } else if(batchSizes != m_sharedBatchSizes) {
+                throw Exception("The batch sizes selected for device " + std::to_string(devices[i]) + " differ from those of device " + std::to_string(devices[0]));
+            }
+            for(auto PO : pipeline->getProcessObjects()) {
+                if(auto network = std::dynamic_pointer_cast<NeuralNetwork>(PO.second))
+                    m_sharedEngines[devices[i]][PO.first] = network->getInferenceEngine();
+            }
+        }
+    }
+
+    void BatchScheduler::useSharedInferenceEngines(std::shared_ptr<Pipeline> pipeline, int device) {
+        std::lock_guard<std::mutex> lock(m_engineMutex);
+        auto& engines = m_sharedEngines[device];
+        // The engine loaded when parsing the pipeline is released here, if not shared already
+        for(auto PO : pipeline->getProcessObjects()) {
+            auto network = std::dynamic_pointer_cast<NeuralNetwork>(PO.second);
+            if(!network || engines.count(PO.first) == 0 || network->getInferenceEngine() == engines[PO.first])
+                continue;
+            const int batchSize = m_sharedBatchSizes.count(PO.first) > 0 ? m_sharedBatchSizes[PO.first] : 1;
+            if(engines[PO.first]->getMaxBatchSize() < batchSize)
+                throw Exception("The shared inference engine of " + PO.first + " is not loaded for batches of " + std::to_string(batchSize));
+            network->setInferenceEngine(engines[PO.first]);
+        }
+    }
+
+    void BatchScheduler::stop() {
+        m_stop = true;
+        {
+            std::lock_guard<std::mutex> lock(m_runningMutex);
+            for(auto& running : m_runningPipelines) {
+                for(auto& pipeline : running.second) {
+                    for(auto PO : pipeline->getProcessObjects())
+                        PO.second->stopPipeline();
+                }
+            }
+        }
+        m_slotCondition.notify_all();
+    }
+
+    float BatchScheduler::getProgress() {
+        if(m_total == 0)
+            return 0.0f;
+        float progress = m_finished;
+        std::lock_guard<std::mutex> lock(m_runningMutex);
+        for(auto& running : m_runningPipelines) {
+            float pipelineProgress = 0.0f;
+            int generators = 0;
+            for(auto& pipeline : running.second) {
+                for(auto PO : pipeline->getProcessObjects()) {
+                    if(auto generator = std::dynamic_pointer_cast<PatchGenerator>(PO.second)) {
+                        pipelineProgress += generator->getProgress();
+                        ++generators;
+                    }
+                }
+            }
+            if(generators > 0)
+                progress += pipelineProgress / generators;
+        }
+        return std::min(1.0f, progress / m_total);
+    }
+} // End of namespace fast
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <chrono>
+#include <cstdint>
+
+namespace fast{
+    class Project;
+    class Pipeline;
+    class BatchJournal;
+    class WholeSlideImageImporter;
+    class InferenceEngine;
+    class DataObject;
+    class SlideLease;
+
+    /**
+     * Outcome of processing one WSI in a batch.
+     */
+    class BatchItemReport {
+        public:
+            std::string uid;
+            std::string filename;
+            std::string status; /* done, skipped (results up to date), failed or stopped */
+            std::string error;
+            int attempts = 0; /* Nr of times processing was started, including previous batch runs */
+            int device = -1; /* Inference device used, -1 if the default device was used. The first device of a split WSI. */
+            std::vector<int> devices; /* All inference devices of a WSI split over devices, see setSplitSlides */
+            std::map<std::string, double> timings; /* Seconds spent per stage: import, parse, preprocess, memory (waiting for the memory budget), inference, merge (of split WSIs), export (queued and written) */
+    };
+
+    /**
+     * Parsed pipeline kept by a worker between WSIs, so that models are only loaded once per worker.
+     */
+    class BatchWorkerState {
+        public:
+            std::shared_ptr<Pipeline> pipeline;
+            std::shared_ptr<WholeSlideImageImporter> importer; /* Input WSI of the pipeline */
+            std::shared_ptr<SlideLease> lease; /* Local file of the current WSI, released when the worker moves on */
+            std::shared_future<void> exported; /* Ready when the results of the previous WSI are written, they are output data of the pipeline */
+            int device = -1; /* Device the models of the pipeline are loaded on, -1 for the default device. Not used with shared inference engines. */
+    };
+
+    /**
+     * Runs a pipeline on many WSIs of a project, keeping several WSIs in flight so that import, tissue
+     * segmentation and export of one WSI overlap with inference of another.
+     *
+     * Each WSI goes through the stages import -> parse -> preprocess -> inference -> export. Only the inference
+     * stage is limited by the number of available inference slots (devices times slots per device), all other
+     * stages run as soon as one of the in-flight workers is free.
+     *
+     * With one inference slot per device, the neural networks of all in-flight pipelines share one loaded inference
+     * engine per device, thus the GPU memory used by models does not grow with the number of WSIs in flight.
+     *
+     * The state of each WSI is recorded in the batch.journal file of the project. A failing WSI is retried a bounded
+     * number of times and does not stop the batch, and attempts which crashed the application are counted on resume.
+     */
+    class BatchScheduler {
+        public:
+            BatchScheduler(std::shared_ptr<Project> project, std::string pipelineFilename);
+            ~BatchScheduler();
+
+            /**
+             * @brief setSlidesInFlight Number of WSIs processed concurrently (K). Default from the max in flight
+             * setting of the pipeline (see PipelineBatching), else the batch/slides-in-flight setting, else 2.
+             */
+            void setSlidesInFlight(int slides);
+            /**
+             * @brief setInferenceSlotsPerDevice Number of WSIs allowed to run inference at the same time on each device.
+             * Default from the batch/inference-slots-per-device setting, else 1.
+             */
+            void setInferenceSlotsPerDevice(int slots);
+            /**
+             * @brief setDevices Inference devices to distribute WSIs over, e.g. {0, 1} for two GPUs.
+             * An empty list (default) uses the device selected in the pipeline. Default from the batch/devices setting.
+             */
+            void setDevices(std::vector<int> devices);
+            /**
+             * @brief setSkipUpToDate Skip WSIs which already have results created with the same pipeline, models and
+             * WSI, see Project::hasUpToDateResults. Default true.
+             */
+            void setSkipUpToDate(bool skip);
+            /**
+             * @brief setMaxAttempts Nr of times processing of a WSI is attempted before giving up, counting attempts of
+             * previous batch runs recorded in the journal. Default from the batch/max-attempts setting, else 3.
+             */
+            void setMaxAttempts(int attempts);
+            /**
+             * @brief setReusePipeline Parse the pipeline once per worker and only change the input WSI between WSIs,
+             * instead of parsing it, and loading its models, for every WSI. Default from the batch/reuse-pipeline
+             * setting, else true.
+             */
+            void setReusePipeline(bool reuse);
+            /**
+             * @brief setBatchSize Nr of patches per inference, see PipelineBatching. 0 selects the largest batch which
+             * fits in GPU memory, 1 disables batching. Default from the batch size setting of the pipeline.
+             */
+            void setBatchSize(int batchSize);
+            /**
+             * @brief setShareInferenceEngines Let the pipelines of all workers use one inference engine per neural
+             * network and device, which is handed to the pipeline holding the inference slot of the device. Only
+             * used with one inference slot per device, as engines can not run several inferences at once.
+             * Default from the batch/share-engines setting, else true.
+             */
+            void setShareInferenceEngines(bool share);
+            /**
+             * @brief setSplitSlides Process one WSI at a time, with its patches split over all devices given with
+             * setDevices, see SlideSharding. Lowers the time per WSI when there are several devices. Default from the
+             * batch/split-slides setting, else false.
+             */
+            void setSplitSlides(bool split);
+            /**
+             * @brief run Process all given WSIs. Blocks until all are done or the scheduler is stopped.
+             * @param uids Unique identifiers of the WSIs in the project to process.
+             * @return One report per WSI, in the order of uids.
+             */
+            std::vector<BatchItemReport> run(const std::vector<std::string>& uids);
+            /**
+             * @brief stop Stop processing. WSIs in flight are stopped, and no new WSIs are started.
+             * Can be called from any thread.
+             */
+            void stop();
+            /**
+             * @brief getProgress Progress of the batch from 0 to 1, including partial progress of WSIs in flight.
+             * Can be called from any thread.
+             */
+            float getProgress();
+            /**
+             * Called each time a WSI is finished, i.e. when its results are written or it failed.
+             * Called from a worker thread or the export thread of the project.
+             */
+            void setItemFinishedCallback(std::function<void(const BatchItemReport&)> callback);
+        protected:
+            void processItem(BatchItemReport& report, BatchWorkerState& worker);
+            /**
+             * Runs one attempt of processing a WSI.
+             * @return True if the results were queued for export, the item is then finished by the export thread.
+             */
+            bool runItem(BatchItemReport& report, BatchWorkerState& worker, std::chrono::steady_clock::time_point itemStart);
+            /**
+             * Runs one attempt of processing a WSI with one copy of the pipeline per device, each on a part of the WSI.
+             * The copies are kept for the next WSI, as the pipeline of a worker.
+             * @return True if the results were queued for export.
+             */
+            bool runSplitItem(BatchItemReport& report, std::chrono::steady_clock::time_point itemStart);
+            /**
+             * Queues the results of a WSI for export, the item is finished and the reserved memory and the lease of
+             * the WSI file released when they are written.
+             * @return Ready when the results are written.
+             */
+            std::shared_future<void> queueResults(BatchItemReport& report, std::shared_ptr<Pipeline> pipeline, std::map<std::string, std::shared_ptr<DataObject>> data,
+                              std::chrono::steady_clock::time_point itemStart, std::int64_t reservedMemory, std::shared_ptr<SlideLease> lease);
+            void finishItem(BatchItemReport& report, std::chrono::steady_clock::time_point itemStart);
+            /**
+             * Waits for a free inference slot.
+             * @param device Set to the device to use, -1 for the default device.
+             * @return False if the scheduler was stopped while waiting.
+             */
+            bool acquireInferenceSlot(int& device);
+            void releaseInferenceSlot(int device);
+            /**
+             * Creates the shared inference engines of all devices before the workers start. Each device gets the
+             * engines of its own parse of the pipeline, batched with PipelineBatching and loaded on the device.
+             * Throws if the batch sizes differ between devices.
+             */
+            void createSharedInferenceEngines(const std::string& uid);
+            /**
+             * Sets the shared inference engines of a device in the neural networks of a pipeline, releasing the
+             * engines loaded when it was parsed.
+             */
+            void useSharedInferenceEngines(std::shared_ptr<Pipeline> pipeline, int device);
+        private:
+            std::shared_ptr<Project> m_project;
+            std::string m_pipelineFilename;
+            int m_slidesInFlight;
+            int m_slotsPerDevice;
+            std::vector<int> m_devices;
+            bool m_skipUpToDate = true;
+            int m_maxAttempts;
+            bool m_reusePipeline;
+            int m_batchSize;
+            bool m_shareEngines;
+            bool m_splitSlides;
+            std::string m_pipelineName;
+            std::shared_ptr<BatchJournal> m_journal; /* Persistent state of each WSI, to resume after a crash */
+            std::function<void(const BatchItemReport&)> m_itemFinishedCallback;
+
+            std::atomic_bool m_stop;
+            std::atomic_int m_finished;
+            int m_total = 0;
+
+            std::mutex m_slotMutex;
+            std::condition_variable m_slotCondition;
+            std::map<int, int> m_usedSlots; /* Nr of inference slots in use per device */
+
+            std::mutex m_engineMutex;
+            std::mutex m_parseMutex; /* Parses of the workers, when sharing engines */
+            std::map<int, std::map<std::string, std::shared_ptr<InferenceEngine>>> m_sharedEngines; /* Per device, per neural network id */
+            std::map<std::string, int> m_sharedBatchSizes; /* Per batched neural network id, the same on all devices */
+
+            std::vector<BatchWorkerState> m_splitWorkers; /* One per device, of the only worker when splitting WSIs */
+
+            std::mutex m_runningMutex;
+            std::map<std::string, std::vector<std::shared_ptr<Pipeline>>> m_runningPipelines; /* Pipelines in flight, per uid */
+    };
+} // End of namespace fast
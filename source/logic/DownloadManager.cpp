@@ -0,0 +1,250 @@
+#include "DownloadManager.h"
+#include "source/utils/utilities.h"
+#include <FAST/Exception.hpp>
+#include <FAST/Reporter.hpp>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QEventLoop>
+#include <QFile>
+#include <QLockFile>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QSaveFile>
+#include <QSettings>
+#include <QUrl>
+#include <algorithm>
+#include <map>
+#include <vector>
+
+namespace fast{
+    DownloadManager::Info DownloadManager::requestInfo(const std::string& url) {
+        QNetworkAccessManager manager;
+        QNetworkRequest request(QUrl(QString::fromStdString(url)));
+        request.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+        QNetworkReply* reply = manager.head(request);
+        QEventLoop loop;
+        QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
+        loop.exec();
+        reply->deleteLater();
+        if(reply->error() != QNetworkReply::NoError)
+            throw Exception("Unable to reach " + url + ": " + reply->errorString().toStdString());
+        Info info;
+        if(reply->header(QNetworkRequest::ContentLengthHeader).isValid())
+            info.size = reply->header(QNetworkRequest::ContentLengthHeader).toLongLong();
+        info.etag = reply->rawHeader("ETag").toStdString();
+        if(info.etag.empty())
+            info.etag = reply->rawHeader("Last-Modified").toStdString();
+        // Servers are not required to announce range support, it is detected from the first response otherwise
+        info.acceptsRanges = info.size > 0 && reply->rawHeader("Accept-Ranges") != "none";
+        return info;
+    }
+
+    bool DownloadManager::fetchBlocks(const std::string& url, QFile& file, std::int64_t size, std::int64_t blockSize,
+                                      std::string& blocks, int parallelRequests, ProgressCallback progress,
+                                      std::function<void()> checkpoint) {
+        std::vector<int> missing;
+        std::int64_t present = 0;
+        for(int block = 0; block < blocks.size(); ++block) {
+            if(blocks[block] == '0') {
+                missing.push_back(block);
+            } else {
+                present += std::min(blockSize, size - block*blockSize);
+            }
+        }
+        if(missing.empty())
+            return true;
+
+        // Several range requests are kept running, each block is written when its request finishes
+        QNetworkAccessManager manager;
+        QEventLoop loop;
+        std::map<int, int> attempts;
+        int next = 0;
+        int active = 0;
+        int sinceCheckpoint = 0;
+        bool rangesIgnored = false;
+        std::string error;
+        std::function<void()> startRequests = [&]() {
+            while(error.empty() && !rangesIgnored && active < parallelRequests && next < missing.size()) {
+                const int block = missing[next++];
+                const std::int64_t offset = block*blockSize;
+                const std::int64_t length = std::min(blockSize, size - offset);
+                QNetworkRequest request(QUrl(QString::fromStdString(url)));
+                request.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+                request.setRawHeader("Range", QByteArray::fromStdString("bytes=" + std::to_string(offset) + "-" + std::to_string(offset + length - 1)));
+                QNetworkReply* reply = manager.get(request);
+                ++active;
+                QObject::connect(reply, &QNetworkReply::finished, [&, reply, block, offset, length]() {
+                    --active;
+                    const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+                    const QByteArray data = reply->readAll();
+                    if(reply->error() == QNetworkReply::NoError && status == 206 && data.size() == length) {
+                        file.seek(offset);
+                        file.write(data);
+                        blocks[block] = '1';
+                        present += length;
+                        if(progress && !progress(present, size))
+                            error = "Download of " + url + " was cancelled";
+                        // Store progress regularly, thus an interrupted download is resumed
+                        if(checkpoint && ++sinceCheckpoint == 16) {
+                            file.flush();
+                            checkpoint();
+                            sinceCheckpoint = 0;
+                        }
+                    } else if(reply->error() == QNetworkReply::NoError && status == 200) {
+                        rangesIgnored = true;
+                    } else if(reply->error() == QNetworkReply::OperationCanceledError) {
+                        // Aborted below
+                    } else if(++attempts[block] < 3) {
+                        missing.push_back(block);
+                    } else {
+                        error = "Unable to fetch " + url + ": " + reply->errorString().toStdString();
+                    }
+                    reply->deleteLater();
+                    if(!error.empty() || rangesIgnored) {
+                        for(auto running : manager.findChildren<QNetworkReply*>()) {
+                            if(running != reply)
+                                running->abort();
+                        }
+                    }
+                    startRequests();
+                    if(active == 0)
+                        loop.quit();
+                });
+            }
+        };
+        startRequests();
+        if(active > 0)
+            loop.exec();
+        file.flush();
+        if(checkpoint)
+            checkpoint();
+        if(!error.empty())
+            throw Exception(error);
+        return !rangesIgnored;
+    }
+
+    /**
+     * Download with a single request, for servers without range support.
+     */
+    static void fetchWhole(const std::string& url, QFile& file, DownloadManager::ProgressCallback progress) {
+        file.resize(0);
+        QNetworkAccessManager manager;
+        QNetworkRequest request(QUrl(QString::fromStdString(url)));
+        request.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+        QNetworkReply* reply = manager.get(request);
+        bool cancelled = false;
+        QObject::connect(reply, &QNetworkReply::readyRead, [&]() {
+            file.write(reply->readAll());
+        });
+        QObject::connect(reply, &QNetworkReply::downloadProgress, [&](qint64 current, qint64 total) {
+            if(progress && !progress(current, total)) {
+                cancelled = true;
+                reply->abort();
+            }
+        });
+        QEventLoop loop;
+        QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
+        loop.exec();
+        reply->deleteLater();
+        if(cancelled)
+            throw Exception("Download of " + url + " was cancelled");
+        if(reply->error() != QNetworkReply::NoError)
+            throw Exception("Unable to fetch " + url + ": " + reply->errorString().toStdString());
+        file.write(reply->readAll());
+        file.flush();
+    }
+
+    void DownloadManager::download(const std::string& url, const std::string& filename, ProgressCallback progress,
+                                   const std::string& sha256) {
+        const QString folder = getSetting("downloads/folder", QDir::homePath() + "/fastpathology/downloads").toString();
+        QDir().mkpath(folder);
+        const QString base = folder + "/" + QCryptographicHash::hash(QByteArray::fromStdString(url), QCryptographicHash::Sha1).toHex();
+        // Other processes downloading the same URL would write the same blocks
+        QLockFile lock(base + ".lock");
+        lock.setStaleLockTime(0);
+        if(!lock.tryLock(0))
+            throw Exception(url + " is being downloaded by another process");
+
+        const Info info = requestInfo(url);
+        QFile file(base + ".part");
+        QSettings state(base + ".ini", QSettings::IniFormat);
+        const std::int64_t blockSize = std::max(1LL, getSetting("downloads/block-size-mb", 16).toLongLong())*1024*1024;
+        bool complete = false;
+        if(info.acceptsRanges) {
+            std::string blocks = state.value("blocks").toString().toStdString();
+            if(state.value("url").toString().toStdString() != url || state.value("size").toLongLong() != info.size ||
+                    state.value("etag").toString().toStdString() != info.etag || state.value("block-size").toLongLong() != blockSize ||
+                    blocks.size() != (info.size + blockSize - 1) / blockSize) {
+                // New download, or the file changed on the server since the partial download
+                blocks = std::string((info.size + blockSize - 1) / blockSize, '0');
+                file.remove();
+                state.setValue("url", QString::fromStdString(url));
+                state.setValue("size", (qlonglong)info.size);
+                state.setValue("etag", QString::fromStdString(info.etag));
+                state.setValue("block-size", (qlonglong)blockSize);
+            } else if(blocks.find('1') != std::string::npos) {
+                Reporter::info() << "Resuming download of " << url << Reporter::end();
+            }
+            if(!file.open(QIODevice::ReadWrite))
+                throw Exception("Unable to write " + file.fileName().toStdString());
+            if(file.size() != info.size)
+                file.resize(info.size);
+            complete = fetchBlocks(url, file, info.size, blockSize, blocks,
+                    std::max(1, getSetting("downloads/parallel-requests", 4).toInt()), progress, [&]() {
+                // The file is flushed before a block is marked present
+                state.setValue("blocks", QString::fromStdString(blocks));
+                state.sync();
+            });
+            if(!complete)
+                Reporter::info() << "The server of " << url << " does not support range requests, downloading without resume" << Reporter::end();
+        } else {
+            if(!file.open(QIODevice::ReadWrite))
+                throw Exception("Unable to write " + file.fileName().toStdString());
+        }
+        if(!complete)
+            fetchWhole(url, file, progress);
+        if(info.size >= 0 && file.size() != info.size)
+            throw Exception("Download of " + url + " is incomplete");
+
+        if(!sha256.empty()) {
+            file.seek(0);
+            QCryptographicHash hash(QCryptographicHash::Sha256);
+            hash.addData(&file);
+            if(hash.result().toHex().toStdString() != sha256) {
+                // Corrupt, start from zero next time
+                file.remove();
+                state.clear();
+                throw Exception("Checksum of " + url + " does not match, the download has been removed");
+            }
+        }
+        file.close();
+        QFile::remove(QString::fromStdString(filename));
+        if(!file.rename(QString::fromStdString(filename))) {
+            // Different file system
+            if(!QFile::copy(file.fileName(), QString::fromStdString(filename)))
+                throw Exception("Unable to write " + filename);
+            file.remove();
+        }
+        state.clear();
+        state.sync();
+        QFile::remove(base + ".ini");
+    }
+
+    void DownloadManager::downloadZipFile(const std::string& url, const std::string& destination, ProgressCallback progress,
+                                          const std::string& sha256) {
+        createDirectories(destination);
+        const QString folder = getSetting("downloads/folder", QDir::homePath() + "/fastpathology/downloads").toString();
+        const std::string zipFilename = folder.toStdString() + "/" +
+                QCryptographicHash::hash(QByteArray::fromStdString(url), QCryptographicHash::Sha1).toHex().toStdString() + ".zip";
+        download(url, zipFilename, progress, sha256);
+        Reporter::info() << "Extracting " << url << " to " << destination << Reporter::end();
+        try {
+            extractZipFile(zipFilename, destination);
+        } catch(Exception &e) {
+            QFile::remove(QString::fromStdString(zipFilename));
+            throw Exception("Unable to extract " + url + ": " + e.what());
+        }
+        QFile::remove(QString::fromStdString(zipFilename));
+    }
+} // End of namespace fast
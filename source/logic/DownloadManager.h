@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+#include <functional>
+#include <cstdint>
+
+class QFile;
+
+namespace fast{
+    /**
+     * Downloads of large files, e.g. test data and models, with parallel HTTP range requests.
+     *
+     * A download is written to a .part file in ~/fastpathology/downloads/, named by a hash of the URL, together
+     * with the list of blocks already fetched. An interrupted download thus continues where it stopped, also in a
+     * later session, and concurrent downloads of different URLs do not share files. Servers without range support
+     * are downloaded with a single request, without resume.
+     *
+     * All functions block the calling thread, which need not be the GUI thread.
+     */
+    class DownloadManager {
+        public:
+            /**
+             * Called with the bytes downloaded and the total size (-1 if unknown), return false to cancel.
+             */
+            typedef std::function<bool(std::int64_t, std::int64_t)> ProgressCallback;
+            class Info {
+                public:
+                    std::int64_t size = -1; /* -1 if the server does not tell */
+                    std::string etag; /* ETag or Last-Modified if there is no ETag */
+                    bool acceptsRanges = false;
+            };
+            /**
+             * @brief requestInfo Size and ETag of a remote file, from a HEAD request. Throws if the server can not
+             * be reached.
+             */
+            static Info requestInfo(const std::string& url);
+            /**
+             * @brief fetchBlocks Fetch the missing blocks of a file with parallel range requests.
+             * @param url
+             * @param file Open for writing, with the size of the remote file.
+             * @param size Size of the remote file.
+             * @param blockSize
+             * @param blocks One character per block, 1 if present, 0 if missing. Updated as blocks are written.
+             * @param parallelRequests Number of range requests running at once.
+             * @param progress Optional, called after each block.
+             * @param checkpoint Optional, called regularly after flushing the file, to store the blocks.
+             * @return false if the server ignored the range requests, true when all blocks are present. Throws if
+             * a block fails repeatedly or the download is cancelled.
+             */
+            static bool fetchBlocks(const std::string& url, QFile& file, std::int64_t size, std::int64_t blockSize,
+                                    std::string& blocks, int parallelRequests, ProgressCallback progress = nullptr,
+                                    std::function<void()> checkpoint = nullptr);
+            /**
+             * @brief download Download a file, resuming an earlier partial download of the same URL and version.
+             * @param url
+             * @param filename Where to store the file, it is replaced only when the download is complete.
+             * @param progress Optional
+             * @param sha256 Optional hex SHA-256 checksum, the file is discarded and an exception thrown if it differs.
+             */
+            static void download(const std::string& url, const std::string& filename, ProgressCallback progress = nullptr,
+                                 const std::string& sha256 = "");
+            /**
+             * @brief downloadZipFile Download a zip file and extract it to a folder. The zip file is removed after
+             * extraction.
+             */
+            static void downloadZipFile(const std::string& url, const std::string& destination, ProgressCallback progress = nullptr,
+                                        const std::string& sha256 = "");
+    };
+} // End of namespace fast
@@ -0,0 +1,139 @@
+#include "EngineCache.h"
+#include <FAST/Config.hpp>
+#include <FAST/Utility.hpp>
+#include <FAST/Algorithms/NeuralNetwork/NeuralNetwork.hpp>
+#include <FAST/Algorithms/NeuralNetwork/InferenceEngineManager.hpp>
+#include "PipelineGraph.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <fstream>
+#include <mutex>
+#include <set>
+
+namespace fast{
+    static std::mutex indexMutex;
+
+    static std::string getIndexFilename() {
+        return join(EngineCache::getFolder(), "index.txt");
+    }
+
+    /**
+     * Index line format: key model-hash engine input-shape model-filename
+     */
+    static bool isModelInIndex(const std::string& modelHash, const std::string& engineName) {
+        std::lock_guard<std::mutex> lock(indexMutex);
+        std::ifstream file(getIndexFilename());
+        std::string line;
+        while(std::getline(file, line)) {
+            auto tokens = split(line, " ");
+            if(tokens.size() > 2 && tokens[1] == modelHash && tokens[2] == engineName)
+                return true;
+        }
+        return false;
+    }
+
+    /**
+     * Inference engines set with the inference-engine attribute of the networks loading a model, in the pipelines
+     * of ~/fastpathology. Empty for networks using the engine FAST selects.
+     */
+    static std::set<std::string> getPipelineEngines(const std::string& modelFilename) {
+        const std::string folder = join(QDir::homePath().toStdString(), "fastpathology");
+        std::vector<std::string> pipelines;
+        for(auto& filename : getDirectoryList(join(folder, "pipelines")))
+            if(filename.size() > 4 && filename.substr(filename.size() - 4) == ".fpl")
+                pipelines.push_back(join(folder, "pipelines", filename));
+        for(auto& dir : getDirectoryList(join(folder, "datahub"), false, true))
+            pipelines.push_back(join(folder, "datahub", dir, "pipeline.fpl"));
+        const QString model = QFileInfo(QString::fromStdString(modelFilename)).canonicalFilePath();
+        std::set<std::string> engines;
+        for(auto& pipeline : pipelines) {
+            if(!fileExists(pipeline))
+                continue;
+            const PipelineGraph graph(pipeline);
+            const std::string currentPath = QFileInfo(QString::fromStdString(pipeline)).absolutePath().toStdString();
+            for(auto& id : graph.getIds()) {
+                std::string filename = graph.getAttribute(id, "model");
+                if(filename.empty())
+                    continue;
+                filename = replace(replace(filename, "\"", ""), "$CURRENT_PATH$", currentPath);
+                if(QFileInfo(QString::fromStdString(filename)).canonicalFilePath() == model)
+                    engines.insert(graph.getAttribute(id, "inference-engine"));
+            }
+        }
+        return engines;
+    }
+
+    std::string EngineCache::getFolder() {
+        return QDir::homePath().toStdString() + "/fastpathology/cache/engines/";
+    }
+
+    void EngineCache::setup() {
+        createDirectories(getFolder());
+        Config::setKernelBinaryPath(getFolder());
+    }
+
+    std::uint64_t EngineCache::getSize() {
+        std::uint64_t size = 0;
+        QDirIterator it(QString::fromStdString(getFolder()), QDir::Files, QDirIterator::Subdirectories);
+        while(it.hasNext()) {
+            it.next();
+            size += it.fileInfo().size();
+        }
+        return size;
+    }
+
+    void EngineCache::clear() {
+        std::lock_guard<std::mutex> lock(indexMutex);
+        QDir(QString::fromStdString(getFolder())).removeRecursively();
+        createDirectories(getFolder());
+    }
+
+    bool EngineCache::isPrecompiledModel(const std::string& modelFilename) {
+        const QString suffix = QFileInfo(QString::fromStdString(modelFilename)).suffix().toLower();
+        return suffix == "onnx" || suffix == "uff" || suffix == "xml";
+    }
+
+    bool EngineCache::precompile(const std::string& modelFilename) {
+        QFile file(QString::fromStdString(modelFilename));
+        if(!file.open(QIODevice::ReadOnly))
+            throw Exception("Unable to read model " + modelFilename);
+        QCryptographicHash hash(QCryptographicHash::Sha256);
+        hash.addData(&file);
+        file.close();
+        const std::string modelHash = hash.result().toHex().toStdString();
+
+        // Each engine the model is used with is compiled, FAST's default if no pipeline names one
+        auto engineNames = getPipelineEngines(modelFilename);
+        if(engineNames.empty())
+            engineNames.insert("");
+        bool compiled = false;
+        for(auto& engineName : engineNames) {
+            std::shared_ptr<InferenceEngine> engine;
+            if(engineName.empty()) {
+                engine = NeuralNetwork::create(modelFilename)->getInferenceEngine();
+                if(isModelInIndex(modelHash, engine->getName()))
+                    continue; // Already compiled, creating the network only loaded it from the cache
+            } else {
+                if(isModelInIndex(modelHash, engineName))
+                    continue;
+                engine = InferenceEngineManager::loadEngine(engineName);
+                engine->setFilename(modelFilename);
+                engine->load();
+            }
+            std::string inputShape;
+            for(auto& node : engine->getInputNodes())
+                inputShape += node.first + ":" + node.second.shape.toString() + ";";
+            const std::string description = modelHash + " " + engine->getName() + " " + inputShape;
+            const std::string key = QCryptographicHash::hash(QByteArray::fromStdString(description), QCryptographicHash::Sha256).toHex().toStdString();
+            // Loading the model above compiled and serialized the engine, record it
+            std::lock_guard<std::mutex> lock(indexMutex);
+            std::ofstream index(getIndexFilename(), std::ios::app);
+            index << key << " " << description << " " << getFileName(modelFilename) << "\n";
+            compiled = true;
+        }
+        return compiled;
+    }
+} // End of namespace fast
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+namespace fast{
+    /**
+     * Cache of compiled inference engines (e.g. serialized TensorRT engines) in ~/fastpathology/cache/engines/.
+     *
+     * FAST serializes compiled engines to its kernel binary path, which is pointed to the cache folder by setup().
+     * In addition, an index of precompiled models is kept, keyed by model hash, inference engine and input shape,
+     * so that models are only precompiled once per engine. Device and precision are selected by FAST when the engine
+     * is loaded, and FAST names its cached engines by them, thus they are not part of the index.
+     */
+    class EngineCache {
+        public:
+            /**
+             * @brief getFolder Location of the cache.
+             */
+            static std::string getFolder();
+            /**
+             * @brief setup Create the cache folder, and make FAST store its compiled engines there.
+             * Must be called before any model is loaded.
+             */
+            static void setup();
+            /**
+             * @brief getSize Total size of the cache in bytes.
+             */
+            static std::uint64_t getSize();
+            /**
+             * @brief clear Remove all compiled engines. They are compiled again the next time a model is loaded.
+             */
+            static void clear();
+            /**
+             * @brief isPrecompiledModel Whether the model can be compiled ahead of time, i.e. is a TensorRT (.onnx,
+             * .uff) or OpenVINO (.xml) model.
+             */
+            static bool isPrecompiledModel(const std::string& modelFilename);
+            /**
+             * @brief precompile Load a model with each inference engine the pipelines in ~/fastpathology use it with
+             * (the inference-engine attribute of their networks), or else the engine FAST selects, which compiles and
+             * caches the engine. Engines of a model with the same contents already in the index are skipped.
+             * Blocks until done.
+             * @param modelFilename Path to the model.
+             * @return True if the model was compiled, false if it was already cached.
+             */
+            static bool precompile(const std::string& modelFilename);
+    };
+} // End of namespace fast
@@ -0,0 +1,191 @@
+#include "IncrementalPipeline.h"
+#include "PipelineGraph.h"
+#include "source/utils/utilities.h"
+#include <FAST/Pipeline.hpp>
+#include <FAST/ProcessObject.hpp>
+#include <FAST/Reporter.hpp>
+#include <QFileInfo>
+#include <functional>
+
+namespace fast{
+    std::string IncrementalPipeline::getKey(const PipelineGraph& graph, const std::string& id, const std::string& pipelineFilename) {
+        std::string key = graph.getDefinition(id);
+        const std::string folder = QFileInfo(QString::fromStdString(pipelineFilename)).absolutePath().toStdString();
+        for(auto token : split(replace(key, "\n", " "), " ")) {
+            token = replace(replace(token, "\"", ""), "$CURRENT_PATH$", folder);
+            if(!token.empty() && fileExists(token))
+                key += token + " " + std::to_string(QFileInfo(QString::fromStdString(token)).lastModified().toMSecsSinceEpoch()) + "\n";
+        }
+        return key;
+    }
+
+    int IncrementalPipeline::reuse(const std::string& uid, std::shared_ptr<Pipeline> pipeline, const std::string& parameters) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_reused.clear();
+        m_skipped.clear();
+        m_runParameters = parameters;
+        if(uid != m_uid || pipeline->getFilename() != m_pipelineFilename) {
+            m_keys.clear();
+            m_processObjects.clear();
+            return 0;
+        }
+        // The stored outputs are kept, a run with other parameters, e.g. of a region, may not replace them
+        if(parameters != m_parameters)
+            return 0;
+        const PipelineGraph graph(pipeline->getFilename());
+        std::map<std::string, bool> changed;
+        std::function<bool(const std::string&)> isChanged = [&](const std::string& id) {
+            if(graph.getClassName(id).empty())
+                return false; // Pipeline input data, i.e. the same WSI
+            if(changed.count(id) > 0)
+                return changed[id];
+            changed[id] = true; // In case of cycles
+            bool result = m_keys.count(id) == 0 || m_keys[id] != getKey(graph, id, m_pipelineFilename);
+            for(const auto& connection : graph.getConnections()) {
+                if(connection.target == id && isChanged(connection.source))
+                    result = true;
+            }
+            changed[id] = result;
+            return result;
+        };
+        // Stages in the patch stream only keep their last output
+        std::map<std::string, bool> streaming;
+        std::function<bool(const std::string&)> isStreaming = [&](const std::string& id) {
+            const std::string className = graph.getClassName(id);
+            if(className == "PatchStitcher" || className.empty())
+                return false;
+            if(className == "PatchGenerator")
+                return true;
+            if(streaming.count(id) > 0)
+                return streaming[id];
+            streaming[id] = false;
+            bool result = false;
+            for(const auto& connection : graph.getConnections()) {
+                if(connection.target == id && isStreaming(connection.source))
+                    result = true;
+            }
+            streaming[id] = result;
+            return result;
+        };
+        // Renderers have no outputs, they are always created again
+        for(const auto& id : graph.getIds()) {
+            if(!graph.isRenderer(id) && !isChanged(id) && !isStreaming(id) && m_processObjects.count(id) > 0)
+                m_reused.insert(id);
+        }
+
+        // Stages which are run again get the outputs of the reused stages they depend on
+        auto processObjects = pipeline->getProcessObjects();
+        for(const auto& connection : graph.getConnections()) {
+            if(m_reused.count(connection.source) == 0 || m_reused.count(connection.target) > 0 || processObjects.count(connection.target) == 0)
+                continue;
+            try {
+                auto data = m_processObjects[connection.source]->getOutputData<DataObject>(connection.outputPort);
+                if(data) {
+                    processObjects[connection.target]->setInputData(connection.inputPort, data);
+                    continue;
+                }
+            } catch(std::exception &e) {
+            }
+            // No output kept, e.g. the previous run was stopped
+            m_reused.erase(connection.source);
+            m_keys.erase(connection.source);
+        }
+        // Stages are executed when their output is pulled by an executed stage or renderer
+        std::map<std::string, bool> skipped;
+        std::function<bool(const std::string&)> isSkipped = [&](const std::string& id) {
+            if(m_reused.count(id) > 0)
+                return true;
+            if(skipped.count(id) > 0)
+                return skipped[id];
+            skipped[id] = false; // In case of cycles
+            bool result = false;
+            for(const auto& connection : graph.getConnections()) {
+                if(connection.source != id)
+                    continue;
+                if(isSkipped(connection.target)) {
+                    result = true;
+                } else {
+                    result = false;
+                    break;
+                }
+            }
+            skipped[id] = result;
+            return result;
+        };
+        if(!m_reused.empty()) {
+            for(const auto& id : graph.getIds()) {
+                if(isSkipped(id))
+                    m_skipped.insert(id);
+            }
+        }
+        if(!m_reused.empty())
+            Reporter::info() << "Reusing the outputs of " << m_reused.size() << " unchanged stages of " << pipeline->getName() << Reporter::end();
+        return m_reused.size();
+    }
+
+    std::map<std::string, std::shared_ptr<DataObject>> IncrementalPipeline::getAllPipelineOutputData(std::shared_ptr<Pipeline> pipeline) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_reused.empty())
+            return pipeline->getAllPipelineOutputData();
+        const PipelineGraph graph(pipeline->getFilename());
+        auto processObjects = pipeline->getProcessObjects();
+        std::map<std::string, std::shared_ptr<DataObject>> data;
+        for(const auto& output : graph.getOutputs()) {
+            if(m_reused.count(output.source) > 0) {
+                data[output.target] = m_processObjects[output.source]->getOutputData<DataObject>(output.outputPort);
+            } else if(processObjects.count(output.source) > 0) {
+                // Already computed for the renderers, unless no renderer shows it
+                data[output.target] = processObjects[output.source]->runAndGetOutputData<DataObject>(output.outputPort);
+            }
+        }
+        return data;
+    }
+
+    std::set<std::string> IncrementalPipeline::getSkippedStages() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_skipped;
+    }
+
+    void IncrementalPipeline::store(const std::string& uid, std::shared_ptr<Pipeline> pipeline) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const PipelineGraph graph(pipeline->getFilename());
+        if(uid != m_uid || pipeline->getFilename() != m_pipelineFilename) {
+            m_keys.clear();
+            m_processObjects.clear();
+            m_reused.clear();
+            m_skipped.clear();
+        }
+        m_uid = uid;
+        m_pipelineFilename = pipeline->getFilename();
+        m_parameters = m_runParameters;
+        // Reused stages did not run in this pipeline, their outputs are in the stored process objects
+        auto processObjects = pipeline->getProcessObjects();
+        std::map<std::string, std::shared_ptr<ProcessObject>> stored;
+        std::map<std::string, std::string> keys;
+        for(const auto& id : graph.getIds()) {
+            if(m_reused.count(id) > 0) {
+                stored[id] = m_processObjects[id];
+            } else if(processObjects.count(id) > 0) {
+                stored[id] = processObjects[id];
+            } else {
+                continue;
+            }
+            keys[id] = getKey(graph, id, m_pipelineFilename);
+        }
+        m_processObjects = stored;
+        m_keys = keys;
+        m_reused.clear();
+        m_skipped.clear();
+    }
+
+    void IncrementalPipeline::clear() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_uid = "";
+        m_pipelineFilename = "";
+        m_parameters = "";
+        m_keys.clear();
+        m_processObjects.clear();
+        m_reused.clear();
+        m_skipped.clear();
+    }
+} // End of namespace fast
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <set>
+#include <memory>
+#include <mutex>
+
+namespace fast{
+    class Pipeline;
+    class PipelineGraph;
+    class ProcessObject;
+    class DataObject;
+
+    /**
+     * Outputs of the last pipeline run on the current WSI, so that after editing the pipeline only the changed
+     * stages and the stages depending on them are run again.
+     *
+     * Stages are compared by their definition in the pipeline file (class, attributes and inputs) and the
+     * modification time of the files they reference, e.g. models. A stage is reused if it and all stages it depends
+     * on are unchanged, and its output is complete: stages in the patch stream between a PatchGenerator and a
+     * PatchStitcher only keep their last patch, thus for example the output of an unchanged network is reused
+     * through its stitcher, not directly. Reused outputs are given to the stages and renderers depending on them,
+     * which disconnects the unchanged part of the newly parsed pipeline.
+     *
+     * Changes made to a pipeline after it is parsed, e.g. a patch mask (TissueMaskCache), the batch size
+     * (PipelineBatching) or a region of interest, are not in the pipeline file. They are given to reuse as
+     * parameters, and nothing is reused unless they equal those of the stored run.
+     */
+    class IncrementalPipeline {
+        public:
+            /**
+             * @brief reuse Give the cached outputs of unchanged stages to the stages depending on them in a newly
+             * parsed pipeline. Clears the cache if it is of another WSI or pipeline file.
+             * @param uid WSI the pipeline is run on.
+             * @param pipeline Parsed, not yet run.
+             * @param parameters Description of the changes made to the pipeline after parsing, stored with the run.
+             * @return Nr of reused stages.
+             */
+            int reuse(const std::string& uid, std::shared_ptr<Pipeline> pipeline, const std::string& parameters);
+            /**
+             * @brief getAllPipelineOutputData Output data of a pipeline given to reuse, the cached data for outputs
+             * of reused stages, else that of the process objects of the pipeline.
+             */
+            std::map<std::string, std::shared_ptr<DataObject>> getAllPipelineOutputData(std::shared_ptr<Pipeline> pipeline);
+            /**
+             * @brief getSkippedStages Ids of the stages of the pipeline given to reuse which are not executed: the
+             * reused stages, and the stages of which every consumer is skipped, e.g. a PatchGenerator feeding a reused
+             * stitcher. Empty if nothing is reused.
+             */
+            std::set<std::string> getSkippedStages();
+            /**
+             * @brief store Keep the process objects of a finished run, and their outputs, for the next run. The
+             * parameters are those last given to reuse.
+             */
+            void store(const std::string& uid, std::shared_ptr<Pipeline> pipeline);
+            void clear();
+        private:
+            /**
+             * Definition of a stage, with the modification time of every file it references.
+             */
+            static std::string getKey(const PipelineGraph& graph, const std::string& id, const std::string& pipelineFilename);
+
+            std::mutex m_mutex;
+            std::string m_uid;
+            std::string m_pipelineFilename;
+            std::string m_parameters; /* Of the stored run */
+            std::string m_runParameters; /* Given to reuse, stored with the run */
+            std::map<std::string, std::string> m_keys; /* Per stage id, of the stored run */
+            std::map<std::string, std::shared_ptr<ProcessObject>> m_processObjects; /* Of the stored run, they keep their last outputs */
+            std::set<std::string> m_reused; /* Ids of stages reused by the pipeline given to reuse */
+            std::set<std::string> m_skipped; /* Ids of stages not executed by the pipeline given to reuse */
+    };
+} // End of namespace fast
@@ -0,0 +1,146 @@
+#include "MemoryBudget.h"
+#include "PipelineGraph.h"
+#include "source/utils/utilities.h"
+#include <FAST/Utility.hpp>
+#include <FAST/Pipeline.hpp>
+#include <FAST/Data/ImagePyramid.hpp>
+#include <FAST/Algorithms/ImagePatch/PatchGenerator.hpp>
+#include <FAST/Algorithms/ImagePatch/PatchStitcher.hpp>
+#include <FAST/Algorithms/NeuralNetwork/NeuralNetwork.hpp>
+#include <chrono>
+#ifdef WIN32
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <sys/sysctl.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace fast{
+    // PatchStitcher stitches images up to this width and height into an Image, larger into a TIFF backed ImagePyramid
+    static const int MAX_STITCHED_IMAGE_SIZE = 8192;
+
+    MemoryBudget& MemoryBudget::getInstance() {
+        static MemoryBudget budget;
+        return budget;
+    }
+
+    MemoryBudget::MemoryBudget() {
+        std::int64_t defaultBudget = getPhysicalMemory() / 2;
+        if(defaultBudget <= 0)
+            defaultBudget = (std::int64_t)8*1024*1024*1024;
+        m_budget = (std::int64_t)getSetting("memory/budget-mb", (qlonglong)(defaultBudget/(1024*1024))).toLongLong()*1024*1024;
+        std::cout << "Memory budget for pipeline outputs: " << m_budget/(1024*1024) << " MB" << std::endl;
+    }
+
+    std::int64_t MemoryBudget::getPhysicalMemory() {
+#ifdef WIN32
+        MEMORYSTATUSEX status;
+        status.dwLength = sizeof(status);
+        if(GlobalMemoryStatusEx(&status))
+            return status.ullTotalPhys;
+        return 0;
+#elif defined(__APPLE__)
+        std::int64_t memory = 0;
+        size_t length = sizeof(memory);
+        if(sysctlbyname("hw.memsize", &memory, &length, nullptr, 0) == 0)
+            return memory;
+        return 0;
+#else
+        const long pages = sysconf(_SC_PHYS_PAGES);
+        const long pageSize = sysconf(_SC_PAGE_SIZE);
+        if(pages <= 0 || pageSize <= 0)
+            return 0;
+        return (std::int64_t)pages*pageSize;
+#endif
+    }
+
+    std::int64_t MemoryBudget::estimateOutputSize(std::shared_ptr<Pipeline> pipeline, std::shared_ptr<ImagePyramid> WSI) {
+        auto processObjects = pipeline->getProcessObjects();
+        const PipelineGraph graph(pipeline->getFilename());
+        std::int64_t size = 0;
+        for(auto& processObject : processObjects) {
+            if(!std::dynamic_pointer_cast<PatchStitcher>(processObject.second))
+                continue;
+            // Follow the inputs back to the patch generator, through networks and batch generators
+            int level = 0;
+            int patchWidth = 256, patchHeight = 256;
+            bool heatmap = false;
+            int channels = 1;
+            bool foundNetwork = false;
+            std::string id = graph.getSource(processObject.first, 0).source;
+            for(int i = 0; i < 10 && processObjects.count(id) > 0; ++i) {
+                auto network = std::dynamic_pointer_cast<NeuralNetwork>(processObjects[id]);
+                if(network && !foundNetwork) {
+                    // Segmentation networks output images, other networks a tensor per patch
+                    foundNetwork = true;
+                    const std::string className = graph.getClassName(id);
+                    heatmap = className != "SegmentationNetwork" && className != "ImageToImageNetwork";
+                    try {
+                        auto outputNodes = network->getInferenceEngine()->getOutputNodes();
+                        if(!outputNodes.empty()) {
+                            const auto shape = outputNodes.front().second.shape;
+                            if(shape.getDimensions() > 0)
+                                channels = std::max(1, shape[shape.getDimensions() - 1]);
+                        }
+                    } catch(std::exception &e) {
+                        // Not loaded, count one channel
+                    }
+                }
+                if(std::dynamic_pointer_cast<PatchGenerator>(processObjects[id])) {
+                    try {
+                        level = std::stoi(graph.getAttribute(id, "patch-level", "0"));
+                    } catch(std::exception &e) {
+                        // Set by a variable, count it as level 0
+                    }
+                    auto patchSize = split(graph.getAttribute(id, "patch-size"), " ");
+                    try {
+                        if(patchSize.size() >= 2) {
+                            patchWidth = std::max(1, std::stoi(patchSize[0]));
+                            patchHeight = std::max(1, std::stoi(patchSize[1]));
+                        }
+                    } catch(std::exception &e) {
+                        // Set by variables, count 256x256 patches
+                    }
+                    break;
+                }
+                id = graph.getSource(id, 0).source;
+            }
+            level = std::max(0, std::min(level, WSI->getNrOfLevels() - 1));
+            const std::int64_t levelWidth = WSI->getLevelWidth(level);
+            const std::int64_t levelHeight = WSI->getLevelHeight(level);
+            if(heatmap) {
+                const std::int64_t cells = ((levelWidth + patchWidth - 1)/patchWidth)*((levelHeight + patchHeight - 1)/patchHeight);
+                size += cells*channels*sizeof(float);
+            } else if(levelWidth <= MAX_STITCHED_IMAGE_SIZE && levelHeight <= MAX_STITCHED_IMAGE_SIZE) {
+                size += levelWidth*levelHeight;
+            }
+        }
+        return size;
+    }
+
+    std::int64_t MemoryBudget::getReserved() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_reserved;
+    }
+
+    bool MemoryBudget::reserve(std::int64_t bytes, std::function<bool()> stopped) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while(m_reserved > 0 && m_reserved + bytes > m_budget) {
+            if(stopped && stopped())
+                return false;
+            // Released reservations notify, the timeout is only to check stopped
+            m_condition.wait_for(lock, std::chrono::milliseconds(200));
+        }
+        m_reserved += bytes;
+        return true;
+    }
+
+    void MemoryBudget::release(std::int64_t bytes) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_reserved = std::max((std::int64_t)0, m_reserved - bytes);
+        }
+        m_condition.notify_all();
+    }
+} // End of namespace fast
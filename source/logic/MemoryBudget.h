@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+
+namespace fast{
+    class Pipeline;
+    class ImagePyramid;
+
+    /**
+     * Application wide budget for the memory used by pipeline outputs, shared by all pipelines running in the process.
+     *
+     * Pipelines reserve the estimated size of their outputs before inference and release it when the outputs are
+     * exported, thus the number of WSIs with outputs in memory at the same time is bounded, also with high resolution
+     * segmentations of 40x WSIs. A reservation larger than the budget is granted when nothing else is reserved.
+     */
+    class MemoryBudget {
+        public:
+            /**
+             * @brief getInstance The budget of the application. The size is read from the memory/budget-mb setting,
+             * default is half of the physical memory.
+             */
+            static MemoryBudget& getInstance();
+            /**
+             * @brief getPhysicalMemory Size of the physical memory in bytes, 0 if unknown.
+             */
+            static std::int64_t getPhysicalMemory();
+            /**
+             * @brief estimateOutputSize Upper bound on the memory of the outputs of a pipeline for a WSI. Stitched
+             * outputs dominate, each PatchStitcher is counted by what it stitches from the PatchGenerator feeding it:
+             * a segmentation is one byte per pixel at the patch level, unless the stitched image is so large that
+             * FAST stores it as a TIFF backed pyramid, which is on disk and not counted. A heatmap (a tensor per
+             * patch) is one float per channel and patch of the patch grid.
+             */
+            static std::int64_t estimateOutputSize(std::shared_ptr<Pipeline> pipeline, std::shared_ptr<ImagePyramid> WSI);
+
+            std::int64_t getBudget() const { return m_budget; }
+            std::int64_t getReserved();
+            /**
+             * @brief reserve Wait until the bytes fit in the budget, and reserve them. Can be called from any thread.
+             * @param bytes
+             * @param stopped Checked while waiting, reserve returns false without reserving if it returns true.
+             */
+            bool reserve(std::int64_t bytes, std::function<bool()> stopped = nullptr);
+            void release(std::int64_t bytes);
+        private:
+            MemoryBudget();
+            std::int64_t m_budget;
+            std::int64_t m_reserved = 0;
+            std::mutex m_mutex;
+            std::condition_variable m_condition;
+    };
+} // End of namespace fast
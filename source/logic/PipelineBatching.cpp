@@ -0,0 +1,122 @@
+#include "PipelineBatching.h"
+#include "PipelineGraph.h"
+#include "source/utils/utilities.h"
+#include <FAST/Pipeline.hpp>
+#include <FAST/DeviceManager.hpp>
+#include <FAST/Algorithms/ImagePatch/PatchGenerator.hpp>
+#include <FAST/Algorithms/ImagePatch/ImageToBatchGenerator.hpp>
+#include <FAST/Algorithms/NeuralNetwork/NeuralNetwork.hpp>
+
+namespace fast{
+    static QString getKey(const std::string& pipelineName, const std::string& name) {
+        return QString::fromStdString("pipeline-batching/" + pipelineName + "/" + name);
+    }
+
+    int PipelineBatching::getBatchSize(const std::string& pipelineName) {
+        return std::max(0, getSetting(getKey(pipelineName, "batch-size"), 0).toInt());
+    }
+
+    void PipelineBatching::setBatchSize(const std::string& pipelineName, int batchSize) {
+        setSetting(getKey(pipelineName, "batch-size"), std::max(0, batchSize));
+    }
+
+    int PipelineBatching::getMaxInFlight(const std::string& pipelineName) {
+        return std::max(0, getSetting(getKey(pipelineName, "max-in-flight"), 0).toInt());
+    }
+
+    void PipelineBatching::setMaxInFlight(const std::string& pipelineName, int images) {
+        setSetting(getKey(pipelineName, "max-in-flight"), std::max(0, images));
+    }
+
+    int PipelineBatching::getAutomaticBatchSize(std::shared_ptr<NeuralNetwork> network) {
+        const int maxBatchSize = std::max(1, getSetting("batching/max-batch-size", 32).toInt());
+        const double activationFactor = getSetting("batching/activation-factor", 64).toDouble();
+        const double memoryFraction = getSetting("batching/memory-fraction", 0.5).toDouble();
+        double memory = 0;
+        try {
+            auto device = std::dynamic_pointer_cast<OpenCLDevice>(DeviceManager::getInstance()->getDefaultDevice());
+            memory = device->getDevice().getInfo<CL_DEVICE_GLOBAL_MEM_SIZE>();
+        } catch(std::exception &e) {
+            return 1;
+        }
+        // Bytes per patch of all inputs, as float. Unknown dimensions (-1), such as the batch dimension, are skipped.
+        double bytesPerPatch = 0;
+        for(auto& node : network->getInferenceEngine()->getInputNodes()) {
+            double size = sizeof(float);
+            for(auto dimension : node.second.shape.getAll()) {
+                if(dimension > 0)
+                    size *= dimension;
+            }
+            bytesPerPatch += size;
+        }
+        if(bytesPerPatch <= 0)
+            return 1;
+        int batchSize = 1;
+        while(batchSize*2 <= maxBatchSize && batchSize*2*bytesPerPatch*activationFactor <= memory*memoryFraction)
+            batchSize *= 2;
+        return batchSize;
+    }
+
+    int PipelineBatching::apply(std::shared_ptr<Pipeline> pipeline, int batchSize, int device, std::map<std::string, int>* batchSizes) {
+        if(batchSizes)
+            batchSizes->clear();
+        auto processObjects = pipeline->getProcessObjects();
+        int used = 1;
+        std::map<std::string, int> sizes;
+        const PipelineGraph graph(pipeline->getFilename());
+        for(auto& processObject : processObjects) {
+            auto network = std::dynamic_pointer_cast<NeuralNetwork>(processObject.second);
+            if(!network)
+                continue;
+            if(device >= 0)
+                network->getInferenceEngine()->setDevice(device);
+            const auto connection = graph.getSource(processObject.first, 0);
+            int size = 1;
+            if(batchSize != 1 && processObjects.count(connection.source) > 0 && std::dynamic_pointer_cast<PatchGenerator>(processObjects[connection.source]))
+                size = batchSize > 0 ? batchSize : getAutomaticBatchSize(network);
+            if(size <= 1) {
+                if(device >= 0)
+                    network->getInferenceEngine()->load();
+                continue;
+            }
+            // The engine is compiled for the maximum batch size. If it does not fit, try smaller batches.
+            while(size > 1) {
+                try {
+                    network->getInferenceEngine()->setMaxBatchSize(size);
+                    network->getInferenceEngine()->load();
+                    break;
+                } catch(Exception &e) {
+                    std::cout << "Unable to load " << processObject.first << " with batch size " << size << ": " << e.what() << std::endl;
+                    size /= 2;
+                }
+            }
+            if(size <= 1) {
+                // Not even a batch of two fits, load the model as it was parsed
+                network->getInferenceEngine()->setMaxBatchSize(1);
+                network->getInferenceEngine()->load();
+                continue;
+            }
+            sizes[processObject.first] = size;
+            used = std::max(used, size);
+        }
+        insertBatchGenerators(pipeline, sizes);
+        if(batchSizes)
+            *batchSizes = sizes;
+        return used;
+    }
+
+    void PipelineBatching::insertBatchGenerators(std::shared_ptr<Pipeline> pipeline, const std::map<std::string, int>& batchSizes) {
+        auto processObjects = pipeline->getProcessObjects();
+        const PipelineGraph graph(pipeline->getFilename());
+        for(auto& batchSize : batchSizes) {
+            const auto connection = graph.getSource(batchSize.first, 0);
+            if(processObjects.count(batchSize.first) == 0 || processObjects.count(connection.source) == 0)
+                continue;
+            auto batchGenerator = ImageToBatchGenerator::create();
+            batchGenerator->setMaxBatchSize(batchSize.second);
+            batchGenerator->setInputConnection(processObjects[connection.source]->getOutputPort(connection.outputPort));
+            processObjects[batchSize.first]->setInputConnection(batchGenerator->getOutputPort());
+            std::cout << "Running " << batchSize.first << " with batch size " << batchSize.second << std::endl;
+        }
+    }
+} // End of namespace fast
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <map>
+
+namespace fast{
+    class Pipeline;
+    class NeuralNetwork;
+
+    /**
+     * Micro-batching of the patches of a pipeline, configured per pipeline without editing the .fpl file.
+     *
+     * apply() inserts an ImageToBatchGenerator between each PatchGenerator and the NeuralNetwork it feeds in a parsed
+     * pipeline, thus the network processes several patches per inference. The batch size and the number of images in
+     * flight in batch mode are stored per pipeline name in the settings, under pipeline-batching/<name>/.
+     */
+    class PipelineBatching {
+        public:
+            /**
+             * @brief getBatchSize Batch size of a pipeline. 0 selects the largest batch which fits in GPU memory
+             * (default), 1 disables batching.
+             */
+            static int getBatchSize(const std::string& pipelineName);
+            static void setBatchSize(const std::string& pipelineName, int batchSize);
+            /**
+             * @brief getMaxInFlight Nr of images processed concurrently when running the pipeline for all images.
+             * 0 (default) uses the batch/slides-in-flight setting.
+             */
+            static int getMaxInFlight(const std::string& pipelineName);
+            static void setMaxInFlight(const std::string& pipelineName, int images);
+            /**
+             * @brief apply Batch the patches of a parsed pipeline. The models are loaded again with the new batch size.
+             * Networks which are not fed directly by a PatchGenerator are not changed, unless a device is given.
+             * @param pipeline
+             * @param batchSize Size of batches, 0 for automatic selection.
+             * @param device If not negative, the models of all networks are loaded on this device instead.
+             * @param batchSizes If given, set to the batch size of each batched network, per id.
+             * @return Batch size used, 1 if nothing was batched.
+             */
+            static int apply(std::shared_ptr<Pipeline> pipeline, int batchSize, int device = -1, std::map<std::string, int>* batchSizes = nullptr);
+            /**
+             * @brief insertBatchGenerators Insert the ImageToBatchGenerators of apply, without loading the models,
+             * e.g. for networks which get an inference engine already loaded with these batch sizes.
+             * @param batchSizes Batch size per network id, as given by apply.
+             */
+            static void insertBatchGenerators(std::shared_ptr<Pipeline> pipeline, const std::map<std::string, int>& batchSizes);
+            /**
+             * @brief getAutomaticBatchSize Largest power of two batch size for which the input of the network, times
+             * the batching/activation-factor setting (default 64) for intermediate activations, fits in the
+             * batching/memory-fraction (default 0.5) of GPU memory. At most batching/max-batch-size (default 32).
+             */
+            static int getAutomaticBatchSize(std::shared_ptr<NeuralNetwork> network);
+    };
+} // End of namespace fast
@@ -0,0 +1,83 @@
+#include "PipelineGraph.h"
+#include "source/utils/utilities.h"
+#include <fstream>
+
+namespace fast{
+    PipelineGraph::PipelineGraph(const std::string& pipelineFilename) {
+        std::ifstream file(pipelineFilename);
+        std::string line;
+        std::string current;
+        while(std::getline(file, line)) {
+            trim(line);
+            auto tokens = split(line, " ");
+            if(tokens.empty())
+                continue;
+            if((tokens[0] == "ProcessObject" || tokens[0] == "Renderer") && tokens.size() > 1) {
+                current = tokens[1];
+                m_classes[current] = tokens.size() > 2 ? tokens[2] : "";
+                if(tokens[0] == "Renderer")
+                    m_renderers.insert(current);
+            } else if(tokens[0] == "PipelineOutputData" && tokens.size() > 2) {
+                PipelineConnection output;
+                output.target = tokens[1];
+                output.source = tokens[2];
+                output.outputPort = tokens.size() > 3 ? std::stoi(tokens[3]) : 0;
+                m_outputs.push_back(output);
+                current = "";
+                continue;
+            } else if(tokens[0].compare(0, 8, "Pipeline") == 0) {
+                current = "";
+                continue;
+            } else if(tokens[0] == "Input" && tokens.size() > 2 && !current.empty()) {
+                PipelineConnection connection;
+                connection.target = current;
+                connection.inputPort = std::stoi(tokens[1]);
+                connection.source = tokens[2];
+                connection.outputPort = tokens.size() > 3 ? std::stoi(tokens[3]) : 0;
+                m_connections.push_back(connection);
+            } else if(tokens[0] == "Attribute" && tokens.size() > 1 && !current.empty()) {
+                std::string value = line.substr(line.find(tokens[1]) + tokens[1].size());
+                trim(value);
+                m_attributes[current][tokens[1]] = value;
+            }
+            if(!current.empty())
+                m_definitions[current] += line + "\n";
+        }
+    }
+
+    PipelineConnection PipelineGraph::getSource(const std::string& target, int inputPort) const {
+        for(const auto& connection : m_connections) {
+            if(connection.target == target && connection.inputPort == inputPort)
+                return connection;
+        }
+        PipelineConnection connection;
+        connection.target = target;
+        connection.inputPort = inputPort;
+        return connection;
+    }
+
+    std::vector<std::string> PipelineGraph::getIds() const {
+        std::vector<std::string> ids;
+        for(const auto& item : m_classes)
+            ids.push_back(item.first);
+        return ids;
+    }
+
+    std::string PipelineGraph::getClassName(const std::string& id) const {
+        return m_classes.count(id) > 0 ? m_classes.at(id) : "";
+    }
+
+    std::string PipelineGraph::getDefinition(const std::string& id) const {
+        return m_definitions.count(id) > 0 ? m_definitions.at(id) : "";
+    }
+
+    std::map<std::string, std::string> PipelineGraph::getAttributes(const std::string& id) const {
+        return m_attributes.count(id) > 0 ? m_attributes.at(id) : std::map<std::string, std::string>();
+    }
+
+    std::string PipelineGraph::getAttribute(const std::string& id, const std::string& name, const std::string& defaultValue) const {
+        if(m_attributes.count(id) == 0 || m_attributes.at(id).count(name) == 0)
+            return defaultValue;
+        return m_attributes.at(id).at(name);
+    }
+} // End of namespace fast
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+namespace fast{
+    /**
+     * Connection from an output port of a process object to an input port of another, as written in a pipeline file.
+     */
+    class PipelineConnection {
+        public:
+            std::string target; /* Id of the process object or renderer with the input */
+            int inputPort = 0;
+            std::string source; /* Id of the process object or pipeline input data providing the data */
+            int outputPort = 0;
+    };
+
+    /**
+     * Connections and attributes of a pipeline file (.fpl). The Pipeline class does not expose the connections it
+     * parsed, this reads them from the Input lines of the file, so that a parsed pipeline can be rewired.
+     */
+    class PipelineGraph {
+        public:
+            explicit PipelineGraph(const std::string& pipelineFilename);
+            std::vector<PipelineConnection> getConnections() const { return m_connections; }
+            /**
+             * @brief getSource Connection to an input port of a process object.
+             * @return Connection with empty source if the input port is not connected.
+             */
+            PipelineConnection getSource(const std::string& target, int inputPort) const;
+            /**
+             * @brief getAttribute Value of an attribute of a process object or renderer, as written in the file,
+             * e.g. "512 512" for patch-size. Variables are not replaced.
+             * @return defaultValue if the attribute is not set.
+             */
+            std::string getAttribute(const std::string& id, const std::string& name, const std::string& defaultValue = "") const;
+            /**
+             * @brief getAttributes All attributes of a process object or renderer, name -> value as written in the file.
+             */
+            std::map<std::string, std::string> getAttributes(const std::string& id) const;
+            /**
+             * @brief getIds Ids of all process objects and renderers.
+             */
+            std::vector<std::string> getIds() const;
+            /**
+             * @brief getClassName Class of a process object or renderer, empty if id is not one, e.g. pipeline input data.
+             */
+            std::string getClassName(const std::string& id) const;
+            /**
+             * @brief getDefinition Lines defining a process object or renderer, its class, attributes and inputs,
+             * as written in the file. Empty if id is not defined.
+             */
+            std::string getDefinition(const std::string& id) const;
+            bool isRenderer(const std::string& id) const { return m_renderers.count(id) > 0; }
+            /**
+             * @brief getOutputs Pipeline output data, as connections with the name of the output as target.
+             */
+            std::vector<PipelineConnection> getOutputs() const { return m_outputs; }
+        private:
+            std::vector<PipelineConnection> m_connections;
+            std::vector<PipelineConnection> m_outputs;
+            std::map<std::string, std::map<std::string, std::string>> m_attributes; /* id -> name -> value */
+            std::map<std::string, std::string> m_classes; /* id -> class */
+            std::map<std::string, std::string> m_definitions; /* id -> lines */
+            std::set<std::string> m_renderers;
+    };
+} // End of namespace fast
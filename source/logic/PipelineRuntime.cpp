@@ -0,0 +1,133 @@
+#include "PipelineRuntime.h"
+#include <FAST/Exception.hpp>
+#include <FAST/ProcessObject.hpp>
+#include <FAST/RuntimeMeasurement.hpp>
+#include <FAST/Algorithms/ImagePatch/PatchGenerator.hpp>
+#include <FAST/Algorithms/ImagePatch/PatchStitcher.hpp>
+#include <FAST/Algorithms/NeuralNetwork/NeuralNetwork.hpp>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <sstream>
+#include <iomanip>
+
+namespace fast{
+    /**
+     * Names of the runtime measurements of a process object. All process objects measure execute, some classes
+     * measure the stages of execute as well.
+     */
+    static std::vector<std::string> getStageNames(std::shared_ptr<ProcessObject> processObject) {
+        std::vector<std::string> names = {"execute"};
+        if(std::dynamic_pointer_cast<PatchGenerator>(processObject)) {
+            names.push_back("create patch");
+        } else if(std::dynamic_pointer_cast<NeuralNetwork>(processObject)) {
+            names.push_back("input_processing");
+            names.push_back("inference");
+            names.push_back("output_processing");
+        } else if(std::dynamic_pointer_cast<PatchStitcher>(processObject)) {
+            names.push_back("stitch patch");
+        }
+        return names;
+    }
+
+    PipelineRuntime::PipelineRuntime(std::map<std::string, std::shared_ptr<ProcessObject>> processObjects) :
+        m_processObjects(processObjects) {
+        enable(m_processObjects);
+        m_lastUpdate = std::chrono::steady_clock::now();
+    }
+
+    void PipelineRuntime::enable(const std::map<std::string, std::shared_ptr<ProcessObject>>& processObjects) {
+        for(auto processObject : processObjects) {
+            processObject.second->enableRuntimeMeasurements();
+            for(const auto& name : getStageNames(processObject.second)) {
+                try {
+                    processObject.second->getRuntime(name)->reset();
+                } catch(Exception &e) {
+                    // Not measured yet
+                }
+            }
+        }
+    }
+
+    std::vector<StageRuntime> PipelineRuntime::getStages(const std::map<std::string, std::shared_ptr<ProcessObject>>& processObjects) {
+        std::vector<StageRuntime> stages;
+        for(auto processObject : processObjects) {
+            for(const auto& name : getStageNames(processObject.second)) {
+                RuntimeMeasurement::pointer runtime;
+                try {
+                    runtime = processObject.second->getRuntime(name);
+                } catch(Exception &e) {
+                    continue;
+                }
+                if(!runtime || runtime->getSamples() == 0)
+                    continue;
+                StageRuntime stage;
+                stage.processObject = processObject.first;
+                stage.className = processObject.second->getNameOfClass();
+                stage.stage = name;
+                stage.samples = runtime->getSamples();
+                stage.average = runtime->getAverage();
+                stage.stdDeviation = runtime->getStdDeviation();
+                stage.total = runtime->getSum();
+                stages.push_back(stage);
+            }
+        }
+        return stages;
+    }
+
+    void PipelineRuntime::update() {
+        m_stages = getStages(m_processObjects);
+        int created = 0;
+        int stitched = 0;
+        bool hasGenerator = false;
+        bool hasStitcher = false;
+        for(const auto& stage : m_stages) {
+            if(stage.stage == "create patch") {
+                created += stage.samples;
+                hasGenerator = true;
+            } else if(stage.stage == "stitch patch") {
+                stitched += stage.samples;
+                hasStitcher = true;
+            }
+        }
+        const auto now = std::chrono::steady_clock::now();
+        const float seconds = std::chrono::duration<float>(now - m_lastUpdate).count();
+        if(seconds > 0)
+            m_patchesPerSecond = (created - m_lastPatches) / seconds;
+        m_lastPatches = created;
+        m_lastUpdate = now;
+        m_patchesInFlight = hasGenerator && hasStitcher ? std::max(0, created - stitched) : -1;
+    }
+
+    std::string PipelineRuntime::getSummary() const {
+        std::stringstream summary;
+        summary << std::fixed << std::setprecision(1);
+        summary << m_patchesPerSecond << " patches/s";
+        if(m_patchesInFlight >= 0)
+            summary << ", " << m_patchesInFlight << " patches in queues";
+        for(const auto& stage : m_stages) {
+            if(stage.stage == "execute" && getStageNames(m_processObjects.at(stage.processObject)).size() > 1)
+                continue; // The substages are more informative
+            summary << "\n" << stage.processObject << " " << stage.stage << ": " << stage.average << " ± " << stage.stdDeviation << " ms";
+        }
+        return summary.str();
+    }
+
+    std::string PipelineRuntime::toJSON(const std::vector<StageRuntime>& stages) {
+        QJsonArray stageArray;
+        for(const auto& stage : stages) {
+            QJsonObject object;
+            object["process_object"] = QString::fromStdString(stage.processObject);
+            object["class"] = QString::fromStdString(stage.className);
+            object["stage"] = QString::fromStdString(stage.stage);
+            object["samples"] = stage.samples;
+            object["average_ms"] = stage.average;
+            object["std_ms"] = stage.stdDeviation;
+            object["total_ms"] = stage.total;
+            stageArray.append(object);
+        }
+        QJsonObject document;
+        document["stages"] = stageArray;
+        return QJsonDocument(document).toJson().toStdString();
+    }
+} // End of namespace fast
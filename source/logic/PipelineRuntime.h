@@ -0,0 +1,79 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <chrono>
+
+namespace fast{
+    class ProcessObject;
+
+    /**
+     * Runtime of one stage of a process object, in milliseconds, from the FAST runtime measurements.
+     */
+    class StageRuntime {
+        public:
+            std::string processObject; /* Id in the pipeline */
+            std::string className;
+            std::string stage; /* e.g. execute, create patch, inference, stitch patch */
+            int samples = 0;
+            double average = 0;
+            double stdDeviation = 0;
+            double total = 0;
+    };
+
+    /**
+     * Per stage runtime measurements of the process objects of a running pipeline.
+     *
+     * The measurements are kept by the process objects, and written by the thread executing the pipeline while
+     * they are read here, thus values read during execution are approximate.
+     */
+    class PipelineRuntime {
+        public:
+            /**
+             * @brief PipelineRuntime Enable and reset runtime measurements of all process objects.
+             * @param processObjects Process objects of a parsed pipeline.
+             */
+            PipelineRuntime(std::map<std::string, std::shared_ptr<ProcessObject>> processObjects);
+            /**
+             * @brief update Read the current measurements, call periodically to update the patch rate.
+             */
+            void update();
+            std::vector<StageRuntime> getStages() const { return m_stages; }
+            /**
+             * @brief getPatchesPerSecond Patches created by the patch generators per second, since the previous update.
+             */
+            float getPatchesPerSecond() const { return m_patchesPerSecond; }
+            /**
+             * @brief getPatchesInFlight Patches created but not yet stitched, i.e. waiting in the queues between the
+             * patch generators and the patch stitchers. -1 if the pipeline has no patch generator or stitcher.
+             */
+            int getPatchesInFlight() const { return m_patchesInFlight; }
+            /**
+             * @brief getSummary Patch rate, queue depth and average time of each stage, as text for the GUI.
+             */
+            std::string getSummary() const;
+
+            /**
+             * @brief getStages Current measurements of process objects, without enabling or resetting them.
+             * Stages without samples are skipped.
+             */
+            static std::vector<StageRuntime> getStages(const std::map<std::string, std::shared_ptr<ProcessObject>>& processObjects);
+            /**
+             * @brief toJSON Stages as a JSON document, the runtime.json file of a result.
+             */
+            static std::string toJSON(const std::vector<StageRuntime>& stages);
+            /**
+             * @brief enable Enable and reset the runtime measurements of process objects.
+             */
+            static void enable(const std::map<std::string, std::shared_ptr<ProcessObject>>& processObjects);
+        private:
+            std::map<std::string, std::shared_ptr<ProcessObject>> m_processObjects;
+            std::vector<StageRuntime> m_stages;
+            float m_patchesPerSecond = 0;
+            int m_patchesInFlight = -1;
+            int m_lastPatches = 0;
+            std::chrono::steady_clock::time_point m_lastUpdate;
+    };
+} // End of namespace fast
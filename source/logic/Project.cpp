@@ -1,7 +1,17 @@
 #include "Project.h"
+#include "source/logic/PipelineRuntime.h"
+#include "source/logic/PipelineGraph.h"
+#include "source/logic/PipelineBatching.h"
+#include "source/logic/TissueMaskCache.h"
+#include "source/logic/ProjectIndex.h"
+#include "source/logic/RemoteSlideCache.h"
+#include "source/logic/TiledTensor.h"
+#include "source/logic/Tracing.h"
 #include <FAST/Reporter.hpp>
 #include <FAST/Utility.hpp>
 #include <FAST/Pipeline.hpp>
+#include <FAST/Data/ImagePyramid.hpp>
+#include <FAST/Data/Tensor.hpp>
 #include <FAST/Importers/TIFFImagePyramidImporter.hpp>
 #include <FAST/Exporters/TIFFImagePyramidExporter.hpp>
 #include <FAST/Importers/MetaImageImporter.hpp>
@@ -12,45 +22,119 @@
 #include <FAST/Visualization/SegmentationRenderer/SegmentationRenderer.hpp>
 #include <FAST/Visualization/HeatmapRenderer/HeatmapRenderer.hpp>
 #include <FAST/Visualization/View.hpp>
+#include <QCryptographicHash>
+#include <tiffio.h>
+#include <QDateTime>
+#include <QFileInfo>
 #include <fstream>
+#include <sstream>
+#include <algorithm>
 
 namespace fast{
+    /**
+     * Files referenced by attributes of a pipeline, such as models. $CURRENT_PATH$ is the folder of the pipeline file.
+     */
+    static std::vector<std::string> getReferencedFiles(const std::string& pipelineFilename) {
+        std::vector<std::string> files;
+        const std::string currentPath = QFileInfo(QString::fromStdString(pipelineFilename)).absolutePath().toStdString();
+        std::ifstream file(pipelineFilename);
+        std::string line;
+        while(std::getline(file, line)) {
+            trim(line);
+            if(line.rfind("Attribute", 0) != 0)
+                continue;
+            for(auto token : split(line)) {
+                token.erase(std::remove(token.begin(), token.end(), '"'), token.end());
+                const std::string variable = "$CURRENT_PATH$";
+                const auto position = token.find(variable);
+                if(position != std::string::npos)
+                    token.replace(position, variable.size(), currentPath);
+                if(!fileExists(token) || isDir(token))
+                    continue;
+                files.push_back(token);
+                // OpenVINO models consist of an .xml and a .bin file
+                if(token.size() > 4 && token.substr(token.size() - 4) == ".xml") {
+                    const std::string weights = token.substr(0, token.size() - 4) + ".bin";
+                    if(fileExists(weights))
+                        files.push_back(weights);
+                }
+            }
+        }
+        return files;
+    }
+
+    /**
+     * Path, size and modification time of a file.
+     */
+    std::string Project::getFileIdentity(const std::string& filename) {
+        if(RemoteSlideCache::isRemote(filename))
+            return RemoteSlideCache::getInstance().getIdentity(filename);
+        QFileInfo info(QString::fromStdString(filename));
+        return info.absoluteFilePath().toStdString() + " " + std::to_string(info.size()) + " " + std::to_string(info.lastModified().toMSecsSinceEpoch());
+    }
+
     Project::Project(std::string name, bool open)
     {
         m_name = name;
         this->_root_folder = QDir::home().path().toStdString() + "/fastpathology/projects/" + name + "/";
-        if(open) {
-            std::vector<std::string> lines;
-            std::ifstream file(_root_folder + "project.txt");
-            std::string line;
-            while (std::getline(file, line)) {
-                lines.push_back(line);
-            }
-            for(int i = 0; i < lines.size(); i += 2) {
-                _images[lines[i]] = std::make_shared<WholeSlideImage>(lines[i+1]);
-            }
-        } else {
+        if(!open)
             this->createFolderDirectoryArchitecture();
-        }
+        m_manifest = std::make_unique<ProjectManifest>(_root_folder);
+        // Only metadata and cached thumbnails are read here, the WSIs themselves are imported on first use
+        for(auto& slide : m_manifest->getSlides())
+            includeImageFromProject(slide.first, slide.second.filename);
+        m_exportMaxPending = std::max(1, getSetting("export/max-pending", 2).toInt());
+        m_exportThread = std::thread(&Project::exportThread, this);
     }
 
     Project::~Project()
     {
+        // Results still in the queue are written before the export thread stops
+        {
+            std::lock_guard<std::mutex> lock(m_exportMutex);
+            m_exportStop = true;
+        }
+        m_exportCondition.notify_all();
+        m_exportThread.join();
     }
 
-    void Project::writeTimestmap() {
+    QVariant Project::getProjectSetting(const QString& key, const QVariant& defaultValue) const {
+        QSettings settings(QString::fromStdString(join(_root_folder, "project.ini")), QSettings::IniFormat);
+        return settings.value(key, defaultValue);
+    }
+
+    void Project::setProjectSetting(const QString& key, const QVariant& value) {
+        QSettings settings(QString::fromStdString(join(_root_folder, "project.ini")), QSettings::IniFormat);
+        settings.setValue(key, value);
+    }
+
+    void Project::writeTimestmap(std::int64_t bytesAdded) {
+        std::lock_guard<std::mutex> lock(m_timestampMutex);
         std::ofstream timestampFile(_root_folder + "timestamp.txt");
         timestampFile << currentDateTime();
         timestampFile.close();
-        std::cout << "Writing timestamping.." << currentDateTime() << std::endl;
+        try {
+            // Called while creating the folders of a new project, before the manifest is opened
+            const int slides = m_manifest ? m_manifest->getNrOfSlides() : 0;
+            const std::string thumbnail = m_manifest ? m_manifest->getThumbnail() : "";
+            ProjectIndex(QDir::home().path().toStdString() + "/fastpathology/projects/").updateProject(m_name, [&](ProjectRecord& record) {
+                record.modified = QDateTime::currentMSecsSinceEpoch();
+                record.slides = slides;
+                record.bytes = std::max((std::int64_t)0, record.bytes + bytesAdded);
+                record.thumbnail = thumbnail;
+            });
+        } catch(Exception &e) {
+            // The index is only used to list projects, it is rebuilt from the project folders if missing
+            Reporter::warning() << "Unable to update the project index: " << e.what() << Reporter::end();
+        }
     }
 
     void Project::createFolderDirectoryArchitecture()
     {
         QDir().mkdir(QString::fromStdString(this->_root_folder));
-        std::ofstream file(_root_folder + "project.txt", std::ios::out);
-        file << "";
-        file.close();
+        // A new project starts empty, a project.txt left in the folder would otherwise be migrated into the manifest
+        QFile::remove(QString::fromStdString(_root_folder + "manifest.bin"));
+        QFile::remove(QString::fromStdString(_root_folder + "project.txt"));
         writeTimestmap();
         // check if all relevant files and folders are in selected folder directory
         // if any of the folders does not exists, create them
@@ -66,9 +150,15 @@ namespace fast{
 
     std::shared_ptr<WholeSlideImage> Project::getImage(const std::string& name)
     {
-        if (this->_images.find(name) != this->_images.end())
-            return this->_images[name];
-        // else?
+        auto image = this->_images.find(name);
+        if(image == this->_images.end())
+            throw Exception("WSI " + name + " is not in project " + m_name);
+        return image->second;
+    }
+
+    bool Project::hasImage(const std::string& name) const
+    {
+        return this->_images.count(name) > 0;
     }
 
     std::vector<std::string> Project::getAllWsiUids() const
@@ -88,29 +178,8 @@ namespace fast{
 
     const std::string Project::includeImage(const std::string& image_filepath)
     {
-        auto image(std::make_shared<WholeSlideImage>(image_filepath));
-        std::string img_name_short = splitCustom(splitCustom(image_filepath, "/").back(), ".").front();
-        bool in_use = this->_images.find(img_name_short) != _images.end();
-        if(in_use)
-        {
-            bool new_in_use = true;
-            while(new_in_use)
-            {
-                int rand_int = rand() % 10000;
-                std::string new_name = img_name_short + "#" + std::to_string(rand_int);
-                if(this->_images.find(new_name) == this->_images.end())
-                {
-                    new_in_use = false;
-                    img_name_short = new_name;
-                }
-            }
-        }
-        this->_images[img_name_short] = image;
-
-        std::ofstream file(_root_folder + "project.txt", std::ios::app);
-        file << img_name_short << "\n";
-        file << image_filepath << "\n";
-        file.close();
+        const std::string img_name_short = m_manifest->addSlide(splitCustom(splitCustom(image_filepath, "/").back(), ".").front(), image_filepath);
+        this->_images[img_name_short] = std::make_shared<WholeSlideImage>(image_filepath);
         writeTimestmap();
 
         return img_name_short;
@@ -118,47 +187,63 @@ namespace fast{
 
     void Project::includeImageFromProject(const std::string& uid_name, const std::string& image_filepath)
     {
-        std::string thumbnail_filename = this->_root_folder + "/thumbnails" + uid_name + ".png";
-        if (QFile(QString::fromStdString(thumbnail_filename)).exists())
-        {
-            QImage thumbnail = QImage(QString::fromStdString(thumbnail_filename));
-            auto image(std::make_shared<WholeSlideImage>(image_filepath, thumbnail));
-            this->_images[uid_name] = image;
-        }
-        else
-        {
-            auto image(std::make_shared<WholeSlideImage>(image_filepath));
-            this->_images[uid_name] = image;
-        }
+        // The cached thumbnail is read by the project view when the WSI is shown, and created there if missing
+        this->_images[uid_name] = std::make_shared<WholeSlideImage>(image_filepath);
+    }
+
+    std::string Project::getThumbnailPath(const std::string& uid) const
+    {
+        return join(this->_root_folder, "thumbnails", uid + ".png");
     }
 
     void Project::removeImage(const std::string& uid)
     {
         this->_images.erase(uid);
+        m_manifest->removeSlide(uid);
 
-        std::vector<std::string> lines;
-        {
-            std::ifstream file(_root_folder + "project.txt");
-            std::string line;
-            while (std::getline(file, line)) {
-                lines.push_back(line);
-            }
-        }
+        // TODO remove any results
+        QDir().rmdir(QString::fromStdString(this->_root_folder + "/results/" + uid + "/"));
+        QFile::remove(QString::fromStdString(getThumbnailPath(uid)));
 
-        {
-            std::ofstream file(_root_folder + "project.txt", std::ios::out);
-            for(int i = 0; i < lines.size(); i += 2) {
-                if(lines[i] != uid) {
-                    file << lines[i] << "\n";
-                    file << lines[i+1] << "\n";
+        writeTimestmap();
+    }
+
+    void Project::updateSlideMetadata(const std::string& uid)
+    {
+        if(!hasImage(uid)) // Removed while its thumbnail was created
+            return;
+        auto image = getImage(uid);
+        if(!image->is_loaded())
+            return;
+        auto pyramid = image->get_image_pyramid();
+        float magnification = 0.0f;
+        auto metadata = pyramid->getMetadata();
+        for(auto key : {"openslide.objective-power", "aperio.AppMag"}) {
+            if(metadata.count(key) > 0) {
+                try {
+                    magnification = std::stof(metadata[key]);
+                    break;
+                } catch(std::exception &e) {
                 }
             }
         }
+        const bool hasThumbnail = fileExists(getThumbnailPath(uid));
+        m_manifest->updateSlide(uid, [&](SlideRecord& record) {
+            record.width = pyramid->getFullWidth();
+            record.height = pyramid->getFullHeight();
+            record.levels = pyramid->getNrOfLevels();
+            record.magnification = magnification;
+            if(hasThumbnail)
+                record.thumbnail = join("thumbnails", uid + ".png");
+        });
+    }
 
-        // TODO remove any results and thumbnails
-        QDir().rmdir(QString::fromStdString(this->_root_folder + "/results/" + uid + "/"));
-
-        writeTimestmap();
+    SlideRecord Project::getSlideRecord(const std::string& uid)
+    {
+        SlideRecord record;
+        if(!m_manifest->getSlide(uid, record))
+            throw Exception("WSI " + uid + " is not in project " + m_name);
+        return record;
     }
 
     void Project::saveThumbnails()
@@ -166,8 +251,7 @@ namespace fast{
         for (const auto currWSI : this->_images)
         {
             QImage thumbnail = currWSI.second->get_thumbnail();
-            std::string dump_filename = this->_root_folder + "/thumbnails/" + splitCustom(splitCustom(currWSI.second->get_filename(), "/").back(), ".")[0] + ".png";
-            thumbnail.save(QString::fromStdString(dump_filename));
+            thumbnail.save(QString::fromStdString(getThumbnailPath(currWSI.first)));
         }
     }
 
@@ -176,75 +260,282 @@ namespace fast{
         if (this->_images.find(wsi_uid) != this->_images.end())
         {
             QImage thumbnail = this->_images[wsi_uid]->get_thumbnail();
-            std::string dump_filename = this->_root_folder + "/thumbnails/" + splitCustom(splitCustom(this->_images[wsi_uid]->get_filename(), "/").back(), ".")[0] + ".png";
-            thumbnail.save(QString::fromStdString(dump_filename));
+            thumbnail.save(QString::fromStdString(getThumbnailPath(wsi_uid)));
         }
         else
             std::cout<<"Requested saving thumbnail for WSI named: "<<wsi_uid<<", which is not in the project..."<<std::endl;
     }
 
-    void Project::saveResults(const std::string& wsi_uid, std::shared_ptr<Pipeline> pipeline, std::map<std::string, std::shared_ptr<DataObject>> pipelineData) {
+    /**
+     * Id of the first renderer in a pipeline file showing a pipeline output, empty if none.
+     */
+    static std::string getOutputRenderer(const PipelineGraph& graph, const std::string& outputName) {
+        for(const auto& output : graph.getOutputs()) {
+            if(output.target != outputName)
+                continue;
+            for(const auto& connection : graph.getConnections()) {
+                if(graph.isRenderer(connection.target) && connection.inputPort == 0 &&
+                        connection.source == output.source && connection.outputPort == output.outputPort)
+                    return connection.target;
+            }
+        }
+        return "";
+    }
+
+    bool Project::saveResults(const std::string& wsi_uid, std::shared_ptr<Pipeline> pipeline, std::map<std::string, std::shared_ptr<DataObject>> pipelineData, std::function<void(bool)> finished, int batchSize, bool wait) {
+        ResultExportJob job;
+        job.WSI_uid = wsi_uid;
+        job.pipelineName = pipeline->getName();
+        job.resultKey = getResultKey(wsi_uid, pipeline->getFilename(), batchSize);
+        job.data = pipelineData;
+        job.finished = finished;
+        // Attributes are captured now, as the pipeline and its renderers may change or be gone when the job is written
+        const PipelineGraph graph(pipeline->getFilename());
         for(auto data : pipelineData) {
+            const std::string dataTypeName = data.second->getNameOfClass();
+            std::string attributes;
+            bool found = false;
+            for(auto renderer : pipeline->getRenderers()) {
+                // Check that this renderer is connected to the output
+                if(renderer->getInputPort(0)->getFrame() == data.second) {
+                    attributes += renderer->attributesToString();
+                    found = true;
+                }
+            }
+            if(!found) {
+                // Pipelines parsed without visualization, e.g. in batch mode, have no renderers. The attributes of the
+                // renderers of the output in the pipeline file are used, or else default settings.
+                const std::string rendererId = getOutputRenderer(graph, data.first);
+                Renderer::pointer renderer;
+                if(dataTypeName == "ImagePyramid" || dataTypeName == "Image") {
+                    renderer = SegmentationRenderer::create();
+                } else if(dataTypeName == "Tensor") {
+                    auto heatmapRenderer = HeatmapRenderer::create();
+                    heatmapRenderer->setInterpolation(false);
+                    renderer = heatmapRenderer;
+                }
+                if(renderer) {
+                    renderer->setDisabled(rendererId.empty()); // Outputs without a renderer were not shown either
+                    for(auto& attribute : graph.getAttributes(rendererId)) {
+                        try {
+                            renderer->getAttribute(attribute.first)->parseInput(attribute.second);
+                        } catch(Exception &e) {
+                            // Attribute of another renderer class than the one results are shown with
+                        }
+                    }
+                    renderer->loadAttributes();
+                    attributes = renderer->attributesToString();
+                }
+            }
+            job.rendererAttributes[data.first] = attributes;
+        }
+        try {
+            job.classes = pipeline->getPipelineAttribute("classes");
+        } catch(Exception& e) {
+
+        }
+        auto stages = PipelineRuntime::getStages(pipeline->getProcessObjects());
+        if(!stages.empty())
+            job.runtime = PipelineRuntime::toJSON(stages);
+        if(Tracing::isEnabled()) {
+            // Patches are processed by FAST threads which are not traced, the totals show where the time went
+            for(const auto& stage : stages)
+                Tracing::instant("pipeline", "stage runtime", wsi_uid + " " + stage.processObject + " " + stage.stage + " " + std::to_string((int)stage.total) + " ms");
+        }
+
+        bool queued;
+        {
+            std::unique_lock<std::mutex> lock(m_exportMutex);
+            if(wait)
+                m_exportCondition.wait(lock, [this]() { return m_exportQueue.size() < m_exportMaxPending; });
+            queued = m_exportQueue.size() < m_exportMaxPending;
+            m_exportQueue.push_back(std::move(job));
+        }
+        m_exportCondition.notify_all();
+        return queued;
+    }
+
+    void Project::flushResults() {
+        std::unique_lock<std::mutex> lock(m_exportMutex);
+        m_exportCondition.wait(lock, [this]() { return m_exportQueue.empty() && !m_exportBusy; });
+    }
+
+    void Project::exportThread() {
+        Tracing::setThreadName("export");
+        while(true) {
+            ResultExportJob job;
+            {
+                std::unique_lock<std::mutex> lock(m_exportMutex);
+                m_exportCondition.wait(lock, [this]() { return m_exportStop || !m_exportQueue.empty(); });
+                if(m_exportQueue.empty()) // Stopped, and all results written
+                    return;
+                job = std::move(m_exportQueue.front());
+                m_exportQueue.pop_front();
+                m_exportBusy = true;
+            }
+            m_exportCondition.notify_all(); // Room in the queue
+
+            bool success = true;
+            try {
+                writeResults(job);
+            } catch(std::exception &e) {
+                Reporter::error() << "Unable to save results of " << job.pipelineName << " for " << job.WSI_uid << ": " << e.what() << Reporter::end();
+                success = false;
+            }
+            job.data.clear();
+            // The callback is run before the job is marked done, so that flushResults also waits for it
+            if(job.finished)
+                job.finished(success);
+
+            {
+                std::lock_guard<std::mutex> lock(m_exportMutex);
+                m_exportBusy = false;
+            }
+            m_exportCondition.notify_all();
+        }
+    }
+
+    void Project::writeResults(const ResultExportJob& job) {
+        TraceScope trace("export", "write results", job.WSI_uid);
+        const std::string resultsFolder = join(getRootFolder(), "results", job.WSI_uid);
+        const std::string pipelineFolder = join(resultsFolder, job.pipelineName);
+        // Folders starting with . are ignored by loadResults
+        const std::string partialFolder = join(resultsFolder, "." + job.pipelineName + ".partial");
+        const std::string oldFolder = join(resultsFolder, "." + job.pipelineName + ".old");
+        QDir(QString::fromStdString(partialFolder)).removeRecursively();
+
+        for(auto data : job.data) {
             const std::string dataTypeName = data.second->getNameOfClass();
             const std::string dataName = data.first;
-            const std::string saveFolder = join(getRootFolder(), "results", wsi_uid, pipeline->getName(), dataName);
+            const std::string saveFolder = join(partialFolder, dataName);
             createDirectories(saveFolder);
-            std::cout << "Saving " << dataTypeName << " data to " << saveFolder << std::endl;
+            TraceScope traceData("export", "write data", job.WSI_uid + " " + dataName + " " + dataTypeName);
             if(dataTypeName == "ImagePyramid" || dataTypeName == "Image") {
                 const std::string saveFilename = join(saveFolder, data.first + ".tiff");
-                auto exporter = TIFFImagePyramidExporter::create(saveFilename)
-                        ->connect(data.second);
-                exporter->run();
+                // Large stitched pyramids are written tile by tile to a tiled TIFF on disk by FAST while the pipeline
+                // runs. Exporting them is then only a copy of the finished file, not an encode of the whole pyramid.
+                auto pyramid = std::dynamic_pointer_cast<ImagePyramid>(data.second);
+                bool copied = false;
+                if(pyramid && pyramid->usesTIFF()) {
+                    // The read access waits for writers of the pyramid. Tiles and the directory buffered by libtiff
+                    // are then flushed, so the copy is a complete TIFF.
+                    auto access = pyramid->getAccess(ACCESS_READ);
+                    TIFF* tiff = pyramid->getTIFFHandler();
+                    copied = tiff != nullptr && TIFFFlush(tiff) == 1 &&
+                            QFile::copy(QString::fromStdString(pyramid->getTIFFPath()), QString::fromStdString(saveFilename));
+                    if(!copied)
+                        QFile::remove(QString::fromStdString(saveFilename));
+                }
+                if(!copied) {
+                    auto exporter = TIFFImagePyramidExporter::create(saveFilename)
+                            ->connect(data.second);
+                    exporter->run();
+                }
             } else if(dataTypeName == "Tensor") {
-                const std::string saveFilename = join(saveFolder, data.first + ".hdf5");
-                auto exporter = HDF5TensorExporter::create(saveFilename)
-                        ->connect(data.second);
-                exporter->run();
+                // Heatmaps are stored tiled and compressed with a pyramid, thus viewing only reads what it needs
+                if(getSetting("results/heatmap-format", "fpt").toString() == "hdf5") {
+                    const std::string saveFilename = join(saveFolder, data.first + ".hdf5");
+                    auto exporter = HDF5TensorExporter::create(saveFilename)
+                            ->connect(data.second);
+                    exporter->run();
+                } else {
+                    TiledTensor::write(join(saveFolder, data.first + ".fpt"), std::dynamic_pointer_cast<Tensor>(data.second));
+                }
             } else {
                 std::cout << "Unsupported data to export " << dataTypeName << std::endl;
             }
 
             {
                 std::ofstream file(join(saveFolder, "renderer.attributes.txt"), std::iostream::out);
-                bool found = false;
-                for(auto renderer : pipeline->getRenderers()) {
-                    // Check that this renderer is connected to the output
-                    if(renderer->getInputPort(0)->getFrame() == data.second) {
-                        file << renderer->attributesToString();
-                        found = true;
-                    }
-                }
-                if(!found) { // If no renderer was found for this output data, we create a renderer with default settings
-                    // Write default renderer parameters
-                    if(dataTypeName == "ImagePyramid" || dataTypeName == "Image") {
-                        auto renderer = SegmentationRenderer::create();
-                        renderer->setDisabled(true);
-                        file << renderer->attributesToString();
-                    } else if(dataTypeName == "Tensor") {
-                        auto renderer = HeatmapRenderer::create();
-                        renderer->setInterpolation(false);
-                        renderer->setDisabled(true);
-                        file << renderer->attributesToString();
-                    } else {
-                        // Ignore
-                    }
-                }
+                file << job.rendererAttributes.at(dataName);
                 file.close();
             }
             {
                 std::ofstream file(join(saveFolder, "pipeline.attributes.txt"), std::iostream::out);
-                try {
-                    file << pipeline->getPipelineAttribute("classes") << "\n";
-                } catch(Exception& e) {
+                file << job.classes << "\n";
+                file.close();
+            }
+        }
+
+        {
+            std::ofstream file(join(partialFolder, "result.key"), std::iostream::out);
+            file << job.resultKey << "\n";
+            file.close();
+        }
+        if(!job.runtime.empty()) {
+            std::ofstream file(join(partialFolder, "runtime.json"), std::iostream::out);
+            file << job.runtime;
+            file.close();
+        }
+
+        const std::int64_t previousSize = ProjectIndex::getFolderSize(pipelineFolder);
+        const std::int64_t size = ProjectIndex::getFolderSize(partialFolder);
 
+        // Replace any previous results of this pipeline
+        QDir(QString::fromStdString(oldFolder)).removeRecursively();
+        QDir().rename(QString::fromStdString(pipelineFolder), QString::fromStdString(oldFolder));
+        if(!QDir().rename(QString::fromStdString(partialFolder), QString::fromStdString(pipelineFolder)))
+            throw Exception("Unable to move results to " + pipelineFolder);
+        QDir(QString::fromStdString(oldFolder)).removeRecursively();
+        m_manifest->updateSlide(job.WSI_uid, [&job](SlideRecord& record) {
+            if(std::find(record.results.begin(), record.results.end(), job.pipelineName) == record.results.end())
+                record.results.push_back(job.pipelineName);
+            // The new results start with the attributes of the pipeline
+            for(auto attribute = record.rendererAttributes.begin(); attribute != record.rendererAttributes.end();) {
+                if(attribute->first.compare(0, job.pipelineName.size() + 1, job.pipelineName + "/") == 0) {
+                    attribute = record.rendererAttributes.erase(attribute);
+                } else {
+                    ++attribute;
                 }
-                /*for(auto attribute : pipeline->getPipelineAttributes()) {
-                    file << "Attribute " << attribute.first << " \"" << attribute.second << "\"\n";
-                }*/
-                file.close();
             }
+        });
+        writeTimestmap(size - previousSize);
+    }
+
+    std::string Project::hashFile(const std::string& filename) {
+        const std::string identity = getFileIdentity(filename);
+        {
+            std::lock_guard<std::mutex> lock(m_hashMutex);
+            auto cached = m_fileHashes.find(filename);
+            if(cached != m_fileHashes.end() && cached->second.first == identity)
+                return cached->second.second;
         }
-        writeTimestmap();
+        QFile file(QString::fromStdString(filename));
+        if(!file.open(QIODevice::ReadOnly))
+            throw Exception("Unable to read " + filename);
+        QCryptographicHash hash(QCryptographicHash::Sha256);
+        hash.addData(&file);
+        const std::string result = hash.result().toHex().toStdString();
+        std::lock_guard<std::mutex> lock(m_hashMutex);
+        m_fileHashes[filename] = std::make_pair(identity, result);
+        return result;
+    }
+
+    std::string Project::getResultKey(const std::string& wsi_uid, const std::string& pipelineFilename, int batchSize) {
+        // The WSI itself is not hashed, they are too large. Scanners do not modify slides after acquisition.
+        std::string key = "pipeline " + hashFile(pipelineFilename) + "\n";
+        for(auto& filename : getReferencedFiles(pipelineFilename))
+            key += "file " + hashFile(filename) + "\n";
+        key += "WSI " + getFileIdentity(getImage(wsi_uid)->get_filename()) + "\n";
+        // Patches skipped by the mask are not processed. The coarse pipeline creating the mask is not masked itself.
+        const std::string coarsePipeline = getProjectSetting("tissue/coarse-pipeline", "").toString().toStdString();
+        if(TissueMaskCache::isEnabled(*this) && pipelineFilename != coarsePipeline)
+            key += "mask " + TissueMaskCache::getKey(*this, wsi_uid) + "\n";
+        if(batchSize < 0)
+            batchSize = PipelineBatching::getBatchSize(Pipeline(pipelineFilename).getName());
+        key += "batch-size " + std::to_string(batchSize) + "\n";
+        return QCryptographicHash::hash(QByteArray::fromStdString(key), QCryptographicHash::Sha256).toHex().toStdString();
+    }
+
+    bool Project::hasUpToDateResults(const std::string& wsi_uid, const std::string& pipelineFilename, int batchSize) {
+        const std::string pipelineName = Pipeline(pipelineFilename).getName();
+        std::ifstream file(join(_root_folder, "results", wsi_uid, pipelineName, "result.key"));
+        if(!file.is_open()) // No results, or results from before result keys were stored
+            return false;
+        std::string storedKey;
+        std::getline(file, storedKey);
+        trim(storedKey);
+        return storedKey == getResultKey(wsi_uid, pipelineFilename, batchSize);
     }
 
     std::shared_ptr<WholeSlideImage> Project::getImage(int i) {
@@ -256,12 +547,21 @@ namespace fast{
     }
 
     std::vector<Result> Project::loadResults(const std::string &wsi_uid) {
+        TraceScope trace("results", "list results", wsi_uid);
         std::vector<Result> results;
         // Load any results for current WSI
         const std::string saveFolder = join(_root_folder, "results", wsi_uid);
         if(!isDir(saveFolder))
             return {};
+        std::map<std::string, std::string> storedAttributes;
+        {
+            SlideRecord record;
+            if(m_manifest->getSlide(wsi_uid, record))
+                storedAttributes = record.rendererAttributes;
+        }
         for(auto pipelineName : getDirectoryList(saveFolder, false, true)) {
+            if(pipelineName[0] == '.') // Results which are still being written
+                continue;
             const std::string folder = join(saveFolder, pipelineName);
             if(!isDir(folder))
                 break;
@@ -270,70 +570,117 @@ namespace fast{
                 if(!isDir(folder))
                     break;
                 for(auto filename : getDirectoryList(folder, true, false)) {
-                    const std::string path = join(folder, filename);
                     const std::string extension = filename.substr(filename.rfind('.'));
-                    Renderer::pointer renderer;
-                    if(extension == ".tiff") {
-                        auto importer = TIFFImagePyramidImporter::create(path);
-                        renderer = SegmentationRenderer::create()->connect(importer);
-                    } else if(extension == ".mhd") {
+                    if(extension == ".mhd") {
                         Reporter::error() << ".mhd/.raw format is no longer used in fastpathology (" << filename << "). You will have to recreate your results. The segmentation will now always be stored as a TIFF pyramid." << Reporter::end();
                         continue;
-                    } else if(extension == ".hdf5") {
-                        auto importer = HDF5TensorImporter::create(path);
-                        renderer = HeatmapRenderer::create()->connect(importer);
+                    } else if(extension != ".tiff" && extension != ".hdf5" && extension != ".fpt") {
+                        continue;
                     }
-                    if(renderer) {
-                        // Read attributes from txt file
+
+                    Result result;
+                    auto stored = storedAttributes.find(pipelineName + "/" + dataName);
+                    if(stored != storedAttributes.end()) {
+                        result.rendererAttributes = stored->second;
+                    } else {
                         std::ifstream file(join(folder, "renderer.attributes.txt"), std::iostream::in);
-                        if(!file.is_open())
-                            throw Exception("Error reading " + join(folder, "renderer.attributes.txt"));
-                        do {
+                        if(!file.is_open()) {
+                            Reporter::warning() << "Error reading " << join(folder, "renderer.attributes.txt") << ", ignoring result" << Reporter::end();
+                            continue;
+                        }
+                        std::stringstream buffer;
+                        buffer << file.rdbuf();
+                        result.rendererAttributes = buffer.str();
+                    }
+                    // Read pipeline attributes
+                    {
+                        std::ifstream file(join(folder, "pipeline.attributes.txt"), std::iostream::in);
+                        if(file.is_open()) {
                             std::string line;
                             std::getline(file, line);
                             trim(line);
-                            std::cout << line << std::endl;
-
-                            std::vector<std::string> tokens = split(line);
-                            if(tokens[0] != "Attribute")
-                                break;
-
-                            if(tokens.size() < 3)
-                                throw Exception("Expecting at least 3 items on attribute line when parsing object " + renderer->getNameOfClass() + " but got " + line);
-
-                            std::string name = tokens[1];
-
-                            std::shared_ptr<Attribute> attribute = renderer->getAttribute(name);
-                            std::string attributeValues = line.substr(line.find(name) + name.size());
-                            trim(attributeValues);
-                            attribute->parseInput(attributeValues);
-                            std::cout << "Set attribute " << name << " to " << attributeValues  << " for object " << renderer->getNameOfClass() << std::endl;
-                        } while(!file.eof());
-                        renderer->loadAttributes();
-
-                        Result result;
-
-                        // Read pipeline attributes
-                        {
-                            std::ifstream file(join(folder, "pipeline.attributes.txt"), std::iostream::in);
-                            if(file.is_open()) {
-                                std::string line;
-                                std::getline(file, line);
-                                trim(line);
-                                std::cout << line << std::endl;
-                                result.classNames = split(line, ";");
-                            }
+                            result.classNames = split(line, ";");
                         }
-
-                        result.WSI_uid = wsi_uid;
-                        result.renderer = renderer;
-                        result.name = dataName;
-                        result.pipelineName = pipelineName;
-                        results.push_back(result);
                     }
+
+                    result.WSI_uid = wsi_uid;
+                    result.filename = join(folder, filename);
+                    result.name = dataName;
+                    result.pipelineName = pipelineName;
+                    results.push_back(result);
                 }
             }
         }
         return results;
     }
+
+    std::shared_ptr<DataObject> Project::importResult(const Result& result) {
+        TraceScope trace("results", "import result", result.pipelineName + "/" + result.name);
+        const std::string extension = result.filename.substr(result.filename.rfind('.'));
+        if(extension == ".tiff") {
+            auto importer = TIFFImagePyramidImporter::create(result.filename);
+            return importer->updateAndGetOutputData<ImagePyramid>();
+        } else if(extension == ".hdf5") {
+            auto importer = HDF5TensorImporter::create(result.filename);
+            return importer->updateAndGetOutputData<Tensor>();
+        } else if(extension == ".fpt") {
+            // The renderer needs the whole tensor, thus the largest level within the limit is assembled
+            TiledTensor tensor(result.filename);
+            const std::int64_t maxCells = getSetting("results/max-heatmap-cells", 4096*4096).toLongLong();
+            return tensor.readLevel(tensor.getLevelForSize(maxCells));
+        }
+        throw Exception("Unknown result format " + result.filename);
+    }
+
+    std::shared_ptr<Renderer> Project::createResultRenderer(const Result& result, std::shared_ptr<DataObject> data) {
+        Renderer::pointer renderer;
+        if(std::dynamic_pointer_cast<ImagePyramid>(data)) {
+            renderer = SegmentationRenderer::create()->connect(data);
+        } else {
+            renderer = HeatmapRenderer::create()->connect(data);
+        }
+        // Set attributes from renderer.attributes.txt
+        std::stringstream stream(result.rendererAttributes);
+        std::string line;
+        while(std::getline(stream, line)) {
+            trim(line);
+            std::vector<std::string> tokens = split(line);
+            if(tokens.empty() || tokens[0] != "Attribute")
+                break;
+
+            if(tokens.size() < 3)
+                throw Exception("Expecting at least 3 items on attribute line when parsing object " + renderer->getNameOfClass() + " but got " + line);
+
+            std::string name = tokens[1];
+
+            std::shared_ptr<Attribute> attribute = renderer->getAttribute(name);
+            std::string attributeValues = line.substr(line.find(name) + name.size());
+            trim(attributeValues);
+            attribute->parseInput(attributeValues);
+        }
+        renderer->loadAttributes();
+        return renderer;
+    }
+
+    void Project::setRendererAttributes(const std::string& wsi_uid, const std::map<std::string, std::string>& attributes) {
+        if(attributes.empty())
+            return;
+        m_manifest->updateSlide(wsi_uid, [&attributes](SlideRecord& record) {
+            for(auto& attribute : attributes)
+                record.rendererAttributes[attribute.first] = attribute.second;
+        });
+        writeTimestmap();
+    }
+
+    bool Project::isResultEnabled(const Result& result) {
+        std::stringstream stream(result.rendererAttributes);
+        std::string line;
+        while(std::getline(stream, line)) {
+            trim(line);
+            std::vector<std::string> tokens = split(line);
+            if(tokens.size() >= 3 && tokens[0] == "Attribute" && tokens[1] == "disabled")
+                return tokens[2] != "true" && tokens[2] != "1";
+        }
+        return true;
+    }
 } // End of namespace fast
@@ -3,25 +3,53 @@
 #include <iostream>
 #include <string>
 #include <QString>
+#include <QVariant>
 #include <QTemporaryDir>
 #include <QFile>
 #include <QIODevice>
 #include <QTextStream>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 #include "source/utils/utilities.h"
 #include "source/logic/WholeSlideImage.h"
+#include "source/logic/ProjectManifest.h"
 
 namespace fast{
     class DataObject;
     class Pipeline;
     class Renderer;
 
+    /**
+     * A saved result of a pipeline. The data and renderer are not loaded when listing results, see
+     * Project::importResult and Project::createResultRenderer.
+     */
     class Result {
         public:
             std::string name;
             std::string pipelineName;
             std::string WSI_uid;
             std::vector<std::string> classNames;
-            std::shared_ptr<Renderer> renderer;
+            std::string filename; /* Location of the data, .tiff for segmentations and .fpt (or .hdf5) for heatmaps */
+            std::string rendererAttributes; /* As stored in the manifest, or else the contents of renderer.attributes.txt */
+            std::shared_ptr<Renderer> renderer; /* Empty until created */
+    };
+
+    /**
+     * Results of one pipeline run waiting to be written to disk by the export thread of a Project.
+     */
+    class ResultExportJob {
+        public:
+            std::string WSI_uid;
+            std::string pipelineName;
+            std::map<std::string, std::shared_ptr<DataObject>> data;
+            std::map<std::string, std::string> rendererAttributes; /* Per data name, captured when queued */
+            std::string classes;
+            std::string resultKey;
+            std::string runtime; /* runtime.json, empty if the pipeline had no runtime measurements */
+            std::function<void(bool)> finished;
     };
 
     class Project {
@@ -33,23 +61,99 @@ namespace fast{
             bool isProjectEmpty() const{return _images.empty();}
             int getWSICountInProject() const{return this->_images.size();}
             std::vector<std::string> getAllWsiUids() const;
+            /**
+             * @brief getImage WSI of the project. Throws an Exception if there is no WSI with this uid.
+             */
             std::shared_ptr<WholeSlideImage> getImage(const std::string& name);
+            /**
+             * @brief hasImage Whether the project has a WSI with this uid, e.g. one which may have been removed since.
+             */
+            bool hasImage(const std::string& name) const;
             std::shared_ptr<WholeSlideImage> getImage(int i);
             std::string getName() const { return m_name; };
 
             void emptyProject();
-            void saveResults(const std::string& wsi_uid, std::shared_ptr<Pipeline> pipeline, std::map<std::string, std::shared_ptr<DataObject>> data);
+            /**
+             * @brief saveResults Queue the output data of a pipeline for export. The data is written by a
+             * background thread to a temporary folder, which is renamed to results/<uid>/<pipeline>/ when complete,
+             * thus loadResults never sees partially written results. Blocks while export/max-pending (default 2)
+             * results are already waiting to be written, to bound memory usage, unless wait is false.
+             * @param wsi_uid Unique identifier for the WSI.
+             * @param pipeline Pipeline which created the data. Renderer and pipeline attributes, and runtime measurements
+             * of the process objects (see PipelineRuntime), are read when queued.
+             * @param data Output data of the pipeline.
+             * @param finished Called from the export thread when the results are written, with false if export failed.
+             * @param batchSize Batch size the pipeline was run with, see getResultKey.
+             * @param wait Whether to block while the queue is full. If false, e.g. on the GUI thread, the data is queued
+             * in addition to the pending results.
+             * @return false if the queue was full, thus the results are written after the pending ones.
+             */
+            bool saveResults(const std::string& wsi_uid, std::shared_ptr<Pipeline> pipeline, std::map<std::string, std::shared_ptr<DataObject>> data, std::function<void(bool)> finished = nullptr, int batchSize = -1, bool wait = true);
+            /**
+             * @brief flushResults Block until all queued results have been written to disk.
+             */
+            void flushResults();
 
+            /**
+             * @brief loadResults List the saved results of a WSI. Only the small attribute files are read, the data
+             * itself is imported with importResult when needed.
+             * @param wsi_uid Unique identifier for the WSI.
+             */
             std::vector<Result> loadResults(const std::string& wsi_uid);
+            /**
+             * @brief importResult Import the data of a result. Can be called from any thread.
+             */
+            static std::shared_ptr<DataObject> importResult(const Result& result);
+            /**
+             * @brief createResultRenderer Create the renderer of a result, with its saved attributes.
+             * @param result
+             * @param data Data of the result, from importResult.
+             */
+            static std::shared_ptr<Renderer> createResultRenderer(const Result& result, std::shared_ptr<DataObject> data);
+            /**
+             * @brief setRendererAttributes Store renderer attributes of results of a WSI edited in the view. They are
+             * kept in the manifest, with one entry for all of them, and replace the renderer.attributes.txt written
+             * with the results until the pipeline is run again.
+             * @param wsi_uid Unique identifier for the WSI.
+             * @param attributes "<pipeline name>/<data name>" -> attributes, as given by Renderer::attributesToString.
+             */
+            void setRendererAttributes(const std::string& wsi_uid, const std::map<std::string, std::string>& attributes);
+            /**
+             * @brief isResultEnabled Whether a result was last shown, according to its saved renderer attributes.
+             */
+            static bool isResultEnabled(const Result& result);
+            /**
+             * @brief getResultKey Hash identifying the results of running a pipeline on a WSI. It covers the contents
+             * of the pipeline file and of the model files it references, the identity of the WSI (path, size and
+             * modification time, or ETag for remote slides), the patch mask (see TissueMaskCache::getKey) and the batch
+             * size. Stored as result.key in each result folder.
+             * @param wsi_uid Unique identifier for the WSI.
+             * @param pipelineFilename Path to the pipeline (.fpl).
+             * @param batchSize Batch size of the run, see PipelineBatching. -1 for the batch size set for the pipeline.
+             */
+            std::string getResultKey(const std::string& wsi_uid, const std::string& pipelineFilename, int batchSize = -1);
+            /**
+             * @brief getFileIdentity Path, size and modification time of a local file, or URI, size and ETag of a
+             * remote slide.
+             */
+            static std::string getFileIdentity(const std::string& filename);
+            /**
+             * @brief hasUpToDateResults Whether results of the pipeline exist for the WSI, and were created with
+             * the same pipeline file, models, WSI, patch mask and batch size as now.
+             */
+            bool hasUpToDateResults(const std::string& wsi_uid, const std::string& pipelineFilename, int batchSize = -1);
 
             /**
-             * @brief includeImage Include image to the current project.
+             * @brief includeImage Include image to the current project. The WSI is not opened here, the
+             * thumbnail cache is filled in the background by the ProjectWidget ingest workers when the WSI is shown.
              * @param image_filepath Disk location of the WSI to include.
-             * @return
+             * @return Unique identifier for the WSI, the file name without extension, followed by #2, #3, ..
+             * if it is in use.
              */
             const std::string includeImage(const std::string& image_filepath);
             /**
-             * @brief includeImageFromProject Reload a WSI from a previously saved project.
+             * @brief includeImageFromProject Reload a WSI from a previously saved project. Neither the WSI nor its
+             * cached thumbnail are read here, the WSI is only imported when first needed.
              * @param uid_name Unique identifier for the WSI.
              * @param image_filepath Disk location of the WSI.
              */
@@ -59,8 +163,36 @@ namespace fast{
              * @param uid Unique identifier for the WSI to remove.
              */
             void removeImage(const std::string& uid);
+            /**
+             * @brief getThumbnailPath Location of the cached thumbnail of a WSI.
+             * @param uid Unique identifier for the WSI.
+             */
+            std::string getThumbnailPath(const std::string& uid) const;
+            /**
+             * @brief updateSlideMetadata Store size, levels, magnification and thumbnail of a WSI in the manifest.
+             * Does nothing if the WSI has not been imported yet, or is no longer in the project.
+             * @param uid Unique identifier for the WSI.
+             */
+            void updateSlideMetadata(const std::string& uid);
+            /**
+             * @brief getSlideRecord Metadata of a WSI, as stored in the manifest.
+             * @param uid Unique identifier for the WSI.
+             */
+            SlideRecord getSlideRecord(const std::string& uid);
 
-            void writeTimestmap();
+            /**
+             * @brief getProjectSetting Setting of this project only, stored in project.ini in the project folder.
+             * Application wide settings are read with getSetting.
+             */
+            QVariant getProjectSetting(const QString& key, const QVariant& defaultValue = QVariant()) const;
+            void setProjectSetting(const QString& key, const QVariant& value);
+
+            /**
+             * @brief writeTimestmap Mark the project as modified, in timestamp.txt and the project index shown by the
+             * splash screen, see ProjectIndex.
+             * @param bytesAdded Change of the size of the project folder since the last call, if known.
+             */
+            void writeTimestmap(std::int64_t bytesAdded = 0);
        protected:
             /**
              * @brief createFolderDirectoryArchitecture Prepare the folder structure with sub-folders
@@ -76,9 +208,31 @@ namespace fast{
              * @param wsi_uid unique id of the WSI whose thumbnail should be saved.
              */
             void saveThumbnail(const std::string& wsi_uid);
+            /**
+             * @brief writeResults Export a queued job. Runs in the export thread.
+             */
+            void writeResults(const ResultExportJob& job);
+            void exportThread();
+            /**
+             * @brief hashFile Hash of the contents of a file. Cached as long as size and modification time are unchanged.
+             */
+            std::string hashFile(const std::string& filename);
        private:
             std::string m_name;
             std::string _root_folder;  /* Location on disk where to save all data for the current project. */
             std::map<std::string, std::shared_ptr<WholeSlideImage>> _images; /* Loaded image objects. */
+            std::unique_ptr<ProjectManifest> m_manifest; /* WSIs of the project, stored in manifest.bin */
+
+            std::mutex m_timestampMutex;
+            std::mutex m_exportMutex;
+            std::condition_variable m_exportCondition;
+            std::deque<ResultExportJob> m_exportQueue;
+            int m_exportMaxPending;
+            bool m_exportBusy = false;
+            bool m_exportStop = false;
+            std::thread m_exportThread;
+
+            std::mutex m_hashMutex;
+            std::map<std::string, std::pair<std::string, std::string>> m_fileHashes; /* path -> (size and modification time, hash) */
     };
 } // End of namespace fast
@@ -0,0 +1,162 @@
+#include "ProjectIndex.h"
+#include "ProjectManifest.h"
+#include "source/utils/utilities.h"
+#include <FAST/Exception.hpp>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QLockFile>
+#include <QSaveFile>
+#include <algorithm>
+#include <fstream>
+#include <set>
+
+namespace fast{
+    // One line per project: name, modified, slides, bytes and thumbnail, separated by tabs
+    static const std::string INDEX_HEADER = "FastPathology project index 1";
+
+    std::int64_t ProjectIndex::getFolderSize(const std::string& folder) {
+        std::int64_t size = 0;
+        QDirIterator it(QString::fromStdString(folder), QDir::Files, QDirIterator::Subdirectories);
+        while(it.hasNext()) {
+            it.next();
+            size += it.fileInfo().size();
+        }
+        return size;
+    }
+
+    ProjectIndex::ProjectIndex(const std::string& projectsFolder) {
+        m_folder = projectsFolder;
+        m_filename = join(projectsFolder, "projects.index");
+        m_lockFilename = join(projectsFolder, "projects.index.lock");
+    }
+
+    std::map<std::string, ProjectRecord> ProjectIndex::read() {
+        std::map<std::string, ProjectRecord> projects;
+        std::ifstream file(m_filename);
+        std::string line;
+        if(!std::getline(file, line) || line != INDEX_HEADER)
+            return projects; // Missing or unknown version, rebuilt by scanning
+        while(std::getline(file, line)) {
+            auto tokens = split(line, "\t");
+            if(tokens.size() < 4)
+                continue;
+            ProjectRecord record;
+            try {
+                record.name = tokens[0];
+                record.modified = std::stoll(tokens[1]);
+                record.slides = std::stoi(tokens[2]);
+                record.bytes = std::stoll(tokens[3]);
+                record.thumbnail = tokens.size() > 4 ? tokens[4] : "";
+            } catch(std::exception &e) {
+                continue;
+            }
+            projects[record.name] = record;
+        }
+        return projects;
+    }
+
+    void ProjectIndex::write(const std::map<std::string, ProjectRecord>& projects) {
+        std::string data = INDEX_HEADER + "\n";
+        for(auto& project : projects) {
+            const auto& record = project.second;
+            data += record.name + "\t" + std::to_string(record.modified) + "\t" + std::to_string(record.slides) + "\t" +
+                    std::to_string(record.bytes) + "\t" + record.thumbnail + "\n";
+        }
+        QSaveFile file(QString::fromStdString(m_filename));
+        if(!file.open(QIODevice::WriteOnly))
+            throw Exception("Unable to write project index " + m_filename);
+        file.write(data.c_str(), data.size());
+        if(!file.commit())
+            throw Exception("Unable to write project index " + m_filename);
+    }
+
+    ProjectRecord ProjectIndex::scan(const std::string& name) {
+        const std::string projectFolder = join(m_folder, name);
+        ProjectRecord record;
+        record.name = name;
+        QFileInfo timestamp(QString::fromStdString(join(projectFolder, "timestamp.txt")));
+        record.modified = (timestamp.exists() ? timestamp.lastModified() : QFileInfo(QString::fromStdString(projectFolder)).lastModified()).toMSecsSinceEpoch();
+        record.bytes = getFolderSize(projectFolder);
+        try {
+            ProjectManifest manifest(projectFolder);
+            auto slides = manifest.getSlides();
+            record.slides = slides.size();
+            for(auto& slide : slides) {
+                if(!slide.second.thumbnail.empty()) {
+                    record.thumbnail = slide.second.thumbnail;
+                    break;
+                }
+            }
+        } catch(Exception &e) {
+            std::cout << "Unable to read the manifest of project " << name << ": " << e.what() << std::endl;
+        }
+        return record;
+    }
+
+    std::vector<ProjectRecord> ProjectIndex::getProjects() {
+        // Listing the folder is a single directory read, which is needed anyway to find new and deleted projects
+        std::set<std::string> folders;
+        for(auto& folder : getDirectoryList(m_folder, false, true))
+            folders.insert(folder);
+        auto projects = read();
+        bool changed = false;
+        for(auto it = projects.begin(); it != projects.end();) {
+            if(folders.count(it->first) == 0) {
+                it = projects.erase(it);
+                changed = true;
+            } else {
+                ++it;
+            }
+        }
+        for(auto& folder : folders) {
+            if(projects.count(folder) == 0) {
+                projects[folder] = scan(folder);
+                changed = true;
+            }
+        }
+        if(changed) {
+            QLockFile lock(QString::fromStdString(m_lockFilename));
+            if(lock.lock()) {
+                // Keep entries other processes have updated since we read the index
+                for(auto& project : read()) {
+                    if(folders.count(project.first) > 0)
+                        projects[project.first] = project.second;
+                }
+                try {
+                    write(projects);
+                } catch(Exception &e) {
+                    std::cout << e.what() << std::endl;
+                }
+            }
+        }
+
+        std::vector<ProjectRecord> records;
+        for(auto& project : projects)
+            records.push_back(project.second);
+        std::sort(records.begin(), records.end(), [](const ProjectRecord& a, const ProjectRecord& b) {
+            return a.modified > b.modified;
+        });
+        return records;
+    }
+
+    void ProjectIndex::updateProject(const std::string& name, std::function<void(ProjectRecord&)> update) {
+        QLockFile lock(QString::fromStdString(m_lockFilename));
+        if(!lock.lock())
+            throw Exception("Unable to lock project index " + m_filename);
+        auto projects = read();
+        if(projects.count(name) == 0)
+            projects[name] = scan(name);
+        update(projects[name]);
+        projects[name].name = name;
+        write(projects);
+    }
+
+    void ProjectIndex::removeProject(const std::string& name) {
+        QLockFile lock(QString::fromStdString(m_lockFilename));
+        if(!lock.lock())
+            throw Exception("Unable to lock project index " + m_filename);
+        auto projects = read();
+        if(projects.erase(name) > 0)
+            write(projects);
+    }
+} // End of namespace fast
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <cstdint>
+
+namespace fast{
+    /**
+     * Summary of one project, as shown on the splash screen.
+     */
+    class ProjectRecord {
+        public:
+            std::string name; /* Name of the project folder */
+            std::int64_t modified = 0; /* Last modification, ms since epoch */
+            int slides = 0;
+            std::int64_t bytes = 0; /* Size of the project folder, excluding the WSIs themselves */
+            std::string thumbnail; /* Thumbnail of a WSI of the project, relative to the project folder. Empty if none */
+    };
+
+    /**
+     * Index of all projects (projects.index in the projects folder), so that the splash screen lists projects with a
+     * single file read instead of opening every project folder.
+     *
+     * Projects update their entry when modified, see Project::writeTimestmap. Project folders without an entry, e.g.
+     * from older versions or copied in, are scanned once and added; entries of deleted folders are removed. Updates
+     * are done while holding a lock file, and replace the file atomically, as several processes may use the index.
+     */
+    class ProjectIndex {
+        public:
+            /**
+             * @param projectsFolder Folder containing all project folders.
+             */
+            explicit ProjectIndex(const std::string& projectsFolder);
+            /**
+             * @brief getProjects All projects, newest first. Synchronizes the index with the project folders.
+             */
+            std::vector<ProjectRecord> getProjects();
+            /**
+             * @brief updateProject Modify the entry of a project atomically. A missing entry is created by scanning
+             * the project folder first.
+             * @param name Name of the project.
+             * @param update Called with the current record, which is then saved.
+             */
+            void updateProject(const std::string& name, std::function<void(ProjectRecord&)> update);
+            void removeProject(const std::string& name);
+            /**
+             * @brief getFolderSize Total size of the files in a folder and its subfolders, in bytes.
+             */
+            static std::int64_t getFolderSize(const std::string& folder);
+        protected:
+            std::map<std::string, ProjectRecord> read();
+            void write(const std::map<std::string, ProjectRecord>& projects);
+            /**
+             * Create the record of a project from its folder: manifest, timestamp.txt modification time and size.
+             */
+            ProjectRecord scan(const std::string& name);
+        private:
+            std::string m_folder;
+            std::string m_filename;
+            std::string m_lockFilename;
+    };
+} // End of namespace fast
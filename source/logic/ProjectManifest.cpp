@@ -0,0 +1,329 @@
+#include "ProjectManifest.h"
+#include <FAST/Exception.hpp>
+#include <FAST/Utility.hpp>
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QLockFile>
+#include <QMap>
+#include <QSaveFile>
+#include <QStringList>
+#include <fstream>
+#ifdef WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace fast{
+    // File layout: header (magic, version, generation) followed by entries (payload length, checksum, payload).
+    // Version 1 used the CRC-16 of qChecksum, version 2 uses CRC-32.
+    static const quint32 MANIFEST_MAGIC = 0x46504D46; // FPMF
+    static const quint32 MANIFEST_VERSION = 2;
+    static const qint64 HEADER_SIZE = 16;
+    static const qint64 ENTRY_HEADER_SIZE = 8;
+    static const quint8 ENTRY_PUT = 1;
+    static const quint8 ENTRY_REMOVE = 2;
+
+    static quint32 crc32(const QByteArray& data) {
+        static const std::vector<quint32> table = [] {
+            std::vector<quint32> table(256);
+            for(quint32 i = 0; i < 256; ++i) {
+                quint32 value = i;
+                for(int bit = 0; bit < 8; ++bit)
+                    value = (value & 1) ? 0xEDB88320 ^ (value >> 1) : value >> 1;
+                table[i] = value;
+            }
+            return table;
+        }();
+        quint32 crc = 0xFFFFFFFF;
+        for(const char byte : data)
+            crc = table[(crc ^ (quint8)byte) & 0xFF] ^ (crc >> 8);
+        return crc ^ 0xFFFFFFFF;
+    }
+
+    static quint32 checksum(const QByteArray& data, quint32 version) {
+        if(version == 1)
+            return qChecksum(data.constData(), data.size());
+        return crc32(data);
+    }
+
+    static QByteArray createHeader(quint64 generation) {
+        QByteArray header;
+        QDataStream stream(&header, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_5_0);
+        stream << MANIFEST_MAGIC << MANIFEST_VERSION << generation;
+        return header;
+    }
+
+    static quint64 createGeneration() {
+        return (quint64)QDateTime::currentMSecsSinceEpoch()*1000 + QCoreApplication::applicationPid() % 1000;
+    }
+
+    static QByteArray createEntry(bool remove, const SlideRecord& record, quint32 version = MANIFEST_VERSION) {
+        QByteArray payload;
+        {
+            QDataStream stream(&payload, QIODevice::WriteOnly);
+            stream.setVersion(QDataStream::Qt_5_0);
+            stream << (remove ? ENTRY_REMOVE : ENTRY_PUT) << QString::fromStdString(record.uid);
+            if(!remove) {
+                QStringList results;
+                for(auto& result : record.results)
+                    results << QString::fromStdString(result);
+                QMap<QString, QString> attributes;
+                for(auto& attribute : record.rendererAttributes)
+                    attributes[QString::fromStdString(attribute.first)] = QString::fromStdString(attribute.second);
+                stream << QString::fromStdString(record.filename) << (qint32)record.width << (qint32)record.height
+                       << (qint32)record.levels << record.magnification << QString::fromStdString(record.thumbnail)
+                       << results << attributes;
+            }
+        }
+        QByteArray entry;
+        QDataStream stream(&entry, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_5_0);
+        stream << (quint32)payload.size() << checksum(payload, version);
+        entry.append(payload);
+        return entry;
+    }
+
+    ProjectManifest::ProjectManifest(const std::string& projectFolder) {
+        m_filename = join(projectFolder, "manifest.bin");
+        m_lockFilename = join(projectFolder, "manifest.lock");
+        if(!fileExists(m_filename)) {
+            QLockFile lock(QString::fromStdString(m_lockFilename));
+            if(!lock.lock())
+                throw Exception("Unable to lock project manifest " + m_filename);
+            if(!fileExists(m_filename)) // May have been created by another process while waiting for the lock
+                migrate(join(projectFolder, "project.txt"));
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        refresh();
+        if(m_version < MANIFEST_VERSION) {
+            // Rewrite the manifest of an older version with the current checksums
+            QLockFile fileLock(QString::fromStdString(m_lockFilename));
+            if(fileLock.lock()) {
+                refresh();
+                compact();
+            }
+        }
+    }
+
+    void ProjectManifest::migrate(const std::string& projectTxtFilename) {
+        // project.txt of older versions contains pairs of lines with uid and filename. It is left as is.
+        QByteArray data = createHeader(createGeneration());
+        std::ifstream file(projectTxtFilename);
+        std::vector<std::string> lines;
+        std::string line;
+        while(std::getline(file, line))
+            lines.push_back(line);
+        for(int i = 0; i + 1 < lines.size(); i += 2) {
+            SlideRecord record;
+            record.uid = lines[i];
+            record.filename = lines[i + 1];
+            data.append(createEntry(false, record));
+        }
+        QSaveFile manifest(QString::fromStdString(m_filename));
+        if(!manifest.open(QIODevice::WriteOnly))
+            throw Exception("Unable to create project manifest " + m_filename);
+        manifest.write(data);
+        if(!manifest.commit())
+            throw Exception("Unable to create project manifest " + m_filename);
+    }
+
+    void ProjectManifest::refresh() {
+        const QFileInfo info(QString::fromStdString(m_filename));
+        const long long fileSize = info.size();
+        const long long fileModified = info.lastModified().toMSecsSinceEpoch();
+        if(fileSize == m_fileSize && fileModified == m_fileModified && fileSize == m_offset)
+            return;
+        m_fileSize = fileSize;
+        m_fileModified = fileModified;
+        QFile file(QString::fromStdString(m_filename));
+        if(!file.open(QIODevice::ReadOnly))
+            throw Exception("Unable to read project manifest " + m_filename);
+        QByteArray header = file.read(HEADER_SIZE);
+        QDataStream headerStream(header);
+        headerStream.setVersion(QDataStream::Qt_5_0);
+        quint32 magic = 0, version = 0;
+        quint64 generation = 0;
+        headerStream >> magic >> version >> generation;
+        if(headerStream.status() != QDataStream::Ok || magic != MANIFEST_MAGIC || version < 1 || version > MANIFEST_VERSION)
+            throw Exception("Invalid project manifest " + m_filename);
+        if(generation != m_generation || version != m_version || file.size() < m_offset) {
+            // Compacted by another process, read everything again
+            m_slides.clear();
+            m_entries = 0;
+            m_generation = generation;
+            m_version = version;
+            m_offset = HEADER_SIZE;
+        }
+
+        file.seek(m_offset);
+        while(file.size() - m_offset >= ENTRY_HEADER_SIZE) {
+            QDataStream entryHeader(file.read(ENTRY_HEADER_SIZE));
+            entryHeader.setVersion(QDataStream::Qt_5_0);
+            quint32 length, entryChecksum;
+            entryHeader >> length >> entryChecksum;
+            if(file.size() - m_offset - ENTRY_HEADER_SIZE < length)
+                break; // Still being written, or partially written
+            QByteArray payload = file.read(length);
+            if(checksum(payload, m_version) != entryChecksum)
+                break;
+
+            QDataStream stream(payload);
+            stream.setVersion(QDataStream::Qt_5_0);
+            quint8 type;
+            QString uid;
+            stream >> type >> uid;
+            if(type == ENTRY_PUT) {
+                SlideRecord record;
+                record.uid = uid.toStdString();
+                QString filename, thumbnail;
+                qint32 width, height, levels;
+                QStringList results;
+                stream >> filename >> width >> height >> levels >> record.magnification >> thumbnail >> results;
+                record.filename = filename.toStdString();
+                record.width = width;
+                record.height = height;
+                record.levels = levels;
+                record.thumbnail = thumbnail.toStdString();
+                for(auto& result : results)
+                    record.results.push_back(result.toStdString());
+                if(!stream.atEnd()) { // Entries written before renderer attributes were stored have none
+                    QMap<QString, QString> attributes;
+                    stream >> attributes;
+                    for(auto attribute = attributes.begin(); attribute != attributes.end(); ++attribute)
+                        record.rendererAttributes[attribute.key().toStdString()] = attribute.value().toStdString();
+                }
+                m_slides[record.uid] = record;
+            } else {
+                m_slides.erase(uid.toStdString());
+            }
+            m_offset += ENTRY_HEADER_SIZE + length;
+            ++m_entries;
+        }
+    }
+
+    void ProjectManifest::append(bool remove, const SlideRecord& record) {
+        QFile file(QString::fromStdString(m_filename));
+        if(!file.open(QIODevice::ReadWrite))
+            throw Exception("Unable to write project manifest " + m_filename);
+        if(file.size() > m_offset) // Remove a partially written entry
+            file.resize(m_offset);
+        // Until the file is compacted, entries use the checksum of the version it was written with
+        const QByteArray entry = createEntry(remove, record, m_version);
+        file.seek(m_offset);
+        if(file.write(entry) != entry.size() || !file.flush())
+            throw Exception("Unable to write project manifest " + m_filename);
+        // Make the entry durable before the update is reported as done
+#ifdef WIN32
+        _commit(file.handle());
+#else
+        fsync(file.handle());
+#endif
+        file.close();
+        m_offset += entry.size();
+        ++m_entries;
+        if(remove) {
+            m_slides.erase(record.uid);
+        } else {
+            m_slides[record.uid] = record;
+        }
+        if(m_entries > 2*(int)m_slides.size() + 64)
+            compact();
+    }
+
+    void ProjectManifest::compact() {
+        const quint64 generation = createGeneration();
+        QByteArray data = createHeader(generation);
+        for(auto& slide : m_slides)
+            data.append(createEntry(false, slide.second));
+        QSaveFile file(QString::fromStdString(m_filename));
+        if(!file.open(QIODevice::WriteOnly))
+            return; // The log is still valid, try again on the next update
+        file.write(data);
+        if(!file.commit())
+            return;
+        m_generation = generation;
+        m_version = MANIFEST_VERSION;
+        m_offset = data.size();
+        m_entries = m_slides.size();
+    }
+
+    std::map<std::string, SlideRecord> ProjectManifest::getSlides() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        refresh();
+        return m_slides;
+    }
+
+    bool ProjectManifest::getSlide(const std::string& uid, SlideRecord& record) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        refresh();
+        auto slide = m_slides.find(uid);
+        if(slide == m_slides.end())
+            return false;
+        record = slide->second;
+        return true;
+    }
+
+    int ProjectManifest::getNrOfSlides() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        refresh();
+        return m_slides.size();
+    }
+
+    std::string ProjectManifest::getThumbnail() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        refresh();
+        for(auto& slide : m_slides) {
+            if(!slide.second.thumbnail.empty())
+                return slide.second.thumbnail;
+        }
+        return "";
+    }
+
+    std::string ProjectManifest::addSlide(const std::string& name, const std::string& filename) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        QLockFile fileLock(QString::fromStdString(m_lockFilename));
+        if(!fileLock.lock())
+            throw Exception("Unable to lock project manifest " + m_filename);
+        refresh();
+        std::string uid = name;
+        for(int i = 2; m_slides.count(uid) > 0; ++i)
+            uid = name + "#" + std::to_string(i);
+        SlideRecord record;
+        record.uid = uid;
+        record.filename = filename;
+        append(false, record);
+        return uid;
+    }
+
+    void ProjectManifest::updateSlide(const std::string& uid, std::function<void(SlideRecord&)> update) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        QLockFile fileLock(QString::fromStdString(m_lockFilename));
+        if(!fileLock.lock())
+            throw Exception("Unable to lock project manifest " + m_filename);
+        refresh();
+        auto slide = m_slides.find(uid);
+        if(slide == m_slides.end())
+            return;
+        SlideRecord record = slide->second;
+        update(record);
+        record.uid = uid;
+        append(false, record);
+    }
+
+    void ProjectManifest::removeSlide(const std::string& uid) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        QLockFile fileLock(QString::fromStdString(m_lockFilename));
+        if(!fileLock.lock())
+            throw Exception("Unable to lock project manifest " + m_filename);
+        refresh();
+        auto slide = m_slides.find(uid);
+        if(slide == m_slides.end())
+            return;
+        append(true, slide->second);
+    }
+} // End of namespace fast
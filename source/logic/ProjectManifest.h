@@ -0,0 +1,106 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <functional>
+
+namespace fast{
+    /**
+     * Metadata of one WSI in a project.
+     */
+    class SlideRecord {
+        public:
+            std::string uid;
+            std::string filename; /* Disk location of the WSI */
+            int width = 0; /* Size of the highest resolution level, 0 if not known yet */
+            int height = 0;
+            int levels = 0;
+            float magnification = 0.0f; /* Objective magnification from the WSI metadata, 0 if not known */
+            std::string thumbnail; /* Cached thumbnail, relative to the project folder. Empty if not created yet */
+            std::vector<std::string> results; /* Names of the pipelines which have results for this WSI */
+            std::map<std::string, std::string> rendererAttributes; /* "<pipeline>/<data name>" -> attributes edited in the view, replacing renderer.attributes.txt */
+    };
+
+    /**
+     * Binary manifest of the WSIs in a project (manifest.bin), replacing project.txt.
+     *
+     * The file is a log of CRC-32 checksummed put/remove entries, thus an update only appends one entry, which is
+     * synced to disk, and an entry which was only partially written (e.g. by a crash) is ignored. The slides are kept in a map, giving O(log n)
+     * lookup, add and remove. The log is compacted, with an atomic rename, when it has grown to more than twice the
+     * number of slides.
+     *
+     * Several processes (e.g. the GUI and fastpathology-cli) may use the same project. Updates are done while holding
+     * a lock file, and new entries written by other processes are read before each update.
+     */
+    class ProjectManifest {
+        public:
+            /**
+             * @brief ProjectManifest Open the manifest of a project. A project.txt of older versions is migrated.
+             * @param projectFolder Project folder, which must exist.
+             */
+            ProjectManifest(const std::string& projectFolder);
+            /**
+             * @brief getSlides All slides in the project, including slides added by other processes.
+             */
+            std::map<std::string, SlideRecord> getSlides();
+            /**
+             * @brief getSlide Record of one slide, without copying the others.
+             * @return false if the WSI is not in the project.
+             */
+            bool getSlide(const std::string& uid, SlideRecord& record);
+            /**
+             * @brief getNrOfSlides Nr of slides in the project.
+             */
+            int getNrOfSlides();
+            /**
+             * @brief getThumbnail Cached thumbnail of the first slide which has one, relative to the project folder.
+             * Empty if no slide has a thumbnail.
+             */
+            std::string getThumbnail();
+            /**
+             * @brief addSlide Add a WSI to the project.
+             * @param name Preferred uid. If it is in use, the first free of name#2, name#3, ... is used.
+             * @param filename Disk location of the WSI.
+             * @return The uid of the WSI.
+             */
+            std::string addSlide(const std::string& name, const std::string& filename);
+            /**
+             * @brief updateSlide Modify the record of a WSI atomically. Does nothing if the WSI is not in the project.
+             * @param uid Unique identifier for the WSI.
+             * @param update Called with the current record, which is then saved.
+             */
+            void updateSlide(const std::string& uid, std::function<void(SlideRecord&)> update);
+            /**
+             * @brief removeSlide Remove a WSI from the project.
+             */
+            void removeSlide(const std::string& uid);
+        protected:
+            /**
+             * Read entries added since the last read, or the entire file if it was compacted. Does not open the file if
+             * its size and modification time are unchanged since the last read. Assumes m_mutex is locked.
+             */
+            void refresh();
+            /**
+             * Append an entry. Assumes m_mutex and the lock file are locked.
+             */
+            void append(bool remove, const SlideRecord& record);
+            /**
+             * Rewrite the file with only the current slides. Assumes m_mutex and the lock file are locked.
+             */
+            void compact();
+            void migrate(const std::string& projectTxtFilename);
+        private:
+            std::string m_filename;
+            std::string m_lockFilename;
+            std::mutex m_mutex;
+            std::map<std::string, SlideRecord> m_slides;
+            unsigned long long m_generation = 0; /* Changed on each compaction */
+            unsigned int m_version = 0; /* File format version, from the header */
+            long long m_offset = 0; /* End of the last valid entry read */
+            int m_entries = 0; /* Nr of entries in the file */
+            long long m_fileSize = -1; /* Size and modification time of the file at the last read */
+            long long m_fileModified = 0;
+    };
+} // End of namespace fast
@@ -0,0 +1,134 @@
+#include "RegionOfInterest.h"
+#include "PipelineGraph.h"
+#include "TilePrefetcher.h"
+#include <FAST/Pipeline.hpp>
+#include <FAST/Data/Image.hpp>
+#include <FAST/Data/ImagePyramid.hpp>
+#include <FAST/Algorithms/ImagePatch/PatchGenerator.hpp>
+#include <FAST/Algorithms/TissueSegmentation/TissueSegmentation.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace fast{
+    RegionOfInterest::RegionOfInterest(std::vector<std::pair<float, float>> polygon) : m_polygon(polygon) {
+    }
+
+    RegionOfInterest RegionOfInterest::fromViewport(const Viewport& viewport) {
+        const float x0 = std::max(0.0f, viewport.x);
+        const float y0 = std::max(0.0f, viewport.y);
+        const float x1 = std::min(1.0f, viewport.x + viewport.width);
+        const float y1 = std::min(1.0f, viewport.y + viewport.height);
+        if(x1 <= x0 || y1 <= y0)
+            return RegionOfInterest();
+        return RegionOfInterest({{x0, y0}, {x1, y0}, {x1, y1}, {x0, y1}});
+    }
+
+    bool RegionOfInterest::contains(float x, float y) const {
+        // Even-odd rule
+        bool inside = false;
+        for(int i = 0, j = (int)m_polygon.size() - 1; i < m_polygon.size(); j = i++) {
+            const auto& a = m_polygon[i];
+            const auto& b = m_polygon[j];
+            if((a.second > y) != (b.second > y) &&
+                    x < (b.first - a.first)*(y - a.second)/(b.second - a.second) + a.first)
+                inside = !inside;
+        }
+        return inside;
+    }
+
+    std::string RegionOfInterest::toString() const {
+        if(isEmpty())
+            return "";
+        std::string text;
+        for(const auto& point : m_polygon)
+            text += std::to_string(point.first) + "," + std::to_string(point.second) + " ";
+        return text;
+    }
+
+    std::shared_ptr<Image> RegionOfInterest::createMask(std::shared_ptr<ImagePyramid> WSI, std::shared_ptr<Image> tissueMask) const {
+        if(isEmpty())
+            throw Exception("The region of interest is empty");
+        const int fullWidth = WSI->getFullWidth();
+        const int fullHeight = WSI->getFullHeight();
+        int width, height;
+        if(tissueMask) {
+            width = tissueMask->getWidth();
+            height = tissueMask->getHeight();
+        } else {
+            // One mask pixel per 64x64 WSI pixels is finer than any patch size used
+            width = std::max(1, std::min(4096, fullWidth/64));
+            height = std::max(1, (int)std::round((float)fullHeight*width/fullWidth));
+        }
+
+        float minX = 1, minY = 1, maxX = 0, maxY = 0;
+        for(const auto& point : m_polygon) {
+            minX = std::min(minX, point.first);
+            minY = std::min(minY, point.second);
+            maxX = std::max(maxX, point.first);
+            maxY = std::max(maxY, point.second);
+        }
+        const int startX = std::max(0, (int)std::floor(minX*width));
+        const int startY = std::max(0, (int)std::floor(minY*height));
+        const int endX = std::min(width, (int)std::ceil(maxX*width));
+        const int endY = std::min(height, (int)std::ceil(maxY*height));
+
+        std::vector<uchar> mask(width*height, 0);
+        const uchar* tissue = nullptr;
+        ImageAccess::pointer tissueAccess;
+        if(tissueMask) {
+            tissueAccess = tissueMask->getImageAccess(ACCESS_READ);
+            tissue = (const uchar*)tissueAccess->get();
+        }
+        int64_t set = 0;
+        for(int y = startY; y < endY; ++y) {
+            for(int x = startX; x < endX; ++x) {
+                if(tissue && tissue[x + y*width] == 0)
+                    continue;
+                if(!contains((x + 0.5f)/width, (y + 0.5f)/height))
+                    continue;
+                mask[x + y*width] = 1;
+                ++set;
+            }
+        }
+        if(set == 0)
+            throw Exception("The region of interest contains no tissue");
+
+        auto image = Image::create(width, height, TYPE_UINT8, 1, mask.data());
+        const Vector3f spacing = WSI->getSpacing();
+        image->setSpacing(Vector3f(spacing.x()*fullWidth/width, spacing.y()*fullHeight/height, 1));
+        return image;
+    }
+
+    int RegionOfInterest::apply(std::shared_ptr<Pipeline> pipeline, std::shared_ptr<ImagePyramid> WSI, std::shared_ptr<Image> tissueMask) const {
+        auto processObjects = pipeline->getProcessObjects();
+        const PipelineGraph graph(pipeline->getFilename());
+        std::shared_ptr<Image> cachedMask; // Mask of tissueMask, the same for all generators
+        int restricted = 0;
+        for(auto& processObject : processObjects) {
+            auto generator = std::dynamic_pointer_cast<PatchGenerator>(processObject.second);
+            if(!generator)
+                continue;
+            const auto connection = graph.getSource(processObject.first, 1);
+            std::shared_ptr<TissueSegmentation> segmentation;
+            if(!connection.source.empty()) {
+                if(processObjects.count(connection.source) > 0)
+                    segmentation = std::dynamic_pointer_cast<TissueSegmentation>(processObjects[connection.source]);
+                if(!segmentation) {
+                    Reporter::warning() << "Patch generator " << processObject.first << " is masked by " << connection.source << ", it is not restricted to the region" << Reporter::end();
+                    continue;
+                }
+            }
+            if(tissueMask || !segmentation) {
+                if(!cachedMask)
+                    cachedMask = createMask(WSI, tissueMask);
+                generator->setInputData(1, cachedMask);
+            } else {
+                // The tissue segmentation is cheap compared to the patches it saves, run it here to combine its mask
+                auto tissue = segmentation->runAndGetOutputData<Image>(connection.outputPort);
+                generator->setInputData(1, createMask(WSI, tissue));
+            }
+            ++restricted;
+        }
+        return restricted;
+    }
+} // End of namespace fast
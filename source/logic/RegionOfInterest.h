@@ -0,0 +1,57 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace fast{
+    class Pipeline;
+    class Image;
+    class ImagePyramid;
+    class Viewport;
+
+    /**
+     * Region of a WSI to run a pipeline on, instead of the whole WSI, e.g. the region visible in the view or a
+     * region drawn by the user. The pipeline is restricted to the region by masking its patch generators, combined
+     * with the tissue mask of the WSI, thus patches outside of it are never created.
+     *
+     * Points are normalized to [0, 1] by the full size of the WSI, as the Viewport.
+     */
+    class RegionOfInterest {
+        public:
+            RegionOfInterest() = default;
+            /**
+             * @brief RegionOfInterest Polygon, closed from the last point to the first.
+             */
+            explicit RegionOfInterest(std::vector<std::pair<float, float>> polygon);
+            /**
+             * @brief fromViewport Rectangle of a viewport, clamped to the WSI.
+             */
+            static RegionOfInterest fromViewport(const Viewport& viewport);
+            bool isEmpty() const { return m_polygon.size() < 3; }
+            /**
+             * @brief contains Whether a normalized point is inside the polygon.
+             */
+            bool contains(float x, float y) const;
+            /**
+             * @brief toString Points of the polygon, "x,y" separated by spaces. Empty if the region is empty.
+             */
+            std::string toString() const;
+            /**
+             * @brief createMask Mask of the region, for the patch generators of a pipeline on a WSI.
+             * @param WSI
+             * @param tissueMask If not empty, the mask has its size and is only set where it is set as well.
+             * @return Mask with the spacing of one of its pixels on the WSI. Throws if no pixel is set.
+             */
+            std::shared_ptr<Image> createMask(std::shared_ptr<ImagePyramid> WSI, std::shared_ptr<Image> tissueMask = nullptr) const;
+            /**
+             * @brief apply Restrict each PatchGenerator of a parsed pipeline to the region. Generators masked by a
+             * TissueSegmentation of the pipeline get the region of that mask, or of tissueMask if given, see
+             * TissueMaskCache. Generators masked by anything else, e.g. an earlier model, are not restricted.
+             * @return Nr of restricted patch generators.
+             */
+            int apply(std::shared_ptr<Pipeline> pipeline, std::shared_ptr<ImagePyramid> WSI, std::shared_ptr<Image> tissueMask = nullptr) const;
+        private:
+            std::vector<std::pair<float, float>> m_polygon;
+    };
+} // End of namespace fast
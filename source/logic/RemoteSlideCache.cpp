@@ -0,0 +1,262 @@
+#include "RemoteSlideCache.h"
+#include "DownloadManager.h"
+#include "source/utils/utilities.h"
+#include <FAST/Exception.hpp>
+#include <FAST/Reporter.hpp>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSettings>
+#include <QUrl>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace fast{
+    RemoteSlideCache& RemoteSlideCache::getInstance() {
+        static RemoteSlideCache instance;
+        return instance;
+    }
+
+    RemoteSlideCache::RemoteSlideCache() {
+        m_cacheFolder = getSetting("remote/cache-folder", QDir::homePath() + "/fastpathology/remote-cache").toString().toStdString();
+        m_maxSize = getSetting("remote/cache-size-gb", 50).toLongLong()*1024*1024*1024;
+        m_blockSize = std::max(1LL, getSetting("remote/block-size-mb", 8).toLongLong())*1024*1024;
+        m_parallelRequests = std::max(1, getSetting("remote/parallel-requests", 4).toInt());
+        QDir().mkpath(QString::fromStdString(m_cacheFolder));
+    }
+
+    bool RemoteSlideCache::isRemote(const std::string& filename) {
+        for(auto scheme : {"s3://", "http://", "https://"}) {
+            if(filename.compare(0, std::strlen(scheme), scheme) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    std::string RemoteSlideCache::getURL(const std::string& uri) {
+        if(uri.compare(0, 5, "s3://") != 0)
+            return uri;
+        std::string endpoint = getSetting("remote/s3-endpoint", "https://s3.amazonaws.com").toString().toStdString();
+        if(!endpoint.empty() && endpoint.back() == '/')
+            endpoint.pop_back();
+        return endpoint + "/" + uri.substr(5);
+    }
+
+    std::string RemoteSlideCache::getFolder(const std::string& uri) const {
+        const QByteArray hash = QCryptographicHash::hash(QByteArray::fromStdString(uri), QCryptographicHash::Sha1).toHex();
+        return m_cacheFolder + "/" + hash.toStdString();
+    }
+
+    std::string RemoteSlideCache::getDataFilename(const std::string& uri) const {
+        // Keep the extension, as the slide format is detected from it
+        const QString suffix = QFileInfo(QUrl(QString::fromStdString(getURL(uri))).path()).suffix();
+        return getFolder(uri) + "/slide" + (suffix.isEmpty() ? "" : "." + suffix.toStdString());
+    }
+
+    RemoteSlideCache::Entry RemoteSlideCache::readEntry(const std::string& folder) const {
+        Entry entry;
+        const QString filename = QString::fromStdString(folder + "/entry.ini");
+        if(!QFile::exists(filename))
+            return entry;
+        QSettings settings(filename, QSettings::IniFormat);
+        entry.uri = settings.value("uri").toString().toStdString();
+        entry.size = settings.value("size", -1).toLongLong();
+        entry.etag = settings.value("etag").toString().toStdString();
+        entry.blockSize = settings.value("block-size", 0).toLongLong();
+        entry.lastUsed = settings.value("last-used", 0).toLongLong();
+        QFile blocks(QString::fromStdString(folder + "/blocks"));
+        if(blocks.open(QIODevice::ReadOnly))
+            entry.blocks = blocks.readAll().toStdString();
+        if(entry.blockSize > 0 && entry.size >= 0 && entry.blocks.size() != (entry.size + entry.blockSize - 1) / entry.blockSize)
+            entry.size = -1; // Inconsistent, fetch again
+        return entry;
+    }
+
+    void RemoteSlideCache::writeEntry(const std::string& folder, const Entry& entry) const {
+        // The block list is written after the blocks are flushed, thus a block marked present is always complete
+        QSaveFile blocks(QString::fromStdString(folder + "/blocks"));
+        if(!blocks.open(QIODevice::WriteOnly))
+            throw Exception("Unable to write to the remote slide cache " + folder);
+        blocks.write(QByteArray::fromStdString(entry.blocks));
+        blocks.commit();
+        QSettings settings(QString::fromStdString(folder + "/entry.ini"), QSettings::IniFormat);
+        settings.setValue("uri", QString::fromStdString(entry.uri));
+        settings.setValue("size", (qlonglong)entry.size);
+        settings.setValue("etag", QString::fromStdString(entry.etag));
+        settings.setValue("block-size", (qlonglong)entry.blockSize);
+        settings.setValue("last-used", (qlonglong)entry.lastUsed);
+        settings.sync();
+    }
+
+    RemoteSlideCache::Entry RemoteSlideCache::requestInfo(const std::string& url) const {
+        const auto info = DownloadManager::requestInfo(url);
+        if(!info.acceptsRanges)
+            throw Exception("The server of " + url + " does not support range requests");
+        Entry entry;
+        entry.size = info.size;
+        entry.etag = info.etag;
+        return entry;
+    }
+
+    std::shared_ptr<std::mutex> RemoteSlideCache::getMutex(const std::string& uri) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& mutex = m_slideMutexes[uri];
+        if(!mutex)
+            mutex = std::make_shared<std::mutex>();
+        return mutex;
+    }
+
+    std::string RemoteSlideCache::getIdentity(const std::string& uri) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if(m_identities.count(uri) > 0)
+                return m_identities[uri];
+        }
+        Entry entry;
+        try {
+            entry = requestInfo(getURL(uri));
+        } catch(Exception &e) {
+            entry = readEntry(getFolder(uri));
+            if(entry.size < 0)
+                throw;
+            Reporter::warning() << e.what() << ", using the cached version" << Reporter::end();
+        }
+        const std::string identity = uri + " " + std::to_string(entry.size) + " " + entry.etag;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_identities[uri] = identity;
+        return identity;
+    }
+
+    std::string RemoteSlideCache::getLocalFile(const std::string& uri, std::function<void(float)> progress) {
+        auto mutex = getMutex(uri);
+        std::lock_guard<std::mutex> lock(*mutex);
+        const std::string url = getURL(uri);
+        const std::string folder = getFolder(uri);
+        QDir().mkpath(QString::fromStdString(folder));
+        Entry entry = readEntry(folder);
+        try {
+            Entry remote = requestInfo(url);
+            if(remote.size != entry.size || remote.etag != entry.etag || entry.blockSize != m_blockSize) {
+                // New or changed on the server
+                QFile::remove(QString::fromStdString(getDataFilename(uri)));
+                entry = remote;
+                entry.uri = uri;
+                entry.blockSize = m_blockSize;
+                entry.blocks = std::string((entry.size + m_blockSize - 1) / m_blockSize, '0');
+            }
+        } catch(Exception &e) {
+            if(entry.size < 0 || entry.blocks.find('0') != std::string::npos)
+                throw;
+            Reporter::warning() << e.what() << ", using the cached version" << Reporter::end();
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_inUse[uri] += 1;
+        }
+        try {
+            if(entry.blocks.find('0') != std::string::npos)
+                download(url, folder, entry, progress);
+        } catch(Exception &e) {
+            release(uri);
+            throw;
+        }
+        entry.lastUsed = QDateTime::currentMSecsSinceEpoch();
+        writeEntry(folder, entry);
+        evict();
+        if(progress)
+            progress(1.0f);
+        return getDataFilename(uri);
+    }
+
+    std::shared_ptr<SlideLease> RemoteSlideCache::acquire(const std::string& filename, std::function<void(float)> progress) {
+        if(!isRemote(filename))
+            return std::make_shared<SlideLease>("", filename);
+        return std::make_shared<SlideLease>(filename, getLocalFile(filename, progress));
+    }
+
+    bool RemoteSlideCache::isCached(const std::string& uri) {
+        auto mutex = getMutex(uri);
+        std::lock_guard<std::mutex> lock(*mutex);
+        const Entry entry = readEntry(getFolder(uri));
+        return entry.size >= 0 && entry.blocks.find('0') == std::string::npos && QFile::exists(QString::fromStdString(getDataFilename(uri)));
+    }
+
+    SlideLease::SlideLease(const std::string& uri, const std::string& filename) : m_uri(uri), m_filename(filename) {
+    }
+
+    SlideLease::~SlideLease() {
+        if(!m_uri.empty())
+            RemoteSlideCache::getInstance().release(m_uri);
+    }
+
+    void RemoteSlideCache::release(const std::string& uri) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_inUse.find(uri);
+        if(it != m_inUse.end() && --it->second <= 0)
+            m_inUse.erase(it);
+    }
+
+    void RemoteSlideCache::download(const std::string& url, const std::string& folder, Entry& entry, std::function<void(float)> progress) {
+        QFile file(QString::fromStdString(getDataFilename(entry.uri)));
+        if(!file.open(QIODevice::ReadWrite))
+            throw Exception("Unable to write to the remote slide cache " + folder);
+        if(file.size() != entry.size)
+            file.resize(entry.size);
+
+        const int missing = std::count(entry.blocks.begin(), entry.blocks.end(), '0');
+        Reporter::info() << "Fetching " << missing << " of " << entry.blocks.size() << " blocks of " << url << Reporter::end();
+        DownloadManager::ProgressCallback callback;
+        if(progress) {
+            callback = [progress](std::int64_t current, std::int64_t total) {
+                progress((float)current / total);
+                return true;
+            };
+        }
+        const bool ranges = DownloadManager::fetchBlocks(url, file, entry.size, entry.blockSize, entry.blocks,
+                m_parallelRequests, callback, [&]() { writeEntry(folder, entry); });
+        file.close();
+        if(!ranges)
+            throw Exception("The server of " + url + " ignored the range request");
+    }
+
+    void RemoteSlideCache::evict() {
+        std::vector<std::pair<std::string, Entry>> entries;
+        std::int64_t size = 0;
+        for(auto& name : QDir(QString::fromStdString(m_cacheFolder)).entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+            const std::string folder = m_cacheFolder + "/" + name.toStdString();
+            Entry entry = readEntry(folder);
+            size += std::count(entry.blocks.begin(), entry.blocks.end(), '1')*entry.blockSize;
+            entries.push_back(std::make_pair(folder, entry));
+        }
+        if(size <= m_maxSize)
+            return;
+        std::sort(entries.begin(), entries.end(), [](const std::pair<std::string, Entry>& a, const std::pair<std::string, Entry>& b) {
+            return a.second.lastUsed < b.second.lastUsed;
+        });
+        for(auto& entry : entries) {
+            if(size <= m_maxSize)
+                break;
+            std::shared_ptr<std::mutex> mutex;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if(m_inUse.count(entry.second.uri) > 0)
+                    continue;
+                auto& slideMutex = m_slideMutexes[entry.second.uri];
+                if(!slideMutex)
+                    slideMutex = std::make_shared<std::mutex>();
+                mutex = slideMutex;
+            }
+            // Slides are only opened while holding their mutex, skip those being fetched by another thread
+            std::unique_lock<std::mutex> slideLock(*mutex, std::try_to_lock);
+            if(!slideLock.owns_lock())
+                continue;
+            Reporter::info() << "Removing " << entry.second.uri << " from the remote slide cache" << Reporter::end();
+            QDir(QString::fromStdString(entry.first)).removeRecursively();
+            size -= std::count(entry.second.blocks.begin(), entry.second.blocks.end(), '1')*entry.second.blockSize;
+        }
+    }
+} // End of namespace fast
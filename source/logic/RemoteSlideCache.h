@@ -0,0 +1,110 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <cstdint>
+
+namespace fast{
+    /**
+     * Local file of a WSI, which is kept in the remote slide cache while the lease exists. Leases of local WSIs are
+     * only their filename. Held while a pipeline or importer uses the file, see RemoteSlideCache::acquire.
+     */
+    class SlideLease {
+        public:
+            SlideLease(const std::string& uri, const std::string& filename);
+            ~SlideLease();
+            SlideLease(const SlideLease&) = delete;
+            SlideLease& operator=(const SlideLease&) = delete;
+            std::string getFilename() const { return m_filename; }
+        private:
+            std::string m_uri; /* Of a remote WSI, empty for local files */
+            std::string m_filename;
+    };
+
+    /**
+     * Local block cache of slides on object storage (s3://bucket/key) or web servers (http(s)://).
+     *
+     * The slide is fetched with parallel HTTP range requests of fixed size blocks into a file in the cache folder.
+     * Which blocks are present is stored next to it, thus an interrupted download continues where it stopped, and
+     * a slide is only fetched again if its size or ETag changes. When the cache grows beyond its size limit, the
+     * least recently used slides which are not open are removed.
+     *
+     * s3:// URIs are mapped to path style URLs of the remote/s3-endpoint setting, requests are not signed, thus
+     * private buckets need presigned https:// URLs.
+     */
+    class RemoteSlideCache {
+        public:
+            static RemoteSlideCache& getInstance();
+            /**
+             * @brief isRemote Whether a slide filename is an s3:// or http(s):// URI.
+             */
+            static bool isRemote(const std::string& filename);
+            /**
+             * @brief getURL The http(s) URL a slide URI is fetched from.
+             */
+            static std::string getURL(const std::string& uri);
+            /**
+             * @brief getLocalFile Fetch all missing blocks of a slide and return the local file. The slide stays
+             * in the cache until released. Blocks until the download finishes.
+             * @param uri s3:// or http(s):// URI of the slide.
+             * @param progress Called with the fraction of the slide present, from the downloading thread.
+             */
+            std::string getLocalFile(const std::string& uri, std::function<void(float)> progress = nullptr);
+            /**
+             * @brief acquire Fetch a slide as getLocalFile, and keep it in the cache until the lease is destroyed.
+             * @param filename Local file, for which a lease without caching is returned, or URI of a remote slide.
+             */
+            std::shared_ptr<SlideLease> acquire(const std::string& filename, std::function<void(float)> progress = nullptr);
+            /**
+             * @brief isCached Whether all blocks of a remote slide are in the cache, without contacting the server.
+             */
+            bool isCached(const std::string& uri);
+            /**
+             * @brief release Allow a slide to be removed from the cache, when it is no longer open.
+             */
+            void release(const std::string& uri);
+            /**
+             * @brief getIdentity URI, size and ETag of a remote slide, used in result keys as the size and
+             * modification time of local files is. The cached value is used if the server can not be reached.
+             */
+            std::string getIdentity(const std::string& uri);
+        private:
+            class Entry {
+                public:
+                    std::string uri;
+                    std::int64_t size = -1;
+                    std::string etag;
+                    std::int64_t blockSize = 0;
+                    std::string blocks; /* 1 if the block is present, else 0 */
+                    std::int64_t lastUsed = 0; /* ms since epoch */
+            };
+            RemoteSlideCache();
+            std::string getFolder(const std::string& uri) const;
+            Entry readEntry(const std::string& folder) const;
+            void writeEntry(const std::string& folder, const Entry& entry) const;
+            /**
+             * Size and ETag of a remote file, from a HEAD request. Throws if the server can not be reached.
+             */
+            Entry requestInfo(const std::string& url) const;
+            void download(const std::string& url, const std::string& folder, Entry& entry, std::function<void(float)> progress);
+            /**
+             * Remove least recently used slides until the cache is within its size limit.
+             */
+            void evict();
+            std::shared_ptr<std::mutex> getMutex(const std::string& uri);
+            std::string getDataFilename(const std::string& uri) const;
+
+            std::string m_cacheFolder;
+            std::int64_t m_maxSize;
+            std::int64_t m_blockSize;
+            int m_parallelRequests;
+            std::mutex m_mutex; /* Guards the maps below */
+            std::map<std::string, std::shared_ptr<std::mutex>> m_slideMutexes; /* One per URI, held while fetching */
+            std::map<std::string, int> m_inUse; /* Number of open handles per URI */
+            std::map<std::string, std::string> m_identities; /* Identity per URI, requested once per session */
+    };
+} // End of namespace fast
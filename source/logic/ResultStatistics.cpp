@@ -0,0 +1,387 @@
+#include "ResultStatistics.h"
+#include "TiledTensor.h"
+#include <FAST/Utility.hpp>
+#include <FAST/Data/ImagePyramid.hpp>
+#include <FAST/Data/Image.hpp>
+#include <FAST/Data/Tensor.hpp>
+#include <FAST/Data/Access/ImagePyramidAccess.hpp>
+#include <QFileInfo>
+#include <QDateTime>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include "source/logic/WholeSlideImage.h"
+#include "source/utils/utilities.h"
+
+namespace fast{
+    /**
+     * Connected regions of one segmentation tile, with the region ids along its borders so that regions crossing
+     * tile borders can be merged.
+     */
+    class TileRegions {
+        public:
+            std::vector<int64_t> pixels = std::vector<int64_t>(256, 0);
+            std::vector<uint8_t> regionLabel; /* Label of each region */
+            std::vector<int> top, bottom, left, right; /* Region id of each border pixel, -1 for background */
+    };
+
+    /**
+     * Label the regions of a tile, with 4-connectivity. Label 0 is background.
+     */
+    static void labelTile(const uint8_t* data, int width, int height, TileRegions& tile) {
+        std::vector<int> regions(width*height, -1);
+        std::vector<int> stack;
+        for(int i = 0; i < width*height; ++i) {
+            const uint8_t label = data[i];
+            tile.pixels[label] += 1;
+            if(label == 0 || regions[i] >= 0)
+                continue;
+            const int region = tile.regionLabel.size();
+            tile.regionLabel.push_back(label);
+            regions[i] = region;
+            stack.push_back(i);
+            while(!stack.empty()) {
+                const int j = stack.back();
+                stack.pop_back();
+                const int x = j % width;
+                const int y = j / width;
+                const int neighbours[4] = {x > 0 ? j - 1 : -1, x + 1 < width ? j + 1 : -1, y > 0 ? j - width : -1, y + 1 < height ? j + width : -1};
+                for(int k : neighbours) {
+                    if(k >= 0 && regions[k] < 0 && data[k] == label) {
+                        regions[k] = region;
+                        stack.push_back(k);
+                    }
+                }
+            }
+        }
+        tile.top.assign(regions.begin(), regions.begin() + width);
+        tile.bottom.assign(regions.end() - width, regions.end());
+        tile.left.resize(height);
+        tile.right.resize(height);
+        for(int y = 0; y < height; ++y) {
+            tile.left[y] = regions[y*width];
+            tile.right[y] = regions[y*width + width - 1];
+        }
+    }
+
+    static int64_t findRoot(std::vector<int64_t>& parents, int64_t i) {
+        while(parents[i] != i) {
+            parents[i] = parents[parents[i]];
+            i = parents[i];
+        }
+        return i;
+    }
+
+    /**
+     * Run function(i) for i in [0, count) on several threads. The first exception thrown is rethrown.
+     */
+    static void parallelFor(int count, int threads, std::function<void(int)> function) {
+        std::atomic<int> next(0);
+        std::exception_ptr error;
+        std::mutex errorMutex;
+        std::vector<std::thread> workers;
+        for(int t = 0; t < std::max(1, std::min(threads, count)); ++t) {
+            workers.emplace_back([&]() {
+                int i;
+                while((i = next++) < count) {
+                    try {
+                        function(i);
+                    } catch(...) {
+                        std::lock_guard<std::mutex> lock(errorMutex);
+                        if(!error)
+                            error = std::current_exception();
+                        next = count;
+                    }
+                }
+            });
+        }
+        for(auto& worker : workers)
+            worker.join();
+        if(error)
+            std::rethrow_exception(error);
+    }
+
+    static std::string getClassName(const Result& result, int label) {
+        if(label < result.classNames.size())
+            return result.classNames[label];
+        return "Class " + std::to_string(label);
+    }
+
+    ResultStatistics ResultStatistics::compute(const Result& result, std::shared_ptr<WholeSlideImage> image, int maxLevelSize, int threads) {
+        if(maxLevelSize <= 0)
+            maxLevelSize = getSetting("stats/max-level-size", 16384).toInt();
+        if(threads <= 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+
+        ResultStatistics statistics;
+        statistics.WSI_uid = result.WSI_uid;
+        statistics.pipelineName = result.pipelineName;
+        statistics.resultName = result.name;
+        const std::string key = getCacheKey(result, maxLevelSize);
+        const std::string cacheFilename = getCacheFilename(result);
+        if(statistics.read(cacheFilename, key))
+            return statistics;
+
+        const std::string extension = result.filename.substr(result.filename.rfind('.'));
+        statistics.heatmap = extension == ".hdf5" || extension == ".fpt";
+        if(statistics.heatmap) {
+            statistics.computeHeatmap(result, threads);
+        } else {
+            statistics.computeSegmentation(result, maxLevelSize, threads);
+        }
+        const double slideArea = getSlideArea(image);
+        if(slideArea > 0)
+            statistics.pixelArea = slideArea / ((double)statistics.width*statistics.height);
+        for(auto& classStatistics : statistics.classes)
+            classStatistics.area = statistics.pixelArea > 0 ? classStatistics.pixels*statistics.pixelArea : -1;
+        statistics.write(cacheFilename, key);
+        return statistics;
+    }
+
+    void ResultStatistics::computeSegmentation(const Result& result, int maxLevelSize, int threads) {
+        auto pyramid = std::dynamic_pointer_cast<ImagePyramid>(Project::importResult(result));
+        if(!pyramid)
+            throw Exception("Result " + result.filename + " is not a segmentation");
+        // Highest resolution level which fits, or the lowest resolution level
+        level = 0;
+        while(level + 1 < pyramid->getNrOfLevels() &&
+                (pyramid->getLevelWidth(level) > maxLevelSize || pyramid->getLevelHeight(level) > maxLevelSize))
+            ++level;
+        width = pyramid->getLevelWidth(level);
+        height = pyramid->getLevelHeight(level);
+        int tileWidth = pyramid->getLevelTileWidth(level);
+        int tileHeight = pyramid->getLevelTileHeight(level);
+        if(tileWidth <= 0 || tileHeight <= 0)
+            tileWidth = tileHeight = 256;
+        const int tilesX = (width + tileWidth - 1) / tileWidth;
+        const int tilesY = (height + tileHeight - 1) / tileHeight;
+
+        std::vector<TileRegions> tiles(tilesX*tilesY);
+        parallelFor(tiles.size(), threads, [&](int i) {
+            const int x = (i % tilesX)*tileWidth;
+            const int y = (i / tilesX)*tileHeight;
+            const int patchWidth = std::min(tileWidth, width - x);
+            const int patchHeight = std::min(tileHeight, height - y);
+            auto patch = pyramid->getAccess(ACCESS_READ)->getPatchAsImage(level, x, y, patchWidth, patchHeight);
+            if(patch->getDataType() != TYPE_UINT8 || patch->getNrOfChannels() != 1)
+                throw Exception("Expected a segmentation, with one 8 bit channel, in " + result.filename);
+            auto access = patch->getImageAccess(ACCESS_READ);
+            labelTile((const uint8_t*)access->get(), patchWidth, patchHeight, tiles[i]);
+        });
+
+        // Merge regions along tile borders
+        std::vector<int64_t> offsets(tiles.size() + 1, 0);
+        for(int i = 0; i < tiles.size(); ++i)
+            offsets[i + 1] = offsets[i] + tiles[i].regionLabel.size();
+        std::vector<int64_t> parents(offsets.back());
+        for(int64_t i = 0; i < parents.size(); ++i)
+            parents[i] = i;
+        auto merge = [&](int tileA, const std::vector<int>& borderA, int tileB, const std::vector<int>& borderB) {
+            for(int j = 0; j < borderA.size(); ++j) {
+                const int a = borderA[j];
+                const int b = borderB[j];
+                if(a < 0 || b < 0 || tiles[tileA].regionLabel[a] != tiles[tileB].regionLabel[b])
+                    continue;
+                const int64_t rootA = findRoot(parents, offsets[tileA] + a);
+                const int64_t rootB = findRoot(parents, offsets[tileB] + b);
+                if(rootA != rootB)
+                    parents[std::max(rootA, rootB)] = std::min(rootA, rootB);
+            }
+        };
+        for(int tileY = 0; tileY < tilesY; ++tileY) {
+            for(int tileX = 0; tileX < tilesX; ++tileX) {
+                const int i = tileX + tileY*tilesX;
+                if(tileX + 1 < tilesX)
+                    merge(i, tiles[i].right, i + 1, tiles[i + 1].left);
+                if(tileY + 1 < tilesY)
+                    merge(i, tiles[i].bottom, i + tilesX, tiles[i + tilesX].top);
+            }
+        }
+
+        std::vector<int64_t> pixels(256, 0);
+        std::vector<int64_t> regions(256, 0);
+        for(int i = 0; i < tiles.size(); ++i) {
+            for(int label = 0; label < 256; ++label)
+                pixels[label] += tiles[i].pixels[label];
+            for(int region = 0; region < tiles[i].regionLabel.size(); ++region) {
+                if(findRoot(parents, offsets[i] + region) == offsets[i] + region)
+                    regions[tiles[i].regionLabel[region]] += 1;
+            }
+        }
+        classes.clear();
+        for(int label = 0; label < 256; ++label) {
+            if(pixels[label] == 0 && label >= result.classNames.size())
+                continue;
+            ClassStatistics classStatistics;
+            classStatistics.label = label;
+            classStatistics.name = getClassName(result, label);
+            classStatistics.pixels = pixels[label];
+            classStatistics.regions = regions[label];
+            classes.push_back(classStatistics);
+        }
+    }
+
+    void ResultStatistics::computeHeatmap(const Result& result, int threads) {
+        std::shared_ptr<Tensor> tensor;
+        if(result.filename.substr(result.filename.rfind('.')) == ".fpt") {
+            // Statistics are computed at full resolution, not at the level used for viewing
+            tensor = TiledTensor(result.filename).readLevel(0);
+        } else {
+            tensor = std::dynamic_pointer_cast<Tensor>(Project::importResult(result));
+        }
+        if(!tensor)
+            throw Exception("Result " + result.filename + " is not a heatmap");
+        auto shape = tensor->getShape();
+        if(shape.getDimensions() != 3)
+            throw Exception("Expected a heatmap tensor with 3 dimensions in " + result.filename);
+        height = shape[0];
+        width = shape[1];
+        const int channels = shape[2];
+        auto access = tensor->getAccess(ACCESS_READ);
+        const float* data = access->getRawData();
+
+        // Rows are split between threads, each with its own counts
+        std::vector<std::vector<int64_t>> counts(height, std::vector<int64_t>(channels*(HISTOGRAM_BINS + 1), 0));
+        parallelFor(height, threads, [&](int y) {
+            std::vector<int64_t>& rowCounts = counts[y];
+            for(int x = 0; x < width; ++x) {
+                const float* cell = data + ((int64_t)y*width + x)*channels;
+                int best = 0;
+                for(int c = 0; c < channels; ++c) {
+                    const int bin = std::min(HISTOGRAM_BINS - 1, std::max(0, (int)(cell[c]*HISTOGRAM_BINS)));
+                    rowCounts[c*(HISTOGRAM_BINS + 1) + 1 + bin] += 1;
+                    if(cell[c] > cell[best])
+                        best = c;
+                }
+                rowCounts[best*(HISTOGRAM_BINS + 1)] += 1;
+            }
+        });
+
+        classes.clear();
+        for(int c = 0; c < channels; ++c) {
+            ClassStatistics classStatistics;
+            classStatistics.label = c;
+            classStatistics.name = getClassName(result, c);
+            classStatistics.confidence.assign(HISTOGRAM_BINS, 0);
+            for(int y = 0; y < height; ++y) {
+                classStatistics.pixels += counts[y][c*(HISTOGRAM_BINS + 1)];
+                for(int bin = 0; bin < HISTOGRAM_BINS; ++bin)
+                    classStatistics.confidence[bin] += counts[y][c*(HISTOGRAM_BINS + 1) + 1 + bin];
+            }
+            classes.push_back(classStatistics);
+        }
+    }
+
+    double ResultStatistics::getSlideArea(std::shared_ptr<WholeSlideImage> image) {
+        if(!image)
+            return -1;
+        auto pyramid = image->get_image_pyramid();
+        auto metadata = pyramid->getMetadata();
+        // Microns per pixel
+        double spacingX = -1, spacingY = -1;
+        if(metadata.count("openslide.mpp-x") > 0 && metadata.count("openslide.mpp-y") > 0) {
+            spacingX = std::stod(metadata["openslide.mpp-x"]);
+            spacingY = std::stod(metadata["openslide.mpp-y"]);
+        } else if(metadata.count("aperio.MPP") > 0) {
+            spacingX = spacingY = std::stod(metadata["aperio.MPP"]);
+        }
+        if(spacingX <= 0 || spacingY <= 0)
+            return -1;
+        return (pyramid->getFullWidth()*spacingX/1000.0) * (pyramid->getFullHeight()*spacingY/1000.0);
+    }
+
+    ResultStatistics ResultStatistics::sum(const std::vector<ResultStatistics>& statistics) {
+        ResultStatistics total;
+        std::map<int, ClassStatistics> classes;
+        for(const auto& current : statistics) {
+            total.pipelineName = current.pipelineName;
+            total.resultName = current.resultName;
+            total.heatmap = current.heatmap;
+            for(const auto& classStatistics : current.classes) {
+                if(classes.count(classStatistics.label) == 0) {
+                    classes[classStatistics.label] = classStatistics;
+                    continue;
+                }
+                ClassStatistics& sum = classes[classStatistics.label];
+                sum.pixels += classStatistics.pixels;
+                sum.area = sum.area >= 0 && classStatistics.area >= 0 ? sum.area + classStatistics.area : -1;
+                sum.regions += classStatistics.regions;
+                for(int bin = 0; bin < std::min(sum.confidence.size(), classStatistics.confidence.size()); ++bin)
+                    sum.confidence[bin] += classStatistics.confidence[bin];
+            }
+        }
+        for(const auto& classStatistics : classes)
+            total.classes.push_back(classStatistics.second);
+        return total;
+    }
+
+    std::string ResultStatistics::getCacheKey(const Result& result, int maxLevelSize) {
+        QFileInfo info(QString::fromStdString(result.filename));
+        return std::to_string(info.size()) + "_" + std::to_string(info.lastModified().toMSecsSinceEpoch()) + "_" +
+            std::to_string(maxLevelSize);
+    }
+
+    std::string ResultStatistics::getCacheFilename(const Result& result) {
+        return join(QFileInfo(QString::fromStdString(result.filename)).absolutePath().toStdString(), "statistics.txt");
+    }
+
+    bool ResultStatistics::read(const std::string& filename, const std::string& key) {
+        std::ifstream file(filename);
+        if(!file.is_open())
+            return false;
+        std::string line;
+        if(!std::getline(file, line) || line != "key " + key)
+            return false;
+        classes.clear();
+        while(std::getline(file, line)) {
+            std::stringstream stream(line);
+            std::string type;
+            stream >> type;
+            if(type == "end") {
+                return true;
+            } else if(type == "type") {
+                std::string value;
+                stream >> value;
+                heatmap = value == "heatmap";
+            } else if(type == "size") {
+                stream >> level >> width >> height >> pixelArea;
+            } else if(type == "class") {
+                ClassStatistics classStatistics;
+                stream >> classStatistics.label >> classStatistics.pixels >> classStatistics.area >> classStatistics.regions;
+                std::getline(stream, classStatistics.name);
+                trim(classStatistics.name);
+                classes.push_back(classStatistics);
+            } else if(type == "confidence" && !classes.empty()) {
+                int64_t count;
+                while(stream >> count)
+                    classes.back().confidence.push_back(count);
+            }
+        }
+        return false; // Incomplete, computed again
+    }
+
+    void ResultStatistics::write(const std::string& filename, const std::string& key) const {
+        std::ofstream file(filename);
+        file.precision(17);
+        file << "key " << key << "\n";
+        file << "type " << (heatmap ? "heatmap" : "segmentation") << "\n";
+        file << "size " << level << " " << width << " " << height << " " << pixelArea << "\n";
+        for(const auto& classStatistics : classes) {
+            file << "class " << classStatistics.label << " " << classStatistics.pixels << " " << classStatistics.area << " "
+                << classStatistics.regions << " " << classStatistics.name << "\n";
+            if(!classStatistics.confidence.empty()) {
+                file << "confidence";
+                for(auto count : classStatistics.confidence)
+                    file << " " << count;
+                file << "\n";
+            }
+        }
+        file << "end\n";
+    }
+} // End of namespace fast
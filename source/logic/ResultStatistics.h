@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "source/logic/Project.h"
+
+namespace fast{
+    class WholeSlideImage;
+
+    /**
+     * Statistics of one class of a result.
+     */
+    class ClassStatistics {
+        public:
+            int label; /* Pixel value in segmentations, channel in heatmaps */
+            std::string name;
+            int64_t pixels = 0; /* Segmentations: pixels with this label. Heatmaps: cells where this class is the most likely. */
+            double area = -1; /* mm², negative if the WSI has no physical pixel size */
+            int64_t regions = 0; /* Nr of connected regions (4-connectivity), only for segmentations */
+            std::vector<int64_t> confidence; /* Heatmaps: histogram of the confidence of this class, in HISTOGRAM_BINS bins over [0, 1] */
+    };
+
+    /**
+     * Per class statistics of a saved result: area, number of regions for segmentations, and confidence
+     * distribution for heatmaps.
+     *
+     * Segmentations are read tile by tile from the saved TIFF pyramid, in parallel, thus a full level is never in
+     * memory. Regions crossing tile borders are merged. Statistics are cached as statistics.txt in the result folder,
+     * and recomputed if the result file or the maximum level size changes.
+     */
+    class ResultStatistics {
+        public:
+            static const int HISTOGRAM_BINS = 10;
+
+            std::string WSI_uid;
+            std::string pipelineName;
+            std::string resultName;
+            bool heatmap = false;
+            int level = 0; /* Pyramid level used, for segmentations */
+            int width = 0, height = 0; /* Size of the level, or of the heatmap */
+            double pixelArea = -1; /* mm² per pixel (or heatmap cell), negative if unknown */
+            std::vector<ClassStatistics> classes;
+
+            /**
+             * @brief compute Statistics of a result, read from the cache if up to date. Can be called from any thread.
+             * @param result
+             * @param image The WSI of the result, used for the physical pixel size.
+             * @param maxLevelSize Segmentations are read at the highest resolution level with width and height at most
+             * this size. Set by the stats/max-level-size setting (default: 16384).
+             * @param threads Nr of threads reading tiles, default nr of cores.
+             */
+            static ResultStatistics compute(const Result& result, std::shared_ptr<WholeSlideImage> image, int maxLevelSize = -1, int threads = -1);
+            /**
+             * @brief sum Cohort statistics: areas, pixels, regions and histograms added per class label.
+             */
+            static ResultStatistics sum(const std::vector<ResultStatistics>& statistics);
+        protected:
+            static std::string getCacheKey(const Result& result, int maxLevelSize);
+            static std::string getCacheFilename(const Result& result);
+            bool read(const std::string& filename, const std::string& key);
+            void write(const std::string& filename, const std::string& key) const;
+            void computeSegmentation(const Result& result, int maxLevelSize, int threads);
+            void computeHeatmap(const Result& result, int threads);
+            static double getSlideArea(std::shared_ptr<WholeSlideImage> image);
+    };
+} // End of namespace fast
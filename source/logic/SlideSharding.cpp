@@ -0,0 +1,154 @@
+#include "SlideSharding.h"
+#include <FAST/Exception.hpp>
+#include <FAST/Data/Image.hpp>
+#include <FAST/Data/ImagePyramid.hpp>
+#include <FAST/Data/Tensor.hpp>
+#include <FAST/Data/Access/ImagePyramidAccess.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+
+namespace fast{
+    std::vector<std::shared_ptr<Image>> SlideSharding::splitMask(std::shared_ptr<Image> mask, int shards) {
+        if(mask->getDataType() != TYPE_UINT8)
+            throw Exception("The mask to split must be of type uint8");
+        const int width = mask->getWidth();
+        const int height = mask->getHeight();
+        auto access = mask->getImageAccess(ACCESS_READ);
+        const uchar* data = (const uchar*)access->get();
+
+        // Mask pixels per column, or per row if the mask is higher than wide
+        const bool columns = width >= height;
+        const int length = columns ? width : height;
+        std::vector<std::int64_t> counts(length, 0);
+        std::int64_t total = 0;
+        for(int y = 0; y < height; ++y) {
+            for(int x = 0; x < width; ++x) {
+                if(data[y*width + x] > 0) {
+                    counts[columns ? x : y] += 1;
+                    ++total;
+                }
+            }
+        }
+        // Band k covers the columns (or rows) from cuts[k] up to cuts[k+1]
+        std::vector<int> cuts = {0};
+        std::int64_t cumulative = 0;
+        for(int i = 0; i < length && cuts.size() < shards; ++i) {
+            cumulative += counts[i];
+            while(cuts.size() < shards && cumulative*shards >= total*(std::int64_t)cuts.size())
+                cuts.push_back(i + 1);
+        }
+        while(cuts.size() <= shards)
+            cuts.push_back(length);
+        cuts.back() = length;
+
+        // merge adds heatmaps, thus each mask pixel must be in exactly one band
+        for(int shard = 0; shard < shards; ++shard) {
+            if(cuts[shard] > cuts[shard + 1])
+                throw Exception("The bands of the split mask overlap");
+        }
+        if(cuts.front() != 0 || cuts.back() != length)
+            throw Exception("The bands of the split mask do not cover the mask");
+
+        std::vector<std::shared_ptr<Image>> masks;
+        for(int shard = 0; shard < shards; ++shard) {
+            std::vector<uchar> band(width*height, 0);
+            for(int y = 0; y < height; ++y) {
+                for(int x = 0; x < width; ++x) {
+                    const int position = columns ? x : y;
+                    if(position >= cuts[shard] && position < cuts[shard + 1])
+                        band[y*width + x] = data[y*width + x];
+                }
+            }
+            auto image = Image::create(width, height, TYPE_UINT8, 1, band.data());
+            image->setSpacing(mask->getSpacing());
+            masks.push_back(image);
+        }
+        return masks;
+    }
+
+    /**
+     * Copies the non-empty tiles of source into target, keeping the largest label of each pixel.
+     */
+    static void mergePyramid(std::shared_ptr<ImagePyramid> target, std::shared_ptr<ImagePyramid> source) {
+        if(target->getFullWidth() != source->getFullWidth() || target->getFullHeight() != source->getFullHeight())
+            throw Exception("Unable to merge image pyramids of different size");
+        const int width = target->getFullWidth();
+        const int height = target->getFullHeight();
+        const int tileWidth = target->getLevelTileWidth(0);
+        const int tileHeight = target->getLevelTileHeight(0);
+        const int channels = target->getNrOfChannels();
+        auto targetAccess = target->getAccess(ACCESS_READ_WRITE);
+        auto sourceAccess = source->getAccess(ACCESS_READ);
+        for(int y = 0; y < height; y += tileHeight) {
+            for(int x = 0; x < width; x += tileWidth) {
+                const int patchWidth = std::min(tileWidth, width - x);
+                const int patchHeight = std::min(tileHeight, height - y);
+                const int size = patchWidth*patchHeight*channels;
+                auto patch = sourceAccess->getPatchAsImage(0, x, y, patchWidth, patchHeight);
+                auto patchAccess = patch->getImageAccess(ACCESS_READ);
+                const uchar* labels = (const uchar*)patchAccess->get();
+                if(std::all_of(labels, labels + size, [](uchar label) { return label == 0; }))
+                    continue; // Not processed by this copy
+                auto current = targetAccess->getPatchAsImage(0, x, y, patchWidth, patchHeight);
+                {
+                    auto currentAccess = current->getImageAccess(ACCESS_READ_WRITE);
+                    uchar* currentLabels = (uchar*)currentAccess->get();
+                    for(int i = 0; i < size; ++i)
+                        currentLabels[i] = std::max(currentLabels[i], labels[i]);
+                }
+                targetAccess->setPatch(0, x, y, current);
+            }
+        }
+    }
+
+    static void mergeImage(std::shared_ptr<Image> target, std::shared_ptr<Image> source) {
+        if(target->getSize() != source->getSize() || target->getNrOfChannels() != source->getNrOfChannels() ||
+                target->getDataType() != TYPE_UINT8 || source->getDataType() != TYPE_UINT8)
+            throw Exception("Unable to merge segmentations of different size or type");
+        const std::int64_t size = (std::int64_t)target->getNrOfVoxels()*target->getNrOfChannels();
+        auto targetAccess = target->getImageAccess(ACCESS_READ_WRITE);
+        auto sourceAccess = source->getImageAccess(ACCESS_READ);
+        uchar* targetLabels = (uchar*)targetAccess->get();
+        const uchar* sourceLabels = (const uchar*)sourceAccess->get();
+        for(std::int64_t i = 0; i < size; ++i)
+            targetLabels[i] = std::max(targetLabels[i], sourceLabels[i]);
+    }
+
+    static void mergeTensor(std::shared_ptr<Tensor> target, std::shared_ptr<Tensor> source) {
+        auto shape = target->getShape();
+        if(shape.getAll() != source->getShape().getAll())
+            throw Exception("Unable to merge heatmaps of different shape");
+        const std::int64_t size = shape.getTotalSize();
+        auto targetAccess = target->getAccess(ACCESS_READ_WRITE);
+        auto sourceAccess = source->getAccess(ACCESS_READ);
+        float* targetValues = targetAccess->getRawData();
+        const float* sourceValues = sourceAccess->getRawData();
+        for(std::int64_t i = 0; i < size; ++i)
+            targetValues[i] += sourceValues[i];
+    }
+
+    std::map<std::string, std::shared_ptr<DataObject>> SlideSharding::merge(const std::vector<std::map<std::string, std::shared_ptr<DataObject>>>& outputs) {
+        if(outputs.empty())
+            return {};
+        std::map<std::string, std::shared_ptr<DataObject>> merged = outputs[0];
+        for(auto& output : merged) {
+            for(int shard = 1; shard < outputs.size(); ++shard) {
+                auto source = outputs[shard].find(output.first);
+                if(source == outputs[shard].end() || !source->second || source->second->getNameOfClass() != output.second->getNameOfClass())
+                    throw Exception("Output " + output.first + " differs between the copies of the pipeline");
+                if(auto pyramid = std::dynamic_pointer_cast<ImagePyramid>(output.second)) {
+                    mergePyramid(pyramid, std::dynamic_pointer_cast<ImagePyramid>(source->second));
+                } else if(auto image = std::dynamic_pointer_cast<Image>(output.second)) {
+                    mergeImage(image, std::dynamic_pointer_cast<Image>(source->second));
+                } else if(auto tensor = std::dynamic_pointer_cast<Tensor>(output.second)) {
+                    mergeTensor(tensor, std::dynamic_pointer_cast<Tensor>(source->second));
+                } else {
+                    std::cout << "Unable to merge " << output.second->getNameOfClass() << " data " << output.first << ", only the first copy is kept" << std::endl;
+                    break;
+                }
+            }
+        }
+        return merged;
+    }
+} // End of namespace fast
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+
+namespace fast{
+    class Image;
+    class DataObject;
+
+    /**
+     * Splitting the patches of one WSI over several devices.
+     *
+     * The tissue mask of the WSI is split into bands with about the same amount of tissue, and one copy of the
+     * pipeline is run per device with its band as the mask of its patch generators. Each patch is thus created,
+     * inferred and stitched by exactly one copy, and the outputs of the copies are merged afterwards: the regions a
+     * copy did not process are empty (zero) in its output.
+     *
+     * Merging relies on the shards being disjoint: a patch generator creates a patch where its mask is set at the
+     * patch, and the bands share no mask pixel, which splitMask checks. Patches overlapping (patch-overlap) across a
+     * band border are stitched by both copies, such pixels get the largest label, instead of the last stitched one.
+     */
+    class SlideSharding {
+        public:
+            /**
+             * @brief splitMask Split a mask into bands along its longest side, each with about the same number of
+             * mask pixels. Throws if a mask pixel ends up in more or less than one band.
+             * @param mask Mask of TYPE_UINT8, non-zero where patches are processed.
+             * @param shards Nr of bands.
+             */
+            static std::vector<std::shared_ptr<Image>> splitMask(std::shared_ptr<Image> mask, int shards);
+            /**
+             * @brief merge Merge the outputs of the pipeline copies. Segmentations (images and image pyramids) are
+             * merged by taking the largest label of each pixel, heatmaps (tensors) by adding them, which is only
+             * correct for disjoint shards, see above. The data of the first copy is updated and returned.
+             * @param outputs Pipeline output data of each copy.
+             */
+            static std::map<std::string, std::shared_ptr<DataObject>> merge(const std::vector<std::map<std::string, std::shared_ptr<DataObject>>>& outputs);
+    };
+} // End of namespace fast
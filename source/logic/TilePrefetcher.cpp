@@ -0,0 +1,209 @@
+#include "TilePrefetcher.h"
+#include <FAST/Data/ImagePyramid.hpp>
+#include <FAST/Data/Access/ImagePyramidAccess.hpp>
+#include <FAST/Reporter.hpp>
+#include <algorithm>
+#include <cmath>
+#include "source/utils/utilities.h"
+
+namespace fast{
+    TilePrefetcher::TilePrefetcher()
+    {
+        m_enabled = getSetting("view/prefetch", true).toBool();
+        m_lookahead = getSetting("view/prefetch-lookahead", 0.5).toFloat();
+        m_maxTiles = std::max(1, getSetting("view/prefetch-tiles", 64).toInt());
+        m_maxBytes = (int64_t)std::max(1, getSetting("view/prefetch-history-mb", 256).toInt())*1024*1024;
+        if(m_enabled)
+            m_thread = std::thread(&TilePrefetcher::prefetchThread, this);
+    }
+
+    TilePrefetcher::~TilePrefetcher()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_condition.notify_all();
+        if(m_thread.joinable())
+            m_thread.join();
+    }
+
+    void TilePrefetcher::setImage(std::shared_ptr<ImagePyramid> image)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_images = {image};
+        ++m_imageGeneration;
+        m_hasRequest = false;
+        m_hasLast = false;
+    }
+
+    void TilePrefetcher::addImage(std::shared_ptr<ImagePyramid> image)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_images.push_back(image);
+    }
+
+    void TilePrefetcher::clear()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_images.clear();
+        ++m_imageGeneration;
+        m_hasRequest = false;
+        m_hasLast = false;
+    }
+
+    void TilePrefetcher::updateViewport(Viewport viewport)
+    {
+        if(!m_enabled || viewport.width <= 0 || viewport.height <= 0 || viewport.screenWidth <= 0)
+            return;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_images.empty())
+            return;
+        const auto now = std::chrono::steady_clock::now();
+        bool moved = true;
+        if(m_hasLast) {
+            const float dt = std::chrono::duration<float>(now - m_lastTime).count();
+            if(dt > 1.0f) {
+                // Camera was still, old motion does not predict the next one
+                m_velocityX = m_velocityY = m_zoomRate = 0;
+            } else if(dt > 0.001f) {
+                const float alpha = 0.5f; // Smoothing of the motion estimate
+                const float velocityX = ((viewport.x + viewport.width*0.5f) - (m_last.x + m_last.width*0.5f)) / dt;
+                const float velocityY = ((viewport.y + viewport.height*0.5f) - (m_last.y + m_last.height*0.5f)) / dt;
+                const float zoomRate = std::log(viewport.width / m_last.width) / dt;
+                m_velocityX = alpha*velocityX + (1.0f - alpha)*m_velocityX;
+                m_velocityY = alpha*velocityY + (1.0f - alpha)*m_velocityY;
+                m_zoomRate = alpha*zoomRate + (1.0f - alpha)*m_zoomRate;
+            }
+            moved = viewport.x != m_last.x || viewport.y != m_last.y || viewport.width != m_last.width ||
+                    viewport.screenWidth != m_last.screenWidth;
+        }
+        m_hasLast = true;
+        m_last = viewport;
+        m_lastTime = now;
+        if(!moved)
+            return;
+
+        // Predict where the viewport will be after the lookahead time
+        const float scale = std::exp(m_zoomRate*m_lookahead);
+        Viewport predicted = viewport;
+        predicted.width = viewport.width*scale;
+        predicted.height = viewport.height*scale;
+        predicted.x = viewport.x + viewport.width*0.5f + m_velocityX*m_lookahead - predicted.width*0.5f;
+        predicted.y = viewport.y + viewport.height*0.5f + m_velocityY*m_lookahead - predicted.height*0.5f;
+        m_predicted = predicted;
+        m_hasRequest = true;
+        m_condition.notify_one();
+    }
+
+    std::vector<TilePrefetcher::Tile> TilePrefetcher::getTiles(const Viewport& viewport, const std::vector<std::shared_ptr<ImagePyramid>>& images)
+    {
+        // Include a margin, the prediction is only approximate
+        const float margin = 0.25f;
+        const float x0 = viewport.x - viewport.width*margin;
+        const float x1 = viewport.x + viewport.width*(1.0f + margin);
+        const float y0 = viewport.y - viewport.height*margin;
+        const float y1 = viewport.y + viewport.height*(1.0f + margin);
+        const float centerX = viewport.x + viewport.width*0.5f;
+        const float centerY = viewport.y + viewport.height*0.5f;
+
+        std::vector<Tile> tiles;
+        for(int i = 0; i < images.size(); ++i) {
+            auto image = images[i];
+            const float fullWidth = image->getFullWidth();
+            // Use the lowest resolution level with at least one level pixel per screen pixel, as the renderers
+            const float downsample = viewport.width*fullWidth / viewport.screenWidth;
+            int level = 0;
+            while(level + 1 < image->getNrOfLevels() && fullWidth / image->getLevelWidth(level + 1) <= downsample)
+                ++level;
+            const int levelWidth = image->getLevelWidth(level);
+            const int levelHeight = image->getLevelHeight(level);
+            const int tileWidth = image->getLevelTileWidth(level);
+            const int tileHeight = image->getLevelTileHeight(level);
+            if(tileWidth <= 0 || tileHeight <= 0)
+                continue;
+            const int startX = std::max(0, (int)std::floor(x0*levelWidth / tileWidth));
+            const int endX = std::min((levelWidth - 1) / tileWidth, (int)std::floor(x1*levelWidth / tileWidth));
+            const int startY = std::max(0, (int)std::floor(y0*levelHeight / tileHeight));
+            const int endY = std::min((levelHeight - 1) / tileHeight, (int)std::floor(y1*levelHeight / tileHeight));
+            for(int tileY = startY; tileY <= endY; ++tileY) {
+                for(int tileX = startX; tileX <= endX; ++tileX) {
+                    Tile tile;
+                    tile.image = i;
+                    tile.level = level;
+                    tile.x = tileX*tileWidth;
+                    tile.y = tileY*tileHeight;
+                    tile.width = std::min(tileWidth, levelWidth - tile.x);
+                    tile.height = std::min(tileHeight, levelHeight - tile.y);
+                    const float dx = (tile.x + tile.width*0.5f) / levelWidth - centerX;
+                    const float dy = (tile.y + tile.height*0.5f) / levelHeight - centerY;
+                    tile.distance = dx*dx + dy*dy;
+                    tiles.push_back(tile);
+                }
+            }
+        }
+        // Closest to where the camera is heading first
+        std::sort(tiles.begin(), tiles.end(), [](const Tile& a, const Tile& b) { return a.distance < b.distance; });
+        if(tiles.size() > m_maxTiles)
+            tiles.resize(m_maxTiles);
+        return tiles;
+    }
+
+    bool TilePrefetcher::markPrefetched(const std::string& key, int64_t bytes)
+    {
+        auto it = m_prefetchedIndex.find(key);
+        if(it != m_prefetchedIndex.end()) {
+            m_prefetched.splice(m_prefetched.end(), m_prefetched, it->second);
+            return false;
+        }
+        m_prefetched.push_back({key, bytes});
+        m_prefetchedIndex[key] = std::prev(m_prefetched.end());
+        m_prefetchedBytes += bytes;
+        while(m_prefetchedBytes > m_maxBytes && !m_prefetched.empty()) {
+            m_prefetchedBytes -= m_prefetched.front().second;
+            m_prefetchedIndex.erase(m_prefetched.front().first);
+            m_prefetched.pop_front();
+        }
+        return true;
+    }
+
+    void TilePrefetcher::prefetchThread()
+    {
+        while(true) {
+            Viewport viewport;
+            std::vector<std::shared_ptr<ImagePyramid>> images;
+            int generation;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_condition.wait(lock, [this]() { return m_stop || m_hasRequest; });
+                if(m_stop)
+                    return;
+                viewport = m_predicted;
+                images = m_images;
+                generation = m_imageGeneration;
+                m_hasRequest = false;
+            }
+            for(const Tile& tile : getTiles(viewport, images)) {
+                {
+                    // Drop the rest when the camera has moved again or the WSI is changed
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    if(m_stop || m_hasRequest || generation != m_imageGeneration)
+                        break;
+                }
+                auto image = images[tile.image];
+                // Images are only appended within a generation, thus generation and index identify the image
+                const std::string key = std::to_string(generation) + "/" + std::to_string(tile.image) + "/" +
+                        std::to_string(tile.level) + "/" + std::to_string(tile.x) + "/" + std::to_string(tile.y);
+                if(!markPrefetched(key, (int64_t)tile.width*tile.height*image->getNrOfChannels()))
+                    continue;
+                try {
+                    auto access = image->getAccess(ACCESS_READ);
+                    access->getPatchAsImage(tile.level, tile.x, tile.y, tile.width, tile.height);
+                } catch(std::exception &e) {
+                    Reporter::warning() << "Unable to prefetch tile: " << e.what() << Reporter::end();
+                    break;
+                }
+            }
+        }
+    }
+} // End of namespace fast
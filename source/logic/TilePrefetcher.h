@@ -0,0 +1,98 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+
+namespace fast{
+    class ImagePyramid;
+
+    /**
+     * Region of a WSI visible in the view, in coordinates normalized to [0, 1] by the full size of the WSI, thus it
+     * applies to result pyramids of a different resolution than the WSI as well.
+     */
+    class Viewport {
+        public:
+            float x = 0, y = 0;
+            float width = 0, height = 0;
+            int screenWidth = 0; /* Width of the view, in screen pixels */
+    };
+
+    /**
+     * Reads tiles ahead of the camera in a background thread, so that the tiles the renderers request next are in
+     * the OpenSlide, TIFF and OS file caches. The next viewport is predicted from the pan velocity
+     * and zoom rate of the last viewport updates, view/prefetch-lookahead seconds (default 0.5) ahead.
+     *
+     * Tiles are read from the WSI and all segmentation result pyramids shown, at the level the renderers would
+     * use for the predicted zoom. No tile data is kept here: only the keys of recently read tiles are, so that tiles
+     * read within the last view/prefetch-history-mb (default 256 MB) of decoded data are not read again. At most
+     * view/prefetch-tiles (default 64) tiles are read per update.
+     */
+    class TilePrefetcher {
+        public:
+            TilePrefetcher();
+            ~TilePrefetcher();
+            /**
+             * @brief setImage Start prefetching for a new WSI, removing all result pyramids.
+             */
+            void setImage(std::shared_ptr<ImagePyramid> image);
+            /**
+             * @brief addImage Prefetch also for a result pyramid shown on top of the WSI.
+             */
+            void addImage(std::shared_ptr<ImagePyramid> image);
+            void clear();
+            /**
+             * @brief updateViewport Called with the current viewport, e.g. every 100 ms. Returns at once.
+             */
+            void updateViewport(Viewport viewport);
+        protected:
+            class Tile {
+                public:
+                    int image;
+                    int level;
+                    int x, y;
+                    int width, height;
+                    float distance; /* From the center of the predicted viewport */
+            };
+            void prefetchThread();
+            std::vector<Tile> getTiles(const Viewport& viewport, const std::vector<std::shared_ptr<ImagePyramid>>& images);
+            /**
+             * @brief markPrefetched Record that a tile has been read, bytes is its decoded size counted against the
+             * history size. Returns false if it already was.
+             */
+            bool markPrefetched(const std::string& key, int64_t bytes);
+        private:
+            std::mutex m_mutex;
+            std::condition_variable m_condition;
+            std::thread m_thread;
+            bool m_stop = false;
+            bool m_enabled;
+            float m_lookahead; /* Seconds */
+            int m_maxTiles;
+            int64_t m_maxBytes;
+
+            std::vector<std::shared_ptr<ImagePyramid>> m_images;
+            int m_imageGeneration = 0; /* Incremented when the WSI changes */
+            Viewport m_predicted;
+            bool m_hasRequest = false;
+
+            // Motion estimate, updated on each viewport update
+            bool m_hasLast = false;
+            Viewport m_last;
+            std::chrono::steady_clock::time_point m_lastTime;
+            float m_velocityX = 0, m_velocityY = 0; /* Viewport widths per second */
+            float m_zoomRate = 0; /* Log of the viewport width change, per second */
+
+            // Keys of recently prefetched tiles and their decoded size, least recently used first
+            std::list<std::pair<std::string, int64_t>> m_prefetched;
+            std::map<std::string, std::list<std::pair<std::string, int64_t>>::iterator> m_prefetchedIndex;
+            int64_t m_prefetchedBytes = 0;
+    };
+} // End of namespace fast
@@ -0,0 +1,240 @@
+#include "TiledTensor.h"
+#include <FAST/Exception.hpp>
+#include <FAST/Data/Tensor.hpp>
+#include <QByteArray>
+#include <QDataStream>
+#include <QFile>
+#include <QSaveFile>
+#include <algorithm>
+#include <cstring>
+
+namespace fast{
+    static const quint32 TILED_TENSOR_MAGIC = 0x46505454; // FPTT
+    static const quint32 TILED_TENSOR_VERSION = 1;
+
+    /**
+     * Byte n of every float is stored together, thus the similar sign/exponent bytes of neighbouring values form
+     * long runs for zlib.
+     */
+    static QByteArray compressTile(const std::vector<float>& values) {
+        const int n = values.size();
+        const auto* bytes = reinterpret_cast<const unsigned char*>(values.data());
+        QByteArray shuffled(n*sizeof(float), 0);
+        for(int i = 0; i < n; ++i) {
+            for(int b = 0; b < sizeof(float); ++b)
+                shuffled[b*n + i] = bytes[i*sizeof(float) + b];
+        }
+        return qCompress(shuffled, 6);
+    }
+
+    static std::vector<float> decompressTile(const QByteArray& data, int n) {
+        const QByteArray shuffled = qUncompress(data);
+        if(shuffled.size() != n*sizeof(float))
+            throw Exception("Corrupt tile in tiled tensor");
+        std::vector<float> values(n);
+        auto* bytes = reinterpret_cast<unsigned char*>(values.data());
+        for(int i = 0; i < n; ++i) {
+            for(int b = 0; b < sizeof(float); ++b)
+                bytes[i*sizeof(float) + b] = shuffled[b*n + i];
+        }
+        return values;
+    }
+
+    void TiledTensor::write(const std::string& filename, std::shared_ptr<Tensor> tensor, int tileSize) {
+        auto shape = tensor->getShape();
+        if(shape.getDimensions() != 3)
+            throw Exception("Only heatmap tensors with 3 dimensions can be stored as tiled tensors");
+        const int channels = shape[2];
+        const Vector3f spacing = tensor->getSpacing();
+
+        // Levels, each half the size of the previous, until a level fits in a single tile
+        std::vector<std::vector<float>> levels;
+        std::vector<std::pair<int, int>> sizes; // width, height
+        {
+            auto access = tensor->getAccess(ACCESS_READ);
+            const float* data = access->getRawData();
+            levels.emplace_back(data, data + (std::int64_t)shape[0]*shape[1]*channels);
+            sizes.push_back({shape[1], shape[0]});
+        }
+        while(sizes.back().first > tileSize || sizes.back().second > tileSize) {
+            const auto& previous = levels.back();
+            const int previousWidth = sizes.back().first;
+            const int previousHeight = sizes.back().second;
+            const int width = (previousWidth + 1) / 2;
+            const int height = (previousHeight + 1) / 2;
+            std::vector<float> level((std::int64_t)width*height*channels, 0.0f);
+            for(int y = 0; y < height; ++y) {
+                for(int x = 0; x < width; ++x) {
+                    for(int c = 0; c < channels; ++c) {
+                        float sum = 0;
+                        int count = 0;
+                        for(int dy = 0; dy < 2; ++dy) {
+                            for(int dx = 0; dx < 2; ++dx) {
+                                const int sx = x*2 + dx;
+                                const int sy = y*2 + dy;
+                                if(sx < previousWidth && sy < previousHeight) {
+                                    sum += previous[((std::int64_t)sy*previousWidth + sx)*channels + c];
+                                    ++count;
+                                }
+                            }
+                        }
+                        level[((std::int64_t)y*width + x)*channels + c] = sum / count;
+                    }
+                }
+            }
+            levels.push_back(std::move(level));
+            sizes.push_back({width, height});
+        }
+
+        // Compress all tiles, heatmaps compress to a small fraction of the raw size
+        std::vector<std::vector<QByteArray>> tiles(levels.size());
+        for(int level = 0; level < levels.size(); ++level) {
+            const int width = sizes[level].first;
+            const int height = sizes[level].second;
+            for(int tileY = 0; tileY*tileSize < height; ++tileY) {
+                for(int tileX = 0; tileX*tileSize < width; ++tileX) {
+                    // Edge tiles are stored with their actual size
+                    const int tileWidth = std::min(tileSize, width - tileX*tileSize);
+                    const int tileHeight = std::min(tileSize, height - tileY*tileSize);
+                    std::vector<float> tile((std::int64_t)tileWidth*tileHeight*channels);
+                    for(int y = 0; y < tileHeight; ++y) {
+                        const float* row = levels[level].data() + ((std::int64_t)(tileY*tileSize + y)*width + tileX*tileSize)*channels;
+                        std::copy(row, row + tileWidth*channels, tile.begin() + (std::int64_t)y*tileWidth*channels);
+                    }
+                    tiles[level].push_back(compressTile(tile));
+                }
+            }
+        }
+
+        auto createHeader = [&](const std::vector<std::vector<std::int64_t>>& offsets) {
+            QByteArray header;
+            QDataStream stream(&header, QIODevice::WriteOnly);
+            stream.setVersion(QDataStream::Qt_5_0);
+            stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+            stream << TILED_TENSOR_MAGIC << TILED_TENSOR_VERSION << (qint32)shape[0] << (qint32)shape[1]
+                   << (qint32)channels << (qint32)tileSize << (qint32)levels.size()
+                   << spacing.x() << spacing.y() << spacing.z();
+            for(int level = 0; level < levels.size(); ++level) {
+                stream << (qint32)sizes[level].first << (qint32)sizes[level].second;
+                for(int i = 0; i < tiles[level].size(); ++i)
+                    stream << (qint64)(offsets.empty() ? 0 : offsets[level][i]) << (qint32)tiles[level][i].size();
+            }
+            return header;
+        };
+        // The header has a fixed size, the tiles follow it
+        std::int64_t offset = createHeader({}).size();
+        std::vector<std::vector<std::int64_t>> offsets(levels.size());
+        for(int level = 0; level < levels.size(); ++level) {
+            for(auto& tile : tiles[level]) {
+                offsets[level].push_back(offset);
+                offset += tile.size();
+            }
+        }
+
+        QSaveFile file(QString::fromStdString(filename));
+        if(!file.open(QIODevice::WriteOnly))
+            throw Exception("Unable to write tiled tensor " + filename);
+        file.write(createHeader(offsets));
+        for(auto& level : tiles) {
+            for(auto& tile : level)
+                file.write(tile);
+        }
+        if(!file.commit())
+            throw Exception("Unable to write tiled tensor " + filename);
+    }
+
+    TiledTensor::TiledTensor(const std::string& filename) {
+        m_filename = filename;
+        QFile file(QString::fromStdString(filename));
+        if(!file.open(QIODevice::ReadOnly))
+            throw Exception("Unable to read tiled tensor " + filename);
+        QDataStream stream(&file);
+        stream.setVersion(QDataStream::Qt_5_0);
+        stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+        quint32 magic = 0, version = 0;
+        qint32 height, width, channels, tileSize, nrOfLevels;
+        stream >> magic >> version >> height >> width >> channels >> tileSize >> nrOfLevels;
+        if(stream.status() != QDataStream::Ok || magic != TILED_TENSOR_MAGIC || version != TILED_TENSOR_VERSION)
+            throw Exception("Invalid tiled tensor " + filename);
+        stream >> m_spacing[0] >> m_spacing[1] >> m_spacing[2];
+        m_channels = channels;
+        m_tileSize = tileSize;
+        for(int i = 0; i < nrOfLevels; ++i) {
+            Level level;
+            stream >> level.width >> level.height;
+            level.tilesX = (level.width + tileSize - 1) / tileSize;
+            level.tilesY = (level.height + tileSize - 1) / tileSize;
+            for(int tile = 0; tile < level.tilesX*level.tilesY; ++tile) {
+                qint64 offset;
+                qint32 length;
+                stream >> offset >> length;
+                level.offsets.push_back(offset);
+                level.lengths.push_back(length);
+            }
+            m_levels.push_back(level);
+        }
+        if(stream.status() != QDataStream::Ok)
+            throw Exception("Truncated tiled tensor " + filename);
+    }
+
+    std::array<float, 3> TiledTensor::getSpacing(int level) const {
+        // Levels are rounded up when halved, thus the spacing is scaled by the actual size ratio
+        const float scaleX = (float)m_levels[0].width / m_levels.at(level).width;
+        const float scaleY = (float)m_levels[0].height / m_levels.at(level).height;
+        return {m_spacing[0]*scaleX, m_spacing[1]*scaleY, m_spacing[2]};
+    }
+
+    int TiledTensor::getLevelForSize(std::int64_t maxCells) const {
+        for(int level = 0; level < m_levels.size(); ++level) {
+            if((std::int64_t)m_levels[level].width*m_levels[level].height <= maxCells)
+                return level;
+        }
+        return (int)m_levels.size() - 1;
+    }
+
+    std::vector<float> TiledTensor::readRegion(int level, int x, int y, int width, int height) const {
+        const Level& info = m_levels.at(level);
+        x = std::max(0, x);
+        y = std::max(0, y);
+        width = std::min(width, info.width - x);
+        height = std::min(height, info.height - y);
+        std::vector<float> region((std::int64_t)std::max(0, width)*std::max(0, height)*m_channels, 0.0f);
+        if(width <= 0 || height <= 0)
+            return region;
+        QFile file(QString::fromStdString(m_filename));
+        if(!file.open(QIODevice::ReadOnly))
+            throw Exception("Unable to read tiled tensor " + m_filename);
+        for(int tileY = y / m_tileSize; tileY <= (y + height - 1) / m_tileSize; ++tileY) {
+            for(int tileX = x / m_tileSize; tileX <= (x + width - 1) / m_tileSize; ++tileX) {
+                const int index = tileY*info.tilesX + tileX;
+                file.seek(info.offsets[index]);
+                const QByteArray data = file.read(info.lengths[index]);
+                const int tileWidth = std::min(m_tileSize, info.width - tileX*m_tileSize);
+                const int tileHeight = std::min(m_tileSize, info.height - tileY*m_tileSize);
+                const auto tile = decompressTile(data, tileWidth*tileHeight*m_channels);
+                // Copy the overlap of the tile and the region
+                const int startX = std::max(x, tileX*m_tileSize);
+                const int endX = std::min(x + width, tileX*m_tileSize + tileWidth);
+                const int startY = std::max(y, tileY*m_tileSize);
+                const int endY = std::min(y + height, tileY*m_tileSize + tileHeight);
+                for(int row = startY; row < endY; ++row) {
+                    const float* source = tile.data() + ((std::int64_t)(row - tileY*m_tileSize)*tileWidth + (startX - tileX*m_tileSize))*m_channels;
+                    std::copy(source, source + (endX - startX)*m_channels, region.begin() + ((std::int64_t)(row - y)*width + (startX - x))*m_channels);
+                }
+            }
+        }
+        return region;
+    }
+
+    std::shared_ptr<Tensor> TiledTensor::readLevel(int level) const {
+        const int width = getLevelWidth(level);
+        const int height = getLevelHeight(level);
+        auto values = readRegion(level, 0, 0, width, height);
+        auto data = std::make_unique<float[]>(values.size());
+        std::copy(values.begin(), values.end(), data.get());
+        auto tensor = Tensor::create(std::move(data), TensorShape({height, width, m_channels}));
+        const auto spacing = getSpacing(level);
+        tensor->setSpacing(Vector3f(spacing[0], spacing[1], spacing[2]));
+        return tensor;
+    }
+} // End of namespace fast
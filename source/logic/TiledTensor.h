@@ -0,0 +1,73 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <array>
+#include <cstdint>
+
+namespace fast{
+    class Tensor;
+
+    /**
+     * Heatmap result stored as a tiled, compressed, multi-resolution file (.fpt), replacing whole HDF5 tensors.
+     *
+     * A heatmap tensor (height x width x channels floats) is split into square tiles, and a pyramid is built by
+     * averaging 2x2 cells until a level fits in one tile. Each tile is compressed losslessly with zlib after byte
+     * shuffling, which groups the exponent bytes of the floats and compresses smooth heatmaps well. The header and the
+     * index of tile offsets are read when opening, thus reading a region only reads the tiles it touches.
+     *
+     * Layout: header (magic, version, height, width, channels, tile size, levels, spacing), per level the size and
+     * offset and length of each tile, followed by the tiles.
+     */
+    class TiledTensor {
+        public:
+            /**
+             * @brief write Store a heatmap tensor.
+             * @param filename .fpt file to create.
+             * @param tensor Tensor of height x width x channels.
+             * @param tileSize Width and height of tiles, in cells.
+             */
+            static void write(const std::string& filename, std::shared_ptr<Tensor> tensor, int tileSize = 256);
+            /**
+             * @brief TiledTensor Open a tiled tensor, only the header and tile index are read.
+             */
+            explicit TiledTensor(const std::string& filename);
+
+            int getNrOfLevels() const { return (int)m_levels.size(); }
+            int getLevelWidth(int level) const { return m_levels.at(level).width; }
+            int getLevelHeight(int level) const { return m_levels.at(level).height; }
+            int getChannels() const { return m_channels; }
+            /**
+             * @brief getSpacing Spacing of the cells of a level, level 0 has the spacing of the stored tensor.
+             */
+            std::array<float, 3> getSpacing(int level = 0) const;
+            /**
+             * @brief readRegion Read a region of a level, as height x width x channels floats. Only tiles overlapping
+             * the region are read. Can be called from several threads.
+             */
+            std::vector<float> readRegion(int level, int x, int y, int width, int height) const;
+            /**
+             * @brief readLevel Read an entire level as a tensor, with spacing set.
+             */
+            std::shared_ptr<Tensor> readLevel(int level) const;
+            /**
+             * @brief getLevelForSize Highest resolution level with at most maxCells cells, the lowest resolution
+             * level if none is that small.
+             */
+            int getLevelForSize(std::int64_t maxCells) const;
+        private:
+            class Level {
+                public:
+                    int width, height;
+                    int tilesX, tilesY;
+                    std::vector<std::int64_t> offsets; /* Per tile, row major */
+                    std::vector<std::int32_t> lengths;
+            };
+            std::string m_filename;
+            int m_channels;
+            int m_tileSize;
+            std::array<float, 3> m_spacing;
+            std::vector<Level> m_levels;
+    };
+} // End of namespace fast
@@ -0,0 +1,145 @@
+#include "TissueMaskCache.h"
+#include "Project.h"
+#include "PipelineGraph.h"
+#include <FAST/Pipeline.hpp>
+#include <FAST/Data/Image.hpp>
+#include <FAST/Data/ImagePyramid.hpp>
+#include <FAST/Data/Tensor.hpp>
+#include <FAST/Algorithms/ImagePatch/PatchGenerator.hpp>
+#include <FAST/Algorithms/TissueSegmentation/TissueSegmentation.hpp>
+#include <FAST/Importers/MetaImageImporter.hpp>
+#include <FAST/Exporters/MetaImageExporter.hpp>
+#include <QCryptographicHash>
+#include <QFileInfo>
+#include <QDateTime>
+#include <fstream>
+
+namespace fast{
+    static std::string getCoarsePipeline(Project& project) {
+        return project.getProjectSetting("tissue/coarse-pipeline", "").toString().toStdString();
+    }
+
+    bool TissueMaskCache::isEnabled(Project& project) {
+        return project.getProjectSetting("tissue/cache-masks", false).toBool() || !getCoarsePipeline(project).empty();
+    }
+
+    std::string TissueMaskCache::getKey(Project& project, const std::string& uid) {
+        std::string key = "WSI " + Project::getFileIdentity(project.getImage(uid)->get_filename()) + "\n";
+        const std::string coarsePipeline = getCoarsePipeline(project);
+        if(!coarsePipeline.empty()) {
+            key += "coarse " + project.getResultKey(uid, coarsePipeline) + " ";
+            key += project.getProjectSetting("tissue/coarse-class", 1).toString().toStdString() + " ";
+            key += project.getProjectSetting("tissue/coarse-threshold", 0.5).toString().toStdString() + "\n";
+        }
+        return QCryptographicHash::hash(QByteArray::fromStdString(key), QCryptographicHash::Sha256).toHex().toStdString();
+    }
+
+    std::shared_ptr<Image> TissueMaskCache::getMask(Project& project, const std::string& uid, std::shared_ptr<ImagePyramid> WSI) {
+        const std::string folder = join(project.getRootFolder(), "tissue");
+        const std::string filename = join(folder, uid + ".mhd");
+        const std::string keyFilename = join(folder, uid + ".key");
+        const std::string key = getKey(project, uid);
+        {
+            std::ifstream file(keyFilename);
+            std::string storedKey;
+            if(std::getline(file, storedKey) && storedKey == key && fileExists(filename)) {
+                try {
+                    return MetaImageImporter::create(filename)->runAndGetOutputData<Image>();
+                } catch(Exception &e) {
+                    std::cout << "Unable to read cached mask of " << uid << ", computing it again: " << e.what() << std::endl;
+                }
+            }
+        }
+
+        auto mask = computeMask(project, WSI);
+        createDirectories(folder);
+        auto exporter = MetaImageExporter::create(filename)
+                ->connect(mask);
+        exporter->run();
+        // The key is written last, thus a partially written mask is never used
+        std::ofstream file(keyFilename, std::iostream::out);
+        file << key << "\n";
+        file.close();
+        return mask;
+    }
+
+    std::shared_ptr<Image> TissueMaskCache::computeMask(Project& project, std::shared_ptr<ImagePyramid> WSI) {
+        const std::string coarsePipeline = getCoarsePipeline(project);
+        if(coarsePipeline.empty()) {
+            auto segmentation = TissueSegmentation::create()
+                    ->connect(WSI);
+            return segmentation->runAndGetOutputData<Image>();
+        }
+
+        Pipeline pipeline(coarsePipeline);
+        pipeline.parse({{"WSI", WSI}}, {}, false);
+        auto data = pipeline.getAllPipelineOutputData();
+        if(data.empty())
+            throw Exception("The coarse pipeline " + coarsePipeline + " has no output data");
+        // Heatmaps are preferred, as they can be thresholded on confidence
+        std::shared_ptr<DataObject> output = data.begin()->second;
+        for(auto& item : data) {
+            if(std::dynamic_pointer_cast<Tensor>(item.second))
+                output = item.second;
+        }
+        return thresholdCoarseOutput(
+                output,
+                project.getProjectSetting("tissue/coarse-class", 1).toInt(),
+                project.getProjectSetting("tissue/coarse-threshold", 0.5).toFloat()
+        );
+    }
+
+    std::shared_ptr<Image> TissueMaskCache::thresholdCoarseOutput(std::shared_ptr<DataObject> data, int classIndex, float threshold) {
+        if(auto tensor = std::dynamic_pointer_cast<Tensor>(data)) {
+            // Heatmap of height x width x classes
+            auto shape = tensor->getShape();
+            if(shape.getDimensions() != 3 || classIndex >= shape[2])
+                throw Exception("The coarse pipeline must output a heatmap with class " + std::to_string(classIndex));
+            const int height = shape[0];
+            const int width = shape[1];
+            const int channels = shape[2];
+            auto access = tensor->getAccess(ACCESS_READ);
+            const float* values = access->getRawData();
+            std::vector<uchar> mask(width*height);
+            for(int i = 0; i < width*height; ++i)
+                mask[i] = values[i*channels + classIndex] >= threshold ? 1 : 0;
+            auto image = Image::create(width, height, TYPE_UINT8, 1, mask.data());
+            image->setSpacing(tensor->getSpacing());
+            return image;
+        }
+
+        std::shared_ptr<Image> segmentation = std::dynamic_pointer_cast<Image>(data);
+        if(auto pyramid = std::dynamic_pointer_cast<ImagePyramid>(data))
+            segmentation = pyramid->getAccess(ACCESS_READ)->getLevelAsImage(pyramid->getNrOfLevels() - 1);
+        if(!segmentation || segmentation->getDataType() != TYPE_UINT8)
+            throw Exception("The coarse pipeline must output a heatmap or a segmentation");
+        // Segmentations have no confidence, the mask is where the label is the class
+        const int size = segmentation->getWidth()*segmentation->getHeight();
+        auto access = segmentation->getImageAccess(ACCESS_READ);
+        const uchar* labels = (const uchar*)access->get();
+        std::vector<uchar> mask(size);
+        for(int i = 0; i < size; ++i)
+            mask[i] = labels[i] == classIndex ? 1 : 0;
+        auto image = Image::create(segmentation->getWidth(), segmentation->getHeight(), TYPE_UINT8, 1, mask.data());
+        image->setSpacing(segmentation->getSpacing());
+        return image;
+    }
+
+    int TissueMaskCache::apply(std::shared_ptr<Pipeline> pipeline, std::shared_ptr<Image> mask) {
+        auto processObjects = pipeline->getProcessObjects();
+        const PipelineGraph graph(pipeline->getFilename());
+        int gated = 0;
+        for(auto& processObject : processObjects) {
+            auto generator = std::dynamic_pointer_cast<PatchGenerator>(processObject.second);
+            if(!generator)
+                continue;
+            const auto connection = graph.getSource(processObject.first, 1);
+            if(!connection.source.empty() && (processObjects.count(connection.source) == 0 ||
+                    !std::dynamic_pointer_cast<TissueSegmentation>(processObjects[connection.source])))
+                continue; // Masked by something else than tissue, e.g. an earlier model
+            generator->setInputData(1, mask);
+            ++gated;
+        }
+        return gated;
+    }
+} // End of namespace fast
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <memory>
+
+namespace fast{
+    class Project;
+    class Pipeline;
+    class Image;
+    class ImagePyramid;
+    class DataObject;
+
+    /**
+     * Patch gating masks of the WSIs of a project, computed once per WSI and reused by every pipeline.
+     *
+     * With the project setting tissue/cache-masks, the mask is the output of TissueSegmentation. With
+     * tissue/coarse-pipeline set to a pipeline file, the mask is instead the output of that (cheap, low magnification)
+     * pipeline, thresholded with tissue/coarse-threshold (default 0.5) for class tissue/coarse-class (default 1), so
+     * that the high resolution model only sees patches the coarse model marked as relevant.
+     *
+     * Masks are stored in the tissue folder of the project, with a key covering the WSI, and for coarse masks the
+     * coarse pipeline, its models and the threshold.
+     */
+    class TissueMaskCache {
+        public:
+            /**
+             * @brief isEnabled Whether a mask is used for the project, see the project settings above.
+             */
+            static bool isEnabled(Project& project);
+            /**
+             * @brief getMask Mask of a WSI, read from the cache, or computed and stored if missing or outdated.
+             * Blocks while computing. Can be called from any thread.
+             * @param project
+             * @param uid Unique identifier of the WSI.
+             * @param WSI The WSI, already imported.
+             */
+            static std::shared_ptr<Image> getMask(Project& project, const std::string& uid, std::shared_ptr<ImagePyramid> WSI);
+            /**
+             * @brief apply Use the mask in each PatchGenerator of a parsed pipeline which has no mask, or which is
+             * masked by a TissueSegmentation of the pipeline. Other masks are kept.
+             * @return Nr of patch generators using the mask.
+             */
+            static int apply(std::shared_ptr<Pipeline> pipeline, std::shared_ptr<Image> mask);
+            /**
+             * @brief getKey Key of the mask of a WSI, which changes when the mask would.
+             */
+            static std::string getKey(Project& project, const std::string& uid);
+        protected:
+            static std::shared_ptr<Image> computeMask(Project& project, std::shared_ptr<ImagePyramid> WSI);
+            /**
+             * Pixels of a heatmap, or labels of a segmentation, where the class is at least the threshold.
+             */
+            static std::shared_ptr<Image> thresholdCoarseOutput(std::shared_ptr<DataObject> data, int classIndex, float threshold);
+    };
+} // End of namespace fast
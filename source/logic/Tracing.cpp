@@ -0,0 +1,180 @@
+#include "Tracing.h"
+#include "source/utils/utilities.h"
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstring>
+
+namespace fast{
+    /**
+     * One span, or instant event if duration is negative. Times are in nanoseconds since the start of tracing.
+     */
+    class TraceEvent {
+        public:
+            const char* category = nullptr;
+            const char* name = nullptr;
+            char detail[64];
+            std::int64_t start = 0;
+            std::int64_t duration = 0;
+    };
+
+    /**
+     * Events of one thread. Only the owning thread writes, dump reads the written range and discards events which
+     * may have been overwritten while reading.
+     */
+    class TraceBuffer {
+        public:
+            explicit TraceBuffer(int capacity) : events(capacity) {}
+            std::vector<TraceEvent> events;
+            std::atomic<std::uint64_t> written{0};
+            std::atomic<std::uint64_t> cleared{0}; /* Events before this are removed */
+            int id = 0;
+            std::mutex nameMutex;
+            std::string name;
+    };
+
+    std::atomic_bool Tracing::m_enabled(false);
+
+    static std::mutex buffersMutex;
+    static std::vector<std::shared_ptr<TraceBuffer>> buffers; /* Kept when their thread has finished */
+    static const auto traceStart = std::chrono::steady_clock::now();
+
+    static std::int64_t toNanoseconds(std::chrono::steady_clock::time_point time) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(time - traceStart).count();
+    }
+
+    static TraceBuffer& getThreadBuffer() {
+        thread_local std::shared_ptr<TraceBuffer> buffer;
+        if(!buffer) {
+            static const int capacity = std::max(1024, getSetting("tracing/events-per-thread", 65536).toInt());
+            buffer = std::make_shared<TraceBuffer>(capacity);
+            std::lock_guard<std::mutex> lock(buffersMutex);
+            buffer->id = buffers.size() + 1;
+            buffers.push_back(buffer);
+        }
+        return *buffer;
+    }
+
+    void Tracing::setEnabled(bool enabled) {
+        m_enabled = enabled;
+    }
+
+    void Tracing::setThreadName(const std::string& name) {
+        auto& buffer = getThreadBuffer();
+        std::lock_guard<std::mutex> lock(buffer.nameMutex);
+        buffer.name = name;
+    }
+
+    void Tracing::add(const char* category, const char* name, const std::string& detail, std::int64_t start, std::int64_t duration) {
+        auto& buffer = getThreadBuffer();
+        const std::uint64_t index = buffer.written.load(std::memory_order_relaxed);
+        TraceEvent& event = buffer.events[index % buffer.events.size()];
+        event.category = category;
+        event.name = name;
+        std::strncpy(event.detail, detail.c_str(), sizeof(event.detail) - 1);
+        event.detail[sizeof(event.detail) - 1] = '\0';
+        event.start = start;
+        event.duration = duration;
+        buffer.written.store(index + 1, std::memory_order_release);
+    }
+
+    void Tracing::record(const char* category, const char* name, const std::string& detail, std::chrono::steady_clock::time_point start) {
+        if(!isEnabled())
+            return;
+        const std::int64_t begin = toNanoseconds(start);
+        add(category, name, detail, begin, toNanoseconds(std::chrono::steady_clock::now()) - begin);
+    }
+
+    void Tracing::instant(const char* category, const char* name, const std::string& detail) {
+        if(!isEnabled())
+            return;
+        add(category, name, detail, toNanoseconds(std::chrono::steady_clock::now()), -1);
+    }
+
+    bool Tracing::dump(const std::string& filename) {
+        std::vector<std::shared_ptr<TraceBuffer>> threads;
+        {
+            std::lock_guard<std::mutex> lock(buffersMutex);
+            threads = buffers;
+        }
+        const qint64 pid = QCoreApplication::applicationPid();
+        QJsonArray events;
+        for(auto& buffer : threads) {
+            {
+                std::lock_guard<std::mutex> lock(buffer->nameMutex);
+                if(!buffer->name.empty()) {
+                    QJsonObject metadata;
+                    metadata["name"] = "thread_name";
+                    metadata["ph"] = "M";
+                    metadata["pid"] = pid;
+                    metadata["tid"] = buffer->id;
+                    metadata["args"] = QJsonObject{{"name", QString::fromStdString(buffer->name)}};
+                    events.append(metadata);
+                }
+            }
+            const std::uint64_t capacity = buffer->events.size();
+            const std::uint64_t end = buffer->written.load(std::memory_order_acquire);
+            const std::uint64_t begin = std::max(end > capacity ? end - capacity : 0, buffer->cleared.load());
+            std::vector<TraceEvent> copy;
+            copy.reserve(end - begin);
+            for(std::uint64_t i = begin; i < end; ++i)
+                copy.push_back(buffer->events[i % capacity]);
+            // Events the thread has overwritten while copying are incomplete, as is the slot of the event it may be
+            // writing now (written is increased after an event is complete)
+            const std::uint64_t after = buffer->written.load(std::memory_order_acquire);
+            const std::uint64_t valid = after + 1 > capacity ? after + 1 - capacity : 0;
+            for(std::uint64_t i = std::max(begin, valid); i < end; ++i) {
+                const TraceEvent& event = copy[i - begin];
+                QJsonObject object;
+                object["name"] = event.name;
+                object["cat"] = event.category;
+                object["pid"] = pid;
+                object["tid"] = buffer->id;
+                object["ts"] = event.start / 1000.0; // Microseconds
+                if(event.duration >= 0) {
+                    object["ph"] = "X";
+                    object["dur"] = event.duration / 1000.0;
+                } else {
+                    object["ph"] = "i";
+                    object["s"] = "t";
+                }
+                if(event.detail[0] != '\0')
+                    object["args"] = QJsonObject{{"detail", QString(event.detail)}};
+                events.append(object);
+            }
+        }
+        QJsonObject document;
+        document["traceEvents"] = events;
+        document["displayTimeUnit"] = "ms";
+        QFile file(QString::fromStdString(filename));
+        if(!file.open(QIODevice::WriteOnly))
+            return false;
+        const QByteArray json = QJsonDocument(document).toJson(QJsonDocument::Compact);
+        return file.write(json) == json.size();
+    }
+
+    void Tracing::clear() {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        for(auto& buffer : buffers)
+            buffer->cleared = buffer->written.load();
+    }
+
+    TraceScope::TraceScope(const char* category, const char* name, const std::string& detail) :
+        m_category(category), m_name(name) {
+        if(!Tracing::isEnabled())
+            return;
+        m_active = true;
+        m_detail = detail;
+        m_start = std::chrono::steady_clock::now();
+    }
+
+    TraceScope::~TraceScope() {
+        if(m_active)
+            Tracing::record(m_category, m_name, m_detail, m_start);
+    }
+} // End of namespace fast
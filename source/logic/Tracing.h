@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace fast{
+    /**
+     * Records spans of the work done by each thread, e.g. import, parse, inference and export of a WSI, and writes
+     * them as a Chrome trace (JSON), which can be opened in chrome://tracing or ui.perfetto.dev.
+     *
+     * Each thread records into its own ring buffer of tracing/events-per-thread (default 65536) events, thus
+     * recording takes no locks, and the oldest events of a thread are overwritten when it is full. When disabled,
+     * a span only costs a relaxed atomic load. Enabled at start with the setting tracing/enabled, and at any time
+     * with setEnabled.
+     *
+     * Categories and names must be string literals, they are stored as pointers. Details, e.g. the uid of a WSI, are
+     * copied, and truncated to 63 characters.
+     */
+    class Tracing {
+        public:
+            static void setEnabled(bool enabled);
+            static bool isEnabled() { return m_enabled.load(std::memory_order_relaxed); }
+            /**
+             * @brief setThreadName Name of the calling thread in the trace.
+             */
+            static void setThreadName(const std::string& name);
+            /**
+             * @brief record Add a span of the calling thread from start until now. Does nothing if disabled.
+             */
+            static void record(const char* category, const char* name, const std::string& detail, std::chrono::steady_clock::time_point start);
+            /**
+             * @brief instant Add an event without duration, e.g. a summary of runtime measurements.
+             */
+            static void instant(const char* category, const char* name, const std::string& detail);
+            /**
+             * @brief dump Write the events of all threads, including threads which have finished, as a Chrome trace.
+             * The events are kept. Can be called while other threads are recording.
+             * @return false if the file could not be written.
+             */
+            static bool dump(const std::string& filename);
+            /**
+             * @brief clear Remove the recorded events of all threads.
+             */
+            static void clear();
+        private:
+            static void add(const char* category, const char* name, const std::string& detail, std::int64_t start, std::int64_t duration);
+            static std::atomic_bool m_enabled;
+    };
+
+    /**
+     * Span from construction to destruction, e.g. of a function, if tracing is enabled at construction.
+     */
+    class TraceScope {
+        public:
+            TraceScope(const char* category, const char* name, const std::string& detail = std::string());
+            ~TraceScope();
+            TraceScope(const TraceScope&) = delete;
+            TraceScope& operator=(const TraceScope&) = delete;
+        private:
+            const char* m_category;
+            const char* m_name;
+            std::string m_detail;
+            bool m_active = false;
+            std::chrono::steady_clock::time_point m_start;
+    };
+} // End of namespace fast
@@ -1,65 +1,253 @@
 #include "WholeSlideImage.h"
+#include "RemoteSlideCache.h"
+#include "Tracing.h"
 #include <FAST/Importers/WholeSlideImageImporter.hpp>
 #include <FAST/Visualization/ImagePyramidRenderer/ImagePyramidRenderer.hpp>
 #include <FAST/Data/ImagePyramid.hpp>
 #include <FAST/Data/Image.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__) || defined(__AVX__)
+#include <tmmintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FP_USE_NEON
+#endif
 
 namespace fast{
+    // Thumbnails are created from the smallest pyramid level with at least this size (longest side, in pixels)
+    static const int THUMBNAIL_SIZE = 512;
+
+    /**
+     * Converts one row of interleaved 8 bit pixels with 1, 3 or 4 channels to QImage::Format_RGB32 (0xffRRGGBB).
+     * The SIMD paths assume a little endian memory layout (BGRA byte order), which holds for x86 and ARM.
+     * @param src Row of width*channels bytes
+     * @param dst Row of width 32 bit pixels
+     * @param width
+     * @param channels
+     */
+    static void convertRowToRGB32(const uint8_t* src, uint32_t* dst, int width, int channels) {
+        int x = 0;
+        if(channels == 3) {
+#if defined(FP_USE_NEON)
+            for(; x + 16 <= width; x += 16) {
+                uint8x16x3_t rgb = vld3q_u8(src + x*3);
+                uint8x16x4_t bgra;
+                bgra.val[0] = rgb.val[2];
+                bgra.val[1] = rgb.val[1];
+                bgra.val[2] = rgb.val[0];
+                bgra.val[3] = vdupq_n_u8(255);
+                vst4q_u8((uint8_t*)(dst + x), bgra);
+            }
+#elif defined(__SSSE3__) || defined(__AVX__) || defined(__AVX2__)
+            const __m128i shuffle = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+            const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+            // Each load reads 16 bytes of which 12 (4 pixels) are used, stop early to stay within the row
+            for(; x + 6 <= width; x += 4) {
+                __m128i rgb = _mm_loadu_si128((const __m128i*)(src + x*3));
+                _mm_storeu_si128((__m128i*)(dst + x), _mm_or_si128(_mm_shuffle_epi8(rgb, shuffle), alpha));
+            }
+#endif
+            for(; x < width; ++x)
+                dst[x] = 0xFF000000u | ((uint32_t)src[x*3] << 16) | ((uint32_t)src[x*3 + 1] << 8) | src[x*3 + 2];
+        } else if(channels == 4) {
+#if defined(FP_USE_NEON)
+            for(; x + 16 <= width; x += 16) {
+                uint8x16x4_t rgba = vld4q_u8(src + x*4);
+                uint8x16x4_t bgra;
+                bgra.val[0] = rgba.val[2];
+                bgra.val[1] = rgba.val[1];
+                bgra.val[2] = rgba.val[0];
+                bgra.val[3] = vdupq_n_u8(255);
+                vst4q_u8((uint8_t*)(dst + x), bgra);
+            }
+#elif defined(__AVX2__)
+            const __m256i shuffle = _mm256_setr_epi8(2, 1, 0, -1, 6, 5, 4, -1, 10, 9, 8, -1, 14, 13, 12, -1,
+                                                     2, 1, 0, -1, 6, 5, 4, -1, 10, 9, 8, -1, 14, 13, 12, -1);
+            const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+            for(; x + 8 <= width; x += 8) {
+                __m256i rgba = _mm256_loadu_si256((const __m256i*)(src + x*4));
+                _mm256_storeu_si256((__m256i*)(dst + x), _mm256_or_si256(_mm256_shuffle_epi8(rgba, shuffle), alpha));
+            }
+#elif defined(__SSSE3__) || defined(__AVX__)
+            const __m128i shuffle = _mm_setr_epi8(2, 1, 0, -1, 6, 5, 4, -1, 10, 9, 8, -1, 14, 13, 12, -1);
+            const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+            for(; x + 4 <= width; x += 4) {
+                __m128i rgba = _mm_loadu_si128((const __m128i*)(src + x*4));
+                _mm_storeu_si128((__m128i*)(dst + x), _mm_or_si128(_mm_shuffle_epi8(rgba, shuffle), alpha));
+            }
+#endif
+            // Alpha is dropped, Format_RGB32 requires it to be 0xff
+            for(; x < width; ++x)
+                dst[x] = 0xFF000000u | ((uint32_t)src[x*4] << 16) | ((uint32_t)src[x*4 + 1] << 8) | src[x*4 + 2];
+        } else { // Grayscale
+#if defined(FP_USE_NEON)
+            for(; x + 16 <= width; x += 16) {
+                uint8x16_t gray = vld1q_u8(src + x);
+                uint8x16x4_t bgra;
+                bgra.val[0] = gray;
+                bgra.val[1] = gray;
+                bgra.val[2] = gray;
+                bgra.val[3] = vdupq_n_u8(255);
+                vst4q_u8((uint8_t*)(dst + x), bgra);
+            }
+#elif defined(__SSSE3__) || defined(__AVX__) || defined(__AVX2__)
+            const __m128i shuffle = _mm_setr_epi8(0, 0, 0, -1, 1, 1, 1, -1, 2, 2, 2, -1, 3, 3, 3, -1);
+            const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+            for(; x + 4 <= width; x += 4) {
+                int32_t pixels;
+                std::memcpy(&pixels, src + x, 4);
+                __m128i gray = _mm_cvtsi32_si128(pixels);
+                _mm_storeu_si128((__m128i*)(dst + x), _mm_or_si128(_mm_shuffle_epi8(gray, shuffle), alpha));
+            }
+#endif
+            for(; x < width; ++x)
+                dst[x] = 0xFF000000u | ((uint32_t)src[x] << 16) | ((uint32_t)src[x] << 8) | src[x];
+        }
+    }
     WholeSlideImage::WholeSlideImage(const std::string filename): _filename(filename)
     {
-        this->init();
     }
 
     WholeSlideImage::WholeSlideImage(const std::string filename, const QImage thumbnail):_filename(filename), _thumbnail(thumbnail)
     {
-        auto importer = WholeSlideImageImporter::New();
-        importer->setFilename(this->_filename);
-        auto currImage = importer->updateAndGetOutputData<ImagePyramid>();
-        this->_image = currImage;
-        this->_metadata = this->_image->getMetadata(); // Can be dropped?
     }
 
     WholeSlideImage::~WholeSlideImage()
     {
     }
 
-    void WholeSlideImage::init()
+    void WholeSlideImage::load()
     {
+        if(this->_image)
+            return;
+        // The importer reads local files, thus remote slides are opened from the block cache
+        auto lease = RemoteSlideCache::getInstance().acquire(this->_filename);
+        const std::string filename = lease->getFilename();
+        TraceScope trace("import", "import WSI", filename);
         auto importer = WholeSlideImageImporter::New();
-        importer->setFilename(this->_filename);
+        importer->setFilename(filename);
         auto currImage = importer->updateAndGetOutputData<ImagePyramid>();
         this->_image = currImage;
+        m_lease = lease;
         this->_metadata = this->_image->getMetadata(); // Can be dropped?
-        this->create_thumbnail();
+    }
+
+    std::shared_ptr<SlideLease> WholeSlideImage::get_local_file()
+    {
+        return RemoteSlideCache::getInstance().acquire(this->_filename);
+    }
+
+    void WholeSlideImage::init()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        this->load();
+        if(this->_thumbnail.isNull())
+            this->create_thumbnail();
+    }
+
+    std::shared_ptr<ImagePyramid> WholeSlideImage::get_image_pyramid()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        this->load();
+        return this->_image;
+    }
+
+    bool WholeSlideImage::is_loaded()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return (bool)this->_image;
+    }
+
+    QImage WholeSlideImage::get_thumbnail()
+    {
+        if(!this->has_thumbnail()) {
+            if(RemoteSlideCache::isRemote(this->_filename) && !is_loaded() && !RemoteSlideCache::getInstance().isCached(this->_filename))
+                return QImage(); // Not worth fetching the whole slide
+            this->init();
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return this->_thumbnail;
+    }
+
+    bool WholeSlideImage::has_thumbnail()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return !this->_thumbnail.isNull();
+    }
+
+    void WholeSlideImage::clear_thumbnail()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        this->_thumbnail = QImage();
     }
 
     void WholeSlideImage::create_thumbnail()
     {
-        // @TODO: This is a little bit slow. Possible to speed it up? Bottleneck is probably the creation of thumbnails
+        TraceScope trace("import", "create thumbnail", this->_filename);
+        // Use the smallest level which is still at least THUMBNAIL_SIZE, the lowest level can be very large for some scanners
+        int level = this->_image->getNrOfLevels() - 1;
+        while(level > 0 && std::max(this->_image->getLevelWidth(level), this->_image->getLevelHeight(level)) < THUMBNAIL_SIZE)
+            --level;
         auto access = this->_image->getAccess(ACCESS_READ);
-        auto input = access->getLevelAsImage(this->_image->getNrOfLevels() - 1);
-
-        // try to convert to FAST Image -> QImage
-//        QImage image(input->getWidth(), input->getHeight(), QImage::Format_RGB32);
-        this->_thumbnail = QImage(input->getWidth(), input->getHeight(), QImage::Format_RGB32);
+        auto input = access->getLevelAsImage(level);
 
-        // @TODO have to do some type conversion here, assuming float for now
-        unsigned char *pixelData = this->_thumbnail.bits();
+        const int width = input->getWidth();
+        const int height = input->getHeight();
+        const int channels = input->getNrOfChannels();
+        if(channels != 1 && channels != 3 && channels != 4)
+            throw Exception("Unsupported number of channels for thumbnail creation: " + std::to_string(channels));
+        this->_thumbnail = QImage(width, height, QImage::Format_RGB32);
 
         ImageAccess::pointer new_access = input->getImageAccess(ACCESS_READ);
-        void *inputData = new_access->get();
-        uint nrOfComponents = input->getNrOfChannels();
-
-        for (uint x = 0; x < (uint)input->getWidth(); x++) {
-            for (uint y = 0; y < (uint)input->getHeight(); y++) {
-                uint i = x + y * input->getWidth();
-                for (uint c = 0; c < (uint)input->getNrOfChannels(); c++) {
-                    float data;
-                    data = ((uchar *) inputData)[i * nrOfComponents + c]; // assumes TYPE_UINT8
-                    pixelData[i * 4 + (2-c)] = (unsigned char) data;  // TODO: NOTE (2-c) fixed BGR->RGB, but maybe there is a smarter solution?
-                    pixelData[i * 4 + 3] = 255; // Alpha
-                }
+        const void *inputData = new_access->get();
+        const std::size_t rowElements = (std::size_t)width*channels;
+
+        // Row-major traversal. Other data types are first converted to a row of 8 bit values.
+        std::vector<uint8_t> row;
+        float floatScale = 255.0f;
+        switch(input->getDataType()) {
+            case TYPE_UINT8:
+                break;
+            case TYPE_UINT16:
+                row.resize(rowElements);
+                break;
+            case TYPE_FLOAT: {
+                row.resize(rowElements);
+                // Float images may be normalized to [0, 1] or be in [0, 255]
+                const float* data = (const float*)inputData;
+                const float maxValue = *std::max_element(data, data + rowElements*height);
+                if(maxValue > 1.0f)
+                    floatScale = 1.0f;
+                break;
             }
+            default:
+                throw Exception("Unsupported data type for thumbnail creation");
         }
+
+        for(int y = 0; y < height; ++y) {
+            const uint8_t* src;
+            if(input->getDataType() == TYPE_UINT8) {
+                src = (const uint8_t*)inputData + y*rowElements;
+            } else if(input->getDataType() == TYPE_UINT16) {
+                const uint16_t* data = (const uint16_t*)inputData + y*rowElements;
+                for(std::size_t i = 0; i < rowElements; ++i)
+                    row[i] = (uint8_t)(data[i] >> 8);
+                src = row.data();
+            } else {
+                const float* data = (const float*)inputData + y*rowElements;
+                for(std::size_t i = 0; i < rowElements; ++i)
+                    row[i] = (uint8_t)std::min(std::max(data[i]*floatScale, 0.0f), 255.0f);
+                src = row.data();
+            }
+            convertRowToRGB32(src, (uint32_t*)this->_thumbnail.scanLine(y), width, channels);
+        }
+
+        if(std::max(width, height) > THUMBNAIL_SIZE)
+            this->_thumbnail = this->_thumbnail.scaled(THUMBNAIL_SIZE, THUMBNAIL_SIZE, Qt::KeepAspectRatio, Qt::SmoothTransformation);
     }
 } // End of namespace fast
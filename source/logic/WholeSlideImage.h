@@ -4,26 +4,61 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <map>
 #include <QImage>
 
 namespace fast{
     class ImagePyramid;
+    class SlideLease;
 
     class WholeSlideImage {
         public:
+            /**
+             * @brief WholeSlideImage Create a WSI handle. The file is not opened until the image pyramid
+             * or the thumbnail is requested.
+             * @param filename Disk location of the WSI, or an s3:// or http(s):// URI.
+             */
             WholeSlideImage(const std::string filename);
+            /**
+             * @brief WholeSlideImage Create a WSI handle with a previously computed (cached) thumbnail.
+             * @param filename Disk location of the WSI.
+             * @param thumbnail Thumbnail loaded from the project cache.
+             */
             WholeSlideImage(const std::string filename, const QImage thumbnail);
             ~WholeSlideImage();
 
             std::string get_filename(){return _filename;}
-            QImage get_thumbnail() {return _thumbnail;}
-            std::shared_ptr<ImagePyramid> get_image_pyramid(){return _image;}
+            /**
+             * Returns the thumbnail, importing the WSI and creating the thumbnail first if it was not cached.
+             * A remote WSI is not fetched for its thumbnail, the thumbnail is empty until the WSI is imported or
+             * completely in the remote slide cache.
+             */
+            QImage get_thumbnail();
+            bool has_thumbnail();
+            /**
+             * Drops the thumbnail from memory, e.g. when it has been stored in the project thumbnail cache.
+             */
+            void clear_thumbnail();
+            /**
+             * Returns the image pyramid, importing the WSI on first access.
+             */
+            std::shared_ptr<ImagePyramid> get_image_pyramid();
+            /**
+             * Returns the local file of the WSI, fetching it to the remote slide cache first if it is remote. The
+             * file is kept in the cache while the lease exists, thus it must be held while the file is used.
+             */
+            std::shared_ptr<SlideLease> get_local_file();
+            bool is_loaded();
 
             void init();
 
         private:
+            /**
+             * Imports the WSI if it has not been imported yet. Assumes m_mutex is locked.
+             */
+            void load();
             /**
              * Gets the thumbnail image and stores it as a QImage.
              * @return
@@ -35,5 +70,7 @@ namespace fast{
             std::map<std::string, std::string> _metadata; /* */
             std::shared_ptr<ImagePyramid> _image; /* Loaded WSI */
             QImage _thumbnail; /* Thumbnail for the WSI */
+            std::mutex m_mutex; /* Guards lazy import, which may happen from the computation thread */
+            std::shared_ptr<SlideLease> m_lease; /* Local file of the imported WSI, kept while it is imported */
     };
-}
\ No newline at end of file
+}
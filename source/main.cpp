@@ -1,5 +1,7 @@
 #include <FAST/Tools/CommandLineParser.hpp>
 #include "source/gui/MainWindow.hpp"
+#include "source/logic/EngineCache.h"
+#include "source/logic/Tracing.h"
 
 using namespace fast;
 
@@ -7,6 +9,12 @@ int main(int argc, char** argv) {
     CommandLineParser parser("FastPathology", "An open-source platform for deep learning-based research and decision support in digital pathology");
     parser.parse(argc, argv);
 
+    // Compiled inference engines are kept in ~/fastpathology/cache/engines/
+    EngineCache::setup();
+    // Can also be toggled in the Process tab, where the trace is saved
+    Tracing::setEnabled(getSetting("tracing/enabled", false).toBool());
+    Tracing::setThreadName("main");
+
     // Setup window
     auto window = MainWindow::New();
     window->start();
@@ -11,6 +11,12 @@
 #include <FAST/Utility.hpp>
 #include <QProgressDialog>
 #include <QEventLoop>
+#include <QSettings>
+#include <QDir>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include "source/logic/DownloadManager.h"
 
 
 namespace fast {
@@ -28,6 +34,27 @@ namespace fast {
         return out;
     }
 
+    /**
+     * Reads an application setting from ~/fastpathology/settings.ini.
+     * @param key Name of the setting, e.g. "ingest/workers"
+     * @param defaultValue Value returned if the setting has not been set
+     * @return
+     */
+    static QVariant getSetting(const QString& key, const QVariant& defaultValue = QVariant()) {
+        QSettings settings(QDir::homePath() + "/fastpathology/settings.ini", QSettings::IniFormat);
+        return settings.value(key, defaultValue);
+    }
+
+    /**
+     * Stores an application setting in ~/fastpathology/settings.ini.
+     * @param key Name of the setting
+     * @param value
+     */
+    static void setSetting(const QString& key, const QVariant& value) {
+        QSettings settings(QDir::homePath() + "/fastpathology/settings.ini", QSettings::IniFormat);
+        settings.setValue(key, value);
+    }
+
     // for string delimiter
     static std::vector<std::string> splitCustom(const std::string& s, const std::string& delimiter) {
         size_t pos_start = 0, pos_end, delim_len = delimiter.length();
@@ -46,62 +73,67 @@ namespace fast {
 
 
 
-    static void downloadZipFile(std::string URL, std::string destination, std::string title) {
-        createDirectories(destination);
-        std::cout << "Progress: " << std::endl;
-        QNetworkAccessManager manager;
-        QUrl url(QString::fromStdString(URL));
-        QNetworkRequest request(url);
-        auto timer = new QElapsedTimer;
-        timer->start();
-        auto reply = manager.get(request);
-        int step = 5;
-        int progress = step;
-        auto progressDialog = new QProgressDialog("Downloading " + QString::fromStdString(title) +", please wait..", "Stop", 0, 101);
-        progressDialog->setModal(Qt::ApplicationModal);
-        QObject::connect(progressDialog, &QProgressDialog::canceled, reply, &QNetworkReply::abort);
+    /**
+     * Downloads a zip file and extracts it to a folder, in a worker thread with the DownloadManager, while showing
+     * the progress. A stopped or failed download is resumed the next time the same URL is downloaded.
+     * @param URL
+     * @param destination Folder to extract to
+     * @param title Shown in the progress dialog
+     * @param sha256 Optional hex SHA-256 checksum of the zip file, see DownloadManager::download
+     * @return Whether the download and extraction succeeded
+     */
+    static bool downloadZipFile(std::string URL, std::string destination, std::string title, std::string sha256 = "") {
+        auto progressDialog = new QProgressDialog("Downloading " + QString::fromStdString(title) +", please wait..", "Stop", 0, 100);
+        progressDialog->setWindowModality(Qt::ApplicationModal);
         progressDialog->setWindowTitle("Downloading " + QString::fromStdString(title));
-        progressDialog->setAutoClose(true);
+        progressDialog->setAutoClose(false);
         progressDialog->show();
-        QObject::connect(reply, &QNetworkReply::downloadProgress, [&](quint64 current, quint64 max) {
-            int percent = ((float)current / max) * 100;
-            float speed = ((float)timer->elapsed() / 1000.0f)/percent;
-            uint64_t remaining = speed * (100 - percent);
-            if(percent >= progress) {
-                std::cout << percent << "% - ETA ~" << (int)std::ceil((float)remaining / 60) << " minutes. " << std::endl;;
-                progress += step;
-            }
-            progressDialog->setValue(percent);
-        });
-        auto tempLocation = QStandardPaths::writableLocation(QStandardPaths::TempLocation) + "/data.zip";
-        QFile file(tempLocation);
-        if(!file.open(QIODevice::WriteOnly)) {
-            throw Exception("Could not write to " + tempLocation.toStdString());
-        }
-        QObject::connect(reply, &QNetworkReply::readyRead, [&reply, &file]() {
-            file.write(reply->read(reply->bytesAvailable()));
-        });
-        QObject::connect(&manager, &QNetworkAccessManager::finished, [&]() {
-            std::cout << "Finished downloading file. Processing.." << std::endl;
-            file.close();
-            std::cout << "Unzipping the data file to: " << destination << std::endl;
+        std::atomic_bool cancelled(false);
+        QObject::connect(progressDialog, &QProgressDialog::canceled, [&cancelled]() { cancelled = true; });
+
+        QEventLoop eventLoop;
+        std::string error;
+        QElapsedTimer timer;
+        timer.start();
+        const int step = 5;
+        int printed = 0;
+        std::thread thread([&]() {
             try {
-                extractZipFile(file.fileName().toStdString(), destination);
-            } catch(Exception & e) {
-                std::cout << "ERROR: Zip extraction failed." << std::endl;
+                DownloadManager::downloadZipFile(URL, destination, [&](std::int64_t current, std::int64_t total) {
+                    if(total > 0) {
+                        const int percent = (int)(100*current / total);
+                        if(percent >= printed + step) {
+                            const float remaining = ((float)timer.elapsed() / 1000.0f) / current * (total - current);
+                            std::cout << percent << "% - ETA ~" << (int)std::ceil(remaining / 60) << " minutes. " << std::endl;
+                            printed = percent;
+                        }
+                        QMetaObject::invokeMethod(progressDialog, [progressDialog, percent]() {
+                            progressDialog->setValue(percent);
+                        }, Qt::QueuedConnection);
+                    }
+                    return !cancelled;
+                }, sha256);
+            } catch(Exception &e) {
+                error = e.what();
+            } catch(std::exception &e) {
+                // E.g. std::bad_alloc, or errors of Qt or the standard library. The thread must not terminate the
+                // application, nor leave the event loop waiting.
+                error = std::string("Unexpected error: ") + e.what();
+            } catch(...) {
+                error = "Unknown error";
             }
-
-            file.remove();
-            std::cout << "Done." << std::endl;
-            progressDialog->setValue(101);
+            QMetaObject::invokeMethod(&eventLoop, "quit", Qt::QueuedConnection);
         });
-
-        auto eventLoop = new QEventLoop(&manager);
-
-        // Make sure to quit the event loop when download is finished
-        QObject::connect(&manager, &QNetworkAccessManager::finished, eventLoop, &QEventLoop::quit);
-
-        // Wait for it to finish
-        eventLoop->exec();
+        // The GUI stays responsive while downloading and extracting
+        eventLoop.exec();
+        thread.join();
+        progressDialog->close();
+        progressDialog->deleteLater();
+        if(!error.empty()) {
+            std::cout << "ERROR: " << error << std::endl;
+            return false;
+        }
+        std::cout << "Done." << std::endl;
+        return true;
     }
 }